@@ -0,0 +1,222 @@
+/*
+ * capture.c
+ * Server traffic for the benchmarks
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "capture.h"
+
+/*
+ * The benchmarks replay raw server traffic, one IRC line per line of a
+ * file, as recorded with e.g. `socat -v` or a bouncer's raw log. Lines
+ * may end in LF or CRLF. Without a file, a mix modelled on a busy
+ * channel is generated: mostly tagged PRIVMSGs, joins, parts and quits,
+ * NAMES and MOTD numerics, CTCPs and PINGs.
+ */
+
+static const char *capture_templates[] = {
+    "@time=2026-10-17T12:%02u:%02u.000Z;msgid=a%u :nick%u!~user%u@host%u"
+        ".example.org PRIVMSG #channel%u :and that is why the build "
+        "broke again on the %u arm boxes, see the log",
+    "@time=2026-10-17T12:%02u:%02u.000Z;msgid=b%u :nick%u!~user%u@host%u"
+        ".example.org PRIVMSG #channel%u :ok %u",
+    ":nick%u!~user%u@host%u.example.org PRIVMSG #channel%u :has anyone "
+        "tried the %u patch from yesterday? it fixes the reconnect %u",
+    ":nick%u!~user%u@host%u.example.org JOIN #channel%u * :real name %u",
+    ":nick%u!~user%u@host%u.example.org PART #channel%u :leaving %u",
+    ":nick%u!~user%u@host%u.example.org QUIT :Quit: Ping timeout: %u s",
+    ":nick%u!~user%u@host%u.example.org MODE #channel%u +o nick%u",
+    ":nick%u!~user%u@host%u.example.org PRIVMSG #channel%u :\001ACTION "
+        "waves at nick%u\001",
+    ":nick%u!~user%u@host%u.example.org NOTICE tester :\001VERSION "
+        "kirc %u\001",
+    ":irc.example.org 353 tester = #channel%u :@nick%u +nick%u nick%u "
+        "nick%u nick%u nick%u nick%u nick%u",
+    ":irc.example.org 366 tester #channel%u :End of /NAMES list. %u",
+    ":irc.example.org 372 tester :- %u: Be excellent to each other %u",
+    "PING :irc.example.org %u",
+};
+
+/* relative frequency of each template, PRIVMSG heavy */
+static const unsigned int capture_weights[] = {
+    20, 20, 16, 4, 3, 3, 1, 2, 1, 4, 1, 2, 1
+};
+
+/**
+ * capture_generate() - Fill a buffer with synthetic server traffic
+ * @capture: Capture to fill
+ * @size: Approximate number of bytes to generate
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int capture_generate(struct capture *capture, size_t size)
+{
+    size_t count = sizeof(capture_weights) / sizeof(capture_weights[0]);
+    unsigned int total = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        total += capture_weights[i];
+    }
+
+    capture->data = malloc(size + MESSAGE_MAX_LEN);
+
+    if (capture->data == NULL) {
+        return -1;
+    }
+
+    uint32_t seed = 2463534242u;
+
+    while (capture->len < size) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        unsigned int pick = seed % total;
+        size_t t = 0;
+
+        while (pick >= capture_weights[t]) {
+            pick -= capture_weights[t++];
+        }
+
+        unsigned int a = seed % 60;
+        unsigned int b = (seed >> 8) % 500;
+        unsigned int c = (seed >> 16) % 8;
+
+        /* every template takes at most nine numbers */
+        int n = snprintf(capture->data + capture->len, MESSAGE_MAX_LEN - 2,
+            capture_templates[t], a, a, b, b, b, b, c, b, b);
+
+        capture->len += (size_t)n;
+        capture->data[capture->len++] = '\r';
+        capture->data[capture->len++] = '\n';
+        capture->lines++;
+    }
+
+    return 0;
+}
+
+/**
+ * capture_read() - Load recorded traffic from a file
+ * @capture: Capture to fill
+ * @path: File with one raw IRC line per line
+ * @size: Minimum number of bytes; the file is repeated to reach it
+ *
+ * Return: 0 on success, -1 if the file cannot be read or is empty
+ */
+static int capture_read(struct capture *capture, const char *path,
+        size_t size)
+{
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[MESSAGE_MAX_LEN];
+    size_t cap = 0;
+
+    for (;;) {
+        if (fgets(line, sizeof(line), fp) == NULL) {
+            if ((capture->lines == 0) || (capture->len >= size)) {
+                break;
+            }
+
+            rewind(fp);
+            continue;
+        }
+
+        size_t n = strcspn(line, "\r\n");
+
+        if (n == 0) {
+            continue;
+        }
+
+        if (capture->len + n + 2 > cap) {
+            size_t grow = (cap == 0) ? 1 << 20 : cap * 2;
+            char *data = realloc(capture->data, grow);
+
+            if (data == NULL) {
+                fclose(fp);
+                return -1;
+            }
+
+            capture->data = data;
+            cap = grow;
+        }
+
+        memcpy(capture->data + capture->len, line, n);
+        capture->len += n;
+        capture->data[capture->len++] = '\r';
+        capture->data[capture->len++] = '\n';
+        capture->lines++;
+    }
+
+    fclose(fp);
+
+    if (capture->lines == 0) {
+        fprintf(stderr, "%s: no lines\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * capture_load() - Load recorded or synthetic traffic
+ * @capture: Capture to initialize
+ * @path: File with raw IRC lines, or NULL for synthetic traffic
+ * @size: Minimum number of bytes to load
+ *
+ * Return: 0 on success, -1 on failure
+ */
+int capture_load(struct capture *capture, const char *path, size_t size)
+{
+    memset(capture, 0, sizeof(*capture));
+
+    int rc = (path != NULL) ? capture_read(capture, path, size) :
+        capture_generate(capture, size);
+
+    if (rc < 0) {
+        capture_free(capture);
+    }
+
+    return rc;
+}
+
+/**
+ * capture_seconds() - Seconds elapsed since a monotonic timestamp
+ * @since: Earlier CLOCK_MONOTONIC reading
+ *
+ * Return: Elapsed time in seconds
+ */
+double capture_seconds(const struct timespec *since)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - since->tv_sec) +
+        (double)(now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+/**
+ * capture_free() - Release loaded traffic
+ * @capture: Capture to clean up
+ *
+ * Return: 0 on success, -1 if capture is NULL
+ */
+int capture_free(struct capture *capture)
+{
+    if (capture == NULL) {
+        return -1;
+    }
+
+    free(capture->data);
+    capture->data = NULL;
+    capture->len = 0;
+    capture->lines = 0;
+
+    return 0;
+}
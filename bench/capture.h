@@ -0,0 +1,23 @@
+/*
+ * capture.h
+ * Header for the benchmark traffic loader
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_BENCH_CAPTURE_H
+#define __KIRC_BENCH_CAPTURE_H
+
+#include "kirc.h"
+
+struct capture {
+    char *data;    /* CRLF-terminated lines */
+    size_t len;
+    size_t lines;
+};
+
+int capture_load(struct capture *capture, const char *path, size_t size);
+double capture_seconds(const struct timespec *since);
+int capture_free(struct capture *capture);
+
+#endif  // __KIRC_BENCH_CAPTURE_H
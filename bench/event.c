@@ -0,0 +1,302 @@
+/*
+ * event.c
+ * Benchmark of command classification and line parsing
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "capture.h"
+#include "event.h"
+
+/*
+ * Replays server traffic through the classifier and the parser and
+ * prints the cost per line. "before" is the linear strcmp() scan over
+ * the command table that event_classify() replaced, kept here verbatim
+ * with its table order; "after" is event_classify() on the same
+ * commands, and event_parse() is the whole tokenizer including it.
+ *
+ * Usage: bench-event [capture]
+ */
+
+struct bench_table {
+    const char *command;
+    enum event_type type;
+};
+
+static const struct bench_table bench_table[] = {
+    { "CAP",     EVENT_EXT_CAP },
+    { "JOIN",    EVENT_JOIN },
+    { "KICK",    EVENT_KICK },
+    { "MODE",    EVENT_MODE },
+    { "NICK",    EVENT_NICK },
+    { "NOTICE",  EVENT_NOTICE },
+    { "PART",    EVENT_PART },
+    { "PING",    EVENT_PING },
+    { "PRIVMSG", EVENT_PRIVMSG },
+    { "QUIT",    EVENT_QUIT },
+    { "TOPIC",   EVENT_TOPIC },
+    { "001",     EVENT_001_RPL_WELCOME },
+    { "002",     EVENT_002_RPL_YOURHOST },
+    { "003",     EVENT_003_RPL_CREATED },
+    { "004",     EVENT_004_RPL_MYINFO },
+    { "005",     EVENT_005_RPL_BOUNCE },
+    { "042",     EVENT_042_RPL_YOURID },
+    { "200",     EVENT_200_RPL_TRACELINK },
+    { "201",     EVENT_201_RPL_TRACECONNECTING },
+    { "202",     EVENT_202_RPL_TRACEHANDSHAKE },
+    { "203",     EVENT_203_RPL_TRACEUNKNOWN },
+    { "204",     EVENT_204_RPL_TRACEOPERATOR },
+    { "205",     EVENT_205_RPL_TRACEUSER },
+    { "206",     EVENT_206_RPL_TRACESERVER },
+    { "207",     EVENT_207_RPL_TRACESERVICE },
+    { "208",     EVENT_208_RPL_TRACENEWTYPE },
+    { "209",     EVENT_209_RPL_TRACECLASS },
+    { "211",     EVENT_211_RPL_STATSLINKINFO },
+    { "212",     EVENT_212_RPL_STATSCOMMANDS },
+    { "213",     EVENT_213_RPL_STATSCLINE},
+    { "215",     EVENT_215_RPL_STATSILINE },
+    { "216",     EVENT_216_RPL_STATSKLINE },
+    { "218",     EVENT_218_RPL_STATSYLINE },
+    { "219",     EVENT_219_RPL_ENDOFSTATS },
+    { "221",     EVENT_221_RPL_UMODEIS },
+    { "234",     EVENT_234_RPL_SERVLIST },
+    { "235",     EVENT_235_RPL_SERVLISTEND },
+    { "241",     EVENT_241_RPL_STATSLLINE },
+    { "242",     EVENT_242_RPL_STATSUPTIME },
+    { "243",     EVENT_243_RPL_STATSOLINE },
+    { "244",     EVENT_244_RPL_STATSHLINE },
+    { "245",     EVENT_245_RPL_STATSSLINE },
+    { "250",     EVENT_250_RPL_STATSCONN },
+    { "251",     EVENT_251_RPL_LUSERCLIENT },
+    { "252",     EVENT_252_RPL_LUSEROP },
+    { "253",     EVENT_253_RPL_LUSERUNKNOWN },
+    { "254",     EVENT_254_RPL_LUSERCHANNELS },
+    { "255",     EVENT_255_RPL_LUSERME },
+    { "256",     EVENT_256_RPL_ADMINME },
+    { "257",     EVENT_257_RPL_ADMINLOC1 },
+    { "258",     EVENT_258_RPL_ADMINLOC2 },
+    { "259",     EVENT_259_RPL_ADMINEMAIL },
+    { "261",     EVENT_261_RPL_TRACELOG },
+    { "263",     EVENT_263_RPL_TRYAGAIN },
+    { "265",     EVENT_265_RPL_LOCALUSERS },
+    { "266",     EVENT_266_RPL_GLOBALUSERS },
+    { "300",     EVENT_300_RPL_NONE },
+    { "301",     EVENT_301_RPL_AWAY },
+    { "302",     EVENT_302_RPL_USERHOST },
+    { "303",     EVENT_303_RPL_ISON },
+    { "305",     EVENT_305_RPL_UNAWAY },
+    { "306",     EVENT_306_RPL_NOWAWAY },
+    { "311",     EVENT_311_RPL_WHOISUSER },
+    { "312",     EVENT_312_RPL_WHOISSERVER },
+    { "313",     EVENT_313_RPL_WHOISOPERATOR },
+    { "314",     EVENT_314_RPL_WHOWASUSER },
+    { "315",     EVENT_315_RPL_ENDOFWHO },
+    { "317",     EVENT_317_RPL_WHOISIDLE },
+    { "318",     EVENT_318_RPL_ENDOFWHOIS },
+    { "319",     EVENT_319_RPL_WHOISCHANNELS },
+    { "322",     EVENT_322_RPL_LIST },
+    { "323",     EVENT_323_RPL_LISTEND },
+    { "324",     EVENT_324_RPL_CHANNELMODEIS },
+    { "328",     EVENT_328_RPL_CHANNEL_URL },
+    { "331",     EVENT_331_RPL_NOTOPIC },
+    { "332",     EVENT_332_RPL_TOPIC },
+    { "333",     EVENT_333_RPL_TOPICWHOTIME },
+    { "341",     EVENT_341_RPL_INVITING },
+    { "346",     EVENT_346_RPL_INVITELIST },
+    { "347",     EVENT_347_RPL_ENDOFINVITELIST },
+    { "348",     EVENT_348_RPL_EXCEPTLIST },
+    { "349",     EVENT_349_RPL_ENDOFEXCEPTLIST },
+    { "351",     EVENT_351_RPL_VERSION },
+    { "352",     EVENT_352_RPL_WHOREPLY },
+    { "353",     EVENT_353_RPL_NAMREPLY },
+    { "364",     EVENT_364_RPL_LINKS },
+    { "365",     EVENT_365_RPL_ENDOFLINKS },
+    { "366",     EVENT_366_RPL_ENDOFNAMES },
+    { "367",     EVENT_367_RPL_BANLIST },
+    { "368",     EVENT_368_RPL_ENDOFBANLIST },
+    { "369",     EVENT_369_RPL_ENDOFWHOWAS },
+    { "375",     EVENT_375_RPL_MOTDSTART },
+    { "371",     EVENT_371_RPL_INFO },
+    { "372",     EVENT_372_RPL_MOTD },
+    { "374",     EVENT_374_RPL_ENDOFINFO },
+    { "376",     EVENT_376_RPL_ENDOFMOTD },
+    { "381",     EVENT_381_RPL_YOUREOPER },
+    { "382",     EVENT_382_RPL_REHASHING },
+    { "383",     EVENT_383_RPL_YOURESERVICE },
+    { "391",     EVENT_391_RPL_TIME },
+    { "392",     EVENT_392_RPL_USERSSTART },
+    { "393",     EVENT_393_RPL_USERS },
+    { "394",     EVENT_394_RPL_ENDOFUSERS },
+    { "395",     EVENT_395_RPL_NOUSERS },
+    { "396",     EVENT_396_RPL_HOSTHIDDEN },
+    { "400",     EVENT_400_ERR_UNKNOWNERROR },
+    { "401",     EVENT_401_ERR_NOSUCHNICK },
+    { "402",     EVENT_402_ERR_NOSUCHSERVER },
+    { "403",     EVENT_403_ERR_NOSUCHCHANNEL },
+    { "404",     EVENT_404_ERR_CANNOTSENDTOCHAN },
+    { "405",     EVENT_405_ERR_TOOMANYCHANNELS },
+    { "406",     EVENT_406_ERR_WASNOSUCHNICK },
+    { "407",     EVENT_407_ERR_TOOMANYTARGETS },
+    { "408",     EVENT_408_ERR_NOSUCHSERVICE },
+    { "409",     EVENT_409_ERR_NOORIGIN },
+    { "411",     EVENT_411_ERR_NORECIPIENT },
+    { "412",     EVENT_412_ERR_NOTEXTTOSEND },
+    { "413",     EVENT_413_ERR_NOTOPLEVEL },
+    { "414",     EVENT_414_ERR_WILDTOPLEVEL },
+    { "415",     EVENT_415_ERR_BADMASK },
+    { "421",     EVENT_421_ERR_UNKNOWNCOMMAND },
+    { "422",     EVENT_422_ERR_NOMOTD },
+    { "423",     EVENT_423_ERR_NOADMININFO },
+    { "424",     EVENT_424_ERR_FILEERROR },
+    { "431",     EVENT_431_ERR_NONICKNAMEGIVEN },
+    { "432",     EVENT_432_ERR_ERRONEUSNICKNAME },
+    { "433",     EVENT_433_ERR_NICKNAMEINUSE },
+    { "436",     EVENT_436_ERR_NICKCOLLISION },
+    { "441",     EVENT_441_ERR_USERNOTINCHANNEL },
+    { "442",     EVENT_442_ERR_NOTONCHANNEL },
+    { "443",     EVENT_443_ERR_USERONCHANNEL },
+    { "444",     EVENT_444_ERR_NOLOGIN },
+    { "445",     EVENT_445_ERR_SUMMONDISABLED },
+    { "446",     EVENT_446_ERR_USERSDISABLED },
+    { "451",     EVENT_451_ERR_NOTREGISTERED },
+    { "461",     EVENT_461_ERR_NEEDMOREPARAMS },
+    { "462",     EVENT_462_ERR_ALREADYREGISTERED },
+    { "463",     EVENT_463_ERR_NOPERMFORHOST },
+    { "464",     EVENT_464_ERR_PASSWDMISMATCH },
+    { "465",     EVENT_465_ERR_YOUREBANNEDCREEP },
+    { "467",     EVENT_467_ERR_KEYSET },
+    { "470",     EVENT_470_ERR_LINKCHANNEL },
+    { "471",     EVENT_471_ERR_CHANNELISFULL },
+    { "472",     EVENT_472_ERR_UNKNOWNMODE },
+    { "473",     EVENT_473_ERR_INVITEONLYCHAN },
+    { "474",     EVENT_474_ERR_BANNEDFROMCHAN },
+    { "475",     EVENT_475_ERR_BADCHANNELKEY },
+    { "476",     EVENT_476_ERR_BADCHANMASK },
+    { "477",     EVENT_477_ERR_NEEDREGGEDNICK },
+    { "478",     EVENT_478_ERR_BANLISTFULL },
+    { "481",     EVENT_481_ERR_NOPRIVILEGES },
+    { "482",     EVENT_482_ERR_CHANOPRIVSNEEDED },
+    { "483",     EVENT_483_ERR_CANTKILLSERVER },
+    { "485",     EVENT_485_ERR_UNIQOPRIVSNEEDED },
+    { "491",     EVENT_491_ERR_NOOPERHOST },
+    { "501",     EVENT_501_ERR_UMODEUNKNOWNFLAG },
+    { "502",     EVENT_502_ERR_USERSDONTMATCH },
+    { "524",     EVENT_524_ERR_HELPNOTFOUND },
+    { "704",     EVENT_704_RPL_HELPSTART },
+    { "705",     EVENT_705_RPL_HELPTXT },
+    { "706",     EVENT_706_RPL_ENDOFHELP },
+    { "900",     EVENT_900_RPL_LOGGEDIN },
+    { "901",     EVENT_901_RPL_LOGGEDOUT },
+    { "902",     EVENT_902_ERR_NICKLOCKED },
+    { "903",     EVENT_903_RPL_SASLSUCCESS },
+    { "904",     EVENT_904_ERR_SASLFAIL },
+    { "905",     EVENT_905_ERR_SASLTOOLONG },
+    { "906",     EVENT_906_ERR_SASLABORTED },
+    { "907",     EVENT_907_ERR_SASLALREADY },
+    { "908",     EVENT_908_RPL_SASLMECHS },
+    { NULL,      EVENT_NONE }
+};
+
+#define BENCH_SIZE     (16 << 20)  /* bytes of synthetic traffic */
+#define BENCH_SECONDS  0.5         /* minimum time per measurement */
+
+/**
+ * bench_linear() - Classify a command the way event_parse() used to
+ * @command: NUL-terminated command
+ *
+ * Return: Matching event type, or EVENT_NONE if unknown
+ */
+static enum event_type bench_linear(const char *command)
+{
+    for (int i = 0; bench_table[i].command != NULL; i++) {
+        if (strcmp(command, bench_table[i].command) == 0) {
+            return bench_table[i].type;
+        }
+    }
+
+    return EVENT_NONE;
+}
+
+int main(int argc, char *argv[])
+{
+    struct capture capture;
+
+    if (capture_load(&capture, (argc > 1) ? argv[1] : NULL,
+        BENCH_SIZE) < 0) {
+        return 1;
+    }
+
+    size_t count = capture.lines;
+    char **lines = malloc(count * sizeof(*lines));
+    char (*commands)[32] = malloc(count * sizeof(*commands));
+    struct event_view *views = malloc(count * sizeof(*views));
+    struct event event;
+
+    if ((lines == NULL) || (commands == NULL) || (views == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* split into lines, as network_next_message() hands them out */
+    char *p = capture.data;
+
+    for (size_t i = 0; i < count; ++i) {
+        char *eol = strstr(p, "\r\n");
+
+        *eol = '\0';
+        lines[i] = p;
+        p = eol + 2;
+
+        event_init(&event, NULL);
+        event_parse(&event, lines[i]);
+        views[i] = event.command;
+        event_view_copy(commands[i], &event.command, sizeof(commands[i]));
+    }
+
+    struct timespec start;
+    volatile unsigned long sink = 0;
+    unsigned long rounds;
+    double before, after, parse;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (rounds = 0; (rounds == 0) ||
+        (capture_seconds(&start) < BENCH_SECONDS); ++rounds) {
+        for (size_t i = 0; i < count; ++i) {
+            sink += bench_linear(commands[i]);
+        }
+    }
+    before = capture_seconds(&start) * 1e9 / ((double)rounds * count);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (rounds = 0; (rounds == 0) ||
+        (capture_seconds(&start) < BENCH_SECONDS); ++rounds) {
+        for (size_t i = 0; i < count; ++i) {
+            sink += event_classify(&views[i]);
+        }
+    }
+    after = capture_seconds(&start) * 1e9 / ((double)rounds * count);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (rounds = 0; (rounds == 0) ||
+        (capture_seconds(&start) < BENCH_SECONDS); ++rounds) {
+        for (size_t i = 0; i < count; ++i) {
+            event_init(&event, NULL);
+            event_parse(&event, lines[i]);
+            sink += event.type;
+        }
+    }
+    parse = capture_seconds(&start) * 1e9 / ((double)rounds * count);
+
+    printf("%zu lines, %zu bytes, %s\n", count, capture.len,
+        (argc > 1) ? argv[1] : "synthetic");
+    printf("%-32s %8.1f ns/line\n", "classify before (table scan)", before);
+    printf("%-32s %8.1f ns/line\n", "classify after (event_classify)", after);
+    printf("%-32s %8.1f ns/line\n", "event_parse", parse);
+
+    free(views);
+    free(commands);
+    free(lines);
+    capture_free(&capture);
+
+    return 0;
+}
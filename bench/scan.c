@@ -0,0 +1,164 @@
+/*
+ * scan.c
+ * Benchmark of the line terminator scan
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "capture.h"
+#include "helper.h"
+
+/*
+ * Splits a large capture into lines and prints the throughput in GB/s.
+ * "before" is the byte-at-a-time loop find_message_end() used to run,
+ * called once per line; find_message_end() is the block scan called
+ * the same way, and find_message_ends() is the batch form used by
+ * network_next_message(). The block width is fixed at compile time:
+ * build with BENCHFLAGS="-O2 -mavx2" to measure the AVX2 path, or
+ * BENCHFLAGS="-O2 -U__SSE2__" for the SWAR fallback.
+ *
+ * Usage: bench-scan [capture]
+ */
+
+#define BENCH_SIZE     (64 << 20)  /* bytes of synthetic traffic */
+#define BENCH_SECONDS  0.5         /* minimum time per measurement */
+
+#if defined(__AVX2__)
+#define BENCH_PATH "AVX2"
+#elif defined(__SSE2__)
+#define BENCH_PATH "SSE2"
+#else
+#define BENCH_PATH "SWAR"
+#endif
+
+/**
+ * bench_bytewise() - Find a message terminator one byte at a time
+ * @buffer: Buffer containing IRC protocol data
+ * @len: Length of the buffer
+ *
+ * The loop find_message_end() ran before blocks were skipped.
+ *
+ * Return: Pointer to \r character of the terminator, or NULL if not found
+ */
+static const char *bench_bytewise(const char *buffer, size_t len)
+{
+    int ctcp_active = 0;
+
+    for (size_t i = 0; i + 1 < len; ++i) {
+        if (buffer[i] == '\001') {
+            ctcp_active = !ctcp_active;
+        } else if (buffer[i] == '\r' && buffer[i + 1] == '\n') {
+            if (!ctcp_active) {
+                return buffer + i;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * bench_single() - Split the capture with one search per line
+ * @capture: Traffic to split
+ * @bytewise: Use bench_bytewise() instead of find_message_end()
+ *
+ * Return: Number of lines found
+ */
+static size_t bench_single(const struct capture *capture, int bytewise)
+{
+    const char *p = capture->data;
+    const char *end = capture->data + capture->len;
+    size_t count = 0;
+
+    for (;;) {
+        const char *eol = bytewise ? bench_bytewise(p, end - p) :
+            find_message_end(p, end - p);
+
+        if (eol == NULL) {
+            break;
+        }
+
+        count++;
+        p = eol + 2;
+    }
+
+    return count;
+}
+
+/**
+ * bench_batch() - Split the capture the way network_next_message() does
+ * @capture: Traffic to split
+ *
+ * Return: Number of lines found
+ */
+static size_t bench_batch(const struct capture *capture)
+{
+    size_t ends[KIRC_MESSAGE_BATCH];
+    size_t head = 0;
+    size_t count = 0;
+    size_t n;
+
+    while ((n = find_message_ends(capture->data + head,
+        capture->len - head, ends, KIRC_MESSAGE_BATCH)) > 0) {
+        count += n;
+        head += ends[n - 1] + 2;
+    }
+
+    return count;
+}
+
+/**
+ * bench_rate() - Repeat one way of splitting and measure its throughput
+ * @capture: Traffic to split
+ * @mode: 0 for byte-wise, 1 for find_message_end(), 2 for the batch form
+ * @lines: Set to the number of lines found
+ *
+ * Return: Throughput in GB/s
+ */
+static double bench_rate(const struct capture *capture, int mode,
+        size_t *lines)
+{
+    struct timespec start;
+    unsigned long rounds;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (rounds = 0; (rounds == 0) ||
+        (capture_seconds(&start) < BENCH_SECONDS); ++rounds) {
+        *lines = (mode == 2) ? bench_batch(capture) :
+            bench_single(capture, mode == 0);
+    }
+
+    return (double)capture->len * rounds / capture_seconds(&start) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    struct capture capture;
+
+    if (capture_load(&capture, (argc > 1) ? argv[1] : NULL,
+        BENCH_SIZE) < 0) {
+        return 1;
+    }
+
+    size_t before_lines, single_lines, batch_lines;
+    double before = bench_rate(&capture, 0, &before_lines);
+    double single = bench_rate(&capture, 1, &single_lines);
+    double batch = bench_rate(&capture, 2, &batch_lines);
+
+    printf("%zu lines, %zu bytes, %s, %s\n", capture.lines, capture.len,
+        (argc > 1) ? argv[1] : "synthetic", BENCH_PATH);
+    printf("%-32s %8.2f GB/s\n", "before (byte-wise)", before);
+    printf("%-32s %8.2f GB/s\n", "find_message_end", single);
+    printf("%-32s %8.2f GB/s\n", "find_message_ends", batch);
+
+    capture_free(&capture);
+
+    if ((single_lines != before_lines) || (batch_lines != before_lines)) {
+        fprintf(stderr, "line counts differ: %zu, %zu, %zu\n",
+            before_lines, single_lines, batch_lines);
+        return 1;
+    }
+
+    return 0;
+}
@@ -5,3 +5,14 @@ BINDIR = $(PREFIX)/bin
 MANDIR = $(PREFIX)/share/man
 
 CC = cc
+
+# native TLS (OpenSSL or LibreSSL), uncomment to enable
+#TLSFLAGS = -DKIRC_TLS_OPENSSL
+#TLSLIBS = -lssl -lcrypto
+
+# event loop: epoll on Linux, poll() elsewhere; uncomment to force poll()
+#LOOPFLAGS = -DKIRC_LOOP_POLL
+
+# resolver thread
+CFLAGS = -pthread $(TLSFLAGS) $(LOOPFLAGS)
+LDFLAGS = -pthread $(TLSLIBS)
@@ -61,5 +61,7 @@
 #define CLEAR_LINE   "\x1b[0K"
 #define CURSOR_HOME  "\x1b[H"
 #define CURSOR_POS   "\x1b[6n"
+#define PASTE_ON     "\x1b[?2004h"
+#define PASTE_OFF    "\x1b[?2004l"
 
 #endif  // __KIRC_ANSI_H
@@ -0,0 +1,28 @@
+/*
+ * casemap.h
+ * Header for the case mapping module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_CASEMAP_H
+#define __KIRC_CASEMAP_H
+
+#include "kirc.h"
+#include "isupport.h"
+
+struct casemap {
+    unsigned char fold[256];  /* lower case of every byte */
+    unsigned char upper;      /* bytes 'A' to upper fold, by adding 0x20 */
+};
+
+int casemap_equals(const struct casemap *casemap, const char *a, size_t alen,
+        const char *b, size_t blen);
+int casemap_compare(const struct casemap *casemap, const char *a,
+        const char *b);
+uint32_t casemap_hash(const struct casemap *casemap, const char *s,
+        size_t len);
+int casemap_init(struct casemap *casemap,
+        enum isupport_casemapping casemapping);
+
+#endif  // __KIRC_CASEMAP_H
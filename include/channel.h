@@ -0,0 +1,72 @@
+/*
+ * channel.h
+ * Header for the channel state module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_CHANNEL_H
+#define __KIRC_CHANNEL_H
+
+#include "kirc.h"
+#include "event.h"
+#include "intern.h"
+#include "isupport.h"
+
+struct channel_nick {
+    uint32_t channels;  /* number of channels the nick is in */
+    uint32_t link;      /* first of its channel links */
+};
+
+struct channel_link {
+    uint32_t channel;  /* index in channel_state.channels + 1 */
+    uint32_t next;     /* next link of the same nick, 0 at the end */
+};
+
+struct channel_member {
+    uint32_t nick;   /* interned nick id, 0 if the slot is empty */
+    uint32_t modes;  /* bit n set for the n-th PREFIX mode */
+};
+
+struct channel {
+    uint32_t id;  /* interned channel name */
+    struct channel_member *members;  /* hash set keyed by nick id */
+    uint32_t mask;
+    uint32_t count;
+};
+
+struct channel_state {
+    struct intern *names;
+    struct isupport *isupport;
+    struct channel *channels[KIRC_CHANNEL_LIMIT];  /* NULL if unused */
+    struct channel_nick *nicks;  /* by nick id - 1 */
+    uint32_t nick_size;
+    struct channel_link *links;  /* by id - 1 */
+    uint32_t link_count;
+    uint32_t link_size;
+    uint32_t link_free;
+};
+
+struct channel *channel_find(struct channel_state *state,
+        const char *name, int len);
+void channel_join(struct channel_state *state, struct event *event,
+        int self);
+void channel_part(struct channel_state *state, const struct event_view *channel,
+        const struct event_view *nick, int self);
+void channel_quit(struct channel_state *state, uint32_t nick);
+void channel_mode(struct channel_state *state, struct event *event);
+void channel_names(struct channel_state *state, struct event *event);
+const char *channel_name(struct channel_state *state,
+        const struct channel *channel);
+int channel_member_prefix(struct channel_state *state,
+        const struct channel_member *member);
+const char *channel_member_name(struct channel_state *state,
+        const struct channel_member *member);
+size_t channel_memory(struct channel_state *state);
+void channel_clear(struct channel_state *state);
+
+int channel_init(struct channel_state *state, struct intern *names,
+        struct isupport *isupport);
+int channel_free(struct channel_state *state);
+
+#endif  // __KIRC_CHANNEL_H
@@ -0,0 +1,52 @@
+/*
+ * chatlog.h
+ * Header for the on-disk chat log module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_CHATLOG_H
+#define __KIRC_CHATLOG_H
+
+#include "kirc.h"
+#include "ansi.h"
+#include "casemap.h"
+#include "event.h"
+#include "helper.h"
+#include "output.h"
+
+struct chatlog_entry {
+    uint64_t offset;  /* of the block in the segment */
+    uint32_t length;
+    uint32_t first;   /* time of the first record */
+    uint32_t last;    /* time of the last record */
+    uint32_t unused;
+    uint64_t bloom;   /* channels with records in the block */
+};
+
+struct chatlog {
+    struct kirc_context *ctx;
+    struct casemap casemap;  /* rfc1459, which folds the most */
+    int fd;        /* current segment, -1 when logging is off */
+    int index_fd;
+    char prefix[PATH_MAX];  /* directory and server name */
+    unsigned int segment;
+    uint64_t size;  /* of the current segment, including pending bytes */
+    struct chatlog_entry block;  /* block being written */
+    char pending[KIRC_LOG_BUFFER_SIZE];
+    size_t pending_len;
+};
+
+int chatlog_append(struct chatlog *chatlog, time_t time,
+        const char *command, const char *channel, int channel_len,
+        const char *nick, int nick_len, const char *text, int text_len);
+void chatlog_event(struct chatlog *chatlog, struct event *event,
+        int direct);
+int chatlog_flush(struct chatlog *chatlog);
+int chatlog_search(struct chatlog *chatlog, const char *channel,
+        const char *needle, struct output *output);
+
+int chatlog_init(struct chatlog *chatlog, struct kirc_context *ctx);
+int chatlog_free(struct chatlog *chatlog);
+
+#endif  // __KIRC_CHATLOG_H
@@ -13,7 +13,8 @@
 #include "base64.h"
 
 int config_init(struct kirc_context *ctx);
-int config_parse_args(struct kirc_context *ctx, int argc, char *argv[]);
+int config_parse_args(struct kirc_context *ctx, int limit,
+        int argc, char *argv[]);
 int config_free(struct kirc_context *ctx);
 
 #endif  // __KIRC_CONFIG_H
@@ -14,6 +14,9 @@
 #include "event.h"
 #include "network.h"
 #include "handler.h"
+#include "intern.h"
+#include "loop.h"
+#include "timer.h"
 
 enum dcc_type {
     DCC_TYPE_SEND = 0,
@@ -32,7 +35,8 @@ struct dcc_transfer {
     enum dcc_type type;
     enum dcc_state state;
     char filename[NAME_MAX];
-    char sender[MESSAGE_MAX_LEN];
+    struct intern *names;  /* name table holding the sender */
+    uint32_t sender;       /* interned nick of the sender, 0 if none */
     unsigned long long filesize;
     unsigned long long sent;
     int file_fd;
@@ -40,17 +44,21 @@ struct dcc_transfer {
 
 struct dcc {
     struct kirc_context *ctx;
+    struct loop *loop;
+    struct timer_wheel *wheel;
     struct pollfd sock_fd[KIRC_DCC_TRANSFERS_MAX];
+    struct timer stall[KIRC_DCC_TRANSFERS_MAX];  /* idle timeout per transfer */
     struct dcc_transfer transfer[KIRC_DCC_TRANSFERS_MAX];
     int transfer_count;
 };
 
-int dcc_init(struct dcc *dcc, struct kirc_context *ctx);
+int dcc_init(struct dcc *dcc, struct kirc_context *ctx,
+        struct loop *loop, struct timer_wheel *wheel);
 int dcc_free(struct dcc *dcc);
-int dcc_request(struct dcc *dcc, const char *sender,
+int dcc_request(struct dcc *dcc, struct intern *names, uint32_t sender,
         const char *params);
 int dcc_send(struct dcc *dcc, int transfer_id);
-int dcc_process(struct dcc *dcc);
+int dcc_process(struct dcc *dcc, int transfer_id, short revents);
 int dcc_cancel(struct dcc *dcc, int transfer_id);
 void dcc_handle(struct dcc *dcc, struct network *network,
         struct event *event);
@@ -11,14 +11,24 @@
 #include "kirc.h"
 #include "terminal.h"
 #include "ansi.h"
+#include "timer.h"
 #include "utf8.h"
 
 enum editor_state {
     EDITOR_STATE_NONE = 0,
     EDITOR_STATE_SEND,
+    EDITOR_STATE_PASTE,   /* a multi-line paste was confirmed */
     EDITOR_STATE_TERMINATE
 };
 
+enum editor_decode {
+    EDITOR_DECODE_GROUND = 0,
+    EDITOR_DECODE_ESCAPE,  /* after ESC */
+    EDITOR_DECODE_CSI,     /* after ESC [ */
+    EDITOR_DECODE_SS3,     /* after ESC O */
+    EDITOR_DECODE_UTF8     /* inside a multi-byte character */
+};
+
 struct editor {
     struct kirc_context *ctx;
     enum editor_state state;
@@ -28,11 +38,38 @@ struct editor {
     int count;
     int position; /* -1 when not browsing history, otherwise index into history[] */
     int cursor;
+    char input[KIRC_INPUT_BUFFER_SIZE];  /* read from stdin, not yet handled */
+    size_t input_len;
+    size_t input_pos;
+    enum editor_decode decode;
+    int csi;  /* numeric parameter of a CSI sequence */
+    char utf8[4];
+    int utf8_len;
+    int utf8_need;
+    struct timer_wheel *wheel;
+    struct timer escape;  /* turns a lone ESC back into a key */
+    char paste[KIRC_PASTE_SIZE];
+    size_t paste_len;
+    size_t paste_dropped;  /* bytes beyond KIRC_PASTE_SIZE */
+    int paste_lines;  /* of a paste awaiting confirmation, 0 if none */
+    int pasting;      /* between ESC[200~ and ESC[201~ */
+    int cols;  /* terminal width, 0 until measured */
+    char frame_prefix[MESSAGE_MAX_LEN];  /* prompt as last drawn */
+    int frame_prefix_len;
+    char frame_text[MESSAGE_MAX_LEN];  /* input text as last drawn */
+    int frame_text_len;
+    int frame_end;     /* column after the last drawn cell */
+    int frame_cursor;  /* column the cursor was left at */
+    int frame_valid;   /* 0 once something else wrote to the terminal */
 };
 
 char *editor_last_entry(struct editor *editor);
-int editor_init(struct editor *editor, struct kirc_context *ctx);
+const char *editor_paste(struct editor *editor, size_t *len);
+int editor_init(struct editor *editor, struct kirc_context *ctx,
+        struct timer_wheel *wheel);
+int editor_read(struct editor *editor);
 int editor_process_key(struct editor *editor);
 int editor_handle(struct editor *editor);
+void editor_invalidate(struct editor *editor);
 
 #endif  // __KIRC_EDITOR_H
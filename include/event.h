@@ -29,6 +29,7 @@ enum event_type {
     EVENT_NOTICE,
     EVENT_PART,
     EVENT_PING,
+    EVENT_PONG,
     EVENT_PRIVMSG,
     EVENT_QUIT,
     EVENT_TOPIC,
@@ -193,22 +194,45 @@ enum event_type {
     EVENT_908_RPL_SASLMECHS
 };
 
-struct event_dispatch_table {
-    const char *command;
-    enum event_type type;
+struct event_view {
+    const char *ptr;  /* points into the line passed to event_parse() */
+    int len;
+};
+
+struct event_tag {
+    struct event_view key;
+    struct event_view value;  /* still escaped, see event_tag_value() */
 };
 
 struct event {
     struct kirc_context *ctx;
     enum event_type type;
-    char raw[MESSAGE_MAX_LEN];
-    char channel[CHANNEL_MAX_LEN];
-    char message[MESSAGE_MAX_LEN];
-    char command[MESSAGE_MAX_LEN];
-    char nickname[MESSAGE_MAX_LEN];
-    char params[MESSAGE_MAX_LEN];
+    struct event_view raw;
+    struct event_view prefix;
+    struct event_view nickname;
+    struct event_view user;
+    struct event_view host;
+    struct event_view command;
+    struct event_view channel;  /* first parameter */
+    struct event_view message;  /* trailing parameter or CTCP arguments */
+    struct event_view params[KIRC_PARAMS_MAX];
+    int param_count;
+    struct event_tag tags[KIRC_TAGS_MAX];
+    unsigned char tag_slots[KIRC_TAG_SLOTS];  /* tag index + 1, 0 if empty */
+    int tag_count;
 };
 
+int event_view_equals(const struct event_view *view, const char *s);
+int event_view_copy(char *dest, const struct event_view *view, size_t n);
+
+const struct event_view *event_tag(const struct event *event,
+        const char *key);
+int event_tag_value(const struct event *event, const char *key,
+        char *buf, size_t n);
+time_t event_time(const struct event *event);
+
+enum event_type event_classify(const struct event_view *command);
+
 int event_init(struct event *event, struct kirc_context *ctx);
 int event_parse(struct event *event, char *line);
 
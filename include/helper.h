@@ -14,5 +14,10 @@ int safecpy(char *s1, const char *s2, size_t n);
 int memzero(void *s, size_t n);
 
 char *find_message_end(const char *buffer, size_t len);
+size_t find_message_ends(const char *buffer, size_t len,
+        size_t *ends, size_t n);
+const char *find_substring(const char *buffer, size_t len,
+        const char *needle, size_t n);
+size_t find_text_split(const char *text, size_t len, size_t room);
 
 #endif  // __KIRC_HELPER_H
@@ -0,0 +1,46 @@
+/*
+ * intern.h
+ * Header for the name interning module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_INTERN_H
+#define __KIRC_INTERN_H
+
+#include "kirc.h"
+#include "casemap.h"
+#include "isupport.h"
+
+struct intern_entry {
+    char *name;     /* as last seen, NULL if the id is free */
+    uint32_t hash;  /* of the folded name */
+    uint32_t refs;  /* references held, or the next free id */
+};
+
+struct intern {
+    struct casemap casemap;  /* of the server */
+    struct intern_entry *entries;  /* by id - 1 */
+    uint32_t count;  /* ids handed out, including free ones */
+    uint32_t size;
+    uint32_t free;   /* first free id, 0 if none */
+    uint32_t used;   /* ids in use */
+    uint32_t *slots;  /* hash table of ids, 0 if empty */
+    uint32_t mask;
+};
+
+uint32_t intern_find(struct intern *intern, const char *name, int len);
+uint32_t intern_add(struct intern *intern, const char *name, int len);
+uint32_t intern_hold(struct intern *intern, uint32_t id);
+void intern_release(struct intern *intern, uint32_t id);
+int intern_rename(struct intern *intern, uint32_t id,
+        const char *name, int len);
+const char *intern_name(const struct intern *intern, uint32_t id);
+void intern_casemap(struct intern *intern,
+        enum isupport_casemapping casemapping);
+size_t intern_memory(const struct intern *intern);
+
+int intern_init(struct intern *intern);
+int intern_free(struct intern *intern);
+
+#endif  // __KIRC_INTERN_H
@@ -0,0 +1,51 @@
+/*
+ * isupport.h
+ * Header for the RPL_ISUPPORT module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_ISUPPORT_H
+#define __KIRC_ISUPPORT_H
+
+#include "kirc.h"
+#include "event.h"
+
+enum isupport_casemapping {
+    CASEMAPPING_RFC1459 = 0,  /* A-Z and []\^ fold to a-z and {}|~ */
+    CASEMAPPING_ASCII,        /* A-Z only */
+    CASEMAPPING_STRICT_RFC1459  /* A-Z and []\ */
+};
+
+enum isupport_target {
+    ISUPPORT_TARGET_JOIN = 0,
+    ISUPPORT_TARGET_PART,
+    ISUPPORT_TARGET_PRIVMSG,
+    ISUPPORT_TARGET_NOTICE,
+    ISUPPORT_TARGET_KICK,
+    ISUPPORT_TARGET_NAMES,
+    ISUPPORT_TARGET_WHOIS,
+    ISUPPORT_TARGET_COUNT
+};
+
+struct isupport {
+    enum isupport_casemapping casemapping;
+    int nicklen;     /* longest nickname */
+    int channellen;  /* longest channel name */
+    int linelen;     /* longest line, including CRLF but not tags */
+    int targmax[ISUPPORT_TARGET_COUNT];  /* targets per command, 0 if any */
+    unsigned char chantypes[256];  /* nonzero for channel prefixes */
+    char prefix_modes[KIRC_PREFIX_MAX + 1];    /* highest rank first */
+    char prefix_symbols[KIRC_PREFIX_MAX + 1];  /* in the same order */
+    char chanmodes[64];  /* A,B,C,D lists of channel modes */
+};
+
+int isupport_parse(struct isupport *isupport, struct event *event);
+int isupport_is_channel(const struct isupport *isupport,
+        const char *name, int len);
+int isupport_prefix(const struct isupport *isupport, char c);
+int isupport_mode_arg(const struct isupport *isupport, char mode,
+        int adding);
+int isupport_init(struct isupport *isupport);
+
+#endif  // __KIRC_ISUPPORT_H
@@ -12,6 +12,7 @@
 #define _XOPEN_SOURCE 700
 #endif
 
+#include <arpa/inet.h>
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -19,11 +20,17 @@
 #include <locale.h>
 #include <netdb.h>
 #include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -34,12 +41,17 @@
 #define NAME_MAX                 255
 #endif
 
+#ifndef PATH_MAX
+#define PATH_MAX                 4096
+#endif
+
 #ifndef HOST_NAME_MAX
 #define HOST_NAME_MAX            255
 #endif
 
 #define CHANNEL_MAX_LEN          200  /* per RFC1459 */
 #define MESSAGE_MAX_LEN          512  /* per RFC1459 */
+#define TAGS_MAX_LEN             8191 /* per IRCv3 message-tags */
 #define AUTH_CHUNK_SIZE          400  /* per IRCv3.1 */
 
 #define KIRC_VERSION_MAJOR       "1"
@@ -47,21 +59,57 @@
 #define KIRC_VERSION_PATCH       "2"
 
 #define KIRC_CHANNEL_LIMIT       256
+#define KIRC_CONNECT_ATTEMPTS    16
+#define KIRC_CONNECT_DELAY_MS    250  /* per RFC8305 */
 #define KIRC_DCC_BUFFER_SIZE     8192
+#define KIRC_DCC_STALL_MS        60000
 #define KIRC_DCC_TRANSFERS_MAX   16
+#define KIRC_ESCAPE_TIMEOUT_MS   50
 #define KIRC_EVENT_TYPE_MAX      256
+#define KIRC_FLOOD_BURST         5
+#define KIRC_FLOOD_INTERVAL_MS   2000 /* per RFC1459 */
 #define KIRC_HANDLER_MAX_ENTRIES 256
 #define KIRC_HISTORY_SIZE        64
+#define KIRC_HOSTLEN_GUESS       63   /* until the server shows our host */
+#define KIRC_INPUT_BUFFER_SIZE   4096
+#define KIRC_KEY_MAX_LEN         64
+#define KIRC_LOG_BLOCK_SIZE      65536     /* bytes per index entry */
+#define KIRC_LOG_BUFFER_SIZE     8192
+#define KIRC_LOG_MATCHES         20
+#define KIRC_LOG_SEGMENT_SIZE    67108864  /* 64 MiB per file */
+#define KIRC_LOOP_EVENTS         64
+#define KIRC_MESSAGE_BATCH       64
 #define KIRC_OUTPUT_BUFFER_SIZE  8192
+#define KIRC_PARAMS_MAX          15   /* per RFC1459 */
+#define KIRC_PASTE_SIZE          16384
+#define KIRC_PING_INTERVAL_MS    60000
+#define KIRC_PING_TIMEOUT_MS     120000
+#define KIRC_PREFIX_MAX          8
+#define KIRC_TAGS_MAX            32
+#define KIRC_TAG_SLOTS           64   /* power of two, > KIRC_TAGS_MAX */
 #define KIRC_PORT_RANGE_MAX      65535
+#define KIRC_RECEIVE_BUFFER_SIZE 16384
+#define KIRC_RECEIVE_BUFFER_MAX  65536
+#define KIRC_RECONNECT_BASE_MS   1000
+#define KIRC_RECONNECT_MAX_MS    300000
+#define KIRC_RECONNECT_RETRIES   10
+#define KIRC_SCHEDULER_DEPTH     128
+#define KIRC_SEND_QUEUE_SIZE     16384
+#define KIRC_SCROLLBACK_LINES    131072
+#define KIRC_SCROLLBACK_MEMORY   67108864  /* 64 MiB across all buffers */
+#define KIRC_SCROLLBACK_REPLAY   20
+#define KIRC_SERVER_LIMIT        8
 #define KIRC_TAB_WIDTH           4
 #define KIRC_TIMEOUT_MS          5000
+#define KIRC_TIMER_TICK_MS       10
 #define KIRC_TIMESTAMP_SIZE      6
 #define KIRC_TIMESTAMP_FORMAT    "%H:%M"
+#define KIRC_USERLEN_GUESS       10   /* until the server shows our user */
 
 #define KIRC_DEFAULT_COLUMNS     80
 #define KIRC_DEFAULT_PORT        "6667"
 #define KIRC_DEFAULT_SERVER      "irc.libera.chat"
+#define KIRC_DEFAULT_TLS_PORT    "6697"
 
 enum sasl_mechanism {
     SASL_NONE = 0,
@@ -72,14 +120,22 @@ enum sasl_mechanism {
 struct kirc_context {
     char server[HOST_NAME_MAX];
     char port[6];
+    int port_set;  /* port given by -p or KIRC_PORT */
     char nickname[MESSAGE_MAX_LEN];
     char realname[MESSAGE_MAX_LEN];
     char username[MESSAGE_MAX_LEN];
     char password[MESSAGE_MAX_LEN];
     char channels[KIRC_CHANNEL_LIMIT][CHANNEL_MAX_LEN];
+    char keys[KIRC_CHANNEL_LIMIT][KIRC_KEY_MAX_LEN];
     char target[KIRC_CHANNEL_LIMIT];
+    long lag;  /* last PING round trip in ms, -1 if unknown */
     char auth[MESSAGE_MAX_LEN];
     enum sasl_mechanism mechanism;
+    int flood_burst;
+    int flood_interval;
+    int tls;
+    char tls_cert[PATH_MAX];
+    char log_dir[PATH_MAX];
 };
 
 #endif  // __KIRC_H
@@ -0,0 +1,46 @@
+/*
+ * loop.h
+ * Header for the event loop module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_LOOP_H
+#define __KIRC_LOOP_H
+
+#include "kirc.h"
+
+struct loop_event {
+    int fd;
+    short revents;  /* poll() event bits, whatever the backend */
+    void *data;
+    int id;
+};
+
+struct loop_slot {
+    void *data;  /* owner, or NULL if the fd is not registered */
+    int id;
+    short events;
+    int index;  /* position in pfds (poll backend) */
+};
+
+struct loop {
+    int backend_fd;  /* epoll descriptor, or -1 for the poll backend */
+    struct loop_slot *slots;  /* indexed by fd */
+    int nslots;
+    struct pollfd *pfds;  /* poll backend only */
+    int npfds;
+    struct loop_event ready[KIRC_LOOP_EVENTS];
+    int nready;
+};
+
+int loop_add(struct loop *loop, int fd, short events, void *data, int id);
+int loop_modify(struct loop *loop, int fd, short events, void *data);
+int loop_remove(struct loop *loop, int fd, void *data);
+int loop_wait(struct loop *loop, int timeout);
+const char *loop_backend(struct loop *loop);
+
+int loop_init(struct loop *loop);
+int loop_free(struct loop *loop);
+
+#endif  // __KIRC_LOOP_H
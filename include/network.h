@@ -11,24 +11,86 @@
 #include "kirc.h"
 #include "transport.h"
 #include "ansi.h"
+#include "channel.h"
+#include "chatlog.h"
 #include "helper.h"
+#include "intern.h"
+#include "isupport.h"
 #include "output.h"
+#include "scheduler.h"
+#include "scrollback.h"
+#include "timer.h"
+
+enum network_state {
+    NETWORK_OFFLINE = 0,
+    NETWORK_WAITING,     /* backing off before the next attempt */
+    NETWORK_CONNECTING,
+    NETWORK_ONLINE
+};
 
 struct network {
     struct kirc_context *ctx;
     struct transport *transport;
-    char buffer[MESSAGE_MAX_LEN];
-    int len;
+    char *buffer;
+    size_t size;  /* allocated bytes */
+    size_t head;  /* start of the first unparsed line */
+    size_t tail;  /* end of received data */
+    size_t ends[KIRC_MESSAGE_BATCH];  /* pending terminators, from head */
+    size_t end_count;
+    size_t end_next;
+    char sendq[KIRC_SEND_QUEUE_SIZE];  /* ring of outbound bytes */
+    size_t sendq_head;
+    size_t sendq_len;
+    struct scheduler scheduler;
+    struct isupport isupport;
+    struct intern names;  /* nicks and channels seen on this server */
+    uint32_t self;        /* interned nick of our own */
+    int user_len;  /* of our user@host as others see it, 0 until known */
+    int host_len;
+    struct channel_state chanstate;  /* members of the channels we are in */
+    int autojoined;
+    enum network_state state;
+    int retries;  /* reconnect attempts since the last registration */
+    struct timespec retry_at;
+    struct timer_wheel *wheel;
+    struct scrollback *scrollback;
+    struct chatlog chatlog;
+    struct timer keepalive;
+    struct timer *wake;  /* owner's, started when a timer needs servicing */
+    struct timespec ping_sent;
+    char ping_token[32];  /* payload of the outstanding PING */
+    int ping_pending;
+    int dead;  /* no PONG within KIRC_PING_TIMEOUT_MS */
+    long lag_max;
+    unsigned long pings;
+    unsigned long pongs;
 };
 
 int network_send(struct network *network, const char *fmt, ...);
+int network_schedule(struct network *network);
+int network_flush(struct network *network);
+int network_pending(struct network *network);
 int network_receive(struct network *network);
-int network_connect(struct network *network);
+char *network_next_message(struct network *network);
+int network_start(struct network *network, struct output *output);
+void network_connect_report(struct network *network, struct output *output);
+int network_disconnect(struct network *network, struct output *output);
+int network_reconnect_events(struct network *network,
+        struct pollfd *fds, int n);
+int network_reconnect_timeout(struct network *network);
+int network_reconnect_process(struct network *network,
+        struct pollfd *fds, int n, struct output *output);
+int network_is_self(struct network *network, const struct event_view *nick);
+int network_pong(struct network *network, const char *token);
 int network_command_handler(struct network *network, char *msg, struct output *output);
+int network_send_paste(struct network *network, const char *text,
+        size_t len, struct output *output);
 int network_send_credentials(struct network *network);
+int network_join_channels(struct network *network);
 
 int network_init(struct network *network,
-        struct transport *transport, struct kirc_context *ctx);
+        struct transport *transport, struct kirc_context *ctx,
+        struct timer_wheel *wheel, struct scrollback *scrollback);
 int network_free(struct network *network);
 
 #endif  // __KIRC_NETWORK_H
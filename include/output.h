@@ -13,6 +13,8 @@
 
 struct output {
     struct kirc_context *ctx;
+    const char *source;  /* server the next lines come from */
+    const char *shown;   /* server named by the last marker */
     char buffer[KIRC_OUTPUT_BUFFER_SIZE];
     int len;
 };
@@ -23,6 +25,7 @@ int output_init(struct output *output,
 int output_append(struct output *output,
         const char *fmt, ...);
 
+void output_source(struct output *output, const char *source);
 void output_flush(struct output *output);
 void output_clear(struct output *output);
 
@@ -12,13 +12,18 @@
 #include "ansi.h"
 #include "event.h"
 #include "helper.h"
+#include "isupport.h"
 #include "network.h"
 #include "output.h"
 
 void protocol_noop(struct network *network, struct event *event, struct output *output);
 void protocol_ping(struct network *network, struct event *event, struct output *output);
+void protocol_pong(struct network *network, struct event *event, struct output *output);
+void protocol_cap(struct network *network, struct event *event, struct output *output);
 void protocol_authenticate(struct network *network, struct event *event, struct output *output);
+void protocol_isupport(struct network *network, struct event *event, struct output *output);
 void protocol_welcome(struct network *network, struct event *event, struct output *output);
+void protocol_hosthidden(struct network *network, struct event *event, struct output *output);
 void protocol_raw(struct network *network, struct event *event, struct output *output);
 void protocol_info(struct network *network, struct event *event, struct output *output);
 void protocol_error(struct network *network, struct event *event, struct output *output);
@@ -26,7 +31,11 @@ void protocol_notice(struct network *network, struct event *event, struct output
 void protocol_privmsg(struct network *network, struct event *event, struct output *output);
 void protocol_nick(struct network *network, struct event *event, struct output *output);
 void protocol_join(struct network *network, struct event *event, struct output *output);
+void protocol_kick(struct network *network, struct event *event, struct output *output);
 void protocol_part(struct network *network, struct event *event, struct output *output);
+void protocol_quit(struct network *network, struct event *event, struct output *output);
+void protocol_mode(struct network *network, struct event *event, struct output *output);
+void protocol_names(struct network *network, struct event *event, struct output *output);
 void protocol_ctcp_action(struct network *network, struct event *event, struct output *output);
 void protocol_ctcp_info(struct network *network, struct event *event, struct output *output);
 
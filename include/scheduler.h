@@ -0,0 +1,57 @@
+/*
+ * scheduler.h
+ * Header for the outbound send scheduler
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_SCHEDULER_H
+#define __KIRC_SCHEDULER_H
+
+#include "kirc.h"
+
+enum scheduler_lane {
+    SCHEDULER_URGENT = 0,  /* PING/PONG, registration, authentication */
+    SCHEDULER_NORMAL,      /* everything else */
+    SCHEDULER_BULK,        /* PRIVMSG, NOTICE */
+    SCHEDULER_LANES
+};
+
+struct scheduler_message {
+    size_t len;
+    char data[MESSAGE_MAX_LEN];
+};
+
+struct scheduler_queue {
+    struct scheduler_message *slots;
+    size_t head;
+    size_t count;
+};
+
+struct scheduler {
+    struct kirc_context *ctx;
+    struct scheduler_queue lanes[SCHEDULER_LANES];
+    long credit;  /* milliseconds of send allowance */
+    long burst;
+    long interval;
+    struct timespec last;
+    unsigned long delayed;
+    unsigned long dropped;
+};
+
+enum scheduler_lane scheduler_classify(const char *buf, size_t len);
+int scheduler_push(struct scheduler *scheduler,
+        const char *buf, size_t len);
+int scheduler_peek(struct scheduler *scheduler,
+        const char **buf, size_t *len);
+void scheduler_pop(struct scheduler *scheduler);
+int scheduler_timeout(struct scheduler *scheduler);
+void scheduler_reset(struct scheduler *scheduler);
+size_t scheduler_depth(struct scheduler *scheduler,
+        enum scheduler_lane lane);
+
+int scheduler_init(struct scheduler *scheduler,
+        struct kirc_context *ctx);
+int scheduler_free(struct scheduler *scheduler);
+
+#endif  // __KIRC_SCHEDULER_H
@@ -0,0 +1,85 @@
+/*
+ * scrollback.h
+ * Header for the scrollback module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_SCROLLBACK_H
+#define __KIRC_SCROLLBACK_H
+
+#include "kirc.h"
+#include "ansi.h"
+#include "casemap.h"
+#include "helper.h"
+#include "output.h"
+
+#define SCROLLBACK_CHUNK_LINES 1024
+#define SCROLLBACK_CHUNK_TEXT  (48 * 1024)
+
+enum scrollback_kind {
+    SCROLLBACK_MESSAGE = 0,
+    SCROLLBACK_ACTION,
+    SCROLLBACK_NOTICE
+};
+
+struct scrollback_line {
+    uint32_t time;    /* seconds since the epoch */
+    uint32_t nick;    /* id in the nick table, 0 if none */
+    uint32_t offset;  /* of the text in the chunk */
+    uint16_t len;
+    uint8_t kind;
+    uint8_t unused;
+};
+
+struct scrollback_chunk {
+    struct scrollback_chunk *next;
+    int count;      /* lines used */
+    uint32_t used;  /* text bytes used */
+    struct scrollback_line lines[SCROLLBACK_CHUNK_LINES];
+    char text[SCROLLBACK_CHUNK_TEXT];
+};
+
+struct scrollback_nick {
+    char *name;     /* NULL if the id is free */
+    uint32_t hash;
+    uint32_t refs;  /* lines referring to the nick, or the next free id */
+};
+
+struct scrollback_buffer {
+    struct scrollback_buffer *prev;  /* more recently used */
+    struct scrollback_buffer *next;  /* less recently used */
+    const void *owner;  /* server the buffer belongs to */
+    char name[CHANNEL_MAX_LEN];
+    struct scrollback_chunk *head;  /* oldest */
+    struct scrollback_chunk *tail;  /* newest */
+    size_t count;
+};
+
+struct scrollback {
+    struct casemap casemap;  /* rfc1459, shared by all servers */
+    struct scrollback_buffer *first;  /* most recently used */
+    struct scrollback_buffer *last;   /* least recently used */
+    int buffers;
+    size_t memory;  /* bytes held by chunks, buffers and nicks */
+    size_t limit;
+    struct scrollback_nick *nicks;  /* by id - 1 */
+    uint32_t nick_count;  /* ids handed out, including free ones */
+    uint32_t nick_size;
+    uint32_t nick_free;   /* first free id, 0 if none */
+    uint32_t nick_used;   /* ids in use */
+    uint32_t *nick_slots;  /* hash table of ids, 0 if empty */
+    uint32_t nick_mask;
+    unsigned long evicted;   /* lines dropped to stay within limits */
+};
+
+int scrollback_add(struct scrollback *scrollback, const void *owner,
+        const char *name, time_t time, enum scrollback_kind kind,
+        const char *nick, int nick_len, const char *text, int text_len);
+int scrollback_replay(struct scrollback *scrollback, const void *owner,
+        const char *name, size_t lines, struct output *output);
+
+int scrollback_init(struct scrollback *scrollback, size_t limit);
+int scrollback_free(struct scrollback *scrollback);
+
+#endif  // __KIRC_SCROLLBACK_H
@@ -0,0 +1,47 @@
+/*
+ * server.h
+ * Header for the server connection module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_SERVER_H
+#define __KIRC_SERVER_H
+
+#include "kirc.h"
+#include "dcc.h"
+#include "event.h"
+#include "handler.h"
+#include "loop.h"
+#include "network.h"
+#include "output.h"
+#include "scrollback.h"
+#include "timer.h"
+#include "transport.h"
+
+struct server {
+    struct kirc_context *ctx;
+    struct transport transport;
+    struct network network;
+    struct pollfd fds[KIRC_CONNECT_ATTEMPTS];  /* registered with the loop */
+    int nfds;
+    unsigned long opened;  /* transport.opened when fds were registered */
+    struct timer wake;  /* due when timed work needs servicing */
+    struct server **work;  /* servers to service after this poll() */
+    struct server *next;  /* on that list */
+    int ready;  /* on that list */
+};
+
+void server_mark(struct server *server);
+int server_events(struct server *server, struct loop *loop);
+void server_ready(struct server *server, int fd, short revents);
+int server_process(struct server *server, struct handler *handler,
+        struct dcc *dcc, struct output *output);
+int server_find(struct server *servers, int count, const char *name);
+
+int server_init(struct server *server, struct kirc_context *ctx,
+        struct timer_wheel *wheel, struct scrollback *scrollback,
+        struct server **work);
+int server_free(struct server *server, struct loop *loop);
+
+#endif  // __KIRC_SERVER_H
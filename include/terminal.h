@@ -18,6 +18,7 @@ struct terminal {
 };
 
 int terminal_columns(int tty_fd);
+int terminal_resized(void);
 int terminal_init(struct terminal *terminal,
         struct kirc_context *ctx);
 int terminal_enable_raw(struct terminal *terminal);
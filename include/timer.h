@@ -0,0 +1,45 @@
+/*
+ * timer.h
+ * Header for the timer wheel module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_TIMER_H
+#define __KIRC_TIMER_H
+
+#include "kirc.h"
+
+#define TIMER_LEVELS 4
+#define TIMER_BITS   6
+#define TIMER_SLOTS  (1 << TIMER_BITS)
+
+struct timer;
+
+typedef void (*timer_fn)(struct timer *timer, void *data);
+
+struct timer {
+    struct timer *next;
+    struct timer **pprev;  /* NULL while not armed */
+    uint64_t expires;  /* tick */
+    timer_fn fn;
+    void *data;
+};
+
+struct timer_wheel {
+    struct timer *slots[TIMER_LEVELS][TIMER_SLOTS];
+    uint64_t tick;  /* next tick to run */
+    struct timespec origin;
+    int count;
+};
+
+void timer_setup(struct timer *timer, timer_fn fn, void *data);
+void timer_start(struct timer_wheel *wheel, struct timer *timer, long ms);
+void timer_stop(struct timer_wheel *wheel, struct timer *timer);
+int timer_pending(const struct timer *timer);
+int timer_timeout(struct timer_wheel *wheel);
+int timer_advance(struct timer_wheel *wheel);
+
+int timer_init(struct timer_wheel *wheel);
+
+#endif  // __KIRC_TIMER_H
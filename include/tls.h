@@ -0,0 +1,34 @@
+/*
+ * tls.h
+ * Header for the TLS module
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#ifndef __KIRC_TLS_H
+#define __KIRC_TLS_H
+
+#include "kirc.h"
+#include "helper.h"
+
+struct tls {
+    struct kirc_context *ctx;
+    void *config;  /* backend context, e.g. SSL_CTX */
+    void *session;  /* backend connection, e.g. SSL */
+    short want;  /* poll events the backend is blocked on */
+    int resumed;
+    char session_path[PATH_MAX];
+    char error[256];
+};
+
+int tls_start(struct tls *tls, int fd);
+int tls_handshake(struct tls *tls);
+ssize_t tls_read(struct tls *tls, char *buffer, size_t len);
+ssize_t tls_write(struct tls *tls, const char *buffer, size_t len);
+size_t tls_pending(struct tls *tls);
+int tls_describe(struct tls *tls, char *buffer, size_t len);
+int tls_close(struct tls *tls);
+
+int tls_init(struct tls *tls, struct kirc_context *ctx);
+
+#endif  // __KIRC_TLS_H
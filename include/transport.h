@@ -9,17 +9,62 @@
 #define __KIRC_TRANSPORT_H
 
 #include "kirc.h"
+#include "helper.h"
+#include "tls.h"
+
+enum transport_state {
+    TRANSPORT_IDLE = 0,
+    TRANSPORT_RESOLVING,
+    TRANSPORT_CONNECTING,
+    TRANSPORT_HANDSHAKE,
+    TRANSPORT_CONNECTED,
+    TRANSPORT_FAILED
+};
+
+struct transport_attempt {
+    int fd;  /* -1 once finished */
+    char address[INET6_ADDRSTRLEN];
+    struct timespec started;
+    long elapsed;  /* milliseconds until success or failure */
+    int error;  /* errno value, 0 on success */
+};
 
 struct transport {
     struct kirc_context *ctx;
     int fd;
+    enum transport_state state;
+    pthread_t resolver;
+    int resolver_pipe[2];
+    int resolve_status;  /* getaddrinfo() result */
+    struct addrinfo *addrs;
+    struct addrinfo *order[KIRC_CONNECT_ATTEMPTS];
+    int order_count;
+    int order_next;
+    struct transport_attempt attempts[KIRC_CONNECT_ATTEMPTS];
+    int attempt_count;
+    unsigned long opened;  /* descriptors created, to spot reused numbers */
+    struct timespec next_start;
+    int secure;  /* wrap the connection in TLS */
+    struct tls tls;
+    struct timespec handshake_started;
+    long handshake_elapsed;
 };
 
 ssize_t transport_send(struct transport *transport,
         const char *buffer, size_t len);
+ssize_t transport_sendv(struct transport *transport,
+        const struct iovec *iov, int iovcnt);
 ssize_t transport_receive(struct transport *transport,
         char *buffer, size_t len);
+size_t transport_pending(struct transport *transport);
+short transport_events(struct transport *transport);
 
+int transport_connect_start(struct transport *transport);
+int transport_connect_events(struct transport *transport,
+        struct pollfd *fds, int n);
+int transport_connect_timeout(struct transport *transport);
+int transport_connect_process(struct transport *transport,
+        struct pollfd *fds, int n);
 int transport_connect(struct transport *transport);
 int transport_init(struct transport *transport,
         struct kirc_context *ctx);
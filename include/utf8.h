@@ -10,8 +10,14 @@
 
 #include "kirc.h"
 
+#define UTF8_CACHE_LIMIT 0x20000  /* code points with cached widths */
+#define UTF8_CACHE_BLOCK 256      /* code points filled in at a time */
+
 int utf8_prev_char_len(const char *s, int pos);
 int utf8_next_char_len(const char *s, int pos, int maxlen);
+int utf8_prev_cluster_len(const char *s, int pos);
+int utf8_next_cluster_len(const char *s, int pos, int maxlen);
+int utf8_width(const char *s, int len);
 int utf8_validate(const char *s, int len);
 
 #endif  // __KIRC_UTF8_H
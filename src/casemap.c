@@ -0,0 +1,150 @@
+/*
+ * casemap.c
+ * Case-insensitive comparison of nicknames and channel names
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "casemap.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * IRC servers compare names under the CASEMAPPING they advertise in
+ * RPL_ISUPPORT. All three mappings in use fold one contiguous range of
+ * bytes by adding 0x20: "ascii" folds A-Z, "strict-rfc1459" also []\
+ * to {}|, and "rfc1459", the default, also ^ to ~. The fold table turns
+ * the byte-by-byte comparison into a lookup; for long names the range
+ * test is done on 16 bytes at a time instead.
+ */
+
+/**
+ * casemap_equals() - Compare two names under a case mapping
+ * @casemap: Case mapping of the server
+ * @a: First name, need not be NUL-terminated
+ * @alen: Length of @a
+ * @b: Second name, need not be NUL-terminated
+ * @blen: Length of @b
+ *
+ * Return: 1 if the names are equal, 0 otherwise
+ */
+int casemap_equals(const struct casemap *casemap, const char *a, size_t alen,
+        const char *b, size_t blen)
+{
+    if (alen != blen) {
+        return 0;
+    }
+
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i low = _mm_set1_epi8('A' - 1);
+    const __m128i high = _mm_set1_epi8((char)(casemap->upper + 1));
+    const __m128i bit = _mm_set1_epi8(0x20);
+
+    /* bytes of 0x80 and up compare as negative and are never folded */
+    for (; i + 16 <= alen; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+
+        x = _mm_add_epi8(x, _mm_and_si128(bit, _mm_and_si128(
+            _mm_cmpgt_epi8(x, low), _mm_cmplt_epi8(x, high))));
+        y = _mm_add_epi8(y, _mm_and_si128(bit, _mm_and_si128(
+            _mm_cmpgt_epi8(y, low), _mm_cmplt_epi8(y, high))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) {
+            return 0;
+        }
+    }
+#endif
+
+    for (; i < alen; ++i) {
+        if (casemap->fold[(unsigned char)a[i]] !=
+            casemap->fold[(unsigned char)b[i]]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * casemap_compare() - Order two names under a case mapping
+ * @casemap: Case mapping of the server
+ * @a: First NUL-terminated name
+ * @b: Second NUL-terminated name
+ *
+ * Return: Negative, zero or positive as for strcmp()
+ */
+int casemap_compare(const struct casemap *casemap, const char *a,
+        const char *b)
+{
+    const unsigned char *p = (const unsigned char *)a;
+    const unsigned char *q = (const unsigned char *)b;
+
+    while ((*p != '\0') && (casemap->fold[*p] == casemap->fold[*q])) {
+        p++;
+        q++;
+    }
+
+    return casemap->fold[*p] - casemap->fold[*q];
+}
+
+/**
+ * casemap_hash() - FNV-1a hash of a name folded under a case mapping
+ * @casemap: Case mapping of the server
+ * @s: Name, need not be NUL-terminated
+ * @len: Length of @s
+ *
+ * Names that casemap_equals() considers equal hash alike.
+ *
+ * Return: 32-bit hash
+ */
+uint32_t casemap_hash(const struct casemap *casemap, const char *s,
+        size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= casemap->fold[(unsigned char)s[i]];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * casemap_init() - Build the fold table of a case mapping
+ * @casemap: Case mapping to initialize
+ * @casemapping: CASEMAPPING advertised by the server
+ *
+ * Return: 0 on success, -1 if casemap is NULL
+ */
+int casemap_init(struct casemap *casemap,
+        enum isupport_casemapping casemapping)
+{
+    if (casemap == NULL) {
+        return -1;
+    }
+
+    switch (casemapping) {
+    case CASEMAPPING_ASCII:
+        casemap->upper = 'Z';
+        break;
+    case CASEMAPPING_STRICT_RFC1459:
+        casemap->upper = ']';
+        break;
+    default:
+        casemap->upper = '^';
+        break;
+    }
+
+    for (int c = 0; c < 256; ++c) {
+        casemap->fold[c] = (unsigned char)(((c >= 'A') &&
+            (c <= casemap->upper)) ? c + 0x20 : c);
+    }
+
+    return 0;
+}
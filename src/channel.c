@@ -0,0 +1,830 @@
+/*
+ * channel.c
+ * Membership of the channels we are in
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "channel.h"
+
+/*
+ * Nicks and channel names are interned in the name table of the
+ * connection, see intern.c, and referred to by their 32-bit ids. A
+ * channel keeps its members in an open-addressing hash set of ids and
+ * their prefix modes, so joins, parts and mode changes are O(1)
+ * whatever the size of the channel. A nick in turn keeps a short list
+ * of links to the channels it is in, which is all a QUIT has to walk,
+ * and a NICK only renames the interned name, leaving every channel
+ * untouched. The channel state holds one reference to every nick that
+ * is in at least one of our channels. A member costs 8 bytes in its
+ * channel, 8 bytes of link and, once per nick, 8 bytes here plus the
+ * interned name; with the tables at most half full and arrays grown by
+ * doubling, a channel of 50000 users takes about 4 MB.
+ */
+
+/**
+ * channel_nick_grow() - Make room for a nick id in the nick array
+ * @state: Channel state
+ * @id: Nick id
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int channel_nick_grow(struct channel_state *state, uint32_t id)
+{
+    if (id <= state->nick_size) {
+        return 0;
+    }
+
+    uint32_t size = state->nick_size;
+
+    while (size < id) {
+        size *= 2;
+    }
+
+    struct channel_nick *nicks = realloc(state->nicks,
+        size * sizeof(*nicks));
+
+    if (nicks == NULL) {
+        return -1;
+    }
+
+    memset(nicks + state->nick_size, 0,
+        (size - state->nick_size) * sizeof(*nicks));
+    state->nicks = nicks;
+    state->nick_size = size;
+
+    return 0;
+}
+
+/**
+ * channel_nick_find() - Look up a nick in our channels
+ * @state: Channel state
+ * @name: Nickname bytes, not NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: Nick id, or 0 if the nick is in none of our channels
+ */
+static uint32_t channel_nick_find(struct channel_state *state,
+        const char *name, int len)
+{
+    uint32_t id = intern_find(state->names, name, len);
+
+    if ((id == 0) || (id > state->nick_size) ||
+        (state->nicks[id - 1].channels == 0)) {
+        return 0;
+    }
+
+    return id;
+}
+
+/**
+ * channel_nick_add() - Find a nick in our channels or start tracking it
+ * @state: Channel state
+ * @name: Nickname bytes, not NUL-terminated
+ * @len: Length of @name
+ *
+ * A nick not yet in any of our channels is interned, taking the
+ * reference that channel_nick_release() drops again.
+ *
+ * Return: Nick id, or 0 on allocation failure
+ */
+static uint32_t channel_nick_add(struct channel_state *state,
+        const char *name, int len)
+{
+    uint32_t id = channel_nick_find(state, name, len);
+
+    if (id != 0) {
+        return id;
+    }
+
+    id = intern_add(state->names, name, len);
+
+    if ((id != 0) && (channel_nick_grow(state, id) < 0)) {
+        intern_release(state->names, id);
+        return 0;
+    }
+
+    return id;
+}
+
+/**
+ * channel_nick_release() - Drop a nick that is in no channel any more
+ * @state: Channel state
+ * @id: Nick id
+ */
+static void channel_nick_release(struct channel_state *state, uint32_t id)
+{
+    struct channel_nick *nick = &state->nicks[id - 1];
+
+    if (nick->channels != 0) {
+        return;
+    }
+
+    nick->link = 0;
+    intern_release(state->names, id);
+}
+
+/**
+ * channel_link_add() - Record that a nick is in a channel
+ * @state: Channel state
+ * @id: Nick id
+ * @index: Channel index
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int channel_link_add(struct channel_state *state, uint32_t id,
+        int index)
+{
+    uint32_t link = state->link_free;
+
+    if (link != 0) {
+        state->link_free = state->links[link - 1].next;
+    } else {
+        if (state->link_count == state->link_size) {
+            uint32_t size = state->link_size * 2;
+            struct channel_link *links = realloc(state->links,
+                size * sizeof(*links));
+
+            if (links == NULL) {
+                return -1;
+            }
+
+            state->links = links;
+            state->link_size = size;
+        }
+
+        link = ++state->link_count;
+    }
+
+    struct channel_nick *nick = &state->nicks[id - 1];
+
+    state->links[link - 1].channel = (uint32_t)index + 1;
+    state->links[link - 1].next = nick->link;
+    nick->link = link;
+    nick->channels++;
+
+    return 0;
+}
+
+/**
+ * channel_link_remove() - Forget that a nick is in a channel
+ * @state: Channel state
+ * @id: Nick id
+ * @index: Channel index
+ *
+ * Walks only the channels of this nick. The nick itself is dropped
+ * once it is in none of our channels.
+ */
+static void channel_link_remove(struct channel_state *state, uint32_t id,
+        int index)
+{
+    uint32_t *prev = &state->nicks[id - 1].link;
+
+    while (*prev != 0) {
+        uint32_t link = *prev;
+
+        if (state->links[link - 1].channel == (uint32_t)index + 1) {
+            *prev = state->links[link - 1].next;
+            state->links[link - 1].next = state->link_free;
+            state->link_free = link;
+            state->nicks[id - 1].channels--;
+            break;
+        }
+
+        prev = &state->links[link - 1].next;
+    }
+
+    channel_nick_release(state, id);
+}
+
+/**
+ * channel_member_hash() - Home slot of a nick id in a member set
+ * @id: Nick id
+ * @mask: Size of the set minus one
+ *
+ * Return: Slot index
+ */
+static uint32_t channel_member_hash(uint32_t id, uint32_t mask)
+{
+    return (id * 2654435761u) & mask;
+}
+
+/**
+ * channel_member_slot() - Probe the member set of a channel
+ * @channel: Channel
+ * @id: Nick id
+ *
+ * Return: Slot holding @id, or the empty slot where it belongs
+ */
+static uint32_t channel_member_slot(const struct channel *channel,
+        uint32_t id)
+{
+    uint32_t i = channel_member_hash(id, channel->mask);
+
+    while ((channel->members[i].nick != 0) &&
+        (channel->members[i].nick != id)) {
+        i = (i + 1) & channel->mask;
+    }
+
+    return i;
+}
+
+/**
+ * channel_member_grow() - Double the member set of a channel
+ * @channel: Channel
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int channel_member_grow(struct channel *channel)
+{
+    uint32_t size = (channel->mask + 1) * 2;
+    struct channel_member *members = calloc(size, sizeof(*members));
+
+    if (members == NULL) {
+        return -1;
+    }
+
+    for (uint32_t j = 0; j <= channel->mask; ++j) {
+        if (channel->members[j].nick == 0) {
+            continue;
+        }
+
+        uint32_t i = channel_member_hash(channel->members[j].nick, size - 1);
+
+        while (members[i].nick != 0) {
+            i = (i + 1) & (size - 1);
+        }
+
+        members[i] = channel->members[j];
+    }
+
+    free(channel->members);
+    channel->members = members;
+    channel->mask = size - 1;
+
+    return 0;
+}
+
+/**
+ * channel_member_add() - Add a nick to a channel or update its modes
+ * @state: Channel state
+ * @index: Channel index
+ * @name: Nickname bytes, not NUL-terminated
+ * @len: Length of @name
+ * @modes: Prefix modes of the member
+ */
+static void channel_member_add(struct channel_state *state, int index,
+        const char *name, int len, uint32_t modes)
+{
+    struct channel *channel = state->channels[index];
+    uint32_t id = channel_nick_add(state, name, len);
+
+    if (id == 0) {
+        return;
+    }
+
+    uint32_t i = channel_member_slot(channel, id);
+
+    if (channel->members[i].nick == id) {
+        channel->members[i].modes = modes;
+        return;
+    }
+
+    if ((channel->count + 1) * 2 > channel->mask + 1) {
+        if (channel_member_grow(channel) < 0) {
+            channel_nick_release(state, id);
+            return;
+        }
+
+        i = channel_member_slot(channel, id);
+    }
+
+    if (channel_link_add(state, id, index) < 0) {
+        channel_nick_release(state, id);
+        return;
+    }
+
+    channel->members[i].nick = id;
+    channel->members[i].modes = modes;
+    channel->count++;
+}
+
+/**
+ * channel_member_remove() - Remove a nick from a channel
+ * @state: Channel state
+ * @index: Channel index
+ * @id: Nick id
+ * @unlink: Whether to also remove the channel from the nick's links
+ */
+static void channel_member_remove(struct channel_state *state, int index,
+        uint32_t id, int unlink)
+{
+    struct channel *channel = state->channels[index];
+    uint32_t mask = channel->mask;
+    uint32_t i = channel_member_slot(channel, id);
+
+    if (channel->members[i].nick != id) {
+        return;
+    }
+
+    channel->members[i].nick = 0;
+    channel->count--;
+
+    for (uint32_t j = (i + 1) & mask; channel->members[j].nick != 0;
+        j = (j + 1) & mask) {
+        uint32_t home = channel_member_hash(channel->members[j].nick, mask);
+
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            channel->members[i] = channel->members[j];
+            channel->members[j].nick = 0;
+            i = j;
+        }
+    }
+
+    if (unlink) {
+        channel_link_remove(state, id, index);
+    }
+}
+
+/**
+ * channel_index() - Look up a channel we are in
+ * @state: Channel state
+ * @name: Channel name, not NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: Channel index, or -1 if we are not in the channel
+ */
+static int channel_index(struct channel_state *state,
+        const char *name, int len)
+{
+    uint32_t id = intern_find(state->names, name, len);
+
+    for (int i = 0; (id != 0) && (i < KIRC_CHANNEL_LIMIT); ++i) {
+        if ((state->channels[i] != NULL) && (state->channels[i]->id == id)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * channel_find() - Look up a channel we are in
+ * @state: Channel state
+ * @name: Channel name, need not be NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: Channel, or NULL if we are not in it
+ */
+struct channel *channel_find(struct channel_state *state,
+        const char *name, int len)
+{
+    int index = channel_index(state, name, len);
+
+    return (index < 0) ? NULL : state->channels[index];
+}
+
+/**
+ * channel_create() - Start tracking a channel we joined
+ * @state: Channel state
+ * @name: Channel name, not NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: Channel index, or -1 if the channel limit is reached or
+ * allocation fails
+ */
+static int channel_create(struct channel_state *state,
+        const char *name, int len)
+{
+    int index = channel_index(state, name, len);
+
+    if (index >= 0) {
+        return index;
+    }
+
+    for (index = 0; (index < KIRC_CHANNEL_LIMIT) &&
+        (state->channels[index] != NULL); ++index) {
+        continue;
+    }
+
+    if (index == KIRC_CHANNEL_LIMIT) {
+        return -1;
+    }
+
+    struct channel *channel = calloc(1, sizeof(*channel));
+
+    if (channel == NULL) {
+        return -1;
+    }
+
+    channel->members = calloc(16, sizeof(*channel->members));
+    channel->id = intern_add(state->names, name, len);
+
+    if ((channel->members == NULL) || (channel->id == 0)) {
+        intern_release(state->names, channel->id);
+        free(channel->members);
+        free(channel);
+        return -1;
+    }
+
+    channel->mask = 15;
+    state->channels[index] = channel;
+
+    return index;
+}
+
+/**
+ * channel_destroy() - Stop tracking a channel
+ * @state: Channel state
+ * @index: Channel index
+ *
+ * Nicks left in none of our channels are dropped.
+ */
+static void channel_destroy(struct channel_state *state, int index)
+{
+    struct channel *channel = state->channels[index];
+
+    for (uint32_t i = 0; i <= channel->mask; ++i) {
+        if (channel->members[i].nick != 0) {
+            channel_link_remove(state, channel->members[i].nick, index);
+        }
+    }
+
+    intern_release(state->names, channel->id);
+    free(channel->members);
+    free(channel);
+    state->channels[index] = NULL;
+}
+
+/**
+ * channel_join() - Handle a JOIN
+ * @state: Channel state
+ * @event: JOIN event
+ * @self: Whether we are the one joining
+ *
+ * Our own JOIN starts tracking the channel; anyone else's adds them to
+ * a channel we are in.
+ */
+void channel_join(struct channel_state *state, struct event *event,
+        int self)
+{
+    const struct event_view *channel = &event->channel;
+    const struct event_view *nick = &event->nickname;
+    int index;
+
+    if ((channel->len == 0) || (nick->len == 0)) {
+        return;
+    }
+
+    if (self) {
+        index = channel_create(state, channel->ptr, channel->len);
+    } else {
+        index = channel_index(state, channel->ptr, channel->len);
+    }
+
+    if (index >= 0) {
+        channel_member_add(state, index, nick->ptr, nick->len, 0);
+    }
+}
+
+/**
+ * channel_part() - Handle a PART or KICK
+ * @state: Channel state
+ * @channel: Channel left
+ * @nick: Nick that left or was kicked
+ * @self: Whether @nick is us
+ *
+ * When we are the one leaving, the channel is no longer tracked.
+ */
+void channel_part(struct channel_state *state, const struct event_view *channel,
+        const struct event_view *nick, int self)
+{
+    int index = channel_index(state, channel->ptr, channel->len);
+
+    if (index < 0) {
+        return;
+    }
+
+    if (self) {
+        channel_destroy(state, index);
+        return;
+    }
+
+    uint32_t id = channel_nick_find(state, nick->ptr, nick->len);
+
+    if (id != 0) {
+        channel_member_remove(state, index, id, 1);
+    }
+}
+
+/**
+ * channel_nick_drop() - Remove a nick from all of its channels
+ * @state: Channel state
+ * @id: Nick id
+ */
+static void channel_nick_drop(struct channel_state *state, uint32_t id)
+{
+    uint32_t link = state->nicks[id - 1].link;
+
+    while (link != 0) {
+        uint32_t next = state->links[link - 1].next;
+        int index = (int)state->links[link - 1].channel - 1;
+
+        channel_member_remove(state, index, id, 0);
+        state->links[link - 1].next = state->link_free;
+        state->link_free = link;
+        link = next;
+    }
+
+    state->nicks[id - 1].link = 0;
+    state->nicks[id - 1].channels = 0;
+    channel_nick_release(state, id);
+}
+
+/**
+ * channel_quit() - Handle a QUIT
+ * @state: Channel state
+ * @nick: Id of the nick that quit, or 0
+ *
+ * Removes the nick from exactly the channels it was in. Also used when
+ * a NICK collides with a nick we still track, which means an event was
+ * missed.
+ */
+void channel_quit(struct channel_state *state, uint32_t nick)
+{
+    if ((nick != 0) && (nick <= state->nick_size) &&
+        (state->nicks[nick - 1].channels != 0)) {
+        channel_nick_drop(state, nick);
+    }
+}
+
+/**
+ * channel_mode() - Apply the prefix mode changes of a MODE
+ * @state: Channel state
+ * @event: MODE event
+ *
+ * Walks the mode string, consuming arguments as CHANMODES and PREFIX
+ * say, and updates the modes of members given +o, -v and the like.
+ * User modes and other channel modes are ignored.
+ */
+void channel_mode(struct channel_state *state, struct event *event)
+{
+    int index = channel_index(state, event->channel.ptr,
+        event->channel.len);
+
+    if (index < 0) {
+        return;
+    }
+
+    struct event_view args[KIRC_PARAMS_MAX + 1];
+    int count = 0;
+
+    for (int i = 1; i < event->param_count; ++i) {
+        args[count++] = event->params[i];
+    }
+
+    if (event->message.len > 0) {
+        args[count++] = event->message;
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    const struct event_view *modes = &args[0];
+    int next = 1;
+    int adding = 1;
+
+    for (int i = 0; i < modes->len; ++i) {
+        char mode = modes->ptr[i];
+
+        if ((mode == '+') || (mode == '-')) {
+            adding = (mode == '+');
+            continue;
+        }
+
+        if (!isupport_mode_arg(state->isupport, mode, adding)) {
+            continue;
+        }
+
+        if (next == count) {
+            break;
+        }
+
+        const struct event_view *arg = &args[next++];
+        int rank = isupport_prefix(state->isupport, mode);
+
+        if (rank < 0) {
+            continue;
+        }
+
+        uint32_t id = channel_nick_find(state, arg->ptr, arg->len);
+
+        if (id == 0) {
+            continue;
+        }
+
+        struct channel *channel = state->channels[index];
+        uint32_t slot = channel_member_slot(channel, id);
+
+        if (channel->members[slot].nick != id) {
+            continue;
+        }
+
+        if (adding) {
+            channel->members[slot].modes |= (uint32_t)1 << rank;
+        } else {
+            channel->members[slot].modes &= ~((uint32_t)1 << rank);
+        }
+    }
+}
+
+/**
+ * channel_names() - Handle an RPL_NAMREPLY (353)
+ * @state: Channel state
+ * @event: Event of the form "<me> <type> <channel> :<names>"
+ *
+ * Adds every listed nick with the modes of its prefixes. All prefixes
+ * are honoured, in case the server sends several (multi-prefix), and a
+ * trailing !user@host (userhost-in-names) is dropped.
+ */
+void channel_names(struct channel_state *state, struct event *event)
+{
+    if (event->param_count < 3) {
+        return;
+    }
+
+    const struct event_view *name = &event->params[2];
+    int index = channel_index(state, name->ptr, name->len);
+
+    if (index < 0) {
+        return;
+    }
+
+    const char *symbols = state->isupport->prefix_symbols;
+    const char *p = event->message.ptr;
+    const char *end = p + event->message.len;
+
+    while (p < end) {
+        const char *space = memchr(p, ' ', (size_t)(end - p));
+        const char *stop = (space != NULL) ? space : end;
+        const char *symbol;
+        uint32_t modes = 0;
+
+        while ((p < stop) && (*p != '\0') &&
+            ((symbol = strchr(symbols, *p)) != NULL)) {
+            modes |= (uint32_t)1 << (symbol - symbols);
+            p++;
+        }
+
+        int len = 0;
+
+        while ((p + len < stop) && (p[len] != '!')) {
+            len++;
+        }
+
+        if (len > 0) {
+            channel_member_add(state, index, p, len, modes);
+        }
+
+        p = stop + 1;
+    }
+}
+
+/**
+ * channel_name() - Name of a channel we are in
+ * @state: Channel state
+ * @channel: Channel
+ *
+ * Return: Channel name as we joined it
+ */
+const char *channel_name(struct channel_state *state,
+        const struct channel *channel)
+{
+    return intern_name(state->names, channel->id);
+}
+
+/**
+ * channel_member_prefix() - Highest prefix symbol of a member
+ * @state: Channel state
+ * @member: Occupied member slot
+ *
+ * Return: Prefix symbol such as '@', or 0 if the member has none
+ */
+int channel_member_prefix(struct channel_state *state,
+        const struct channel_member *member)
+{
+    for (int rank = 0; state->isupport->prefix_symbols[rank] != '\0';
+        ++rank) {
+        if (member->modes & ((uint32_t)1 << rank)) {
+            return (unsigned char)state->isupport->prefix_symbols[rank];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * channel_member_name() - Nickname of a member
+ * @state: Channel state
+ * @member: Occupied member slot
+ *
+ * Return: Nickname, valid until the next change to the channel state
+ */
+const char *channel_member_name(struct channel_state *state,
+        const struct channel_member *member)
+{
+    return intern_name(state->names, member->nick);
+}
+
+/**
+ * channel_memory() - Bytes held by the channel state
+ * @state: Channel state
+ *
+ * The interned names are not included, see intern_memory().
+ *
+ * Return: Approximate heap use, not counting allocator overhead
+ */
+size_t channel_memory(struct channel_state *state)
+{
+    size_t bytes = state->nick_size * sizeof(*state->nicks) +
+        state->link_size * sizeof(*state->links);
+
+    for (int i = 0; i < KIRC_CHANNEL_LIMIT; ++i) {
+        if (state->channels[i] != NULL) {
+            bytes += sizeof(struct channel) + (state->channels[i]->mask + 1) *
+                sizeof(struct channel_member);
+        }
+    }
+
+    return bytes;
+}
+
+/**
+ * channel_clear() - Forget every channel, e.g. after a disconnect
+ * @state: Channel state
+ */
+void channel_clear(struct channel_state *state)
+{
+    for (int i = 0; i < KIRC_CHANNEL_LIMIT; ++i) {
+        if (state->channels[i] != NULL) {
+            channel_destroy(state, i);
+        }
+    }
+}
+
+/**
+ * channel_init() - Initialize empty channel state
+ * @state: Channel state to initialize
+ * @names: Name table of the connection for nicks and channel names
+ * @isupport: Server features with the membership prefixes
+ *
+ * Return: 0 on success, -1 if a parameter is NULL or allocation fails
+ */
+int channel_init(struct channel_state *state, struct intern *names,
+        struct isupport *isupport)
+{
+    if ((state == NULL) || (names == NULL) || (isupport == NULL)) {
+        return -1;
+    }
+
+    memset(state, 0, sizeof(*state));
+    state->names = names;
+    state->isupport = isupport;
+    state->nick_size = 64;
+    state->link_size = 64;
+
+    state->nicks = calloc(state->nick_size, sizeof(*state->nicks));
+    state->links = malloc(state->link_size * sizeof(*state->links));
+
+    if ((state->nicks == NULL) || (state->links == NULL)) {
+        channel_free(state);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * channel_free() - Release all channel state
+ * @state: Channel state to clean up
+ *
+ * Return: 0 on success, -1 if state is NULL
+ */
+int channel_free(struct channel_state *state)
+{
+    if (state == NULL) {
+        return -1;
+    }
+
+    if ((state->nicks != NULL) && (state->links != NULL)) {
+        channel_clear(state);
+    }
+
+    free(state->nicks);
+    free(state->links);
+    state->nicks = NULL;
+    state->links = NULL;
+
+    return 0;
+}
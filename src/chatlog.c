@@ -0,0 +1,747 @@
+/*
+ * chatlog.c
+ * Append-only on-disk chat log with a block index
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "chatlog.h"
+
+/*
+ * Each server is logged to numbered segment files in the log directory,
+ * <server>.000000.log and up, one line of text per event:
+ *
+ *   <time>\t<command>\t<channel>\t<nick>\t<text>\n
+ *
+ * so the files can still be read with a pager or grep. A new segment is
+ * started once one reaches KIRC_LOG_SEGMENT_SIZE. Next to each segment
+ * a .idx file holds one struct chatlog_entry for every block of about
+ * KIRC_LOG_BLOCK_SIZE bytes: where the block starts, the times of its
+ * first and last records and a 64-bit bloom filter of the channels in
+ * it. The index is a cache in host byte order; anything it does not
+ * cover, such as the tail of a log left by a crash, is simply scanned.
+ *
+ * A search maps the segments read-only, newest first, skips every block
+ * whose bloom filter rules out the channel, and runs find_substring()
+ * over the rest.
+ */
+
+struct chatlog_match {
+    time_t time;
+    int action;
+    char channel[CHANNEL_MAX_LEN];
+    char nick[MESSAGE_MAX_LEN];
+    char text[MESSAGE_MAX_LEN];
+};
+
+struct chatlog_record {
+    const char *field[5];  /* time, command, channel, nick, text */
+    int len[5];
+};
+
+/**
+ * chatlog_path() - Build the file name of a segment or its index
+ * @chatlog: Chat log
+ * @segment: Segment number
+ * @suffix: "log" or "idx"
+ * @buf: Destination buffer
+ * @n: Size of @buf
+ *
+ * Return: 0 on success, -1 if the name does not fit
+ */
+static int chatlog_path(struct chatlog *chatlog, unsigned int segment,
+        const char *suffix, char *buf, size_t n)
+{
+    int len = snprintf(buf, n, "%s.%06u.%s", chatlog->prefix, segment,
+        suffix);
+
+    return ((len < 0) || ((size_t)len >= n)) ? -1 : 0;
+}
+
+/**
+ * chatlog_bloom() - Bloom filter bits of a channel name
+ * @chatlog: Chat log
+ * @channel: Channel or nickname
+ * @len: Length of @channel
+ *
+ * Hashes the name under the log's case mapping, so that lookups ignore
+ * case, and sets two of 64 bits.
+ *
+ * Return: Bloom filter with the bits of @channel set
+ */
+static uint64_t chatlog_bloom(const struct chatlog *chatlog,
+        const char *channel, int len)
+{
+    uint32_t hash = casemap_hash(&chatlog->casemap, channel, (size_t)len);
+
+    return ((uint64_t)1 << (hash & 63)) | ((uint64_t)1 << ((hash >> 6) & 63));
+}
+
+/**
+ * chatlog_write() - Write a buffer to a file descriptor in full
+ * @fd: File descriptor
+ * @buf: Bytes to write
+ * @len: Number of bytes
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int chatlog_write(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return 0;
+}
+
+/**
+ * chatlog_flush() - Write buffered records to the current segment
+ * @chatlog: Chat log
+ *
+ * Return: 0 on success or when logging is off, -1 on write error
+ */
+int chatlog_flush(struct chatlog *chatlog)
+{
+    if ((chatlog == NULL) || (chatlog->fd < 0) ||
+        (chatlog->pending_len == 0)) {
+        return 0;
+    }
+
+    int rc = chatlog_write(chatlog->fd, chatlog->pending,
+        chatlog->pending_len);
+
+    chatlog->pending_len = 0;
+
+    return rc;
+}
+
+/**
+ * chatlog_index() - Close the current block and add it to the index
+ * @chatlog: Chat log
+ *
+ * The records of the block are flushed first, so an index entry never
+ * points past the end of its segment.
+ *
+ * Return: 0 on success, -1 on write error
+ */
+static int chatlog_index(struct chatlog *chatlog)
+{
+    if (chatlog->block.length == 0) {
+        return 0;
+    }
+
+    int rc = chatlog_flush(chatlog);
+
+    if ((rc == 0) && (chatlog->index_fd >= 0)) {
+        rc = chatlog_write(chatlog->index_fd, &chatlog->block,
+            sizeof(chatlog->block));
+    }
+
+    chatlog->block.offset += chatlog->block.length;
+    chatlog->block.length = 0;
+    chatlog->block.first = 0;
+    chatlog->block.last = 0;
+    chatlog->block.bloom = 0;
+
+    return rc;
+}
+
+/**
+ * chatlog_close() - Close the files of the current segment
+ * @chatlog: Chat log
+ */
+static void chatlog_close(struct chatlog *chatlog)
+{
+    chatlog_index(chatlog);
+    chatlog_flush(chatlog);
+
+    if (chatlog->fd >= 0) {
+        close(chatlog->fd);
+        chatlog->fd = -1;
+    }
+
+    if (chatlog->index_fd >= 0) {
+        close(chatlog->index_fd);
+        chatlog->index_fd = -1;
+    }
+}
+
+/**
+ * chatlog_open() - Open the current segment and its index for appending
+ * @chatlog: Chat log with segment set
+ *
+ * A segment cut short in the middle of a record is ended with a newline
+ * first, so that the next record starts on a line of its own.
+ *
+ * Return: 0 on success, -1 on error with errno set
+ */
+static int chatlog_open(struct chatlog *chatlog)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    int flags = O_CREAT | O_APPEND | O_CLOEXEC;
+
+    if (chatlog_path(chatlog, chatlog->segment, "log",
+        path, sizeof(path)) < 0) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    /* read access only for checking the last byte */
+    chatlog->fd = open(path, O_RDWR | flags, 0600);
+
+    if ((chatlog->fd < 0) || (fstat(chatlog->fd, &st) < 0)) {
+        return -1;
+    }
+
+    chatlog->size = (uint64_t)st.st_size;
+
+    if (chatlog->size > 0) {
+        char last = '\n';
+
+        if ((pread(chatlog->fd, &last, 1, st.st_size - 1) == 1) &&
+            (last != '\n') && (chatlog_write(chatlog->fd, "\n", 1) == 0)) {
+            chatlog->size++;
+        }
+    }
+
+    memset(&chatlog->block, 0, sizeof(chatlog->block));
+    chatlog->block.offset = chatlog->size;
+
+    /* without an index, searches scan the whole segment */
+    if (chatlog_path(chatlog, chatlog->segment, "idx",
+        path, sizeof(path)) == 0) {
+        chatlog->index_fd = open(path, O_WRONLY | flags, 0600);
+    }
+
+    return 0;
+}
+
+/**
+ * chatlog_field() - Copy a field into a record
+ * @dst: Record being built
+ * @pos: Current length of the record
+ * @src: Field bytes
+ * @len: Length of @src
+ * @max: Maximum number of bytes to copy
+ * @sep: Character that ends the field
+ *
+ * Tabs and line breaks would break the record format and are replaced
+ * by spaces.
+ *
+ * Return: New length of the record
+ */
+static size_t chatlog_field(char *dst, size_t pos, const char *src,
+        int len, int max, char sep)
+{
+    if (len > max) {
+        len = max;
+    }
+
+    for (int i = 0; i < len; ++i) {
+        char c = src[i];
+        dst[pos++] = ((c == '\t') || (c == '\r') || (c == '\n')) ? ' ' : c;
+    }
+
+    dst[pos++] = sep;
+
+    return pos;
+}
+
+/**
+ * chatlog_append() - Add a record to the log
+ * @chatlog: Chat log
+ * @time: When the event happened
+ * @command: IRC command, or "ACTION" for a CTCP ACTION
+ * @channel: Channel or nickname the record belongs to, not NUL-terminated
+ * @channel_len: Length of @channel
+ * @nick: Sender, not NUL-terminated, may be empty
+ * @nick_len: Length of @nick
+ * @text: Message text, not NUL-terminated, may be empty
+ * @text_len: Length of @text
+ *
+ * Records are buffered and written once KIRC_LOG_BUFFER_SIZE bytes have
+ * gathered or chatlog_flush() is called.
+ *
+ * Return: 0 on success or when logging is off, -1 on write error
+ */
+int chatlog_append(struct chatlog *chatlog, time_t time,
+        const char *command, const char *channel, int channel_len,
+        const char *nick, int nick_len, const char *text, int text_len)
+{
+    if ((chatlog == NULL) || (chatlog->fd < 0)) {
+        return 0;
+    }
+
+    char record[32 + 32 + CHANNEL_MAX_LEN + 2 * MESSAGE_MAX_LEN];
+    int rc = 0;
+    size_t len = (size_t)snprintf(record, 32, "%lld\t", (long long)time);
+
+    len = chatlog_field(record, len, command, (int)strlen(command), 31, '\t');
+    len = chatlog_field(record, len, channel, channel_len,
+        CHANNEL_MAX_LEN - 1, '\t');
+    len = chatlog_field(record, len, nick, nick_len, MESSAGE_MAX_LEN, '\t');
+    len = chatlog_field(record, len, text, text_len, MESSAGE_MAX_LEN, '\n');
+
+    if ((chatlog->size > 0) &&
+        (chatlog->size + len > KIRC_LOG_SEGMENT_SIZE)) {
+        chatlog_close(chatlog);
+        chatlog->segment++;
+
+        if (chatlog_open(chatlog) < 0) {
+            fprintf(stderr, "log: cannot open segment %u: %s\r\n",
+                chatlog->segment, strerror(errno));
+            chatlog_close(chatlog);
+            return -1;
+        }
+    } else if (chatlog->block.length + len > KIRC_LOG_BLOCK_SIZE) {
+        rc = chatlog_index(chatlog);
+    }
+
+    if (chatlog->pending_len + len > sizeof(chatlog->pending)) {
+        rc |= chatlog_flush(chatlog);
+    }
+
+    memcpy(chatlog->pending + chatlog->pending_len, record, len);
+    chatlog->pending_len += len;
+    chatlog->size += len;
+
+    if (chatlog->block.length == 0) {
+        chatlog->block.first = (uint32_t)time;
+    }
+
+    chatlog->block.length += (uint32_t)len;
+    chatlog->block.last = (uint32_t)time;
+    chatlog->block.bloom |= chatlog_bloom(chatlog, channel, channel_len);
+
+    return rc;
+}
+
+/**
+ * chatlog_event() - Log a message received from the server
+ * @chatlog: Chat log
+ * @event: Parsed event
+ * @direct: Whether the message was addressed to us
+ *
+ * Messages sent to us directly are filed under the sender, like a query
+ * window, and messages whose only parameter is the trailing one, such
+ * as NICK and QUIT, under "*". Keepalive traffic is not logged.
+ */
+void chatlog_event(struct chatlog *chatlog, struct event *event, int direct)
+{
+    if ((chatlog == NULL) || (chatlog->fd < 0) ||
+        (event->type == EVENT_PING) || (event->type == EVENT_PONG)) {
+        return;
+    }
+
+    char command[32];
+    struct event_view channel = event->channel;
+
+    if (event->type == EVENT_CTCP_ACTION) {
+        safecpy(command, "ACTION", sizeof(command));
+    } else {
+        event_view_copy(command, &event->command, sizeof(command));
+    }
+
+    if ((channel.len == 0) || (channel.ptr == event->message.ptr)) {
+        channel.ptr = "*";
+        channel.len = 1;
+    } else if (direct && (event->nickname.len > 0)) {
+        channel = event->nickname;
+    }
+
+    chatlog_append(chatlog, event_time(event), command,
+        channel.ptr, channel.len, event->nickname.ptr, event->nickname.len,
+        event->message.ptr, event->message.len);
+}
+
+/**
+ * chatlog_parse() - Split a record into its fields
+ * @line: Start of the record
+ * @end: End of the record, excluding the newline
+ * @record: Destination for the fields
+ *
+ * Return: 0 on success, -1 if the line is not a record
+ */
+static int chatlog_parse(const char *line, const char *end,
+        struct chatlog_record *record)
+{
+    for (int i = 0; i < 4; ++i) {
+        const char *tab = memchr(line, '\t', (size_t)(end - line));
+
+        if (tab == NULL) {
+            return -1;
+        }
+
+        record->field[i] = line;
+        record->len[i] = (int)(tab - line);
+        line = tab + 1;
+    }
+
+    record->field[4] = line;
+    record->len[4] = (int)(end - line);
+
+    return 0;
+}
+
+/**
+ * chatlog_scan() - Search one range of a mapped segment
+ * @chatlog: Chat log
+ * @data: Start of the range
+ * @len: Length of the range, a whole number of records
+ * @channel: Channel to match, or empty for any
+ * @needle: Text to look for
+ * @found: Ring of the last KIRC_LOG_MATCHES matches in the range
+ * @count: Number of matches in the range, updated
+ *
+ * Candidates are found with find_substring() over the whole range and
+ * then checked against the text and channel fields of their record.
+ */
+static void chatlog_scan(struct chatlog *chatlog, const char *data,
+        size_t len, const char *channel, const char *needle,
+        struct chatlog_match *found, size_t *count)
+{
+    const char *p = data;
+    const char *end = data + len;
+    size_t n = strlen(needle);
+
+    while ((p = find_substring(p, (size_t)(end - p), needle, n)) != NULL) {
+        const char *line = p;
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        struct chatlog_record record;
+
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        while ((line > data) && (line[-1] != '\n')) {
+            line--;
+        }
+
+        p = (eol < end) ? eol + 1 : end;
+
+        if ((chatlog_parse(line, eol, &record) < 0) ||
+            (find_substring(record.field[4], (size_t)record.len[4],
+                needle, n) == NULL)) {
+            continue;
+        }
+
+        if ((channel[0] != '\0') && !casemap_equals(&chatlog->casemap,
+            record.field[2], (size_t)record.len[2], channel,
+            strlen(channel))) {
+            continue;
+        }
+
+        struct chatlog_match *match = &found[*count % KIRC_LOG_MATCHES];
+
+        match->time = (time_t)strtoll(record.field[0], NULL, 10);
+        match->action = (record.len[1] == 6) &&
+            (memcmp(record.field[1], "ACTION", 6) == 0);
+        snprintf(match->channel, sizeof(match->channel), "%.*s",
+            record.len[2], record.field[2]);
+        snprintf(match->nick, sizeof(match->nick), "%.*s",
+            record.len[3], record.field[3]);
+        snprintf(match->text, sizeof(match->text), "%.*s",
+            record.len[4], record.field[4]);
+        (*count)++;
+    }
+}
+
+/**
+ * chatlog_collect() - Search a range and keep its newest matches
+ * @chatlog: Chat log
+ * @data: Start of the range
+ * @len: Length of the range
+ * @channel: Channel to match, or empty for any
+ * @needle: Text to look for
+ * @matches: Matches so far, newest first
+ * @count: Number of entries in @matches, updated
+ *
+ * Ranges are searched from the newest to the oldest, so the matches of
+ * this range are older than those already collected.
+ */
+static void chatlog_collect(struct chatlog *chatlog, const char *data,
+        size_t len, const char *channel, const char *needle,
+        struct chatlog_match *matches, size_t *count)
+{
+    struct chatlog_match found[KIRC_LOG_MATCHES];
+    size_t n = 0;
+
+    chatlog_scan(chatlog, data, len, channel, needle, found, &n);
+
+    for (size_t i = 0; (i < n) && (i < KIRC_LOG_MATCHES) &&
+        (*count < KIRC_LOG_MATCHES); ++i) {
+        matches[(*count)++] = found[(n - 1 - i) % KIRC_LOG_MATCHES];
+    }
+}
+
+/**
+ * chatlog_search_segment() - Search one segment, newest block first
+ * @chatlog: Chat log
+ * @segment: Segment number
+ * @channel: Channel to match, or empty for any
+ * @needle: Text to look for
+ * @matches: Matches so far, newest first
+ * @count: Number of entries in @matches, updated
+ * @blocks: Number of indexed blocks skipped, updated
+ *
+ * Return: 0 on success, -1 if the segment cannot be read
+ */
+static int chatlog_search_segment(struct chatlog *chatlog,
+        unsigned int segment, const char *channel, const char *needle,
+        struct chatlog_match *matches, size_t *count, unsigned long *blocks)
+{
+    char path[PATH_MAX];
+    struct stat st;
+
+    if (chatlog_path(chatlog, segment, "log", path, sizeof(path)) < 0) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if ((fstat(fd, &st) < 0) || (st.st_size == 0)) {
+        close(fd);
+        return 0;
+    }
+
+    uint64_t size = (uint64_t)st.st_size;
+    const char *data = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE,
+        fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    struct chatlog_entry *entries = NULL;
+    size_t entry_count = 0;
+
+    if ((chatlog_path(chatlog, segment, "idx", path, sizeof(path)) == 0) &&
+        ((fd = open(path, O_RDONLY | O_CLOEXEC)) >= 0)) {
+        if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+            entries = malloc((size_t)st.st_size);
+        }
+
+        if (entries != NULL) {
+            ssize_t n = pread(fd, entries, (size_t)st.st_size, 0);
+            entry_count = (n > 0) ? (size_t)n / sizeof(*entries) : 0;
+        }
+
+        close(fd);
+    }
+
+    uint64_t bloom = chatlog_bloom(chatlog, channel, (int)strlen(channel));
+    uint64_t end = size;  /* everything past @end has been searched */
+
+    for (size_t i = entry_count; (i > 0) && (*count < KIRC_LOG_MATCHES);
+        --i) {
+        const struct chatlog_entry *entry = &entries[i - 1];
+        uint64_t start = entry->offset;
+        uint64_t stop = start + entry->length;
+
+        if ((start >= end) || (stop > end)) {
+            continue;  /* stale index */
+        }
+
+        if (stop < end) {
+            chatlog_collect(chatlog, data + stop, (size_t)(end - stop),
+                channel, needle, matches, count);
+        }
+
+        end = start;
+
+        if ((channel[0] != '\0') && ((entry->bloom & bloom) != bloom)) {
+            (*blocks)++;
+            continue;
+        }
+
+        if (*count < KIRC_LOG_MATCHES) {
+            chatlog_collect(chatlog, data + start, entry->length, channel,
+                needle, matches, count);
+        }
+    }
+
+    if ((end > 0) && (*count < KIRC_LOG_MATCHES)) {
+        chatlog_collect(chatlog, data, (size_t)end, channel, needle,
+            matches, count);
+    }
+
+    free(entries);
+    munmap((void *)data, (size_t)size);
+
+    return 0;
+}
+
+/**
+ * chatlog_search() - Show the most recent records containing a string
+ * @chatlog: Chat log
+ * @channel: Channel or nickname to search, or empty for all
+ * @needle: Text to look for, ignoring ASCII case
+ * @output: Output buffer for display
+ *
+ * Return: Number of matches shown, or -1 if logging is off
+ */
+int chatlog_search(struct chatlog *chatlog, const char *channel,
+        const char *needle, struct output *output)
+{
+    if ((chatlog == NULL) || (chatlog->fd < 0)) {
+        const char *err = "search: logging is off, see -l";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+        return -1;
+    }
+
+    struct chatlog_match *matches = malloc(KIRC_LOG_MATCHES *
+        sizeof(*matches));
+
+    if (matches == NULL) {
+        return -1;
+    }
+
+    size_t count = 0;
+    unsigned long skipped = 0;
+
+    chatlog_flush(chatlog);
+
+    for (unsigned int segment = chatlog->segment + 1;
+        (segment > 0) && (count < KIRC_LOG_MATCHES); --segment) {
+        chatlog_search_segment(chatlog, segment - 1, channel, needle,
+            matches, &count, &skipped);
+    }
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "search: %zu matches for \"%s\" in %s, %lu blocks skipped"
+        RESET "\r\n", count, needle,
+        channel[0] != '\0' ? channel : "all channels", skipped);
+
+    for (size_t i = count; i > 0; --i) {
+        const struct chatlog_match *match = &matches[i - 1];
+        char timestamp[20];
+
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M",
+            localtime(&match->time));
+
+        output_append(output, "\r" CLEAR_LINE DIM "%s", timestamp);
+
+        if (channel[0] == '\0') {
+            output_append(output, " %s", match->channel);
+        }
+
+        if (match->action) {
+            output_append(output, " \u2022 %s %s" RESET "\r\n",
+                match->nick, match->text);
+        } else {
+            output_append(output, RESET " " BOLD "%s" RESET " %s\r\n",
+                match->nick, match->text);
+        }
+    }
+
+    free(matches);
+
+    return (int)count;
+}
+
+/**
+ * chatlog_init() - Open the log of a server
+ * @chatlog: Chat log to initialize
+ * @ctx: IRC context with the log directory and server name
+ *
+ * Does nothing when no log directory is configured. Otherwise the
+ * directory is created if needed and the newest segment of the server
+ * is opened for appending, or a new one if it is full. A log that
+ * cannot be opened is reported and leaves logging off for the server,
+ * rather than keeping the client from starting.
+ *
+ * Return: 0 on success or with logging off, -1 if chatlog or ctx is NULL
+ */
+int chatlog_init(struct chatlog *chatlog, struct kirc_context *ctx)
+{
+    if ((chatlog == NULL) || (ctx == NULL)) {
+        return -1;
+    }
+
+    memset(chatlog, 0, sizeof(*chatlog));
+    chatlog->ctx = ctx;
+    chatlog->fd = -1;
+    chatlog->index_fd = -1;
+    casemap_init(&chatlog->casemap, CASEMAPPING_RFC1459);
+
+    if (ctx->log_dir[0] == '\0') {
+        return 0;
+    }
+
+    if ((mkdir(ctx->log_dir, 0700) < 0) && (errno != EEXIST)) {
+        fprintf(stderr, "log: cannot create %s: %s, logging off\n",
+            ctx->log_dir, strerror(errno));
+        return 0;
+    }
+
+    int len = snprintf(chatlog->prefix, sizeof(chatlog->prefix), "%s/%s",
+        ctx->log_dir, ctx->server);
+
+    if ((len < 0) || ((size_t)len >= sizeof(chatlog->prefix))) {
+        fprintf(stderr, "log: directory name too long, logging off\n");
+        return 0;
+    }
+
+    char path[PATH_MAX];
+    struct stat st;
+
+    while ((chatlog_path(chatlog, chatlog->segment + 1, "log",
+        path, sizeof(path)) == 0) && (stat(path, &st) == 0)) {
+        chatlog->segment++;
+    }
+
+    if ((chatlog_path(chatlog, chatlog->segment, "log",
+        path, sizeof(path)) == 0) && (stat(path, &st) == 0) &&
+        ((uint64_t)st.st_size >= KIRC_LOG_SEGMENT_SIZE)) {
+        chatlog->segment++;
+    }
+
+    if (chatlog_open(chatlog) < 0) {
+        chatlog_path(chatlog, chatlog->segment, "log", path, sizeof(path));
+        fprintf(stderr, "log: cannot open %s: %s, logging off\n", path,
+            strerror(errno));
+        chatlog_close(chatlog);
+        return 0;
+    }
+
+    return 0;
+}
+
+/**
+ * chatlog_free() - Write out and close the log
+ * @chatlog: Chat log to clean up
+ *
+ * The block in progress is added to the index, so the next session
+ * does not have to scan it.
+ *
+ * Return: 0 on success, -1 if chatlog is NULL
+ */
+int chatlog_free(struct chatlog *chatlog)
+{
+    if (chatlog == NULL) {
+        return -1;
+    }
+
+    chatlog_close(chatlog);
+
+    return 0;
+}
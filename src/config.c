@@ -55,21 +55,78 @@ static int config_validate_port(const char *value)
  * @value: String containing channel names separated by ',' or '|'
  *
  * Parses a string of channel names and stores them in the context structure.
- * Supports both comma and pipe delimiters. Limited to KIRC_CHANNEL_LIMIT
- * channels.
+ * Supports both comma and pipe delimiters. A channel may carry a key as
+ * "#channel:key"; colons are not valid in channel names. Limited to
+ * KIRC_CHANNEL_LIMIT channels.
  */
 static void config_parse_channels(struct kirc_context *ctx, char *value)
 {
     char *tok = NULL;
     size_t idx = 0;
 
+    memset(ctx->channels, 0, sizeof(ctx->channels));
+    memset(ctx->keys, 0, sizeof(ctx->keys));
+
     for (tok = strtok(value, ",|"); tok != NULL && idx < KIRC_CHANNEL_LIMIT; 
         tok = strtok(NULL, ",|")) {
+        char *key = strchr(tok, ':');
+
+        if (key != NULL) {
+            *key++ = '\0';
+            safecpy(ctx->keys[idx], key, sizeof(ctx->keys[idx]));
+        }
+
         safecpy(ctx->channels[idx], tok, sizeof(ctx->channels[idx]));
         idx++;
     }
 }
 
+/**
+ * config_parse_flood() - Parse flood control settings
+ * @ctx: IRC context structure to store the settings
+ * @value: String in the form "burst:interval"
+ *
+ * Parses the send scheduler's token bucket: the number of messages that
+ * may be sent back to back, and the interval in milliseconds at which
+ * the allowance refills afterwards. Either field may be omitted to keep
+ * its current value (e.g. ":1000").
+ *
+ * Return: 0 on success, -1 if a field is not a positive number
+ */
+static int config_parse_flood(struct kirc_context *ctx, const char *value)
+{
+    char *endptr;
+    long burst = ctx->flood_burst;
+    long interval = ctx->flood_interval;
+
+    errno = 0;
+
+    if ((*value != ':') && (*value != '\0')) {
+        burst = strtol(value, &endptr, 10);
+        value = endptr;
+    }
+
+    if (*value == ':') {
+        value++;
+        interval = strtol(value, &endptr, 10);
+        value = endptr;
+    }
+
+    if ((*value != '\0') || (errno == ERANGE)) {
+        return -1;
+    }
+
+    if ((burst < 1) || (burst > 1000) ||
+        (interval < 1) || (interval > 60000)) {
+        return -1;
+    }
+
+    ctx->flood_burst = (int)burst;
+    ctx->flood_interval = (int)interval;
+
+    return 0;
+}
+
 /**
  * config_parse_mechanism() - Parse SASL authentication mechanism
  * @ctx: IRC context structure to store authentication settings
@@ -182,10 +239,11 @@ static int config_apply_env(struct kirc_context *ctx, const char *env_name,
  *
  * Initializes the configuration context with default values and applies
  * settings from environment variables (KIRC_SERVER, KIRC_PORT, KIRC_CHANNELS,
- * KIRC_REALNAME, KIRC_USERNAME, KIRC_PASSWORD, KIRC_AUTH). Validates port
- * numbers and parses authentication mechanisms.
+ * KIRC_REALNAME, KIRC_USERNAME, KIRC_PASSWORD, KIRC_AUTH, KIRC_TLS,
+ * KIRC_TLS_CERT, KIRC_FLOOD, KIRC_LOG).
+ * Validates port numbers and parses authentication mechanisms.
  *
- * Return: 0 on success, -1 if port validation fails
+ * Return: 0 on success, -1 if port or flood validation fails
  */
 int config_init(struct kirc_context *ctx)
 {
@@ -198,6 +256,8 @@ int config_init(struct kirc_context *ctx)
         sizeof(ctx->port));
 
     ctx->mechanism = SASL_NONE;
+    ctx->flood_burst = KIRC_FLOOD_BURST;
+    ctx->flood_interval = KIRC_FLOOD_INTERVAL_MS;
 
     config_apply_env(ctx, "KIRC_SERVER", ctx->server, sizeof(ctx->server));
 
@@ -209,6 +269,7 @@ int config_init(struct kirc_context *ctx)
         }
 
         safecpy(ctx->port, env_port, sizeof(ctx->port));
+        ctx->port_set = 1;
     }
 
     char *env_channels = getenv("KIRC_CHANNELS");
@@ -231,35 +292,62 @@ int config_init(struct kirc_context *ctx)
         config_parse_mechanism(ctx, env_auth);
     }
 
+    char *env_tls = getenv("KIRC_TLS");
+    if (env_tls && *env_tls) {
+        ctx->tls = 1;
+    }
+
+    config_apply_env(ctx, "KIRC_TLS_CERT", ctx->tls_cert,
+        sizeof(ctx->tls_cert));
+
+    config_apply_env(ctx, "KIRC_LOG", ctx->log_dir, sizeof(ctx->log_dir));
+
+    char *env_flood = getenv("KIRC_FLOOD");
+    if (env_flood && *env_flood) {
+        if (config_parse_flood(ctx, env_flood) < 0) {
+            fprintf(stderr, "invalid flood control in KIRC_FLOOD\n");
+            return -1;
+        }
+    }
+
     return 0;
 }
 
 /**
- * config_parse_args() - Parse command-line arguments
- * @ctx: IRC context structure to populate with parsed values
+ * config_parse_options() - Apply getopt options to the server contexts
+ * @ctx: Array of server contexts; ctx[0] holds the defaults
+ * @limit: Number of entries in @ctx
+ * @defaults: Scratch context that keeps the shared options
  * @argc: Argument count
  * @argv: Argument vector
  *
- * Parses command-line options using getopt. Supports:
- *   -s server, -p port, -r realname, -u username, -k password,
- *   -c channels, -a auth_mechanism
- * The nickname is required as a positional argument.
+ * Every -s starts a new server context, copied from the options seen
+ * before the first -s. Any other option applies to the most recently
+ * started server, or to the shared defaults before the first -s.
  *
- * Return: 0 on success, -1 on error or invalid arguments
+ * Return: Number of -s options seen, or -1 on invalid arguments
  */
-int config_parse_args(struct kirc_context *ctx, int argc, char *argv[])
+static int config_parse_options(struct kirc_context *ctx, int limit,
+        struct kirc_context *defaults, int argc, char *argv[])
 {
-    if (argc < 2) {
-        fprintf(stderr, "%s: no arguments\n", argv[0]);
-        return -1;
-    }
-
+    struct kirc_context *cur = &ctx[0];
+    int count = 0;
     int opt;
 
-    while ((opt = getopt(argc, argv, "s:p:r:u:k:c:a:")) > 0) {
+    while ((opt = getopt(argc, argv, "s:p:r:u:k:c:a:f:tx:l:")) > 0) {
         switch (opt) {
         case 's':  /* server */
-            safecpy(ctx->server, optarg, sizeof(ctx->server));
+            if (count == limit) {
+                fprintf(stderr, "too many servers (limit %d)\n", limit);
+                return -1;
+            }
+            if (count == 0) {
+                memcpy(defaults, &ctx[0], sizeof(*defaults));
+            } else {
+                memcpy(&ctx[count], defaults, sizeof(*defaults));
+            }
+            cur = &ctx[count++];
+            safecpy(cur->server, optarg, sizeof(cur->server));
             break;
 
         case 'p':  /* port */
@@ -267,27 +355,47 @@ int config_parse_args(struct kirc_context *ctx, int argc, char *argv[])
                 fprintf(stderr, "invalid port number\n");
                 return -1;
             }
-            safecpy(ctx->port, optarg, sizeof(ctx->port));
+            safecpy(cur->port, optarg, sizeof(cur->port));
+            cur->port_set = 1;
             break;
 
         case 'r':  /* realname */
-            safecpy(ctx->realname, optarg, sizeof(ctx->realname));
+            safecpy(cur->realname, optarg, sizeof(cur->realname));
             break;
 
         case 'u':  /* username */
-            safecpy(ctx->username, optarg, sizeof(ctx->username));
+            safecpy(cur->username, optarg, sizeof(cur->username));
             break;
 
         case 'k':  /* password */
-            safecpy(ctx->password, optarg, sizeof(ctx->password));
+            safecpy(cur->password, optarg, sizeof(cur->password));
             break;
 
         case 'c':  /* channel(s) */
-            config_parse_channels(ctx, optarg);
+            config_parse_channels(cur, optarg);
             break;
 
         case 'a':  /* SASL authentication */
-            config_parse_mechanism(ctx, optarg);
+            config_parse_mechanism(cur, optarg);
+            break;
+
+        case 't':  /* TLS */
+            cur->tls = 1;
+            break;
+
+        case 'x':  /* TLS client certificate */
+            safecpy(cur->tls_cert, optarg, sizeof(cur->tls_cert));
+            break;
+
+        case 'l':  /* chat log directory */
+            safecpy(cur->log_dir, optarg, sizeof(cur->log_dir));
+            break;
+
+        case 'f':  /* flood control */
+            if (config_parse_flood(cur, optarg) < 0) {
+                fprintf(stderr, "invalid flood control\n");
+                return -1;
+            }
             break;
 
         case ':':
@@ -303,15 +411,73 @@ int config_parse_args(struct kirc_context *ctx, int argc, char *argv[])
         }
     }
 
+    return count;
+}
+
+/**
+ * config_parse_args() - Parse command-line arguments
+ * @ctx: Array of server contexts; ctx[0] holds the defaults
+ * @limit: Number of entries in @ctx
+ * @argc: Argument count
+ * @argv: Argument vector
+ *
+ * Parses command-line options using getopt. Supports:
+ *   -s server, -p port, -r realname, -u username, -k password,
+ *   -c channels, -a auth_mechanism, -f flood_control, -t (TLS),
+ *   -x client_certificate, -l log_directory
+ * The -s option may be repeated to connect to several servers at once;
+ * options before the first -s are shared, options after an -s apply to
+ * that server only. The nickname is required as a positional argument
+ * and is used on every server. With TLS enabled and no port given by -p
+ * or KIRC_PORT, the port becomes KIRC_DEFAULT_TLS_PORT.
+ *
+ * Return: Number of configured servers, or -1 on error or invalid
+ * arguments
+ */
+int config_parse_args(struct kirc_context *ctx, int limit,
+        int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "%s: no arguments\n", argv[0]);
+        return -1;
+    }
+
+    struct kirc_context *defaults = malloc(sizeof(*defaults));
+
+    if (defaults == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    int count = config_parse_options(ctx, limit, defaults, argc, argv);
+
+    memzero(defaults, sizeof(*defaults));
+    free(defaults);
+
+    if (count < 0) {
+        return -1;
+    }
+
     if (optind >= argc) {
         fprintf(stderr, "nickname not specified\n");
         return -1;
     }
 
-    size_t nickname_n = sizeof(ctx->nickname);
-    safecpy(ctx->nickname, argv[optind], nickname_n);
+    if (count == 0) {
+        count = 1;
+    }
 
-    return 0;
+    for (int i = 0; i < count; ++i) {
+        size_t nickname_n = sizeof(ctx[i].nickname);
+        safecpy(ctx[i].nickname, argv[optind], nickname_n);
+
+        if (ctx[i].tls && !ctx[i].port_set) {
+            safecpy(ctx[i].port, KIRC_DEFAULT_TLS_PORT,
+                sizeof(ctx[i].port));
+        }
+    }
+
+    return count;
 }
 
 /**
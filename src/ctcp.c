@@ -20,13 +20,12 @@
 void ctcp_handle_clientinfo(struct network *network, struct event *event, struct output *output)
 {
     (void)output;
-    const char *command = event->command;
-    const char *nickname = event->nickname;
+    const struct event_view *nickname = &event->nickname;
     
-    if (strcmp(command, "PRIVMSG") == 0) {
+    if (event_view_equals(&event->command, "PRIVMSG")) {
         network_send(network,
-            "NOTICE %s :\001PING ACTION CLIENTINFO DCC PING TIME VERSION\001\r\n",
-            nickname);
+            "NOTICE %.*s :\001PING ACTION CLIENTINFO DCC PING TIME VERSION\001\r\n",
+            nickname->len, nickname->ptr);
     }
 }
 
@@ -42,19 +41,18 @@ void ctcp_handle_clientinfo(struct network *network, struct event *event, struct
 void ctcp_handle_ping(struct network *network, struct event *event, struct output *output)
 {
     (void)output;
-    const char *command = event->command;
-    const char *nickname = event->nickname;
-    const char *message = event->message;
+    const struct event_view *nickname = &event->nickname;
+    const struct event_view *message = &event->message;
     
-    if (strcmp(command, "PRIVMSG") == 0) {
-        if (message[0] != '\0') {
+    if (event_view_equals(&event->command, "PRIVMSG")) {
+        if (message->len > 0) {
             network_send(network,
-                "NOTICE %s :\001PING %s\001\r\n",
-                nickname, message);
+                "NOTICE %.*s :\001PING %.*s\001\r\n",
+                nickname->len, nickname->ptr, message->len, message->ptr);
         } else {
             network_send(network,
-                "NOTICE %s :\001PING\001\r\n",
-                nickname);
+                "NOTICE %.*s :\001PING\001\r\n",
+                nickname->len, nickname->ptr);
         }
     }
 }
@@ -71,18 +69,17 @@ void ctcp_handle_ping(struct network *network, struct event *event, struct outpu
 void ctcp_handle_time(struct network *network, struct event *event, struct output *output)
 {
     (void)output;
-    const char *command = event->command;
-    const char *nickname = event->nickname;
+    const struct event_view *nickname = &event->nickname;
     
-    if (strcmp(command, "PRIVMSG") == 0) {
+    if (event_view_equals(&event->command, "PRIVMSG")) {
         char tbuf[128];
         time_t now;
         time(&now);
         struct tm *info = localtime(&now);
         strftime(tbuf, sizeof(tbuf), "%c", info);
         network_send(network,
-            "NOTICE %s :\001TIME %s\001\r\n",
-            nickname, tbuf);
+            "NOTICE %.*s :\001TIME %s\001\r\n",
+            nickname->len, nickname->ptr, tbuf);
     }
 }
 
@@ -98,12 +95,11 @@ void ctcp_handle_time(struct network *network, struct event *event, struct outpu
 void ctcp_handle_version(struct network *network, struct event *event, struct output *output)
 {
     (void)output;
-    const char *command = event->command;
-    const char *nickname = event->nickname;
+    const struct event_view *nickname = &event->nickname;
     
-    if (strcmp(command, "PRIVMSG") == 0) {
+    if (event_view_equals(&event->command, "PRIVMSG")) {
         network_send(network,
-            "NOTICE %s :\001VERSION kirc %s\001\r\n", nickname, 
+            "NOTICE %.*s :\001VERSION kirc %s\001\r\n", nickname->len, nickname->ptr,
             KIRC_VERSION_MAJOR "." KIRC_VERSION_MINOR "." KIRC_VERSION_PATCH);
     }
 }
@@ -46,25 +46,59 @@ static int sanitize_filename(char *filename)
     return 0;
 }
 
+/**
+ * dcc_stalled() - Abort a transfer that has stopped moving
+ * @timer: The transfer's stall timer
+ * @data: DCC structure
+ *
+ * Fires when a transfer's socket has seen no activity for
+ * KIRC_DCC_STALL_MS, which otherwise would hold its slot forever.
+ */
+static void dcc_stalled(struct timer *timer, void *data)
+{
+    struct dcc *dcc = data;
+    int transfer_id = (int)(timer - dcc->stall);
+
+    printf("\r" CLEAR_LINE DIM "error: %d stalled for %d s"
+        RESET "\r\n", transfer_id, KIRC_DCC_STALL_MS / 1000);
+    dcc_cancel(dcc, transfer_id);
+}
+
+/**
+ * dcc_forget_sender() - Drop a transfer's reference to its sender
+ * @transfer: Transfer being released
+ */
+static void dcc_forget_sender(struct dcc_transfer *transfer)
+{
+    intern_release(transfer->names, transfer->sender);
+    transfer->names = NULL;
+    transfer->sender = 0;
+}
+
 /**
  * dcc_init() - Initialize DCC transfer management structure
  * @dcc: DCC structure to initialize
  * @ctx: IRC context structure
+ * @loop: Event loop that transfer sockets are registered with
+ * @wheel: Timer wheel for the per-transfer stall timeouts
  *
  * Initializes the DCC transfer manager, setting all file descriptors to -1
  * and transfer states to idle. Prepares the structure for handling up to
  * KIRC_DCC_TRANSFERS_MAX concurrent transfers.
  *
- * Return: 0 on success, -1 if dcc or ctx is NULL
+ * Return: 0 on success, -1 if any parameter is NULL
  */
-int dcc_init(struct dcc *dcc, struct kirc_context *ctx)
+int dcc_init(struct dcc *dcc, struct kirc_context *ctx, struct loop *loop,
+        struct timer_wheel *wheel)
 {
-    if ((dcc == NULL) || (ctx == NULL)) {
+    if ((dcc == NULL) || (ctx == NULL) || (loop == NULL) || (wheel == NULL)) {
         return -1;
     }
 
     memset(dcc, 0, sizeof(*dcc));
     dcc->ctx = ctx;
+    dcc->loop = loop;
+    dcc->wheel = wheel;
 
     int limit = KIRC_DCC_TRANSFERS_MAX;
 
@@ -73,6 +107,7 @@ int dcc_init(struct dcc *dcc, struct kirc_context *ctx)
         dcc->sock_fd[i].events = POLLIN;
         dcc->transfer[i].state = DCC_STATE_IDLE;
         dcc->transfer[i].file_fd = -1;
+        timer_setup(&dcc->stall[i], dcc_stalled, dcc);
     }
 
     return 0;
@@ -96,7 +131,10 @@ int dcc_free(struct dcc *dcc)
     int limit = KIRC_DCC_TRANSFERS_MAX;
 
     for (int i = 0; i < limit; ++i) {
+        timer_stop(dcc->wheel, &dcc->stall[i]);
+
         if (dcc->sock_fd[i].fd >= 0) {
+            loop_remove(dcc->loop, dcc->sock_fd[i].fd, dcc);
             close(dcc->sock_fd[i].fd);
             dcc->sock_fd[i].fd = -1;
         }
@@ -105,6 +143,8 @@ int dcc_free(struct dcc *dcc)
             close(dcc->transfer[i].file_fd);
             dcc->transfer[i].file_fd = -1;
         }
+
+        dcc_forget_sender(&dcc->transfer[i]);
     }
 
     return 0;
@@ -186,113 +226,88 @@ int dcc_send(struct dcc *dcc, int transfer_id)
 }
 
 /**
- * dcc_process() - Process pending DCC transfers
+ * dcc_process() - Process readiness of a DCC transfer
  * @dcc: DCC structure containing active transfers
+ * @transfer_id: Transfer whose socket became ready
+ * @revents: poll() event bits reported by the event loop
  *
- * Polls all active DCC transfer sockets for I/O readiness and processes
- * data transfer, connection establishment, and error handling. Should be
- * called periodically in the main event loop. Handles both SEND and
- * RECEIVE transfers, cleaning up completed or failed transfers.
+ * Handles data transfer, connection establishment, and error handling
+ * for one transfer. Called by the main event loop for every ready DCC
+ * socket, so idle transfers cost nothing. Handles both SEND and
+ * RECEIVE transfers, cleaning up completed or failed transfers. Any
+ * activity pushes the transfer's stall timeout back.
  *
  * Return: 0 on success, -1 on error
  */
-int dcc_process(struct dcc *dcc)
+int dcc_process(struct dcc *dcc, int transfer_id, short revents)
 {
-    if (dcc == NULL) {
+    if ((dcc == NULL) || (transfer_id < 0) ||
+        (transfer_id >= KIRC_DCC_TRANSFERS_MAX)) {
         return -1;
     }
 
-    if (dcc->transfer_count == 0) {
-        return 0;
-    }
-
-    int limit = KIRC_DCC_TRANSFERS_MAX;
-    int rc = poll(dcc->sock_fd, limit, 0);
-
-    if (rc < 0) {
-        if (errno == EINTR) {
-            return 0;
-        }
-
-        printf("\r" CLEAR_LINE DIM "error: poll failed"
-            RESET "\r\n");
-        return -1;
-    }
+    int i = transfer_id;
 
-    if (rc == 0) {
+    if (dcc->sock_fd[i].fd < 0) {
         return 0;
     }
 
-    /* process each transfer */
-    for (int i = 0; i < limit; ++i) {
-        if (dcc->sock_fd[i].fd < 0) {
-            continue;
-        }
-
-        struct dcc_transfer *transfer = &dcc->transfer[i];
-
-        if (transfer->state == DCC_STATE_CONNECTING) {
-            if (dcc->sock_fd[i].revents & POLLOUT) {
-                int error = 0;
-                socklen_t len = sizeof(error);
-                if (getsockopt(dcc->sock_fd[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0) {
-                    if (error == 0) {
-                        printf("\r" CLEAR_LINE DIM "dcc: %d connected"
-                            RESET "\r\n", i);
-                        transfer->state = DCC_STATE_TRANSFERRING;
-                        dcc->sock_fd[i].events = POLLIN;
-                    } else {
-                        printf("\r" CLEAR_LINE DIM "error: connection failed"
-                            RESET "\r\n");
-                        transfer->state = DCC_STATE_ERROR;
-                    }
-                }
-            }
-            continue;
-        }
-
-        /* handle receive transfers */
-        if ((transfer->type == DCC_TYPE_RECEIVE) &&
-            (transfer->state == DCC_STATE_TRANSFERRING)) {
-
-            if (dcc->sock_fd[i].revents & POLLIN) {
-                char buffer[KIRC_DCC_BUFFER_SIZE];
-                ssize_t nread = read(dcc->sock_fd[i].fd, buffer,
-                    sizeof(buffer));
-
-                if (nread < 0) {
-                    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-                        continue; 
-                    }
-
-                    printf("\r" CLEAR_LINE DIM "error: receive failed"
+    struct dcc_transfer *transfer = &dcc->transfer[i];
+
+    timer_start(dcc->wheel, &dcc->stall[i], KIRC_DCC_STALL_MS);
+
+    if (transfer->state == DCC_STATE_CONNECTING) {
+        if (revents & (POLLOUT | POLLERR | POLLHUP)) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (getsockopt(dcc->sock_fd[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0) {
+                if (error == 0) {
+                    printf("\r" CLEAR_LINE DIM "dcc: %d connected"
+                        RESET "\r\n", i);
+                    transfer->state = DCC_STATE_TRANSFERRING;
+                    dcc->sock_fd[i].events = POLLIN;
+                    loop_modify(dcc->loop, dcc->sock_fd[i].fd,
+                        POLLIN, dcc);
+                } else {
+                    printf("\r" CLEAR_LINE DIM "error: connection failed"
                         RESET "\r\n");
                     transfer->state = DCC_STATE_ERROR;
-                    continue;
-                }
-                
-                if (nread == 0) {
-                    if (transfer->sent >= transfer->filesize) {
-                        printf("\r" CLEAR_LINE DIM "dcc: %d transfer complete (%llu bytes)"
-                            RESET "\r\n", i, transfer->sent);
-                        transfer->state = DCC_STATE_COMPLETE;
-                    } else {
-                        printf("\r" CLEAR_LINE DIM "error: %d transfer incomplete (%llu/%llu bytes)"
-                            RESET "\r\n", i, transfer->sent, transfer->filesize);
-                        transfer->state = DCC_STATE_COMPLETE;
-                    }
-                    continue;
                 }
+            }
+        }
+    }
 
-                ssize_t nwritten = write(transfer->file_fd, buffer, nread);
+    /* handle receive transfers */
+    if ((transfer->type == DCC_TYPE_RECEIVE) &&
+        (transfer->state == DCC_STATE_TRANSFERRING) &&
+        (revents & (POLLIN | POLLHUP))) {
+        char buffer[KIRC_DCC_BUFFER_SIZE];
+        ssize_t nread = read(dcc->sock_fd[i].fd, buffer,
+            sizeof(buffer));
 
-                if (nwritten < 0) {
-                    printf("\r" CLEAR_LINE DIM "error: write failed"
-                        RESET "\r\n");
-                    transfer->state = DCC_STATE_ERROR;
-                    continue;
-                }
+        if (nread < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                printf("\r" CLEAR_LINE DIM "error: receive failed"
+                    RESET "\r\n");
+                transfer->state = DCC_STATE_ERROR;
+            }
+        } else if (nread == 0) {
+            if (transfer->sent >= transfer->filesize) {
+                printf("\r" CLEAR_LINE DIM "dcc: %d transfer complete (%llu bytes)"
+                    RESET "\r\n", i, transfer->sent);
+            } else {
+                printf("\r" CLEAR_LINE DIM "error: %d transfer incomplete (%llu/%llu bytes)"
+                    RESET "\r\n", i, transfer->sent, transfer->filesize);
+            }
+            transfer->state = DCC_STATE_COMPLETE;
+        } else {
+            ssize_t nwritten = write(transfer->file_fd, buffer, nread);
 
+            if (nwritten < 0) {
+                printf("\r" CLEAR_LINE DIM "error: write failed"
+                    RESET "\r\n");
+                transfer->state = DCC_STATE_ERROR;
+            } else {
                 transfer->sent += nwritten;
 
                 if (transfer->sent >= transfer->filesize) {
@@ -302,31 +317,34 @@ int dcc_process(struct dcc *dcc)
                 }
             }
         }
-        
-        /* handle send transfer */
-        if ((transfer->type == DCC_TYPE_SEND) &&
-            (transfer->state == DCC_STATE_TRANSFERRING)) {
-            if (dcc->sock_fd[i].revents & POLLOUT) {
-                dcc_send(dcc, i);
-            }
-        }
+    }
 
-        /* cleanup completed or error transfers */
-        if ((transfer->state == DCC_STATE_COMPLETE) ||
-            (transfer->state == DCC_STATE_ERROR)) {
-            if (dcc->sock_fd[i].fd >= 0) {
-                close(dcc->sock_fd[i].fd);
-                dcc->sock_fd[i].fd = -1;
-            }
+    /* handle send transfer */
+    if ((transfer->type == DCC_TYPE_SEND) &&
+        (transfer->state == DCC_STATE_TRANSFERRING) &&
+        (revents & POLLOUT)) {
+        dcc_send(dcc, i);
+    }
 
-            if (dcc->transfer[i].file_fd >= 0) {
-                close(dcc->transfer[i].file_fd);
-                dcc->transfer[i].file_fd = -1;
-            }
+    /* cleanup completed or error transfers */
+    if ((transfer->state == DCC_STATE_COMPLETE) ||
+        (transfer->state == DCC_STATE_ERROR)) {
+        timer_stop(dcc->wheel, &dcc->stall[i]);
+
+        if (dcc->sock_fd[i].fd >= 0) {
+            loop_remove(dcc->loop, dcc->sock_fd[i].fd, dcc);
+            close(dcc->sock_fd[i].fd);
+            dcc->sock_fd[i].fd = -1;
+        }
 
-            transfer->state = DCC_STATE_IDLE;
-            dcc->transfer_count--;
+        if (dcc->transfer[i].file_fd >= 0) {
+            close(dcc->transfer[i].file_fd);
+            dcc->transfer[i].file_fd = -1;
         }
+
+        dcc_forget_sender(transfer);
+        transfer->state = DCC_STATE_IDLE;
+        dcc->transfer_count--;
     }
 
     return 0;
@@ -335,19 +353,23 @@ int dcc_process(struct dcc *dcc)
 /**
  * dcc_request() - Handle incoming DCC SEND request
  * @dcc: DCC structure to register the transfer
- * @sender: Nickname of the user initiating the transfer
+ * @names: Name table of the connection the request arrived on
+ * @sender: Interned nickname of the user initiating the transfer
  * @params: DCC SEND parameters (filename, IP, port, filesize)
  *
  * Parses a DCC SEND request and initiates a file receive transfer. Creates
  * the destination file, establishes a network connection to the sender, and
  * registers the transfer for processing. Handles quoted filenames and
- * validates parameters for security.
+ * validates parameters for security. On success the transfer takes over
+ * the caller's reference to @sender.
  *
  * Return: Transfer ID on success, -1 on error
  */
-int dcc_request(struct dcc *dcc, const char *sender, const char *params)
+int dcc_request(struct dcc *dcc, struct intern *names, uint32_t sender,
+        const char *params)
 {
-    if ((dcc == NULL) || (sender == NULL) || (params == NULL)) {
+    if ((dcc == NULL) || (names == NULL) || (sender == 0) ||
+        (params == NULL)) {
         return -1;
     }
 
@@ -457,9 +479,6 @@ int dcc_request(struct dcc *dcc, const char *sender, const char *params)
     siz = sizeof(transfer->filename);
     safecpy(transfer->filename, filename, siz);
     
-    siz = sizeof(transfer->sender);
-    safecpy(transfer->sender, sender, siz);
-
     /* open file for writing */
     transfer->file_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
@@ -516,12 +535,25 @@ int dcc_request(struct dcc *dcc, const char *sender, const char *params)
 
     freeaddrinfo(res);
 
+    if (loop_add(dcc->loop, sock_fd, POLLOUT, dcc, transfer_id) < 0) {
+        printf("\r" CLEAR_LINE DIM "error: cannot watch connection"
+            RESET "\r\n");
+        close(sock_fd);
+        close(transfer->file_fd);
+        transfer->file_fd = -1;
+        transfer->state = DCC_STATE_IDLE;
+        return -1;
+    }
+
     dcc->sock_fd[transfer_id].fd = sock_fd;
     dcc->sock_fd[transfer_id].events = POLLOUT;
     dcc->transfer_count++;
+    timer_start(dcc->wheel, &dcc->stall[transfer_id], KIRC_DCC_STALL_MS);
+    transfer->names = names;
+    transfer->sender = sender;
 
     printf("\r" CLEAR_LINE DIM "dcc: receiving %s from %s (%llu bytes)"
-        RESET "\r\n", transfer->filename, transfer->sender,
+        RESET "\r\n", transfer->filename, intern_name(names, sender),
         transfer->filesize);
 
     return transfer_id;
@@ -554,7 +586,10 @@ int dcc_cancel(struct dcc *dcc, int transfer_id)
     printf("\r" CLEAR_LINE DIM "dcc: cancelling transfer %d"
         RESET "\r\n", transfer_id);
 
+    timer_stop(dcc->wheel, &dcc->stall[transfer_id]);
+
     if (dcc->sock_fd[transfer_id].fd >= 0) {
+        loop_remove(dcc->loop, dcc->sock_fd[transfer_id].fd, dcc);
         close(dcc->sock_fd[transfer_id].fd);
         dcc->sock_fd[transfer_id].fd = -1;
     }
@@ -564,6 +599,7 @@ int dcc_cancel(struct dcc *dcc, int transfer_id)
         dcc->transfer[transfer_id].file_fd = -1;
     }
 
+    dcc_forget_sender(transfer);
     transfer->state = DCC_STATE_IDLE;
     dcc->transfer_count--;
 
@@ -581,9 +617,7 @@ int dcc_cancel(struct dcc *dcc, int transfer_id)
  */
 void dcc_handle(struct dcc *dcc, struct network *network, struct event *event)
 {
-    (void)network;
-    
-    if (dcc == NULL || event == NULL) {
+    if (dcc == NULL || network == NULL || event == NULL) {
         return;
     }
     
@@ -591,7 +625,15 @@ void dcc_handle(struct dcc *dcc, struct network *network, struct event *event)
         return;
     }
 
-    if (strcmp(event->command, "PRIVMSG") == 0) {
-        dcc_request(dcc, event->nickname, event->message);
+    if (event_view_equals(&event->command, "PRIVMSG")) {
+        char params[MESSAGE_MAX_LEN];
+        uint32_t sender = intern_add(&network->names, event->nickname.ptr,
+            event->nickname.len);
+
+        event_view_copy(params, &event->message, sizeof(params));
+
+        if (dcc_request(dcc, &network->names, sender, params) < 0) {
+            intern_release(&network->names, sender);
+        }
     }
 }
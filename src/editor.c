@@ -11,9 +11,9 @@
  * editor_backspace() - Delete the character before the cursor
  * @editor: Editor state structure
  *
- * Removes the UTF-8 character immediately before the cursor position,
- * properly handling multi-byte UTF-8 sequences. Does nothing if cursor
- * is at the beginning of the line.
+ * Removes the grapheme cluster immediately before the cursor position,
+ * a character together with its combining marks or a whole emoji
+ * sequence. Does nothing if cursor is at the beginning of the line.
  */
 static void editor_backspace(struct editor *editor)
 {
@@ -24,8 +24,7 @@ static void editor_backspace(struct editor *editor)
         return;  /* nothing to delete or out of range */
     }
 
-    /* Get length of previous UTF-8 character */
-    int bytes = utf8_prev_char_len(editor->scratch, editor->cursor);
+    int bytes = utf8_prev_cluster_len(editor->scratch, editor->cursor);
     
     if (bytes == 0) {
         return;
@@ -86,9 +85,9 @@ static int editor_enter(struct editor *editor)
  * editor_delete() - Delete the character at the cursor
  * @editor: Editor state structure
  *
- * Removes the UTF-8 character at the current cursor position, properly
- * handling multi-byte UTF-8 sequences. Does nothing if cursor is at the
- * end of the line.
+ * Removes the grapheme cluster at the current cursor position, so a
+ * combining mark or an emoji sequence goes with the character it joins.
+ * Does nothing if cursor is at the end of the line.
  */
 static void editor_delete(struct editor *editor)
 {
@@ -99,8 +98,7 @@ static void editor_delete(struct editor *editor)
         return;  /* at end of scratch string */
     }
 
-    /* Get length of next UTF-8 character using mbrtowc */
-    int bytes = utf8_next_char_len(editor->scratch, editor->cursor, len);
+    int bytes = utf8_next_cluster_len(editor->scratch, editor->cursor, len);
     
     if (bytes == 0) {
         return;
@@ -174,8 +172,8 @@ static void editor_history(struct editor *editor, int dir)
  * editor_move_right() - Move cursor one character to the right
  * @editor: Editor state structure
  *
- * Advances the cursor by one UTF-8 character, properly handling multi-byte
- * sequences. Does nothing if cursor is at the end of the line.
+ * Advances the cursor by one grapheme cluster, stepping over combining
+ * marks and joined emoji. Does nothing if cursor is at the end of the line.
  */
 static void editor_move_right(struct editor *editor)
 {
@@ -186,8 +184,7 @@ static void editor_move_right(struct editor *editor)
         return; /* at end */
     }
 
-    /* Use mbrtowc to get proper character length */
-    int adv = utf8_next_char_len(editor->scratch, editor->cursor, len);
+    int adv = utf8_next_cluster_len(editor->scratch, editor->cursor, len);
     
     if (adv > 0 && editor->cursor + adv <= len) {
         editor->cursor += adv;
@@ -201,8 +198,9 @@ static void editor_move_right(struct editor *editor)
  * editor_move_left() - Move cursor one character to the left
  * @editor: Editor state structure
  *
- * Moves the cursor back by one UTF-8 character, properly handling multi-byte
- * sequences. Does nothing if cursor is at the beginning of the line.
+ * Moves the cursor back by one grapheme cluster, stepping over combining
+ * marks and joined emoji. Does nothing if cursor is at the beginning of
+ * the line.
  */
 static void editor_move_left(struct editor *editor)
 {
@@ -210,8 +208,7 @@ static void editor_move_left(struct editor *editor)
         return;
     }
 
-    /* Get length of previous UTF-8 character */
-    int bytes = utf8_prev_char_len(editor->scratch, editor->cursor);
+    int bytes = utf8_prev_cluster_len(editor->scratch, editor->cursor);
     
     if (bytes > 0) {
         editor->cursor -= bytes;
@@ -242,66 +239,6 @@ static void editor_move_end(struct editor *editor)
     editor->cursor = strnlen(editor->scratch, siz);
 }
 
-/**
- * editor_escape() - Handle escape sequences for special keys
- * @editor: Editor state structure
- *
- * Processes ANSI escape sequences for cursor movement and special keys
- * (arrow keys, Home, End, Delete). Reads additional bytes from stdin
- * to determine the complete escape sequence and executes the appropriate
- * editor action.
- */
-static void editor_escape(struct editor *editor)
-{
-    char seq[3];
-
-    if (read(STDIN_FILENO, &seq[0], 1) != 1) {
-        return;
-    }
-
-    if (read(STDIN_FILENO, &seq[1], 1) != 1) {
-        return;
-    }
-
-    if (seq[0] == '[') {
-        if (seq[1] >= '0' && seq[1] <= '9') {
-            if (read(STDIN_FILENO, &seq[2], 1) != 1) {
-                return;
-            }
-
-            if (seq[1] == '3' && seq[2] == '~') {
-                editor_delete(editor);
-            }
-        } else {
-            switch (seq[1]) {
-            case 'A':
-                editor_history(editor, 1);
-                break;
-
-            case 'B':
-                editor_history(editor, -1);
-                break;
-
-            case 'C':
-                editor_move_right(editor);
-                break;
-
-            case 'D':
-                editor_move_left(editor);
-                break;
-
-            case 'H':
-                editor_move_home(editor);
-                break;
-
-            case 'F':
-                editor_move_end(editor);
-                break;
-            }
-        }
-    }
-}
-
 /**
  * editor_insert() - Insert a single character at cursor position
  * @editor: Editor state structure
@@ -369,56 +306,266 @@ static void editor_insert_bytes(struct editor *editor, const char *buf, int n)
 }
 
 /**
- * editor_clear() - Clear the current line on terminal
- * @editor: Editor state structure (unused)
+ * editor_paste_begin() - Start collecting a bracketed paste
+ * @editor: Editor state structure
  *
- * Sends ANSI escape codes to clear the current terminal line, moving
- * the cursor to the beginning.
+ * A paste still awaiting confirmation is replaced.
  */
-static void editor_clear(struct editor *editor)
+static void editor_paste_begin(struct editor *editor)
 {
-    printf("\r" CLEAR_LINE);
+    editor->pasting = 1;
+    editor->paste_len = 0;
+    editor->paste_dropped = 0;
+    editor->paste_lines = 0;
+}
+
+/**
+ * editor_paste_append() - Add pasted bytes to the paste buffer
+ * @editor: Editor state structure
+ * @buf: Pasted bytes
+ * @n: Number of bytes
+ *
+ * Bytes beyond KIRC_PASTE_SIZE are counted and dropped.
+ */
+static void editor_paste_append(struct editor *editor, const char *buf,
+        size_t n)
+{
+    size_t room = sizeof(editor->paste) - editor->paste_len;
+    size_t take = (n < room) ? n : room;
+
+    memcpy(editor->paste + editor->paste_len, buf, take);
+    editor->paste_len += take;
+    editor->paste_dropped += n - take;
+}
+
+/**
+ * editor_paste_insert() - Insert a single-line paste at the cursor
+ * @editor: Editor state structure
+ *
+ * Control characters become spaces, and each invalid UTF-8 sequence
+ * becomes U+FFFD, or is dropped if the locale cannot show that either,
+ * so one stray byte does not cost the whole paste. Text that does not
+ * fit the input line is cut at a UTF-8 character boundary.
+ */
+static void editor_paste_insert(struct editor *editor)
+{
+    static const char replacement[] = "\xEF\xBF\xBD";  /* U+FFFD */
+    int fffd = utf8_validate(replacement, 3);
+    int siz = sizeof(editor->scratch) - 1;
+    int len = strnlen(editor->scratch, siz);
+    int room = siz - 1 - len;
+    int total = (int)editor->paste_len;
+    char text[sizeof(editor->scratch)];
+    int n = 0;
+
+    for (int i = 0; i < total; ) {
+        int step = utf8_next_char_len(editor->paste, i, total);
+        const char *c = editor->paste + i;
+        int clen = step;
+
+        i += step;
+
+        if (!utf8_validate(c, clen)) {
+            if (!fffd) {
+                continue;
+            }
+
+            c = replacement;
+            clen = 3;
+        }
+
+        if (n + clen > room) {
+            break;
+        }
+
+        memcpy(text + n, c, clen);
+
+        if ((clen == 1) && ((unsigned char)text[n] < 0x20)) {
+            text[n] = ' ';
+        }
+
+        n += clen;
+    }
+
+    if (n > 0) {
+        editor_insert_bytes(editor, text, n);
+    }
 }
 
 /**
- * display_width_bytes() - Calculate display width of UTF-8 string
- * @s: UTF-8 encoded string
- * @bytes: Number of bytes to measure
+ * editor_paste_end() - Finish a bracketed paste
+ * @editor: Editor state structure
  *
- * Computes the display width (number of terminal columns) occupied by
- * a UTF-8 string, accounting for wide characters (e.g., CJK characters).
- * Handles invalid sequences by treating them as width 1.
+ * A paste without line breaks, ignoring trailing ones, is inserted
+ * into the input line like typing. Anything longer waits for the user
+ * to confirm it with enter or discard it with CTRL-U, rather than
+ * sending a message per line at once.
+ */
+static void editor_paste_end(struct editor *editor)
+{
+    editor->pasting = 0;
+
+    while ((editor->paste_len > 0) &&
+        ((editor->paste[editor->paste_len - 1] == '\r') ||
+         (editor->paste[editor->paste_len - 1] == '\n'))) {
+        editor->paste_len--;
+    }
+
+    int lines = 0;
+    int breaks = 0;
+
+    for (size_t i = 0; i < editor->paste_len; ++i) {
+        char c = editor->paste[i];
+
+        if ((c == '\r') || (c == '\n')) {
+            breaks = 1;
+        } else if ((i == 0) || (editor->paste[i - 1] == '\r') ||
+            (editor->paste[i - 1] == '\n')) {
+            lines++;
+        }
+    }
+
+    if (!breaks) {
+        editor_paste_insert(editor);
+        editor->paste_len = 0;
+        return;
+    }
+
+    editor->paste_lines = lines;
+}
+
+/**
+ * editor_sequence() - Act on a complete escape sequence
+ * @editor: Editor state structure
+ * @final: Final byte of a CSI (ESC [) or SS3 (ESC O) sequence
  *
- * Return: Display width in terminal columns
+ * Handles the cursor movement and special keys (arrow keys, Home, End,
+ * Delete) and the bracketed paste markers ESC[200~ and ESC[201~. The
+ * numeric parameter of ESC[n~ was collected in editor->csi. Editing
+ * keys are ignored inside a paste or while one awaits confirmation.
  */
-static int display_width_bytes(const char *s, int bytes)
+static void editor_sequence(struct editor *editor, char final)
 {
-    mbstate_t st;
-    memset(&st, 0, sizeof(st));
-    int pos = 0;
-    int wsum = 0;
-
-    while (pos < bytes) {
-        wchar_t wc;
-        size_t ret = mbrtowc(&wc, s + pos, bytes - pos, &st);
-        if (ret == (size_t)-1 || ret == (size_t)-2) {
-            /* invalid sequence: treat as width 1 */
-            pos++;
-            wsum += 1;
-            memset(&st, 0, sizeof(st));
-            continue;
+    int busy = editor->pasting || (editor->paste_lines > 0);
+
+    if (final == '~') {
+        if (editor->csi == 200) {
+            editor_paste_begin(editor);
+        } else if ((editor->csi == 201) && editor->pasting) {
+            editor_paste_end(editor);
+        } else if ((editor->csi == 3) && !busy) {
+            editor_delete(editor);
         }
-        if (ret == 0) {
-            pos++;
-            continue;
+        return;
+    }
+
+    if (busy) {
+        return;
+    }
+
+    switch (final) {
+    case 'A':
+        editor_history(editor, 1);
+        break;
+
+    case 'B':
+        editor_history(editor, -1);
+        break;
+
+    case 'C':
+        editor_move_right(editor);
+        break;
+
+    case 'D':
+        editor_move_left(editor);
+        break;
+
+    case 'H':
+        editor_move_home(editor);
+        break;
+
+    case 'F':
+        editor_move_end(editor);
+        break;
+    }
+}
+
+/**
+ * editor_escape_timeout() - Give up on an unfinished escape sequence
+ * @timer: Escape timer of the editor
+ * @data: Editor state structure
+ *
+ * Terminals send the bytes of a key's sequence together, so an ESC
+ * that nothing follows within KIRC_ESCAPE_TIMEOUT_MS was the ESC key
+ * itself. It is dropped, and the next byte starts a new key.
+ */
+static void editor_escape_timeout(struct timer *timer, void *data)
+{
+    struct editor *editor = data;
+
+    (void)timer;
+    editor->decode = EDITOR_DECODE_GROUND;
+}
+
+/**
+ * editor_utf8() - Collect the bytes of a multi-byte UTF-8 character
+ * @editor: Editor state structure
+ * @c: Input byte
+ *
+ * Inserts the character once complete. A byte that cannot continue the
+ * character drops what was collected.
+ *
+ * Return: 1 if @c was consumed, 0 if it starts a new key
+ */
+static int editor_utf8(struct editor *editor, char c)
+{
+    unsigned char uc = (unsigned char)c;
+
+    if (editor->decode == EDITOR_DECODE_GROUND) {
+        if ((uc & 0xE0) == 0xC0) {
+            editor->utf8_need = 2;
+        } else if ((uc & 0xF0) == 0xE0) {
+            editor->utf8_need = 3;
+        } else if ((uc & 0xF8) == 0xF0) {
+            editor->utf8_need = 4;
+        } else {
+            return 1;  /* stray continuation or invalid byte */
         }
-        int w = wcwidth(wc);
-        if (w < 0) w = 0;
-        wsum += w;
-        pos += ret;
+
+        editor->utf8[0] = c;
+        editor->utf8_len = 1;
+        editor->decode = EDITOR_DECODE_UTF8;
+        return 1;
     }
 
-    return wsum;
+    if ((uc & 0xC0) != 0x80) {
+        editor->decode = EDITOR_DECODE_GROUND;
+        return 0;
+    }
+
+    editor->utf8[editor->utf8_len++] = c;
+
+    if (editor->utf8_len == editor->utf8_need) {
+        editor->decode = EDITOR_DECODE_GROUND;
+
+        if (!editor->pasting && (editor->paste_lines == 0)) {
+            editor_insert_bytes(editor, editor->utf8, editor->utf8_len);
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * editor_clear() - Clear the current line on terminal
+ * @editor: Editor state structure (unused)
+ *
+ * Sends ANSI escape codes to clear the current terminal line, moving
+ * the cursor to the beginning.
+ */
+static void editor_clear(struct editor *editor)
+{
+    printf("\r" CLEAR_LINE);
 }
 
 /**
@@ -453,20 +600,39 @@ char *editor_last_entry(struct editor *editor)
     return editor->history[last];
 }
 
+/**
+ * editor_paste() - Get the paste the user confirmed
+ * @editor: Editor state structure
+ * @len: Set to the length of the paste
+ *
+ * Valid after editor_process_key() set EDITOR_STATE_PASTE, until the
+ * next paste begins.
+ *
+ * Return: Pointer to the pasted text, lines ending in CR, LF or CRLF
+ */
+const char *editor_paste(struct editor *editor, size_t *len)
+{
+    *len = editor->paste_len;
+
+    return editor->paste;
+}
+
 /**
  * editor_init() - Initialize the editor state
  * @editor: Editor structure to initialize
  * @ctx: IRC context structure
+ * @wheel: Timer wheel for the escape sequence timeout
  *
  * Initializes the editor with zeroed state, sets up locale for UTF-8
  * support, and associates it with the IRC context. Prepares the editor
  * for input processing.
  *
- * Return: 0 on success, -1 if editor or ctx is NULL
+ * Return: 0 on success, -1 if editor, ctx or wheel is NULL
  */
-int editor_init(struct editor *editor, struct kirc_context *ctx)
+int editor_init(struct editor *editor, struct kirc_context *ctx,
+        struct timer_wheel *wheel)
 {
-    if ((editor == NULL) || (ctx == NULL)) {
+    if ((editor == NULL) || (ctx == NULL) || (wheel == NULL)) {
         return -1;
     }
 
@@ -475,6 +641,8 @@ int editor_init(struct editor *editor, struct kirc_context *ctx)
     editor->ctx = ctx;
     editor->state = EDITOR_STATE_NONE;
     editor->position = -1;
+    editor->wheel = wheel;
+    timer_setup(&editor->escape, editor_escape_timeout, editor);
 
     setlocale(LC_CTYPE, "");
 
@@ -482,24 +650,78 @@ int editor_init(struct editor *editor, struct kirc_context *ctx)
 }
 
 /**
- * editor_process_key() - Process a single keystroke
+ * editor_read() - Read whatever input is available
  * @editor: Editor state structure
  *
- * Reads and processes one character from stdin. Handles control characters,
- * escape sequences, and UTF-8 multi-byte input. Updates editor state
- * (SEND, TERMINATE, or NONE) based on the key pressed.
+ * Takes up to KIRC_INPUT_BUFFER_SIZE bytes from stdin in one read(), so
+ * a paste costs a few system calls rather than one per byte. Call once
+ * stdin is readable, then editor_process_key() until it returns 1.
  *
- * Return: 0 on success, 1 if read failed
+ * Return: 0 on success, -1 if read failed
  */
-int editor_process_key(struct editor *editor)
+int editor_read(struct editor *editor)
 {
-    char c;
-    
-    if (read(STDIN_FILENO, &c, 1) < 1) {
-        return 1;
+    if (editor->input_pos == editor->input_len) {
+        editor->input_pos = editor->input_len = 0;
+    }
+
+    size_t room = sizeof(editor->input) - editor->input_len;
+
+    if (room == 0) {
+        return 0;
+    }
+
+    ssize_t n = read(STDIN_FILENO, editor->input + editor->input_len, room);
+
+    if (n < 1) {
+        return -1;
+    }
+
+    editor->input_len += (size_t)n;
+
+    return 0;
+}
+
+/**
+ * editor_confirm() - Handle a key while a paste awaits confirmation
+ * @editor: Editor state structure
+ * @c: Key pressed
+ *
+ * ENTER hands the paste over as EDITOR_STATE_PASTE, CTRL-U discards
+ * it. CTRL-C still quits; other keys are ignored. A new paste replaces
+ * the old one.
+ */
+static void editor_confirm(struct editor *editor, char c)
+{
+    switch (c) {
+    case CR:  /* CTRL-M or ENTER */
+        editor->paste_lines = 0;
+        editor->state = EDITOR_STATE_PASTE;
+        break;
+
+    case NAK:  /* CTRL-U */
+        editor->paste_lines = 0;
+        editor->paste_len = 0;
+        break;
+
+    case ETX:  /* CTRL-C */
+        editor_clear(editor);
+        editor->state = EDITOR_STATE_TERMINATE;
+        break;
+    }
+}
+
+/**
+ * editor_key() - Act on a single-byte key
+ * @editor: Editor state structure
+ * @c: Control character or printable ASCII
+ */
+static void editor_key(struct editor *editor, char c)
+{
+    if (editor->paste_lines > 0) {
+        editor_confirm(editor, c);
+        return;
     }
-    
-    editor->state = EDITOR_STATE_NONE;
 
     switch(c) {
     case HT:  /* CTRL-I or TAB */
@@ -526,10 +748,6 @@ int editor_process_key(struct editor *editor)
         }
         break;
 
-    case ESC:  /* CTRL-[ */
-        editor_escape(editor);
-        break;
-
     case SOH:  /* CTRL-A */
     case STX:  /* CTRL-B */
     case EOT:  /* CTRL-D */
@@ -558,96 +776,298 @@ int editor_process_key(struct editor *editor)
         break;  /* not implemented yet */
 
     default:
-        /* handle UTF-8 multi-byte input: read remaining continuation bytes */
-        {
-            unsigned char uc = (unsigned char)c;
-            char buf[5];
-            int need = 0;
-            buf[0] = c;
-
-            if ((uc & 0x80) == 0) {
-                editor_insert(editor, c);
-            } else {
-                if ((uc & 0xE0) == 0xC0) need = 1;
-                else if ((uc & 0xF0) == 0xE0) need = 2;
-                else if ((uc & 0xF8) == 0xF0) need = 3;
-                else need = 0;
-
-                int i;
-                for (i = 1; i <= need; i++) {
-                    if (read(STDIN_FILENO, &buf[i], 1) != 1) {
-                        break;
-                    }
-                }
-
-                editor_insert_bytes(editor, buf, 1 + (i - 1));
+        editor_insert(editor, c);
+        break;
+    }
+}
+
+/**
+ * editor_decode() - Feed one input byte to the key decoder
+ * @editor: Editor state structure
+ * @c: Input byte
+ *
+ * A small state machine turns bytes into keys: plain bytes, escape
+ * sequences and UTF-8 characters. It never waits for input, so a
+ * sequence cut off at the end of a read() is finished by the next one.
+ * An ESC starts the escape timer; see editor_escape_timeout().
+ */
+static void editor_decode(struct editor *editor, char c)
+{
+    unsigned char uc = (unsigned char)c;
+
+    switch (editor->decode) {
+    case EDITOR_DECODE_GROUND:
+        if (c == ESC) {
+            editor->decode = EDITOR_DECODE_ESCAPE;
+            timer_start(editor->wheel, &editor->escape,
+                KIRC_ESCAPE_TIMEOUT_MS);
+        } else if (uc & 0x80) {
+            editor_utf8(editor, c);
+        } else if (!editor->pasting) {
+            editor_key(editor, c);
+        }
+        break;
+
+    case EDITOR_DECODE_ESCAPE:
+        if (c == '[') {
+            editor->decode = EDITOR_DECODE_CSI;
+            editor->csi = 0;
+        } else if (c == 'O') {
+            editor->decode = EDITOR_DECODE_SS3;
+        } else if (c != ESC) {
+            editor->decode = EDITOR_DECODE_GROUND;  /* ALT-key, ignored */
+            timer_stop(editor->wheel, &editor->escape);
+        }
+        break;
+
+    case EDITOR_DECODE_CSI:
+        if ((c >= '0') && (c <= '9')) {
+            if (editor->csi < 1000) {
+                editor->csi = editor->csi * 10 + (c - '0');
             }
+        } else if ((uc >= 0x40) && (uc <= 0x7E)) {
+            editor->decode = EDITOR_DECODE_GROUND;
+            timer_stop(editor->wheel, &editor->escape);
+            editor_sequence(editor, c);
+        }
+        break;
+
+    case EDITOR_DECODE_SS3:
+        editor->decode = EDITOR_DECODE_GROUND;
+        timer_stop(editor->wheel, &editor->escape);
+        editor->csi = 0;
+        editor_sequence(editor, c);
+        break;
+
+    case EDITOR_DECODE_UTF8:
+        if (!editor_utf8(editor, c)) {
+            editor_decode(editor, c);
         }
         break;
     }
+}
+
+/**
+ * editor_process_key() - Process the next byte of buffered input
+ * @editor: Editor state structure
+ *
+ * Takes one byte from the input buffered by editor_read() and feeds it
+ * to editor_decode(). Inside a bracketed paste, everything up to the
+ * next ESC is collected in one step. Updates editor state (SEND, PASTE,
+ * TERMINATE, or NONE) once a key completes.
+ *
+ * Return: 0 if input was processed, 1 if the input buffer is empty
+ */
+int editor_process_key(struct editor *editor)
+{
+    if (editor->input_pos == editor->input_len) {
+        return 1;
+    }
+
+    editor->state = EDITOR_STATE_NONE;
+
+    if (editor->pasting && (editor->decode == EDITOR_DECODE_GROUND)) {
+        const char *start = editor->input + editor->input_pos;
+        size_t left = editor->input_len - editor->input_pos;
+        const char *esc = memchr(start, ESC, left);
+        size_t n = (esc != NULL) ? (size_t)(esc - start) : left;
+
+        editor_paste_append(editor, start, n);
+        editor->input_pos += n;
+
+        if (esc == NULL) {
+            return 0;
+        }
+    }
+
+    editor_decode(editor, editor->input[editor->input_pos++]);
 
     return 0;
 }
 
+/**
+ * editor_invalidate() - Forget what the prompt line shows
+ * @editor: Editor state structure
+ *
+ * Call after anything else wrote to the terminal, which leaves the
+ * cursor on a fresh line. The next editor_handle() draws the whole
+ * prompt instead of only what changed.
+ */
+void editor_invalidate(struct editor *editor)
+{
+    editor->frame_valid = 0;
+}
+
+/**
+ * editor_move() - Append the cursor movement between two columns
+ * @out: Output buffer
+ * @len: Bytes used in @out, updated
+ * @from: Column the cursor is at
+ * @to: Column the cursor should be at
+ */
+static void editor_move(char *out, int *len, int from, int to)
+{
+    if (to > from) {
+        *len += sprintf(out + *len, "\x1b[%dC", to - from);
+    } else if (to < from) {
+        *len += sprintf(out + *len, "\x1b[%dD", from - to);
+    }
+}
+
 /**
  * editor_handle() - Render the editor display
  * @editor: Editor state structure
  *
  * Renders the current editor state to the terminal, displaying the target
- * channel/user and the input text. Handles line scrolling when text exceeds
- * terminal width and positions the cursor correctly. Accounts for UTF-8
- * character widths for proper display alignment.
+ * channel/user, the server lag once measured, and the input text, or
+ * the question whether to send a pending paste. Handles line scrolling
+ * when text exceeds terminal width and positions the cursor correctly.
+ * Accounts for the display width of grapheme clusters, so combining
+ * marks and joined emoji keep the cursor aligned.
+ *
+ * The previous frame is kept. While the prompt is unchanged, only the
+ * input text from the first changed character on is rewritten, and a
+ * frame that differs only in the cursor position costs a cursor move.
+ * Everything goes out in a single write(). The terminal width is only
+ * measured again after a SIGWINCH.
  *
  * Return: 0 on success
  */
 int editor_handle(struct editor *editor)
 {
-    int cols = terminal_columns(STDIN_FILENO);
-    int size = strlen(editor->ctx->target) + 1;
-    int avail = cols - size - 1;
-    int siz = sizeof(editor->scratch) - 1;
-    int len = strnlen(editor->scratch, siz);
+    if ((editor->cols == 0) || terminal_resized()) {
+        editor->cols = terminal_columns(STDIN_FILENO);
+        editor->frame_valid = 0;
+    }
+
+    char lag[32] = "";
+
+    if (editor->ctx->lag >= 0) {
+        snprintf(lag, sizeof(lag), " %ld.%02lds", editor->ctx->lag / 1000,
+            (editor->ctx->lag % 1000) / 10);
+    }
+
+    char prefix[MESSAGE_MAX_LEN];
+    int prefix_len;
+    int size = strlen(editor->ctx->target) + strlen(lag) + 1;
 
-    /* compute display width of bytes up to cursor */
-    int cursor_disp = display_width_bytes(editor->scratch, editor->cursor);
+    if (lag[0] != '\0') {
+        prefix_len = snprintf(prefix, sizeof(prefix), "%s" DIM "%s" RESET ":",
+            editor->ctx->target, lag);
+    } else {
+        prefix_len = snprintf(prefix, sizeof(prefix), "%s:",
+            editor->ctx->target);
+    }
 
-    /* choose start byte offset so that the substring ending at cursor fits in avail */
     int start = editor->cursor;
     int used = 0;
-    while (start > 0) {
-        int char_bytes = utf8_prev_char_len(editor->scratch, start);
-        if (char_bytes == 0) break;
-        int cw = display_width_bytes(editor->scratch + start - char_bytes, char_bytes);
-        if (used + cw > avail) break;
-        used += cw;
-        start -= char_bytes;
+    int text_len = 0;
+
+    if (editor->paste_lines > 0) {
+        int n = snprintf(prefix + prefix_len, sizeof(prefix) - prefix_len,
+            DIM " paste %d lines%s? enter sends, ctrl-u discards" RESET,
+            editor->paste_lines,
+            (editor->paste_dropped > 0) ? " (truncated)" : "");
+
+        size += n - (int)(sizeof(DIM) - 1) - (int)(sizeof(RESET) - 1);
+        prefix_len += n;
+    } else {
+        int avail = editor->cols - size - 1;
+        int siz = sizeof(editor->scratch) - 1;
+        int len = strnlen(editor->scratch, siz);
+
+        /* choose start byte offset so that the text ending at cursor fits in avail */
+        while (start > 0) {
+            int char_bytes = utf8_prev_cluster_len(editor->scratch, start);
+            if (char_bytes == 0) break;
+            int cw = utf8_width(editor->scratch + start - char_bytes, char_bytes);
+            if (used + cw > avail) break;
+            used += cw;
+            start -= char_bytes;
+        }
+
+        /* then take as much text from start as fits in avail */
+        int p = editor->cursor;
+        int printed_width = used;
+        while (p < len) {
+            int cb = utf8_next_cluster_len(editor->scratch, p, len);
+            if (cb == 0) break;
+            int cw = utf8_width(editor->scratch + p, cb);
+            if (printed_width + cw > avail) break;
+            printed_width += cw;
+            p += cb;
+        }
+        text_len = p - start;
     }
 
-    /* compute how many bytes we can print from start given avail */
-    int bytes_to_print = 0;
-    int p = start;
-    int printed_width = 0;
-    while (p < len) {
-        int cb = utf8_next_char_len(editor->scratch, p, len);
-        if (cb == 0) break;
-        int cw = display_width_bytes(editor->scratch + p, cb);
-        if (printed_width + cw > avail) break;
-        printed_width += cw;
-        p += cb;
+    const char *text = editor->scratch + start;
+    char out[3 * MESSAGE_MAX_LEN];
+    int out_len = 0;
+    int column = size + used;
+    int from = 0;   /* first byte of text to rewrite */
+    int at = size;  /* its column */
+
+    if (!editor->frame_valid || (prefix_len != editor->frame_prefix_len) ||
+        (memcmp(prefix, editor->frame_prefix, prefix_len) != 0)) {
+        out[out_len++] = '\r';
+        memcpy(out + out_len, prefix, prefix_len);
+        out_len += prefix_len;
+        editor->frame_end = editor->cols;  /* whatever is left is stale */
+        editor->frame_cursor = size;
+    } else {
+        /* skip the clusters both frames share; a mark added to the last
+         * character changes its cluster, which is then rewritten whole */
+        while (from < text_len) {
+            int cb = utf8_next_cluster_len(text, from, text_len);
+            if (cb == 0) break;
+            if ((from + cb > editor->frame_text_len) ||
+                (memcmp(text + from, editor->frame_text + from, cb) != 0) ||
+                (utf8_next_cluster_len(editor->frame_text, from,
+                    editor->frame_text_len) != cb)) {
+                break;
+            }
+            at += utf8_width(text + from, cb);
+            from += cb;
+        }
     }
-    bytes_to_print = p - start;
 
-    printf("\r%s:", editor->ctx->target);
+    if ((from < text_len) || (text_len != editor->frame_text_len)) {
+        int end = at + utf8_width(text + from, text_len - from);
+
+        editor_move(out, &out_len, editor->frame_cursor, at);
+        memcpy(out + out_len, text + from, text_len - from);
+        out_len += text_len - from;
+
+        if (editor->frame_end > end) {
+            memcpy(out + out_len, CLEAR_LINE, sizeof(CLEAR_LINE) - 1);
+            out_len += sizeof(CLEAR_LINE) - 1;
+        }
 
-    if (bytes_to_print > 0) {
-        fwrite(editor->scratch + start, 1, bytes_to_print, stdout);
+        editor->frame_end = end;
+        editor->frame_cursor = end;
+    } else if (editor->frame_end > at) {
+        memcpy(out + out_len, CLEAR_LINE, sizeof(CLEAR_LINE) - 1);
+        out_len += sizeof(CLEAR_LINE) - 1;
+        editor->frame_end = at;
     }
 
-    printf(" " CLEAR_LINE);
+    editor_move(out, &out_len, editor->frame_cursor, column);
 
-    printf("\r\x1b[%dC", cursor_disp + size);
+    memcpy(editor->frame_prefix, prefix, prefix_len);
+    editor->frame_prefix_len = prefix_len;
+    memcpy(editor->frame_text, text, text_len);
+    editor->frame_text_len = text_len;
+    editor->frame_cursor = column;
+    editor->frame_valid = 1;
 
+    /* lines printed through stdio go out before the prompt */
     fflush(stdout);
 
+    if (out_len > 0) {
+        ssize_t written = write(STDOUT_FILENO, out, out_len);
+
+        (void)written;  /* Ignore errors */
+    }
+
     return 0;
-}
\ No newline at end of file
+}
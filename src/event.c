@@ -7,197 +7,576 @@
 
 #include "event.h"
 
-/* Event dispatch table - used only for parsing */
-static const struct event_dispatch_table event_table[] = {
-    { "CAP",     EVENT_EXT_CAP },
-    { "JOIN",    EVENT_JOIN },
-    { "KICK",    EVENT_KICK },
-    { "MODE",    EVENT_MODE },
-    { "NICK",    EVENT_NICK },
-    { "NOTICE",  EVENT_NOTICE },
-    { "PART",    EVENT_PART },
-    { "PING",    EVENT_PING },
-    { "PRIVMSG", EVENT_PRIVMSG },
-    { "QUIT",    EVENT_QUIT },
-    { "TOPIC",   EVENT_TOPIC },
-    { "001",     EVENT_001_RPL_WELCOME },
-    { "002",     EVENT_002_RPL_YOURHOST },
-    { "003",     EVENT_003_RPL_CREATED },
-    { "004",     EVENT_004_RPL_MYINFO },
-    { "005",     EVENT_005_RPL_BOUNCE },
-    { "042",     EVENT_042_RPL_YOURID },
-    { "200",     EVENT_200_RPL_TRACELINK },
-    { "201",     EVENT_201_RPL_TRACECONNECTING },
-    { "202",     EVENT_202_RPL_TRACEHANDSHAKE },
-    { "203",     EVENT_203_RPL_TRACEUNKNOWN },
-    { "204",     EVENT_204_RPL_TRACEOPERATOR },
-    { "205",     EVENT_205_RPL_TRACEUSER },
-    { "206",     EVENT_206_RPL_TRACESERVER },
-    { "207",     EVENT_207_RPL_TRACESERVICE },
-    { "208",     EVENT_208_RPL_TRACENEWTYPE },
-    { "209",     EVENT_209_RPL_TRACECLASS },
-    { "211",     EVENT_211_RPL_STATSLINKINFO },
-    { "212",     EVENT_212_RPL_STATSCOMMANDS },
-    { "213",     EVENT_213_RPL_STATSCLINE},
-    { "215",     EVENT_215_RPL_STATSILINE },
-    { "216",     EVENT_216_RPL_STATSKLINE },
-    { "218",     EVENT_218_RPL_STATSYLINE },
-    { "219",     EVENT_219_RPL_ENDOFSTATS },
-    { "221",     EVENT_221_RPL_UMODEIS },
-    { "234",     EVENT_234_RPL_SERVLIST },
-    { "235",     EVENT_235_RPL_SERVLISTEND },
-    { "241",     EVENT_241_RPL_STATSLLINE },
-    { "242",     EVENT_242_RPL_STATSUPTIME },
-    { "243",     EVENT_243_RPL_STATSOLINE },
-    { "244",     EVENT_244_RPL_STATSHLINE },
-    { "245",     EVENT_245_RPL_STATSSLINE },
-    { "250",     EVENT_250_RPL_STATSCONN },
-    { "251",     EVENT_251_RPL_LUSERCLIENT },
-    { "252",     EVENT_252_RPL_LUSEROP },
-    { "253",     EVENT_253_RPL_LUSERUNKNOWN },
-    { "254",     EVENT_254_RPL_LUSERCHANNELS },
-    { "255",     EVENT_255_RPL_LUSERME },
-    { "256",     EVENT_256_RPL_ADMINME },
-    { "257",     EVENT_257_RPL_ADMINLOC1 },
-    { "258",     EVENT_258_RPL_ADMINLOC2 },
-    { "259",     EVENT_259_RPL_ADMINEMAIL },
-    { "261",     EVENT_261_RPL_TRACELOG },
-    { "263",     EVENT_263_RPL_TRYAGAIN },
-    { "265",     EVENT_265_RPL_LOCALUSERS },
-    { "266",     EVENT_266_RPL_GLOBALUSERS },
-    { "300",     EVENT_300_RPL_NONE },
-    { "301",     EVENT_301_RPL_AWAY },
-    { "302",     EVENT_302_RPL_USERHOST },
-    { "303",     EVENT_303_RPL_ISON },
-    { "305",     EVENT_305_RPL_UNAWAY },
-    { "306",     EVENT_306_RPL_NOWAWAY },
-    { "311",     EVENT_311_RPL_WHOISUSER },
-    { "312",     EVENT_312_RPL_WHOISSERVER },
-    { "313",     EVENT_313_RPL_WHOISOPERATOR },
-    { "314",     EVENT_314_RPL_WHOWASUSER },
-    { "315",     EVENT_315_RPL_ENDOFWHO },
-    { "317",     EVENT_317_RPL_WHOISIDLE },
-    { "318",     EVENT_318_RPL_ENDOFWHOIS },
-    { "319",     EVENT_319_RPL_WHOISCHANNELS },
-    { "322",     EVENT_322_RPL_LIST },
-    { "323",     EVENT_323_RPL_LISTEND },
-    { "324",     EVENT_324_RPL_CHANNELMODEIS },
-    { "328",     EVENT_328_RPL_CHANNEL_URL },
-    { "331",     EVENT_331_RPL_NOTOPIC },
-    { "332",     EVENT_332_RPL_TOPIC },
-    { "333",     EVENT_333_RPL_TOPICWHOTIME },
-    { "341",     EVENT_341_RPL_INVITING },
-    { "346",     EVENT_346_RPL_INVITELIST },
-    { "347",     EVENT_347_RPL_ENDOFINVITELIST },
-    { "348",     EVENT_348_RPL_EXCEPTLIST },
-    { "349",     EVENT_349_RPL_ENDOFEXCEPTLIST },
-    { "351",     EVENT_351_RPL_VERSION },
-    { "352",     EVENT_352_RPL_WHOREPLY },
-    { "353",     EVENT_353_RPL_NAMREPLY },
-    { "364",     EVENT_364_RPL_LINKS },
-    { "365",     EVENT_365_RPL_ENDOFLINKS },
-    { "366",     EVENT_366_RPL_ENDOFNAMES },
-    { "367",     EVENT_367_RPL_BANLIST },
-    { "368",     EVENT_368_RPL_ENDOFBANLIST },
-    { "369",     EVENT_369_RPL_ENDOFWHOWAS },
-    { "375",     EVENT_375_RPL_MOTDSTART },
-    { "371",     EVENT_371_RPL_INFO },
-    { "372",     EVENT_372_RPL_MOTD },
-    { "374",     EVENT_374_RPL_ENDOFINFO },
-    { "376",     EVENT_376_RPL_ENDOFMOTD },
-    { "381",     EVENT_381_RPL_YOUREOPER },
-    { "382",     EVENT_382_RPL_REHASHING },
-    { "383",     EVENT_383_RPL_YOURESERVICE },
-    { "391",     EVENT_391_RPL_TIME },
-    { "392",     EVENT_392_RPL_USERSSTART },
-    { "393",     EVENT_393_RPL_USERS },
-    { "394",     EVENT_394_RPL_ENDOFUSERS },
-    { "395",     EVENT_395_RPL_NOUSERS },
-    { "396",     EVENT_396_RPL_HOSTHIDDEN },
-    { "400",     EVENT_400_ERR_UNKNOWNERROR },
-    { "401",     EVENT_401_ERR_NOSUCHNICK },
-    { "402",     EVENT_402_ERR_NOSUCHSERVER },
-    { "403",     EVENT_403_ERR_NOSUCHCHANNEL },
-    { "404",     EVENT_404_ERR_CANNOTSENDTOCHAN },
-    { "405",     EVENT_405_ERR_TOOMANYCHANNELS },
-    { "406",     EVENT_406_ERR_WASNOSUCHNICK },
-    { "407",     EVENT_407_ERR_TOOMANYTARGETS },
-    { "408",     EVENT_408_ERR_NOSUCHSERVICE },
-    { "409",     EVENT_409_ERR_NOORIGIN },
-    { "411",     EVENT_411_ERR_NORECIPIENT },
-    { "412",     EVENT_412_ERR_NOTEXTTOSEND },
-    { "413",     EVENT_413_ERR_NOTOPLEVEL },
-    { "414",     EVENT_414_ERR_WILDTOPLEVEL },
-    { "415",     EVENT_415_ERR_BADMASK },
-    { "421",     EVENT_421_ERR_UNKNOWNCOMMAND },
-    { "422",     EVENT_422_ERR_NOMOTD },
-    { "423",     EVENT_423_ERR_NOADMININFO },
-    { "424",     EVENT_424_ERR_FILEERROR },
-    { "431",     EVENT_431_ERR_NONICKNAMEGIVEN },
-    { "432",     EVENT_432_ERR_ERRONEUSNICKNAME },
-    { "433",     EVENT_433_ERR_NICKNAMEINUSE },
-    { "436",     EVENT_436_ERR_NICKCOLLISION },
-    { "441",     EVENT_441_ERR_USERNOTINCHANNEL },
-    { "442",     EVENT_442_ERR_NOTONCHANNEL },
-    { "443",     EVENT_443_ERR_USERONCHANNEL },
-    { "444",     EVENT_444_ERR_NOLOGIN },
-    { "445",     EVENT_445_ERR_SUMMONDISABLED },
-    { "446",     EVENT_446_ERR_USERSDISABLED },
-    { "451",     EVENT_451_ERR_NOTREGISTERED },
-    { "461",     EVENT_461_ERR_NEEDMOREPARAMS },
-    { "462",     EVENT_462_ERR_ALREADYREGISTERED },
-    { "463",     EVENT_463_ERR_NOPERMFORHOST },
-    { "464",     EVENT_464_ERR_PASSWDMISMATCH },
-    { "465",     EVENT_465_ERR_YOUREBANNEDCREEP },
-    { "467",     EVENT_467_ERR_KEYSET },
-    { "470",     EVENT_470_ERR_LINKCHANNEL },
-    { "471",     EVENT_471_ERR_CHANNELISFULL },
-    { "472",     EVENT_472_ERR_UNKNOWNMODE },
-    { "473",     EVENT_473_ERR_INVITEONLYCHAN },
-    { "474",     EVENT_474_ERR_BANNEDFROMCHAN },
-    { "475",     EVENT_475_ERR_BADCHANNELKEY },
-    { "476",     EVENT_476_ERR_BADCHANMASK },
-    { "477",     EVENT_477_ERR_NEEDREGGEDNICK },
-    { "478",     EVENT_478_ERR_BANLISTFULL },
-    { "481",     EVENT_481_ERR_NOPRIVILEGES },
-    { "482",     EVENT_482_ERR_CHANOPRIVSNEEDED },
-    { "483",     EVENT_483_ERR_CANTKILLSERVER },
-    { "485",     EVENT_485_ERR_UNIQOPRIVSNEEDED },
-    { "491",     EVENT_491_ERR_NOOPERHOST },
-    { "501",     EVENT_501_ERR_UMODEUNKNOWNFLAG },
-    { "502",     EVENT_502_ERR_USERSDONTMATCH },
-    { "524",     EVENT_524_ERR_HELPNOTFOUND },
-    { "704",     EVENT_704_RPL_HELPSTART },
-    { "705",     EVENT_705_RPL_HELPTXT },
-    { "706",     EVENT_706_RPL_ENDOFHELP },
-    { "900",     EVENT_900_RPL_LOGGEDIN },
-    { "901",     EVENT_901_RPL_LOGGEDOUT },
-    { "902",     EVENT_902_ERR_NICKLOCKED },
-    { "903",     EVENT_903_RPL_SASLSUCCESS },
-    { "904",     EVENT_904_ERR_SASLFAIL },
-    { "905",     EVENT_905_ERR_SASLTOOLONG },
-    { "906",     EVENT_906_ERR_SASLABORTED },
-    { "907",     EVENT_907_ERR_SASLALREADY },
-    { "908",     EVENT_908_RPL_SASLMECHS },
-    { NULL,      EVENT_NONE }
+/* Numeric replies indexed by three-digit code - used only for parsing */
+static const unsigned char event_numeric_table[1000] = {
+    [1] = EVENT_001_RPL_WELCOME,
+    [2] = EVENT_002_RPL_YOURHOST,
+    [3] = EVENT_003_RPL_CREATED,
+    [4] = EVENT_004_RPL_MYINFO,
+    [5] = EVENT_005_RPL_BOUNCE,
+    [42] = EVENT_042_RPL_YOURID,
+    [200] = EVENT_200_RPL_TRACELINK,
+    [201] = EVENT_201_RPL_TRACECONNECTING,
+    [202] = EVENT_202_RPL_TRACEHANDSHAKE,
+    [203] = EVENT_203_RPL_TRACEUNKNOWN,
+    [204] = EVENT_204_RPL_TRACEOPERATOR,
+    [205] = EVENT_205_RPL_TRACEUSER,
+    [206] = EVENT_206_RPL_TRACESERVER,
+    [207] = EVENT_207_RPL_TRACESERVICE,
+    [208] = EVENT_208_RPL_TRACENEWTYPE,
+    [209] = EVENT_209_RPL_TRACECLASS,
+    [211] = EVENT_211_RPL_STATSLINKINFO,
+    [212] = EVENT_212_RPL_STATSCOMMANDS,
+    [213] = EVENT_213_RPL_STATSCLINE,
+    [215] = EVENT_215_RPL_STATSILINE,
+    [216] = EVENT_216_RPL_STATSKLINE,
+    [218] = EVENT_218_RPL_STATSYLINE,
+    [219] = EVENT_219_RPL_ENDOFSTATS,
+    [221] = EVENT_221_RPL_UMODEIS,
+    [234] = EVENT_234_RPL_SERVLIST,
+    [235] = EVENT_235_RPL_SERVLISTEND,
+    [241] = EVENT_241_RPL_STATSLLINE,
+    [242] = EVENT_242_RPL_STATSUPTIME,
+    [243] = EVENT_243_RPL_STATSOLINE,
+    [244] = EVENT_244_RPL_STATSHLINE,
+    [245] = EVENT_245_RPL_STATSSLINE,
+    [250] = EVENT_250_RPL_STATSCONN,
+    [251] = EVENT_251_RPL_LUSERCLIENT,
+    [252] = EVENT_252_RPL_LUSEROP,
+    [253] = EVENT_253_RPL_LUSERUNKNOWN,
+    [254] = EVENT_254_RPL_LUSERCHANNELS,
+    [255] = EVENT_255_RPL_LUSERME,
+    [256] = EVENT_256_RPL_ADMINME,
+    [257] = EVENT_257_RPL_ADMINLOC1,
+    [258] = EVENT_258_RPL_ADMINLOC2,
+    [259] = EVENT_259_RPL_ADMINEMAIL,
+    [261] = EVENT_261_RPL_TRACELOG,
+    [263] = EVENT_263_RPL_TRYAGAIN,
+    [265] = EVENT_265_RPL_LOCALUSERS,
+    [266] = EVENT_266_RPL_GLOBALUSERS,
+    [300] = EVENT_300_RPL_NONE,
+    [301] = EVENT_301_RPL_AWAY,
+    [302] = EVENT_302_RPL_USERHOST,
+    [303] = EVENT_303_RPL_ISON,
+    [305] = EVENT_305_RPL_UNAWAY,
+    [306] = EVENT_306_RPL_NOWAWAY,
+    [311] = EVENT_311_RPL_WHOISUSER,
+    [312] = EVENT_312_RPL_WHOISSERVER,
+    [313] = EVENT_313_RPL_WHOISOPERATOR,
+    [314] = EVENT_314_RPL_WHOWASUSER,
+    [315] = EVENT_315_RPL_ENDOFWHO,
+    [317] = EVENT_317_RPL_WHOISIDLE,
+    [318] = EVENT_318_RPL_ENDOFWHOIS,
+    [319] = EVENT_319_RPL_WHOISCHANNELS,
+    [322] = EVENT_322_RPL_LIST,
+    [323] = EVENT_323_RPL_LISTEND,
+    [324] = EVENT_324_RPL_CHANNELMODEIS,
+    [328] = EVENT_328_RPL_CHANNEL_URL,
+    [331] = EVENT_331_RPL_NOTOPIC,
+    [332] = EVENT_332_RPL_TOPIC,
+    [333] = EVENT_333_RPL_TOPICWHOTIME,
+    [341] = EVENT_341_RPL_INVITING,
+    [346] = EVENT_346_RPL_INVITELIST,
+    [347] = EVENT_347_RPL_ENDOFINVITELIST,
+    [348] = EVENT_348_RPL_EXCEPTLIST,
+    [349] = EVENT_349_RPL_ENDOFEXCEPTLIST,
+    [351] = EVENT_351_RPL_VERSION,
+    [352] = EVENT_352_RPL_WHOREPLY,
+    [353] = EVENT_353_RPL_NAMREPLY,
+    [364] = EVENT_364_RPL_LINKS,
+    [365] = EVENT_365_RPL_ENDOFLINKS,
+    [366] = EVENT_366_RPL_ENDOFNAMES,
+    [367] = EVENT_367_RPL_BANLIST,
+    [368] = EVENT_368_RPL_ENDOFBANLIST,
+    [369] = EVENT_369_RPL_ENDOFWHOWAS,
+    [371] = EVENT_371_RPL_INFO,
+    [372] = EVENT_372_RPL_MOTD,
+    [374] = EVENT_374_RPL_ENDOFINFO,
+    [375] = EVENT_375_RPL_MOTDSTART,
+    [376] = EVENT_376_RPL_ENDOFMOTD,
+    [381] = EVENT_381_RPL_YOUREOPER,
+    [382] = EVENT_382_RPL_REHASHING,
+    [383] = EVENT_383_RPL_YOURESERVICE,
+    [391] = EVENT_391_RPL_TIME,
+    [392] = EVENT_392_RPL_USERSSTART,
+    [393] = EVENT_393_RPL_USERS,
+    [394] = EVENT_394_RPL_ENDOFUSERS,
+    [395] = EVENT_395_RPL_NOUSERS,
+    [396] = EVENT_396_RPL_HOSTHIDDEN,
+    [400] = EVENT_400_ERR_UNKNOWNERROR,
+    [401] = EVENT_401_ERR_NOSUCHNICK,
+    [402] = EVENT_402_ERR_NOSUCHSERVER,
+    [403] = EVENT_403_ERR_NOSUCHCHANNEL,
+    [404] = EVENT_404_ERR_CANNOTSENDTOCHAN,
+    [405] = EVENT_405_ERR_TOOMANYCHANNELS,
+    [406] = EVENT_406_ERR_WASNOSUCHNICK,
+    [407] = EVENT_407_ERR_TOOMANYTARGETS,
+    [408] = EVENT_408_ERR_NOSUCHSERVICE,
+    [409] = EVENT_409_ERR_NOORIGIN,
+    [411] = EVENT_411_ERR_NORECIPIENT,
+    [412] = EVENT_412_ERR_NOTEXTTOSEND,
+    [413] = EVENT_413_ERR_NOTOPLEVEL,
+    [414] = EVENT_414_ERR_WILDTOPLEVEL,
+    [415] = EVENT_415_ERR_BADMASK,
+    [421] = EVENT_421_ERR_UNKNOWNCOMMAND,
+    [422] = EVENT_422_ERR_NOMOTD,
+    [423] = EVENT_423_ERR_NOADMININFO,
+    [424] = EVENT_424_ERR_FILEERROR,
+    [431] = EVENT_431_ERR_NONICKNAMEGIVEN,
+    [432] = EVENT_432_ERR_ERRONEUSNICKNAME,
+    [433] = EVENT_433_ERR_NICKNAMEINUSE,
+    [436] = EVENT_436_ERR_NICKCOLLISION,
+    [441] = EVENT_441_ERR_USERNOTINCHANNEL,
+    [442] = EVENT_442_ERR_NOTONCHANNEL,
+    [443] = EVENT_443_ERR_USERONCHANNEL,
+    [444] = EVENT_444_ERR_NOLOGIN,
+    [445] = EVENT_445_ERR_SUMMONDISABLED,
+    [446] = EVENT_446_ERR_USERSDISABLED,
+    [451] = EVENT_451_ERR_NOTREGISTERED,
+    [461] = EVENT_461_ERR_NEEDMOREPARAMS,
+    [462] = EVENT_462_ERR_ALREADYREGISTERED,
+    [463] = EVENT_463_ERR_NOPERMFORHOST,
+    [464] = EVENT_464_ERR_PASSWDMISMATCH,
+    [465] = EVENT_465_ERR_YOUREBANNEDCREEP,
+    [467] = EVENT_467_ERR_KEYSET,
+    [470] = EVENT_470_ERR_LINKCHANNEL,
+    [471] = EVENT_471_ERR_CHANNELISFULL,
+    [472] = EVENT_472_ERR_UNKNOWNMODE,
+    [473] = EVENT_473_ERR_INVITEONLYCHAN,
+    [474] = EVENT_474_ERR_BANNEDFROMCHAN,
+    [475] = EVENT_475_ERR_BADCHANNELKEY,
+    [476] = EVENT_476_ERR_BADCHANMASK,
+    [477] = EVENT_477_ERR_NEEDREGGEDNICK,
+    [478] = EVENT_478_ERR_BANLISTFULL,
+    [481] = EVENT_481_ERR_NOPRIVILEGES,
+    [482] = EVENT_482_ERR_CHANOPRIVSNEEDED,
+    [483] = EVENT_483_ERR_CANTKILLSERVER,
+    [485] = EVENT_485_ERR_UNIQOPRIVSNEEDED,
+    [491] = EVENT_491_ERR_NOOPERHOST,
+    [501] = EVENT_501_ERR_UMODEUNKNOWNFLAG,
+    [502] = EVENT_502_ERR_USERSDONTMATCH,
+    [524] = EVENT_524_ERR_HELPNOTFOUND,
+    [704] = EVENT_704_RPL_HELPSTART,
+    [705] = EVENT_705_RPL_HELPTXT,
+    [706] = EVENT_706_RPL_ENDOFHELP,
+    [900] = EVENT_900_RPL_LOGGEDIN,
+    [901] = EVENT_901_RPL_LOGGEDOUT,
+    [902] = EVENT_902_ERR_NICKLOCKED,
+    [903] = EVENT_903_RPL_SASLSUCCESS,
+    [904] = EVENT_904_ERR_SASLFAIL,
+    [905] = EVENT_905_ERR_SASLTOOLONG,
+    [906] = EVENT_906_ERR_SASLABORTED,
+    [907] = EVENT_907_ERR_SASLALREADY,
+    [908] = EVENT_908_RPL_SASLMECHS,
 };
 
+/* Placeholder for fields absent from the current line */
+static const struct event_view event_view_empty = { "", 0 };
+
+/**
+ * event_view_equals() - Compare a view with a C string
+ * @view: View into the current message line
+ * @s: NUL-terminated string to compare against
+ *
+ * Return: 1 if the view holds exactly @s, 0 otherwise
+ */
+int event_view_equals(const struct event_view *view, const char *s)
+{
+    size_t len = strlen(s);
+
+    return ((size_t)view->len == len) &&
+        (memcmp(view->ptr, s, len) == 0);
+}
+
+/**
+ * event_view_copy() - Copy a view into a NUL-terminated buffer
+ * @dest: Destination buffer
+ * @view: View into the current message line
+ * @n: Size of the destination buffer
+ *
+ * Used by handlers that need to keep data beyond the lifetime of the
+ * receive buffer. Truncates to n - 1 bytes and always terminates.
+ *
+ * Return: 0 on success, -1 if parameters are invalid
+ */
+int event_view_copy(char *dest, const struct event_view *view, size_t n)
+{
+    if ((dest == NULL) || (view == NULL) || (n == 0)) {
+        return -1;
+    }
+
+    size_t len = (size_t)view->len;
+
+    if (len > n - 1) {
+        len = n - 1;
+    }
+
+    memcpy(dest, view->ptr, len);
+    dest[len] = '\0';
+
+    return 0;
+}
+
+/**
+ * event_tag_hash() - Hash a tag key for the tag slot table
+ * @key: Key bytes
+ * @len: Number of key bytes
+ *
+ * Return: FNV-1a hash of the key
+ */
+static unsigned int event_tag_hash(const char *key, size_t len)
+{
+    unsigned int hash = 2166136261u;
+
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * event_tag_find() - Locate the slot holding a tag key
+ * @event: Event with parsed tags
+ * @key: Key bytes
+ * @len: Number of key bytes
+ *
+ * Probes the open-addressed tag_slots table linearly starting at the
+ * key's hash. The table is never more than half full, so the probe
+ * always ends at the matching key or an empty slot.
+ *
+ * Return: Slot index for the key (empty if the key is absent)
+ */
+static unsigned int event_tag_find(const struct event *event,
+        const char *key, size_t len)
+{
+    unsigned int mask = KIRC_TAG_SLOTS - 1;
+    unsigned int slot = event_tag_hash(key, len) & mask;
+
+    while (event->tag_slots[slot] != 0) {
+        const struct event_tag *tag = &event->tags[event->tag_slots[slot] - 1];
+
+        if (((size_t)tag->key.len == len) &&
+            (memcmp(tag->key.ptr, key, len) == 0)) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/**
+ * event_parse_tags() - Parse an IRCv3 message-tags section
+ * @event: Event structure to populate
+ * @p: Start of the tag section, just past the leading '@'
+ * @end: End of the tag section (the separating space)
+ *
+ * Records each key=value pair as views into the line and indexes them
+ * by key. Values are left escaped; they are only decoded when a handler
+ * asks for them through event_tag_value(). A repeated key replaces the
+ * earlier value. Tags beyond KIRC_TAGS_MAX are ignored.
+ */
+static void event_parse_tags(struct event *event, const char *p,
+        const char *end)
+{
+    memset(event->tag_slots, 0, sizeof(event->tag_slots));
+
+    while (p < end) {
+        const char *next = memchr(p, ';', end - p);
+
+        if (next == NULL) {
+            next = end;
+        }
+
+        const char *eq = memchr(p, '=', next - p);
+        const char *key_end = eq ? eq : next;
+
+        if (key_end > p) {
+            size_t len = key_end - p;
+            unsigned int slot = event_tag_find(event, p, len);
+            struct event_tag *tag = NULL;
+
+            if (event->tag_slots[slot] != 0) {
+                tag = &event->tags[event->tag_slots[slot] - 1];
+            } else if (event->tag_count < KIRC_TAGS_MAX) {
+                tag = &event->tags[event->tag_count++];
+                event->tag_slots[slot] = (unsigned char)event->tag_count;
+            }
+
+            if (tag != NULL) {
+                tag->key.ptr = p;
+                tag->key.len = (int)len;
+                tag->value.ptr = eq ? eq + 1 : "";
+                tag->value.len = eq ? (int)(next - eq - 1) : 0;
+            }
+        }
+
+        p = next + 1;
+    }
+}
+
+/**
+ * event_tag() - Look up the raw value of a message tag
+ * @event: Parsed event
+ * @key: Tag key (e.g. "time", "msgid", "batch")
+ *
+ * Returns the value exactly as received, without unescaping. Tags
+ * without a value yield an empty view.
+ *
+ * Return: View of the escaped value, or NULL if the tag is absent
+ */
+const struct event_view *event_tag(const struct event *event,
+        const char *key)
+{
+    if (event->tag_count == 0) {
+        return NULL;
+    }
+
+    unsigned int slot = event_tag_find(event, key, strlen(key));
+
+    if (event->tag_slots[slot] == 0) {
+        return NULL;
+    }
+
+    return &event->tags[event->tag_slots[slot] - 1].value;
+}
+
+/**
+ * event_tag_value() - Copy the unescaped value of a message tag
+ * @event: Parsed event
+ * @key: Tag key
+ * @buf: Destination buffer
+ * @n: Size of the destination buffer
+ *
+ * Decodes the message-tags escapes (\: \s \\ \r \n) into @buf. The
+ * result is truncated to n - 1 bytes and always NUL-terminated.
+ *
+ * Return: Length of the decoded value, or -1 if the tag is absent
+ */
+int event_tag_value(const struct event *event, const char *key,
+        char *buf, size_t n)
+{
+    const struct event_view *value = event_tag(event, key);
+
+    if ((value == NULL) || (buf == NULL) || (n == 0)) {
+        return -1;
+    }
+
+    size_t out = 0;
+
+    for (int i = 0; (i < value->len) && (out < n - 1); ++i) {
+        char c = value->ptr[i];
+
+        if (c == '\\') {
+            if (++i >= value->len) {
+                break;  /* trailing backslash is dropped */
+            }
+
+            switch (value->ptr[i]) {
+            case ':': c = ';'; break;
+            case 's': c = ' '; break;
+            case 'r': c = '\r'; break;
+            case 'n': c = '\n'; break;
+            default: c = value->ptr[i]; break;
+            }
+        }
+
+        buf[out++] = c;
+    }
+
+    buf[out] = '\0';
+
+    return (int)out;
+}
+
+/**
+ * event_server_time() - Parse an IRCv3 server-time tag
+ * @event: Event that may carry a "time" tag
+ * @out: Destination for the parsed time
+ *
+ * Converts the UTC timestamp of the form YYYY-MM-DDThh:mm:ss[.sss]Z
+ * into a time_t without relying on the non-portable timegm().
+ *
+ * Return: 0 on success, -1 if the tag is absent or malformed
+ */
+static int event_server_time(const struct event *event, time_t *out)
+{
+    char value[32];
+    int y, m, d, hh, mm, ss;
+
+    if (event_tag_value(event, "time", value, sizeof(value)) <= 0) {
+        return -1;
+    }
+
+    if (sscanf(value, "%4d-%2d-%2dT%2d:%2d:%2d",
+        &y, &m, &d, &hh, &mm, &ss) != 6) {
+        return -1;
+    }
+
+    if ((m < 1) || (m > 12) || (d < 1) || (d > 31)) {
+        return -1;
+    }
+
+    /* days since the epoch for a proleptic Gregorian date */
+    y -= (m <= 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = era * 146097 + doe - 719468;
+
+    *out = (time_t)days * 86400 + hh * 3600 + mm * 60 + ss;
+
+    return 0;
+}
+
+/**
+ * event_time() - When an event happened
+ * @event: Parsed event
+ *
+ * Return: The server-time tag when the server sent one (e.g. bouncer
+ * playback), otherwise the current time
+ */
+time_t event_time(const struct event *event)
+{
+    time_t current;
+
+    if (event_server_time(event, &current) < 0) {
+        time(&current);
+    }
+
+    return current;
+}
+
+/**
+ * event_classify_word() - Map a named IRC command to an event type
+ * @command: View of the command token
+ *
+ * Resolves the small fixed set of named commands with a switch on the
+ * first byte, so each lookup costs at most two string compares instead
+ * of a scan over the whole command table.
+ *
+ * Return: Matching event type, or EVENT_NONE if unknown
+ */
+static enum event_type event_classify_word(const struct event_view *command)
+{
+    const char *p = command->ptr;
+
+    if (command->len < 3) {
+        return EVENT_NONE;
+    }
+
+    switch (p[0]) {
+    case 'A':
+        if (event_view_equals(command, "AUTHENTICATE")) return EVENT_EXT_AUTHENTICATE;
+        break;
+
+    case 'C':
+        if (event_view_equals(command, "CAP")) return EVENT_EXT_CAP;
+        break;
+
+    case 'E':
+        if (event_view_equals(command, "ERROR")) return EVENT_ERROR;
+        break;
+
+    case 'J':
+        if (event_view_equals(command, "JOIN")) return EVENT_JOIN;
+        break;
+
+    case 'K':
+        if (event_view_equals(command, "KICK")) return EVENT_KICK;
+        break;
+
+    case 'M':
+        if (event_view_equals(command, "MODE")) return EVENT_MODE;
+        break;
+
+    case 'N':
+        if (p[1] == 'I') {
+            if (event_view_equals(command, "NICK")) return EVENT_NICK;
+        } else if (event_view_equals(command, "NOTICE")) {
+            return EVENT_NOTICE;
+        }
+        break;
+
+    case 'P':
+        if (p[1] == 'R') {
+            if (event_view_equals(command, "PRIVMSG")) return EVENT_PRIVMSG;
+        } else if (p[1] == 'I') {
+            if (event_view_equals(command, "PING")) return EVENT_PING;
+        } else if (p[1] == 'O') {
+            if (event_view_equals(command, "PONG")) return EVENT_PONG;
+        } else if (event_view_equals(command, "PART")) {
+            return EVENT_PART;
+        }
+        break;
+
+    case 'Q':
+        if (event_view_equals(command, "QUIT")) return EVENT_QUIT;
+        break;
+
+    case 'T':
+        if (event_view_equals(command, "TOPIC")) return EVENT_TOPIC;
+        break;
+    }
+
+    return EVENT_NONE;
+}
+
+/**
+ * event_classify() - Map an IRC command to an event type
+ * @command: View of the command token
+ *
+ * Numeric replies are decoded directly from their three digits into
+ * event_numeric_table; named commands go through event_classify_word().
+ * Both paths run in constant time regardless of table size.
+ *
+ * Return: Matching event type, or EVENT_NONE if unknown
+ */
+enum event_type event_classify(const struct event_view *command)
+{
+    const char *p = command->ptr;
+
+    if ((command->len == 3) &&
+        isdigit((unsigned char)p[0]) &&
+        isdigit((unsigned char)p[1]) &&
+        isdigit((unsigned char)p[2])) {
+        int code = (p[0] - '0') * 100 +
+            (p[1] - '0') * 10 + (p[2] - '0');
+        return (enum event_type)event_numeric_table[code];
+    }
+
+    return event_classify_word(command);
+}
+
 /**
  * event_init() - Initialize an event structure
  * @event: Event structure to initialize
  * @ctx: IRC context structure
  *
- * Zeros out the event structure and associates it with an IRC context.
- * Sets the event type to EVENT_NONE.
+ * Associates the event with an IRC context and points every view at an
+ * empty string. Parameter slots are not cleared; only the first
+ * param_count entries are ever valid. Sets the event type to EVENT_NONE.
  *
  * Return: 0 on success
  */
 int event_init(struct event *event, struct kirc_context *ctx)
 {
-    memset(event, 0, sizeof(*event));
-
     event->ctx = ctx;
     event->type = EVENT_NONE;
+    event->raw = event_view_empty;
+    event->prefix = event_view_empty;
+    event->nickname = event_view_empty;
+    event->user = event_view_empty;
+    event->host = event_view_empty;
+    event->command = event_view_empty;
+    event->channel = event_view_empty;
+    event->message = event_view_empty;
+    event->param_count = 0;
+    event->tag_count = 0;
 
     return 0;
 }
@@ -209,179 +588,206 @@ int event_init(struct event *event, struct kirc_context *ctx)
  * Detects and parses CTCP (Client-To-Client Protocol) commands embedded
  * in PRIVMSG or NOTICE events. CTCP commands are delimited by \001 characters.
  * Supports ACTION, VERSION, PING, TIME, CLIENTINFO, and DCC commands.
- * Updates the event type and extracts command parameters.
+ * Updates the event type and narrows the message view to the CTCP
+ * arguments without copying.
  *
  * Return: 0 on success
  */
 static int event_ctcp_parse(struct event *event)
 {
-    if (((event->type == EVENT_PRIVMSG) ||
-        (event->type == EVENT_NOTICE)) &&
-        (event->message[0] == '\001')) {
-        char ctcp[MESSAGE_MAX_LEN];
-        size_t siz = sizeof(event->message);
-        size_t len = strnlen(event->message, siz);
-        size_t end = 1;
-
-        while ((end < len) && event->message[end] != '\001') {
-            end++;
-        }
+    if (((event->type != EVENT_PRIVMSG) &&
+        (event->type != EVENT_NOTICE)) ||
+        (event->message.len < 2) ||
+        (event->message.ptr[0] != '\001')) {
+        return 0;
+    }
 
-        size_t ctcp_len = (end > 1) ? end - 1 : 0;
+    const char *start = event->message.ptr + 1;
+    const char *end = event->message.ptr + event->message.len;
+    const char *close = memchr(start, '\001', end - start);
 
-        if (ctcp_len > 0) {
-            size_t copy_n;
+    if (close != NULL) {
+        end = close;
+    }
 
-            if (ctcp_len < sizeof(ctcp)) {
-                copy_n = ctcp_len + 1;
-            } else {
-                copy_n = sizeof(ctcp);
-            }
+    if (end == start) {
+        return 0;
+    }
 
-            safecpy(ctcp, event->message + 1, copy_n); 
-
-            char *command = strtok(ctcp, " ");
-            char *args = strtok(NULL, "");
-
-            if (command != NULL) {
-                if (strcmp(command, "ACTION") == 0) {
-                    event->type = EVENT_CTCP_ACTION;
-                    if (args != NULL) {
-                        siz = sizeof(event->message);
-                        safecpy(event->message, args, siz);
-                    } else {
-                        event->message[0] = '\0';
-                    }
-                } else if (strcmp(command, "VERSION") == 0) {
-                    event->type = EVENT_CTCP_VERSION;
-                    if (args != NULL) {
-                        siz = sizeof(event->params);
-                        safecpy(event->params, args, siz);
-                    } else {
-                        event->params[0] = '\0';
-                    }
-                } else if (strcmp(command, "PING") == 0) {
-                    event->type = EVENT_CTCP_PING;
-                    if (args != NULL) {
-                        siz = sizeof(event->message);
-                        safecpy(event->message, args, siz);
-                    } else {
-                        event->message[0] = '\0';
-                    }
-                } else if (strcmp(command, "TIME") == 0) {
-                    event->type = EVENT_CTCP_TIME;
-                } else if (strcmp(command, "CLIENTINFO") == 0) {
-                    event->type = EVENT_CTCP_CLIENTINFO;
-                } else if (strcmp(command, "DCC") == 0) {
-                    event->type = EVENT_CTCP_DCC;
-                    if (args != NULL) {
-                        siz = sizeof(event->message);
-                        safecpy(event->message, args, siz);
-                    } else {
-                        event->message[0] = '\0';
-                    }
-                } else {
-                    event->message[0] = '\0';
-                }
-            }
-        }
+    const char *space = memchr(start, ' ', end - start);
+    struct event_view command = { start, (int)((space ? space : end) - start) };
+    struct event_view args = event_view_empty;
+
+    if (space != NULL) {
+        args.ptr = space + 1;
+        args.len = (int)(end - args.ptr);
+    }
+
+    if (event_view_equals(&command, "ACTION")) {
+        event->type = EVENT_CTCP_ACTION;
+    } else if (event_view_equals(&command, "VERSION")) {
+        event->type = EVENT_CTCP_VERSION;
+    } else if (event_view_equals(&command, "PING")) {
+        event->type = EVENT_CTCP_PING;
+    } else if (event_view_equals(&command, "TIME")) {
+        event->type = EVENT_CTCP_TIME;
+        args = event_view_empty;
+    } else if (event_view_equals(&command, "CLIENTINFO")) {
+        event->type = EVENT_CTCP_CLIENTINFO;
+        args = event_view_empty;
+    } else if (event_view_equals(&command, "DCC")) {
+        event->type = EVENT_CTCP_DCC;
+    } else {
+        args = event_view_empty;
     }
 
+    event->message = args;
+
     return 0;
 }
 
+/**
+ * event_parse_prefix() - Split a message prefix into its components
+ * @event: Event structure to populate
+ *
+ * Splits event->prefix of the form nick!user@host into views. A server
+ * name prefix has no '!' or '@' and is stored whole as the nickname.
+ */
+static void event_parse_prefix(struct event *event)
+{
+    const char *p = event->prefix.ptr;
+    const char *end = p + event->prefix.len;
+    const char *bang = memchr(p, '!', end - p);
+    const char *at = memchr(p, '@', end - p);
+
+    const char *nick_end = bang ? bang : (at ? at : end);
+
+    event->nickname.ptr = p;
+    event->nickname.len = (int)(nick_end - p);
+
+    if (bang != NULL) {
+        const char *user_end = (at && at > bang) ? at : end;
+        event->user.ptr = bang + 1;
+        event->user.len = (int)(user_end - bang - 1);
+    }
+
+    if (at != NULL) {
+        event->host.ptr = at + 1;
+        event->host.len = (int)(end - at - 1);
+    }
+}
+
 /**
  * event_parse() - Parse IRC message into event structure
  * @event: Event structure to populate
  * @line: Raw IRC message line to parse
  *
- * Parses a raw IRC protocol message into structured event data. Handles
- * special cases (PING, AUTHENTICATE, ERROR) and general IRC message format.
- * Extracts prefix, command, channel, nickname, and message components.
- * Determines event type from command using the event dispatch table.
+ * Tokenizes a raw IRC protocol message in place. Every field of the
+ * event is a view into @line, so the line must stay untouched until the
+ * event has been dispatched. Extracts IRCv3 message tags, the prefix
+ * (nick, user, host), command, middle parameters and trailing parameter.
+ * The channel view is the first parameter and the message view is the
+ * trailing one.
+ * Determines event type from command using event_classify().
  * Calls event_ctcp_parse() to detect CTCP commands.
  *
  * Return: 0 on success, -1 if parsing fails
  */
 int event_parse(struct event *event, char *line)
 {
+    const char *p = line;
+    const char *end = line + strlen(line);
 
-    char line_copy[MESSAGE_MAX_LEN];
-    safecpy(line_copy, line, sizeof(line_copy));
-    safecpy(event->raw, line, sizeof(event->raw));
+    event->raw.ptr = line;
+    event->raw.len = (int)(end - line);
 
-    if (strncmp(line, "PING", 4) == 0) {
-        event->type = EVENT_PING;
-        size_t message_n = sizeof(event->message);
-        safecpy(event->message, line + 6, message_n);
-        return 0;
+    if (*p == '@') {
+        const char *space = memchr(p, ' ', end - p);
+
+        if (space == NULL) {
+            return -1;
+        }
+
+        event_parse_tags(event, p + 1, space);
+        p = space;
+
+        while (*p == ' ') {
+            p++;
+        }
     }
 
-    if (strncmp(line, "AUTHENTICATE +", 14) == 0) {
-        event->type = EVENT_EXT_AUTHENTICATE;
-        return 0;
+    if (*p == ':') {
+        const char *space = memchr(p, ' ', end - p);
+
+        if (space == NULL) {
+            return -1;
+        }
+
+        event->prefix.ptr = p + 1;
+        event->prefix.len = (int)(space - p - 1);
+        event_parse_prefix(event);
+        p = space;
     }
 
-    if (strncmp(line, "ERROR", 5) == 0) {
-        event->type = EVENT_ERROR;
-        size_t message_n = sizeof(event->message);
-        safecpy(event->message, line + 7, message_n);
-        return 0;
+    while (*p == ' ') {
+        p++;
     }
 
-    char *token = strtok(line_copy, " ");
+    const char *command_end = p;
 
-    if (token == NULL) {
-        return -1;
+    while ((command_end < end) && (*command_end != ' ')) {
+        command_end++;
     }
 
-    char *prefix = token + 1;
-    char *suffix = strtok(NULL, ":");
-
-    if (suffix == NULL) {
+    if (command_end == p) {
         return -1;
     }
 
-    char *message = strtok(NULL, "\r");
-
-    if (message != NULL) {
-        size_t message_n = sizeof(event->message);
-        safecpy(event->message, message, message_n);
-    }
+    event->command.ptr = p;
+    event->command.len = (int)(command_end - p);
+    p = command_end;
 
-    char *nickname = strtok(prefix, "!");
+    for (;;) {
+        while (*p == ' ') {
+            p++;
+        }
 
-    if (nickname != NULL) {
-        size_t nickname_n = sizeof(event->nickname);
-        safecpy(event->nickname, nickname, nickname_n);
-    }
+        if (p >= end) {
+            break;
+        }
 
-    char *command = strtok(suffix, "#& ");
+        if ((*p == ':') || (event->param_count == KIRC_PARAMS_MAX)) {
+            if (*p == ':') {
+                p++;
+            }
+            event->message.ptr = p;
+            event->message.len = (int)(end - p);
+            break;
+        }
 
-    if (command != NULL) {
-        size_t command_n = sizeof(event->command);
-        safecpy(event->command, command, command_n);
-    }
+        const char *param_end = memchr(p, ' ', end - p);
 
-    char *channel = strtok(NULL, " \r");
+        if (param_end == NULL) {
+            param_end = end;
+        }
 
-    if (channel != NULL) {
-        size_t channel_n = sizeof(event->channel);
-        safecpy(event->channel, channel, channel_n);
+        struct event_view *param = &event->params[event->param_count++];
+        param->ptr = p;
+        param->len = (int)(param_end - p);
+        p = param_end;
     }
 
-    char *params = strtok(NULL, ":\r");
-
-    if (params != NULL) {
-        size_t params_n = sizeof(event->params);
-        safecpy(event->params, params, params_n);
+    if (event->param_count > 0) {
+        event->channel = event->params[0];
+    } else {
+        event->channel = event->message;
     }
 
-    for (int i = 0; event_table[i].command != NULL; i++) {
-        if (strcmp(event->command, event_table[i].command) == 0) {
-            event->type = event_table[i].type;
-            break;
-        }
+    event->type = event_classify(&event->command);
+
+    if ((event->type == EVENT_EXT_AUTHENTICATE) &&
+        !event_view_equals(&event->channel, "+")) {
+        event->type = EVENT_NONE;
     }
 
     event_ctcp_parse(event);
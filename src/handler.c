@@ -73,7 +73,8 @@ int handler_init(struct handler *handler, struct kirc_context *ctx)
  *
  * Dispatches an IRC event to its registered handler using O(1) array lookup.
  * If no specific handler is registered, calls the default handler (typically
- * displays raw message). Does nothing if required parameters are NULL.
+ * displays raw message). The event is written to the chat log first.
+ * Does nothing if required parameters are NULL.
  */
 void handler_dispatch(struct handler *handler, struct network *network,
         struct event *event, struct output *output)
@@ -81,6 +82,9 @@ void handler_dispatch(struct handler *handler, struct network *network,
     if (handler == NULL || network == NULL || event == NULL) {
         return;
     }
+
+    chatlog_event(&network->chatlog, event,
+        network_is_self(network, &event->channel));
     
     /* O(1) direct array lookup instead of O(n) linear search */
     if (event->type >= 0 && event->type < KIRC_EVENT_TYPE_MAX) {
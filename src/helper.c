@@ -7,6 +7,10 @@
 
 #include "helper.h"
 
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 /**
  * safecpy() - Safe string copy with guaranteed null termination
  * @s1: Destination buffer
@@ -58,6 +62,82 @@ int memzero(void *s, size_t n)
     return 0;
 }
 
+/**
+ * find_special() - Find the next CR or CTCP marker byte
+ * @buffer: Buffer to scan
+ * @i: Offset to start scanning at
+ * @len: Length of the buffer
+ *
+ * Skips over ordinary message bytes in blocks: 32 bytes at a time with
+ * AVX2, 16 with SSE2, or 8 with a portable SWAR test when neither is
+ * available at compile time. Only blocks containing a candidate byte
+ * are examined one byte at a time.
+ *
+ * Return: Offset of the first '\r' or '\001' at or after @i, or @len
+ */
+static size_t find_special(const char *buffer, size_t i, size_t len)
+{
+#if defined(__AVX2__)
+    const __m256i cr32 = _mm256_set1_epi8('\r');
+    const __m256i soh32 = _mm256_set1_epi8('\001');
+
+    while (i + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buffer + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, cr32),
+                _mm256_cmpeq_epi8(v, soh32)));
+
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+
+        i += 32;
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i cr16 = _mm_set1_epi8('\r');
+    const __m128i soh16 = _mm_set1_epi8('\001');
+
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buffer + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, cr16),
+                _mm_cmpeq_epi8(v, soh16)));
+
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+
+        i += 16;
+    }
+#else
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    while (i + 8 <= len) {
+        uint64_t v;
+        memcpy(&v, buffer + i, sizeof(v));
+
+        uint64_t cr = v ^ (ones * '\r');
+        uint64_t soh = v ^ ones;
+
+        /* a byte of cr or soh is zero where v matched */
+        if ((((cr - ones) & ~cr) | ((soh - ones) & ~soh)) & highs) {
+            break;
+        }
+
+        i += 8;
+    }
+#endif
+
+    while ((i < len) && (buffer[i] != '\r') && (buffer[i] != '\001')) {
+        i++;
+    }
+
+    return i;
+}
+
 /**
  * find_message_end() - Find IRC message terminator in buffer
  * @buffer: Buffer containing IRC protocol data
@@ -74,17 +154,208 @@ char *find_message_end(const char *buffer, size_t len)
 {
     int ctcp_active = 0;
 
-    for (size_t i = 0; i + 1 < len; ++i) {
+    for (size_t i = 0; (i = find_special(buffer, i, len)) + 1 < len; ++i) {
         if (buffer[i] == '\001') {
             /* Toggle CTCP state when marker encountered */
             ctcp_active = !ctcp_active;
-        } else if (buffer[i] == '\r' && buffer[i + 1] == '\n') {
+        } else if ((buffer[i + 1] == '\n') && !ctcp_active) {
             /* Message end found only if not inside CTCP sequence */
-            if (!ctcp_active) {
-                return (char *)(buffer + i);
+            return (char *)(buffer + i);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * find_message_ends() - Find every IRC message terminator in buffer
+ * @buffer: Buffer containing IRC protocol data
+ * @len: Length of the buffer
+ * @ends: Array receiving the offset of each terminator's \r
+ * @n: Capacity of @ends
+ *
+ * Batch form of find_message_end(): a single pass over the buffer that
+ * records up to @n line boundaries, with the same CTCP rules applied
+ * to each line. Scanning stops early once @ends is full.
+ *
+ * Return: Number of terminators stored in @ends
+ */
+size_t find_message_ends(const char *buffer, size_t len,
+        size_t *ends, size_t n)
+{
+    int ctcp_active = 0;
+    size_t count = 0;
+
+    for (size_t i = 0; (count < n) &&
+        ((i = find_special(buffer, i, len)) + 1 < len); ++i) {
+        if (buffer[i] == '\001') {
+            ctcp_active = !ctcp_active;
+        } else if ((buffer[i + 1] == '\n') && !ctcp_active) {
+            ends[count++] = i;
+            ctcp_active = 0;
+            i++;  /* skip the \n */
+        }
+    }
+
+    return count;
+}
+
+/**
+ * find_substring_at() - Compare a candidate match ignoring ASCII case
+ * @buffer: Candidate position
+ * @needle: String searched for
+ * @n: Length of @needle
+ *
+ * Return: 1 if the @n bytes at @buffer match @needle, 0 otherwise
+ */
+static int find_substring_at(const char *buffer, const char *needle, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (tolower((unsigned char)buffer[i]) !=
+            tolower((unsigned char)needle[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * find_substring() - Find a string in a buffer, ignoring ASCII case
+ * @buffer: Buffer to search, need not be NUL-terminated
+ * @len: Length of the buffer
+ * @needle: String to look for
+ * @n: Length of @needle
+ *
+ * Tests 32 (AVX2) or 16 (SSE2) positions at once by comparing the
+ * first and the last byte of @needle against the buffer, both with bit
+ * 0x20 set so upper and lower case letters compare equal. Only the
+ * positions where both match are compared in full, so most of the
+ * buffer is never looked at byte by byte.
+ *
+ * Return: Pointer to the first match, or NULL if there is none
+ */
+const char *find_substring(const char *buffer, size_t len,
+        const char *needle, size_t n)
+{
+    if (n == 0) {
+        return buffer;
+    }
+
+    if (n > len) {
+        return NULL;
+    }
+
+    size_t end = len - n + 1;  /* candidate positions */
+    size_t i = 0;
+    unsigned char first = (unsigned char)needle[0] | 0x20;
+    unsigned char last = (unsigned char)needle[n - 1] | 0x20;
+
+#if defined(__AVX2__)
+    const __m256i case32 = _mm256_set1_epi8(0x20);
+    const __m256i first32 = _mm256_set1_epi8((char)first);
+    const __m256i last32 = _mm256_set1_epi8((char)last);
+
+    while (i + 32 <= end) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(buffer + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(buffer + i + n - 1));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_or_si256(a, case32), first32),
+                _mm256_cmpeq_epi8(_mm256_or_si256(b, case32), last32)));
+
+        while (mask != 0) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+
+            if (find_substring_at(buffer + at, needle, n)) {
+                return buffer + at;
             }
+
+            mask &= mask - 1;
+        }
+
+        i += 32;
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i case16 = _mm_set1_epi8(0x20);
+    const __m128i first16 = _mm_set1_epi8((char)first);
+    const __m128i last16 = _mm_set1_epi8((char)last);
+
+    while (i + 16 <= end) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(buffer + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(buffer + i + n - 1));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_or_si128(a, case16), first16),
+                _mm_cmpeq_epi8(_mm_or_si128(b, case16), last16)));
+
+        while (mask != 0) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+
+            if (find_substring_at(buffer + at, needle, n)) {
+                return buffer + at;
+            }
+
+            mask &= mask - 1;
+        }
+
+        i += 16;
+    }
+#endif
+
+    for (; i < end; ++i) {
+        if ((((unsigned char)buffer[i] | 0x20) == first) &&
+            (((unsigned char)buffer[i + n - 1] | 0x20) == last) &&
+            find_substring_at(buffer + i, needle, n)) {
+            return buffer + i;
         }
     }
 
     return NULL;
 }
+
+/**
+ * find_text_split() - Find where to cut text that does not fit a line
+ * @text: Message text, need not be NUL-terminated
+ * @len: Length of @text
+ * @room: Most bytes a piece may have
+ *
+ * Cuts at the last space within @room so words stay whole. A word
+ * longer than @room is cut at the last UTF-8 character boundary
+ * instead, so no character is torn in two. The caller skips the spaces
+ * at the start of the next piece.
+ *
+ * Return: Length of the first piece, @len if everything fits, and
+ * never 0 unless @room or @len is 0
+ */
+size_t find_text_split(const char *text, size_t len, size_t room)
+{
+    if (len <= room) {
+        return len;
+    }
+
+    for (size_t i = room; i > 0; --i) {
+        if (text[i] == ' ') {
+            /* the piece ends before the run of spaces */
+            while ((i > 0) && (text[i - 1] == ' ')) {
+                i--;
+            }
+
+            if (i > 0) {
+                return i;
+            }
+
+            break;
+        }
+    }
+
+    size_t cut = room;
+
+    while ((cut > 0) && (((unsigned char)text[cut] & 0xC0) == 0x80)) {
+        cut--;
+    }
+
+    return (cut > 0) ? cut : room;
+}
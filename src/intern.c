@@ -0,0 +1,444 @@
+/*
+ * intern.c
+ * Nicknames and channel names as small integer ids
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "intern.h"
+
+/*
+ * Each connection keeps one table of the names it has to remember:
+ * nicknames, channel names and our own nick. A name is stored once and
+ * handed out as a 32-bit id, so the channel state, DCC and the protocol
+ * handlers keep and compare ids instead of strings. Names are looked up
+ * case-insensitively under the server's CASEMAPPING, so "Nick[1]" and
+ * "nick{1}" get the same id on an rfc1459 server. Ids are reference
+ * counted and reused once the last holder lets go.
+ */
+
+/**
+ * intern_hash() - Hash of a name under the server's case mapping
+ * @intern: Name table
+ * @name: Name bytes
+ * @len: Length of @name
+ *
+ * Return: 32-bit hash
+ */
+static uint32_t intern_hash(const struct intern *intern,
+        const char *name, int len)
+{
+    return casemap_hash(&intern->casemap, name, (size_t)len);
+}
+
+/**
+ * intern_equals() - Compare a stored name with a view under CASEMAPPING
+ * @intern: Name table
+ * @stored: NUL-terminated stored name
+ * @name: Name bytes, not NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: 1 if equal, 0 otherwise
+ */
+static int intern_equals(const struct intern *intern, const char *stored,
+        const char *name, int len)
+{
+    return casemap_equals(&intern->casemap, stored, strlen(stored),
+        name, (size_t)len);
+}
+
+/**
+ * intern_slot() - Probe the hash table
+ * @intern: Name table
+ * @name: Name bytes, not NUL-terminated
+ * @len: Length of @name
+ * @hash: intern_hash() of @name
+ *
+ * Return: Slot holding @name, or the empty slot where it belongs
+ */
+static uint32_t intern_slot(struct intern *intern, const char *name,
+        int len, uint32_t hash)
+{
+    uint32_t i = hash & intern->mask;
+
+    while (intern->slots[i] != 0) {
+        const struct intern_entry *entry = &intern->entries[intern->slots[i] - 1];
+
+        if ((entry->hash == hash) &&
+            intern_equals(intern, entry->name, name, len)) {
+            break;
+        }
+
+        i = (i + 1) & intern->mask;
+    }
+
+    return i;
+}
+
+/**
+ * intern_unhash() - Take an id out of the hash table
+ * @intern: Name table
+ * @id: Id in the table
+ *
+ * Closes the gap by moving later entries of the probe sequence back,
+ * so lookups never need tombstones.
+ */
+static void intern_unhash(struct intern *intern, uint32_t id)
+{
+    uint32_t mask = intern->mask;
+    uint32_t i = intern->entries[id - 1].hash & mask;
+
+    while (intern->slots[i] != id) {
+        i = (i + 1) & mask;
+    }
+
+    intern->slots[i] = 0;
+
+    for (uint32_t j = (i + 1) & mask; intern->slots[j] != 0;
+        j = (j + 1) & mask) {
+        uint32_t home = intern->entries[intern->slots[j] - 1].hash & mask;
+
+        /* move back unless its home lies cyclically in (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            intern->slots[i] = intern->slots[j];
+            intern->slots[j] = 0;
+            i = j;
+        }
+    }
+}
+
+/**
+ * intern_rehash() - Rebuild the hash table
+ * @intern: Name table
+ * @size: Number of slots, a power of two
+ *
+ * Hashes are recomputed, as the fold table may have changed.
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int intern_rehash(struct intern *intern, uint32_t size)
+{
+    uint32_t *slots = calloc(size, sizeof(*slots));
+
+    if (slots == NULL) {
+        return -1;
+    }
+
+    for (uint32_t id = 1; id <= intern->count; ++id) {
+        struct intern_entry *entry = &intern->entries[id - 1];
+
+        if (entry->name == NULL) {
+            continue;
+        }
+
+        entry->hash = intern_hash(intern, entry->name,
+            (int)strlen(entry->name));
+
+        uint32_t i = entry->hash & (size - 1);
+
+        while (slots[i] != 0) {
+            i = (i + 1) & (size - 1);
+        }
+
+        slots[i] = id;
+    }
+
+    free(intern->slots);
+    intern->slots = slots;
+    intern->mask = size - 1;
+
+    return 0;
+}
+
+/**
+ * intern_find() - Look up the id of a name
+ * @intern: Name table
+ * @name: Name bytes, need not be NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: Id, or 0 if the name is not in the table
+ */
+uint32_t intern_find(struct intern *intern, const char *name, int len)
+{
+    if ((intern == NULL) || (name == NULL) || (len <= 0)) {
+        return 0;
+    }
+
+    uint32_t hash = intern_hash(intern, name, len);
+
+    return intern->slots[intern_slot(intern, name, len, hash)];
+}
+
+/**
+ * intern_add() - Find or add a name and take a reference to it
+ * @intern: Name table
+ * @name: Name bytes, need not be NUL-terminated
+ * @len: Length of @name
+ *
+ * Return: Id, or 0 if @len is 0 or allocation fails
+ */
+uint32_t intern_add(struct intern *intern, const char *name, int len)
+{
+    if ((intern == NULL) || (name == NULL) || (len <= 0)) {
+        return 0;
+    }
+
+    uint32_t hash = intern_hash(intern, name, len);
+    uint32_t i = intern_slot(intern, name, len, hash);
+
+    if (intern->slots[i] != 0) {
+        return intern_hold(intern, intern->slots[i]);
+    }
+
+    /* keep the table at most half full */
+    if ((intern->used + 1) * 2 > intern->mask + 1) {
+        if (intern_rehash(intern, (intern->mask + 1) * 2) < 0) {
+            return 0;
+        }
+
+        i = intern_slot(intern, name, len, hash);
+    }
+
+    if ((intern->free == 0) && (intern->count == intern->size)) {
+        uint32_t size = intern->size * 2;
+        struct intern_entry *entries = realloc(intern->entries,
+            size * sizeof(*entries));
+
+        if (entries == NULL) {
+            return 0;
+        }
+
+        intern->entries = entries;
+        intern->size = size;
+    }
+
+    char *copy = malloc((size_t)len + 1);
+
+    if (copy == NULL) {
+        return 0;
+    }
+
+    memcpy(copy, name, (size_t)len);
+    copy[len] = '\0';
+
+    uint32_t id = intern->free;
+
+    if (id != 0) {
+        intern->free = intern->entries[id - 1].refs;
+    } else {
+        id = ++intern->count;
+    }
+
+    struct intern_entry *entry = &intern->entries[id - 1];
+
+    entry->name = copy;
+    entry->hash = hash;
+    entry->refs = 1;
+    intern->slots[i] = id;
+    intern->used++;
+
+    return id;
+}
+
+/**
+ * intern_hold() - Take another reference to an id
+ * @intern: Name table
+ * @id: Id in use
+ *
+ * Return: @id
+ */
+uint32_t intern_hold(struct intern *intern, uint32_t id)
+{
+    if (id != 0) {
+        intern->entries[id - 1].refs++;
+    }
+
+    return id;
+}
+
+/**
+ * intern_release() - Drop a reference to an id
+ * @intern: Name table
+ * @id: Id in use, or 0 for none
+ *
+ * The name is freed and the id reused once no reference is left.
+ */
+void intern_release(struct intern *intern, uint32_t id)
+{
+    if ((intern == NULL) || (id == 0)) {
+        return;
+    }
+
+    struct intern_entry *entry = &intern->entries[id - 1];
+
+    if (--entry->refs != 0) {
+        return;
+    }
+
+    intern_unhash(intern, id);
+    free(entry->name);
+    entry->name = NULL;
+    entry->refs = intern->free;
+    intern->free = id;
+    intern->used--;
+}
+
+/**
+ * intern_rename() - Give an id a new name, e.g. after a NICK
+ * @intern: Name table
+ * @id: Id in use
+ * @name: New name bytes, need not be NUL-terminated
+ * @len: Length of @name
+ *
+ * Everything holding the id sees the new name at once. Should another
+ * id already carry the new name, which only happens if a message was
+ * missed, lookups find one of the two.
+ *
+ * Return: 0 on success, -1 on allocation failure or an empty name
+ */
+int intern_rename(struct intern *intern, uint32_t id,
+        const char *name, int len)
+{
+    if ((intern == NULL) || (id == 0) || (len <= 0)) {
+        return -1;
+    }
+
+    char *copy = malloc((size_t)len + 1);
+
+    if (copy == NULL) {
+        return -1;
+    }
+
+    memcpy(copy, name, (size_t)len);
+    copy[len] = '\0';
+
+    struct intern_entry *entry = &intern->entries[id - 1];
+
+    intern_unhash(intern, id);
+    free(entry->name);
+    entry->name = copy;
+    entry->hash = intern_hash(intern, name, len);
+
+    uint32_t i = entry->hash & intern->mask;
+
+    while (intern->slots[i] != 0) {
+        i = (i + 1) & intern->mask;
+    }
+
+    intern->slots[i] = id;
+
+    return 0;
+}
+
+/**
+ * intern_name() - Name of an id
+ * @intern: Name table
+ * @id: Id in use
+ *
+ * Return: Name as last seen, valid until the id is renamed or released
+ */
+const char *intern_name(const struct intern *intern, uint32_t id)
+{
+    if ((intern == NULL) || (id == 0) || (id > intern->count)) {
+        return "";
+    }
+
+    const char *name = intern->entries[id - 1].name;
+
+    return (name != NULL) ? name : "";
+}
+
+/**
+ * intern_casemap() - Switch to the CASEMAPPING of the server
+ * @intern: Name table
+ * @casemapping: Case mapping from RPL_ISUPPORT
+ *
+ * Names already in the table are rehashed under the new mapping.
+ */
+void intern_casemap(struct intern *intern,
+        enum isupport_casemapping casemapping)
+{
+    casemap_init(&intern->casemap, casemapping);
+
+    if (intern->slots != NULL) {
+        intern_rehash(intern, intern->mask + 1);
+    }
+}
+
+/**
+ * intern_memory() - Bytes held by a name table
+ * @intern: Name table
+ *
+ * Return: Approximate heap use, not counting allocator overhead
+ */
+size_t intern_memory(const struct intern *intern)
+{
+    size_t bytes = intern->size * sizeof(*intern->entries) +
+        (intern->mask + 1) * sizeof(*intern->slots);
+
+    for (uint32_t id = 1; id <= intern->count; ++id) {
+        if (intern->entries[id - 1].name != NULL) {
+            bytes += strlen(intern->entries[id - 1].name) + 1;
+        }
+    }
+
+    return bytes;
+}
+
+/**
+ * intern_init() - Initialize an empty name table
+ * @intern: Name table to initialize
+ *
+ * The table starts out with the rfc1459 case mapping, the default
+ * until the server says otherwise.
+ *
+ * Return: 0 on success, -1 if intern is NULL or allocation fails
+ */
+int intern_init(struct intern *intern)
+{
+    if (intern == NULL) {
+        return -1;
+    }
+
+    memset(intern, 0, sizeof(*intern));
+    intern_casemap(intern, CASEMAPPING_RFC1459);
+    intern->size = 64;
+    intern->mask = 127;
+
+    intern->entries = malloc(intern->size * sizeof(*intern->entries));
+    intern->slots = calloc(intern->mask + 1, sizeof(*intern->slots));
+
+    if ((intern->entries == NULL) || (intern->slots == NULL)) {
+        intern_free(intern);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * intern_free() - Release every name
+ * @intern: Name table to clean up
+ *
+ * Return: 0 on success, -1 if intern is NULL
+ */
+int intern_free(struct intern *intern)
+{
+    if (intern == NULL) {
+        return -1;
+    }
+
+    for (uint32_t id = 1; (intern->entries != NULL) &&
+        (id <= intern->count); ++id) {
+        free(intern->entries[id - 1].name);
+    }
+
+    free(intern->entries);
+    free(intern->slots);
+    intern->entries = NULL;
+    intern->slots = NULL;
+    intern->count = 0;
+    intern->used = 0;
+
+    return 0;
+}
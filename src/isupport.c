@@ -0,0 +1,365 @@
+/*
+ * isupport.c
+ * RPL_ISUPPORT (005) server feature parsing
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "isupport.h"
+
+static const char *isupport_targets[ISUPPORT_TARGET_COUNT] = {
+    "JOIN", "PART", "PRIVMSG", "NOTICE", "KICK", "NAMES", "WHOIS"
+};
+
+/**
+ * isupport_number() - Parse a decimal token value
+ * @ptr: Token value
+ * @len: Length of the value
+ *
+ * Return: Value, or -1 if empty, not a number or above 99999
+ */
+static int isupport_number(const char *ptr, int len)
+{
+    int value = 0;
+
+    if (len <= 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < len; ++i) {
+        if ((ptr[i] < '0') || (ptr[i] > '9') || (value > 9999)) {
+            return -1;
+        }
+
+        value = value * 10 + (ptr[i] - '0');
+    }
+
+    return value;
+}
+
+/**
+ * isupport_targmax() - Apply a TARGMAX token value
+ * @isupport: Server feature structure to update
+ * @ptr: Token value, e.g. "PRIVMSG:4,NOTICE:4,JOIN:"
+ * @len: Length of the value
+ *
+ * Scans the comma-separated command:limit pairs for the commands kirc
+ * sends. An empty limit means the server accepts any number of targets,
+ * and so do commands the token does not mention.
+ */
+static void isupport_targmax(struct isupport *isupport,
+        const char *ptr, int len)
+{
+    const char *end = ptr + len;
+
+    memset(isupport->targmax, 0, sizeof(isupport->targmax));
+
+    while (ptr < end) {
+        const char *comma = memchr(ptr, ',', (size_t)(end - ptr));
+
+        if (comma == NULL) {
+            comma = end;
+        }
+
+        const char *colon = memchr(ptr, ':', (size_t)(comma - ptr));
+
+        if (colon != NULL) {
+            struct event_view command = { ptr, (int)(colon - ptr) };
+            int limit = (colon + 1 == comma) ? 0 :
+                isupport_number(colon + 1, (int)(comma - colon - 1));
+
+            for (int t = 0; (t < ISUPPORT_TARGET_COUNT) && (limit >= 0);
+                ++t) {
+                if (event_view_equals(&command, isupport_targets[t])) {
+                    isupport->targmax[t] = limit;
+                }
+            }
+        }
+
+        ptr = comma + 1;
+    }
+}
+
+/**
+ * isupport_chantypes() - Apply a CHANTYPES token value
+ * @isupport: Server feature structure to update
+ * @ptr: Token value, e.g. "#&"; empty if the server has no channels
+ * @len: Length of the value
+ */
+static void isupport_chantypes(struct isupport *isupport,
+        const char *ptr, int len)
+{
+    memset(isupport->chantypes, 0, sizeof(isupport->chantypes));
+
+    for (int i = 0; i < len; ++i) {
+        isupport->chantypes[(unsigned char)ptr[i]] = 1;
+    }
+}
+
+/**
+ * isupport_prefix_parse() - Apply a PREFIX token value
+ * @isupport: Server feature structure to update
+ * @ptr: Token value, e.g. "(qaohv)~&@%+"
+ * @len: Length of the value
+ *
+ * A malformed value, or one with more than KIRC_PREFIX_MAX modes, is
+ * ignored and the previous prefixes are kept.
+ */
+static void isupport_prefix_parse(struct isupport *isupport,
+        const char *ptr, int len)
+{
+    const char *close = memchr(ptr, ')', (size_t)len);
+
+    if ((len < 2) || (ptr[0] != '(') || (close == NULL)) {
+        return;
+    }
+
+    int count = (int)(close - ptr - 1);
+
+    if ((count > KIRC_PREFIX_MAX) || (len - count - 2 != count)) {
+        return;
+    }
+
+    memcpy(isupport->prefix_modes, ptr + 1, (size_t)count);
+    memcpy(isupport->prefix_symbols, close + 1, (size_t)count);
+    isupport->prefix_modes[count] = '\0';
+    isupport->prefix_symbols[count] = '\0';
+}
+
+/**
+ * isupport_casemapping_parse() - Apply a CASEMAPPING token value
+ * @isupport: Server feature structure to update
+ * @ptr: Token value, e.g. "rfc1459"
+ * @len: Length of the value
+ *
+ * "rfc7613" folds ASCII the same way as "ascii" and is treated as such;
+ * unknown mappings fall back to the rfc1459 default.
+ */
+static void isupport_casemapping_parse(struct isupport *isupport,
+        const char *ptr, int len)
+{
+    if (((len == 5) && (memcmp(ptr, "ascii", 5) == 0)) ||
+        ((len == 7) && (memcmp(ptr, "rfc7613", 7) == 0))) {
+        isupport->casemapping = CASEMAPPING_ASCII;
+    } else if ((len == 14) && (memcmp(ptr, "strict-rfc1459", 14) == 0)) {
+        isupport->casemapping = CASEMAPPING_STRICT_RFC1459;
+    } else {
+        isupport->casemapping = CASEMAPPING_RFC1459;
+    }
+}
+
+/**
+ * isupport_is_channel() - Whether a target is a channel
+ * @isupport: Server features
+ * @name: Channel or nickname, need not be NUL-terminated
+ * @len: Length of @name
+ *
+ * Looks the first byte up in CHANTYPES, so "#kirc" is a channel on
+ * every server, "&local" only where the server says so.
+ *
+ * Return: 1 if @name is a channel name, 0 otherwise
+ */
+int isupport_is_channel(const struct isupport *isupport,
+        const char *name, int len)
+{
+    return (len > 0) && (isupport->chantypes[(unsigned char)name[0]] != 0);
+}
+
+/**
+ * isupport_prefix() - Rank of a channel membership prefix
+ * @isupport: Server features
+ * @c: Prefix symbol (e.g. '@') or mode letter (e.g. 'o')
+ *
+ * Return: Index in PREFIX, 0 being the highest rank, or -1 if @c is
+ * neither a prefix symbol nor a prefix mode
+ */
+int isupport_prefix(const struct isupport *isupport, char c)
+{
+    const char *p;
+
+    if (c == '\0') {
+        return -1;
+    }
+
+    if ((p = strchr(isupport->prefix_symbols, c)) != NULL) {
+        return (int)(p - isupport->prefix_symbols);
+    }
+
+    if ((p = strchr(isupport->prefix_modes, c)) != NULL) {
+        return (int)(p - isupport->prefix_modes);
+    }
+
+    return -1;
+}
+
+/**
+ * isupport_mode_arg() - Whether a channel mode change takes an argument
+ * @isupport: Server features
+ * @mode: Mode letter
+ * @adding: Whether the mode is being set rather than unset
+ *
+ * Prefix modes and CHANMODES types A and B always take an argument,
+ * type C only when set, and type D never. Unknown modes are assumed to
+ * take none.
+ *
+ * Return: 1 if an argument follows, 0 otherwise
+ */
+int isupport_mode_arg(const struct isupport *isupport, char mode,
+        int adding)
+{
+    if (strchr(isupport->prefix_modes, mode) != NULL) {
+        return 1;
+    }
+
+    int type = 0;  /* index of the comma-separated list */
+
+    for (const char *p = isupport->chanmodes; *p != '\0'; ++p) {
+        if (*p == ',') {
+            type++;
+        } else if (*p == mode) {
+            return (type < 2) || ((type == 2) && adding);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * isupport_reset() - Restore the default of a negated token
+ * @isupport: Server feature structure to update
+ * @name: Token name without the leading '-'
+ */
+static void isupport_reset(struct isupport *isupport,
+        const struct event_view *name)
+{
+    struct isupport defaults;
+
+    isupport_init(&defaults);
+
+    if (event_view_equals(name, "CASEMAPPING")) {
+        isupport->casemapping = defaults.casemapping;
+    } else if (event_view_equals(name, "NICKLEN")) {
+        isupport->nicklen = defaults.nicklen;
+    } else if (event_view_equals(name, "CHANNELLEN")) {
+        isupport->channellen = defaults.channellen;
+    } else if (event_view_equals(name, "LINELEN")) {
+        isupport->linelen = defaults.linelen;
+    } else if (event_view_equals(name, "TARGMAX")) {
+        memcpy(isupport->targmax, defaults.targmax, sizeof(defaults.targmax));
+    } else if (event_view_equals(name, "CHANTYPES")) {
+        memcpy(isupport->chantypes, defaults.chantypes,
+            sizeof(defaults.chantypes));
+    } else if (event_view_equals(name, "PREFIX")) {
+        memcpy(isupport->prefix_modes, defaults.prefix_modes,
+            sizeof(defaults.prefix_modes));
+        memcpy(isupport->prefix_symbols, defaults.prefix_symbols,
+            sizeof(defaults.prefix_symbols));
+    } else if (event_view_equals(name, "CHANMODES")) {
+        memcpy(isupport->chanmodes, defaults.chanmodes,
+            sizeof(defaults.chanmodes));
+    }
+}
+
+/**
+ * isupport_set() - Apply one NAME=VALUE token
+ * @isupport: Server feature structure to update
+ * @name: Token name
+ * @ptr: Token value, empty if the token has none
+ * @len: Length of the value
+ *
+ * Malformed numbers are ignored and the previous value is kept.
+ */
+static void isupport_set(struct isupport *isupport,
+        const struct event_view *name, const char *ptr, int len)
+{
+    int number = isupport_number(ptr, len);
+
+    if (event_view_equals(name, "CASEMAPPING")) {
+        isupport_casemapping_parse(isupport, ptr, len);
+    } else if (event_view_equals(name, "NICKLEN") && (number > 0)) {
+        isupport->nicklen = number;
+    } else if (event_view_equals(name, "CHANNELLEN") && (number > 0)) {
+        isupport->channellen = number;
+    } else if (event_view_equals(name, "LINELEN") && (number > 0)) {
+        isupport->linelen = number;
+    } else if (event_view_equals(name, "TARGMAX")) {
+        isupport_targmax(isupport, ptr, len);
+    } else if (event_view_equals(name, "CHANTYPES")) {
+        isupport_chantypes(isupport, ptr, len);
+    } else if (event_view_equals(name, "PREFIX")) {
+        isupport_prefix_parse(isupport, ptr, len);
+    } else if (event_view_equals(name, "CHANMODES") &&
+        (len < (int)sizeof(isupport->chanmodes))) {
+        memcpy(isupport->chanmodes, ptr, (size_t)len);
+        isupport->chanmodes[len] = '\0';
+    }
+}
+
+/**
+ * isupport_parse() - Record the features advertised in RPL_ISUPPORT
+ * @isupport: Server feature structure to update
+ * @event: Parsed 005 event
+ *
+ * Walks the NAME[=VALUE] tokens between the nickname and the trailing
+ * "are supported by this server" text. Tokens negated with a leading
+ * '-' restore the default. Unknown tokens are ignored.
+ *
+ * Return: 0 on success, -1 if a parameter is NULL
+ */
+int isupport_parse(struct isupport *isupport, struct event *event)
+{
+    if ((isupport == NULL) || (event == NULL)) {
+        return -1;
+    }
+
+    for (int i = 1; i < event->param_count; ++i) {
+        const char *ptr = event->params[i].ptr;
+        int len = event->params[i].len;
+        const char *eq = memchr(ptr, '=', (size_t)len);
+        struct event_view name = { ptr, (eq != NULL) ? (int)(eq - ptr) : len };
+
+        if ((len > 1) && (ptr[0] == '-')) {
+            name.ptr++;
+            name.len--;
+            isupport_reset(isupport, &name);
+        } else if (eq != NULL) {
+            isupport_set(isupport, &name, eq + 1, (int)(ptr + len - eq - 1));
+        } else {
+            isupport_set(isupport, &name, ptr + len, 0);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * isupport_init() - Initialize server features to protocol defaults
+ * @isupport: Server feature structure to initialize
+ *
+ * Called on every new connection, before the server sends RPL_ISUPPORT.
+ * The defaults are those of RFC 1459: "rfc1459" case mapping, nicknames
+ * of 9 and channel names of 200 bytes, 512-byte lines, "#&" channels
+ * and "(ov)@+" prefixes.
+ *
+ * Return: 0 on success, -1 if isupport is NULL
+ */
+int isupport_init(struct isupport *isupport)
+{
+    if (isupport == NULL) {
+        return -1;
+    }
+
+    memset(isupport, 0, sizeof(*isupport));
+    isupport->nicklen = 9;
+    isupport->channellen = CHANNEL_MAX_LEN;
+    isupport->linelen = MESSAGE_MAX_LEN;
+    isupport->chantypes['#'] = 1;
+    isupport->chantypes['&'] = 1;
+    safecpy(isupport->prefix_modes, "ov", sizeof(isupport->prefix_modes));
+    safecpy(isupport->prefix_symbols, "@+",
+        sizeof(isupport->prefix_symbols));
+    safecpy(isupport->chanmodes, "beI,k,l,imnpst",
+        sizeof(isupport->chanmodes));
+
+    return 0;
+}
@@ -0,0 +1,417 @@
+/*
+ * loop.c
+ * Event loop with poll and epoll backends
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "loop.h"
+
+#if defined(__linux__) && !defined(KIRC_LOOP_POLL)
+#define LOOP_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
+/*
+ * Descriptors are registered once and stay registered until removed;
+ * only changes of interest cost a call into the kernel. The slot table
+ * remembers which owner registered each fd, so an owner that drops an
+ * fd after it was closed and reused by someone else does not tear down
+ * the new registration.
+ */
+
+/**
+ * loop_slot() - Find or create the slot of a descriptor
+ * @loop: Event loop
+ * @fd: File descriptor
+ *
+ * Return: Slot for @fd, or NULL if the table cannot grow
+ */
+static struct loop_slot *loop_slot(struct loop *loop, int fd)
+{
+    if (fd < loop->nslots) {
+        return &loop->slots[fd];
+    }
+
+    int nslots = (loop->nslots > 0) ? loop->nslots : 64;
+
+    while (nslots <= fd) {
+        nslots *= 2;
+    }
+
+    struct loop_slot *slots = realloc(loop->slots,
+        (size_t)nslots * sizeof(*slots));
+
+    if (slots == NULL) {
+        return NULL;
+    }
+
+    for (int i = loop->nslots; i < nslots; ++i) {
+        slots[i].data = NULL;
+        slots[i].id = 0;
+        slots[i].events = 0;
+        slots[i].index = -1;
+    }
+
+    loop->slots = slots;
+    loop->nslots = nslots;
+
+    return &loop->slots[fd];
+}
+
+#if defined(LOOP_EPOLL)
+
+/**
+ * loop_epoll_events() - Translate poll() event bits for epoll
+ * @events: POLLIN and/or POLLOUT
+ *
+ * Return: Equivalent epoll event mask
+ */
+static uint32_t loop_epoll_events(short events)
+{
+    uint32_t mask = 0;
+
+    if (events & POLLIN) {
+        mask |= EPOLLIN;
+    }
+
+    if (events & POLLOUT) {
+        mask |= EPOLLOUT;
+    }
+
+    return mask;
+}
+
+/**
+ * loop_epoll_ctl() - Register or update a descriptor with epoll
+ * @loop: Event loop
+ * @fd: File descriptor
+ * @events: poll() event bits
+ * @op: EPOLL_CTL_ADD or EPOLL_CTL_MOD
+ *
+ * The kernel drops a descriptor from the interest list when it is
+ * closed, so an fd we believe registered may be gone, and one we
+ * believe new may have been registered under the same number before.
+ * Either way the other operation is tried.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int loop_epoll_ctl(struct loop *loop, int fd, short events, int op)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = loop_epoll_events(events);
+    ev.data.fd = fd;
+
+    if (epoll_ctl(loop->backend_fd, op, fd, &ev) == 0) {
+        return 0;
+    }
+
+    if ((op == EPOLL_CTL_ADD) && (errno == EEXIST)) {
+        op = EPOLL_CTL_MOD;
+    } else if ((op == EPOLL_CTL_MOD) && (errno == ENOENT)) {
+        op = EPOLL_CTL_ADD;
+    } else {
+        return -1;
+    }
+
+    return epoll_ctl(loop->backend_fd, op, fd, &ev);
+}
+
+#endif
+
+/**
+ * loop_add() - Register a descriptor
+ * @loop: Event loop
+ * @fd: File descriptor
+ * @events: poll() event bits to wait for
+ * @data: Owner, returned with every event; must not be NULL
+ * @id: Owner-defined number, returned with every event
+ *
+ * Registering an fd that is already known replaces its owner and
+ * interest.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int loop_add(struct loop *loop, int fd, short events, void *data, int id)
+{
+    if ((loop == NULL) || (fd < 0) || (data == NULL)) {
+        return -1;
+    }
+
+    struct loop_slot *slot = loop_slot(loop, fd);
+
+    if (slot == NULL) {
+        return -1;
+    }
+
+#if defined(LOOP_EPOLL)
+    if (loop_epoll_ctl(loop, fd, events, EPOLL_CTL_ADD) < 0) {
+        return -1;
+    }
+#else
+    if (slot->index < 0) {
+        struct pollfd *pfds = realloc(loop->pfds,
+            (size_t)(loop->npfds + 1) * sizeof(*pfds));
+
+        if (pfds == NULL) {
+            return -1;
+        }
+
+        loop->pfds = pfds;
+        slot->index = loop->npfds++;
+    }
+
+    loop->pfds[slot->index].fd = fd;
+    loop->pfds[slot->index].events = events;
+    loop->pfds[slot->index].revents = 0;
+#endif
+
+    slot->data = data;
+    slot->id = id;
+    slot->events = events;
+
+    return 0;
+}
+
+/**
+ * loop_modify() - Change the events a descriptor waits for
+ * @loop: Event loop
+ * @fd: Registered file descriptor
+ * @events: New poll() event bits
+ * @data: Owner the fd was registered with
+ *
+ * Nothing is done if the interest did not change.
+ *
+ * Return: 0 on success, -1 if @fd is not registered by @data or on error
+ */
+int loop_modify(struct loop *loop, int fd, short events, void *data)
+{
+    if ((loop == NULL) || (fd < 0) || (fd >= loop->nslots)) {
+        return -1;
+    }
+
+    struct loop_slot *slot = &loop->slots[fd];
+
+    if ((slot->data == NULL) || (slot->data != data)) {
+        return -1;
+    }
+
+    if (slot->events == events) {
+        return 0;
+    }
+
+#if defined(LOOP_EPOLL)
+    if (loop_epoll_ctl(loop, fd, events, EPOLL_CTL_MOD) < 0) {
+        return -1;
+    }
+#else
+    loop->pfds[slot->index].events = events;
+#endif
+
+    slot->events = events;
+
+    return 0;
+}
+
+/**
+ * loop_remove() - Unregister a descriptor
+ * @loop: Event loop
+ * @fd: File descriptor, which may already be closed
+ * @data: Owner the fd was registered with
+ *
+ * Does nothing if @fd is not registered, or was registered again by a
+ * different owner since.
+ *
+ * Return: 0 on success, -1 if @fd is not registered by @data
+ */
+int loop_remove(struct loop *loop, int fd, void *data)
+{
+    if ((loop == NULL) || (fd < 0) || (fd >= loop->nslots)) {
+        return -1;
+    }
+
+    struct loop_slot *slot = &loop->slots[fd];
+
+    if ((slot->data == NULL) || (slot->data != data)) {
+        return -1;
+    }
+
+#if defined(LOOP_EPOLL)
+    /* fails harmlessly if the fd was closed, which unregisters it */
+    epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    int last = --loop->npfds;
+
+    if (slot->index != last) {
+        loop->pfds[slot->index] = loop->pfds[last];
+        loop->slots[loop->pfds[last].fd].index = slot->index;
+    }
+#endif
+
+    slot->data = NULL;
+    slot->id = 0;
+    slot->events = 0;
+    slot->index = -1;
+
+    return 0;
+}
+
+/**
+ * loop_wait() - Wait for registered descriptors to become ready
+ * @loop: Event loop
+ * @timeout: Maximum wait in milliseconds, or -1 to wait indefinitely
+ *
+ * Collects up to KIRC_LOOP_EVENTS ready descriptors into loop->ready.
+ * Readiness is level-triggered, so anything beyond that is reported
+ * again by the next call.
+ *
+ * Return: Number of ready events, 0 on timeout, -1 on error (errno set)
+ */
+int loop_wait(struct loop *loop, int timeout)
+{
+    loop->nready = 0;
+
+#if defined(LOOP_EPOLL)
+    struct epoll_event evs[KIRC_LOOP_EVENTS];
+    int rc = epoll_wait(loop->backend_fd, evs, KIRC_LOOP_EVENTS, timeout);
+
+    if (rc < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < rc; ++i) {
+        int fd = evs[i].data.fd;
+
+        if ((fd >= loop->nslots) || (loop->slots[fd].data == NULL)) {
+            continue;
+        }
+
+        struct loop_event *event = &loop->ready[loop->nready++];
+        short revents = 0;
+
+        if (evs[i].events & EPOLLIN) {
+            revents |= POLLIN;
+        }
+
+        if (evs[i].events & EPOLLOUT) {
+            revents |= POLLOUT;
+        }
+
+        if (evs[i].events & EPOLLERR) {
+            revents |= POLLERR;
+        }
+
+        if (evs[i].events & EPOLLHUP) {
+            revents |= POLLHUP;
+        }
+
+        event->fd = fd;
+        event->revents = revents;
+        event->data = loop->slots[fd].data;
+        event->id = loop->slots[fd].id;
+    }
+#else
+    int rc = poll(loop->pfds, (nfds_t)loop->npfds, timeout);
+
+    if (rc < 0) {
+        return -1;
+    }
+
+    for (int i = 0; (i < loop->npfds) && (rc > 0) &&
+        (loop->nready < KIRC_LOOP_EVENTS); ++i) {
+        struct pollfd *pfd = &loop->pfds[i];
+
+        if (pfd->revents == 0) {
+            continue;
+        }
+
+        struct loop_event *event = &loop->ready[loop->nready++];
+
+        event->fd = pfd->fd;
+        event->revents = pfd->revents;
+        event->data = loop->slots[pfd->fd].data;
+        event->id = loop->slots[pfd->fd].id;
+        rc--;
+    }
+#endif
+
+    return loop->nready;
+}
+
+/**
+ * loop_backend() - Name of the compiled-in backend
+ * @loop: Event loop
+ *
+ * Return: "epoll" or "poll"
+ */
+const char *loop_backend(struct loop *loop)
+{
+    (void)loop;
+
+#if defined(LOOP_EPOLL)
+    return "epoll";
+#else
+    return "poll";
+#endif
+}
+
+/**
+ * loop_init() - Initialize an event loop
+ * @loop: Event loop structure to initialize
+ *
+ * Uses epoll on Linux unless built with KIRC_LOOP_POLL, and poll()
+ * everywhere else.
+ *
+ * Return: 0 on success, -1 if loop is NULL or the backend fails
+ */
+int loop_init(struct loop *loop)
+{
+    if (loop == NULL) {
+        return -1;
+    }
+
+    memset(loop, 0, sizeof(*loop));
+    loop->backend_fd = -1;
+
+#if defined(LOOP_EPOLL)
+    loop->backend_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (loop->backend_fd < 0) {
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+/**
+ * loop_free() - Release event loop resources
+ * @loop: Event loop structure to clean up
+ *
+ * Registered descriptors are not closed; they belong to their owners.
+ *
+ * Return: 0 on success, -1 if loop is NULL
+ */
+int loop_free(struct loop *loop)
+{
+    if (loop == NULL) {
+        return -1;
+    }
+
+    if (loop->backend_fd >= 0) {
+        close(loop->backend_fd);
+        loop->backend_fd = -1;
+    }
+
+    free(loop->slots);
+    loop->slots = NULL;
+    loop->nslots = 0;
+
+    free(loop->pfds);
+    loop->pfds = NULL;
+    loop->npfds = 0;
+
+    return 0;
+}
@@ -12,11 +12,14 @@
 #include "event.h"
 #include "handler.h"
 #include "helper.h"
+#include "loop.h"
 #include "network.h"
 #include "output.h"
 #include "protocol.h"
+#include "scrollback.h"
+#include "server.h"
 #include "terminal.h"
-#include "transport.h"
+#include "timer.h"
 
 /**
  * kirc_register_handlers() - Register all IRC event handlers
@@ -35,23 +38,24 @@ static void kirc_register_handlers(struct handler *handler) {
     handler_register(handler, EVENT_CTCP_ACTION, protocol_ctcp_action);
     handler_register(handler, EVENT_CTCP_DCC, protocol_ctcp_info);
     handler_register(handler, EVENT_ERROR, protocol_error);
-    handler_register(handler, EVENT_EXT_CAP, protocol_info);
+    handler_register(handler, EVENT_EXT_CAP, protocol_cap);
     handler_register(handler, EVENT_EXT_AUTHENTICATE, protocol_authenticate);
     handler_register(handler, EVENT_JOIN, protocol_join);
-    handler_register(handler, EVENT_KICK, protocol_info);
-    handler_register(handler, EVENT_MODE, protocol_info);
+    handler_register(handler, EVENT_KICK, protocol_kick);
+    handler_register(handler, EVENT_MODE, protocol_mode);
     handler_register(handler, EVENT_NICK, protocol_nick);
     handler_register(handler, EVENT_NOTICE, protocol_notice);
     handler_register(handler, EVENT_PART, protocol_part);
     handler_register(handler, EVENT_PING, protocol_ping);
+    handler_register(handler, EVENT_PONG, protocol_pong);
     handler_register(handler, EVENT_PRIVMSG, protocol_privmsg);
-    handler_register(handler, EVENT_QUIT, protocol_noop);
+    handler_register(handler, EVENT_QUIT, protocol_quit);
     handler_register(handler, EVENT_TOPIC, protocol_info);
-    handler_register(handler, EVENT_001_RPL_WELCOME, protocol_welcome);
+    handler_register(handler, EVENT_001_RPL_WELCOME, protocol_info);
     handler_register(handler, EVENT_002_RPL_YOURHOST, protocol_info);
     handler_register(handler, EVENT_003_RPL_CREATED, protocol_info);
     handler_register(handler, EVENT_004_RPL_MYINFO, protocol_info);
-    handler_register(handler, EVENT_005_RPL_BOUNCE, protocol_info);
+    handler_register(handler, EVENT_005_RPL_BOUNCE, protocol_isupport);
     handler_register(handler, EVENT_042_RPL_YOURID, protocol_info);
     handler_register(handler, EVENT_200_RPL_TRACELINK, protocol_info);
     handler_register(handler, EVENT_201_RPL_TRACECONNECTING, protocol_info);
@@ -120,7 +124,7 @@ static void kirc_register_handlers(struct handler *handler) {
     handler_register(handler, EVENT_349_RPL_ENDOFEXCEPTLIST, protocol_info);
     handler_register(handler, EVENT_351_RPL_VERSION, protocol_info);
     handler_register(handler, EVENT_352_RPL_WHOREPLY, protocol_info);
-    handler_register(handler, EVENT_353_RPL_NAMREPLY, protocol_info);
+    handler_register(handler, EVENT_353_RPL_NAMREPLY, protocol_names);
     handler_register(handler, EVENT_364_RPL_LINKS, protocol_info);
     handler_register(handler, EVENT_365_RPL_ENDOFLINKS, protocol_info);
     handler_register(handler, EVENT_366_RPL_ENDOFNAMES, protocol_info);
@@ -131,7 +135,7 @@ static void kirc_register_handlers(struct handler *handler) {
     handler_register(handler, EVENT_372_RPL_MOTD, protocol_info);
     handler_register(handler, EVENT_374_RPL_ENDOFINFO, protocol_info);
     handler_register(handler, EVENT_375_RPL_MOTDSTART, protocol_info);
-    handler_register(handler, EVENT_376_RPL_ENDOFMOTD, protocol_info);
+    handler_register(handler, EVENT_376_RPL_ENDOFMOTD, protocol_welcome);
     handler_register(handler, EVENT_381_RPL_YOUREOPER, protocol_info);
     handler_register(handler, EVENT_382_RPL_REHASHING, protocol_info);
     handler_register(handler, EVENT_383_RPL_YOURESERVICE, protocol_info);
@@ -140,7 +144,7 @@ static void kirc_register_handlers(struct handler *handler) {
     handler_register(handler, EVENT_393_RPL_USERS, protocol_info);
     handler_register(handler, EVENT_394_RPL_ENDOFUSERS, protocol_info);
     handler_register(handler, EVENT_395_RPL_NOUSERS, protocol_info);
-    handler_register(handler, EVENT_396_RPL_HOSTHIDDEN, protocol_info);
+    handler_register(handler, EVENT_396_RPL_HOSTHIDDEN, protocol_hosthidden);
     handler_register(handler, EVENT_400_ERR_UNKNOWNERROR, protocol_error);
     handler_register(handler, EVENT_401_ERR_NOSUCHNICK, protocol_error);
     handler_register(handler, EVENT_402_ERR_NOSUCHSERVER, protocol_error);
@@ -157,7 +161,7 @@ static void kirc_register_handlers(struct handler *handler) {
     handler_register(handler, EVENT_414_ERR_WILDTOPLEVEL, protocol_error);
     handler_register(handler, EVENT_415_ERR_BADMASK, protocol_error);
     handler_register(handler, EVENT_421_ERR_UNKNOWNCOMMAND, protocol_error);
-    handler_register(handler, EVENT_422_ERR_NOMOTD, protocol_error);
+    handler_register(handler, EVENT_422_ERR_NOMOTD, protocol_welcome);
     handler_register(handler, EVENT_423_ERR_NOADMININFO, protocol_error);
     handler_register(handler, EVENT_424_ERR_FILEERROR, protocol_error);
     handler_register(handler, EVENT_431_ERR_NONICKNAMEGIVEN, protocol_error);
@@ -208,112 +212,250 @@ static void kirc_register_handlers(struct handler *handler) {
     handler_register(handler, EVENT_908_RPL_SASLMECHS, protocol_info);
 }
 
+/**
+ * kirc_servers_free() - Release every server connection and the loop
+ * @servers: Array of servers
+ * @count: Number of initialized entries in @servers
+ * @loop: Event loop the servers are registered with
+ */
+static void kirc_servers_free(struct server *servers, int count,
+        struct loop *loop)
+{
+    for (int i = 0; i < count; ++i) {
+        server_free(&servers[i], loop);
+    }
+
+    free(servers);
+    loop_free(loop);
+}
+
+/**
+ * kirc_label() - Name used to mark a server's output
+ * @server: Server connection
+ * @count: Number of configured servers
+ *
+ * Return: The server hostname, or NULL when there is only one server
+ */
+static const char *kirc_label(struct server *server, int count)
+{
+    return (count > 1) ? server->ctx->server : NULL;
+}
+
+/**
+ * kirc_server_command() - Handle the /server command
+ * @servers: Array of servers
+ * @count: Number of entries in @servers
+ * @active: Index of the server user input is sent to
+ * @editor: Editor whose prompt follows the active server
+ * @msg: User input line
+ * @output: Output buffer for display
+ *
+ * Without an argument, lists the configured servers and their state.
+ * With a hostname or 1-based position, makes that server the one that
+ * user input and its target belong to.
+ *
+ * Return: 1 if @msg was a /server command, 0 otherwise
+ */
+static int kirc_server_command(struct server *servers, int count,
+        int *active, struct editor *editor, const char *msg,
+        struct output *output)
+{
+    static const char *states[] = {
+        "offline", "waiting", "connecting", "online"
+    };
+
+    if ((strncmp(msg, "/server", 7) != 0) ||
+        ((msg[7] != '\0') && (msg[7] != ' '))) {
+        return 0;
+    }
+
+    const char *name = msg + 7;
+
+    while (*name == ' ') {
+        name++;
+    }
+
+    if (*name == '\0') {
+        for (int i = 0; i < count; ++i) {
+            struct kirc_context *ctx = servers[i].ctx;
+
+            output_append(output, "\r" CLEAR_LINE DIM
+                "server: %c %d %s:%s %s%s%s" RESET "\r\n",
+                (i == *active) ? '*' : ' ', i + 1,
+                ctx->server, ctx->port,
+                states[servers[i].network.state],
+                (ctx->target[0] != '\0') ? ", target " : "",
+                ctx->target);
+        }
+        return 1;
+    }
+
+    int index = server_find(servers, count, name);
+
+    if (index < 0) {
+        output_append(output, "\r" CLEAR_LINE DIM
+            "error: no such server: %s" RESET "\r\n", name);
+        return 1;
+    }
+
+    *active = index;
+    editor->ctx = servers[index].ctx;
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "server: now using %s" RESET "\r\n", servers[index].ctx->server);
+
+    return 1;
+}
+
 /**
  * kirc_run() - Main IRC client event loop
- * @ctx: IRC context structure with connection settings
+ * @ctx: Array of server configurations
+ * @count: Number of entries in @ctx
+ * @scrollback: Scrollback store shared by all servers
  *
- * Initializes all subsystems (editor, transport, network, DCC, handlers,
- * terminal, output), establishes the IRC connection, and runs the main
- * event loop. Polls stdin and network socket for events, processing user
- * input and IRC messages. Handles terminal raw mode and cleanup on exit.
+ * Initializes all subsystems (editor, servers, DCC, handlers, terminal,
+ * output, event loop), starts connecting to every configured server
+ * without waiting for any of them, and runs the main event loop. Stdin,
+ * every server connection and every DCC transfer are registered with
+ * one event loop, so each wakeup costs a single wait; afterwards only
+ * the servers and transfers whose descriptors fired, or servers that
+ * have timed work pending, are serviced. Output from different servers
+ * is marked with the server name when more than one is configured. A
+ * connection that fails, at startup or later, is retried in the
+ * background with exponential backoff while the editor stays usable;
+ * the loop ends once every server has given up. Handles terminal raw
+ * mode and cleanup on exit.
  *
  * Return: 0 on clean exit, -1 on initialization or runtime error
  */
-static int kirc_run(struct kirc_context *ctx)
+static int kirc_run(struct kirc_context *ctx, int count,
+        struct scrollback *scrollback)
 {
+    struct timer_wheel wheel;
+
+    timer_init(&wheel);
+
     struct editor editor;
 
-    if (editor_init(&editor, ctx) < 0) {
+    if (editor_init(&editor, &ctx[0], &wheel) < 0) {
         fprintf(stderr, "editor_init failed\n");
         return -1;
     }
 
-    struct transport transport;
+    struct loop loop;
 
-    if (transport_init(&transport, ctx) < 0) {
-        fprintf(stderr, "transport_init failed\n");
+    if (loop_init(&loop) < 0) {
+        fprintf(stderr, "loop_init failed\n");
         return -1;
     }
 
-    struct network network;
+    struct server *servers = calloc((size_t)count, sizeof(*servers));
+    struct server *work = NULL;
 
-    if (network_init(&network, &transport, ctx) < 0) {
-        fprintf(stderr, "network_init failed\n");
+    if (servers == NULL) {
+        fprintf(stderr, "out of memory\n");
+        loop_free(&loop);
         return -1;
     }
 
+    for (int i = 0; i < count; ++i) {
+        if (server_init(&servers[i], &ctx[i], &wheel, scrollback,
+            &work) < 0) {
+            fprintf(stderr, "server_init failed\n");
+            kirc_servers_free(servers, i, &loop);
+            return -1;
+        }
+    }
+
     struct dcc dcc;
 
-    if (dcc_init(&dcc, ctx) < 0) {
+    if (dcc_init(&dcc, &ctx[0], &loop, &wheel) < 0) {
         fprintf(stderr, "dcc_init failed\n");
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
     struct handler handler;
 
-    if (handler_init(&handler, ctx) < 0) {
+    if (handler_init(&handler, &ctx[0]) < 0) {
         fprintf(stderr, "handler_init failed\n");
         dcc_free(&dcc);
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
     kirc_register_handlers(&handler);
 
-    if (network_connect(&network) < 0) {
-        fprintf(stderr, "network_connect failed\n");
+    struct output output;
+
+    if (output_init(&output, &ctx[0]) < 0) {
+        fprintf(stderr, "output_init failed\n");
         dcc_free(&dcc);
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
-    if (network_send_credentials(&network) < 0) {
-        fprintf(stderr, "network_send_credentials failed\n");
+    int alive = 0;
+
+    for (int i = 0; i < count; ++i) {
+        output_source(&output, kirc_label(&servers[i], count));
+
+        if (network_start(&servers[i].network, &output) == 0) {
+            alive++;
+        }
+
+        server_events(&servers[i], &loop);
+    }
+
+    output_flush(&output);
+
+    if (alive == 0) {
+        fprintf(stderr, "network_start failed\n");
         dcc_free(&dcc);
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
-    size_t siz = sizeof(ctx->target);
-    safecpy(ctx->target, ctx->channels[0], siz);
+    for (int i = 0; i < count; ++i) {
+        size_t siz = sizeof(ctx[i].target);
+        safecpy(ctx[i].target, ctx[i].channels[0], siz);
+    }
+
+    int active = 0;
 
     struct terminal terminal;
 
-    if (terminal_init(&terminal, ctx) < 0) {
+    if (terminal_init(&terminal, &ctx[0]) < 0) {
         fprintf(stderr, "terminal_init failed\n");
         dcc_free(&dcc);
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
-    struct output output;
-
-    if (output_init(&output, ctx) < 0) {
-        fprintf(stderr, "output_init failed\n");
+    if (terminal_enable_raw(&terminal) < 0) {
+        fprintf(stderr, "terminal_enable_raw failed\n");
+        terminal_disable_raw(&terminal);
         dcc_free(&dcc);
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
-    if (terminal_enable_raw(&terminal) < 0) {
-        fprintf(stderr, "terminal_enable_raw failed\n");
+    if (loop_add(&loop, STDIN_FILENO, POLLIN, &editor, 0) < 0) {
         terminal_disable_raw(&terminal);
+        fprintf(stderr, "loop_add failed\n");
         dcc_free(&dcc);
-        network_free(&network);
+        kirc_servers_free(servers, count, &loop);
         return -1;
     }
 
-    struct pollfd fds[2] = {
-        { .fd = STDIN_FILENO, .events = POLLIN },
-        { .fd = network.transport->fd, .events = POLLIN }
-    };
-
     for (;;) {
-        int rc = poll(fds, 2, -1);
+        /* a server queued while being serviced must not wait for I/O */
+        int timeout = (work != NULL) ? 0 : timer_timeout(&wheel);
+        int rc = loop_wait(&loop, timeout);
 
         if (rc == -1) {
             if (errno == EINTR) {
+                editor_handle(&editor);  /* the window may have changed */
                 continue;
             }
 
@@ -323,89 +465,112 @@ static int kirc_run(struct kirc_context *ctx)
             break;
         }
 
-        if (rc == 0) {
-            continue;
+        /* a DCC stall notice may have been printed over the prompt */
+        if (timer_advance(&wheel) > 0) {
+            editor_invalidate(&editor);
         }
 
-        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-            terminal_disable_raw(&terminal);
-            fprintf(stderr, "stdin error or hangup\n");
-            break;
+        short input = 0;
+
+        for (int j = 0; j < rc; ++j) {
+            struct loop_event *event = &loop.ready[j];
+
+            if (event->data == &editor) {
+                input = event->revents;
+            } else if (event->data == &dcc) {
+                dcc_process(&dcc, event->id, event->revents);
+                editor_invalidate(&editor);
+            } else {
+                server_ready(event->data, event->fd, event->revents);
+            }
         }
 
-        if (fds[1].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        if (input & (POLLERR | POLLHUP | POLLNVAL)) {
             terminal_disable_raw(&terminal);
-            fprintf(stderr, "network connection error or closed\n");
+            fprintf(stderr, "stdin error or hangup\n");
             break;
         }
 
-        if (fds[0].revents & POLLIN) {
-            editor_process_key(&editor);
+        int redraw = 0;
+        struct server *next = work;
 
-            if (editor.state == EDITOR_STATE_TERMINATE)
-                break;
+        work = NULL;
 
-            if (editor.state == EDITOR_STATE_SEND) {
-                char *msg = editor_last_entry(&editor);
-                network_command_handler(&network, msg, &output);
-                output_flush(&output);
-            }
+        while (next != NULL) {
+            struct server *server = next;
 
-            editor_handle(&editor);
-        }
+            next = server->next;
+            server->ready = 0;
 
-        if (fds[1].revents & POLLIN) {
-            int recv = network_receive(&network);
+            output_source(&output, kirc_label(server, count));
 
-            if (recv < 0) {
-                terminal_disable_raw(&terminal);
-                fprintf(stderr, "network_receive error\n");
-                break;
+            int serviced = server_process(server, &handler, &dcc, &output);
+
+            if (serviced < 0) {
+                alive--;
             }
 
-            if (recv > 0) {
-                char *msg = network.buffer;
-                size_t remaining = network.len;
+            if (serviced != 0) {
+                redraw = 1;
+            }
+
+            server_events(server, &loop);
+        }
 
-                for (;;) {
-                    char *eol = find_message_end(msg, remaining);
-                    if (!eol) break; /* no complete message found */
+        if (redraw) {
+            output_flush(&output);
+            editor_invalidate(&editor);
+            editor_handle(&editor);
+        }
 
-                    *eol = '\0';
+        if (alive == 0) {
+            break;
+        }
 
-                    struct event event;
-                    event_init(&event, ctx);
-                    event_parse(&event, msg);
+        if (input & POLLIN) {
+            editor_read(&editor);
 
-                    handler_dispatch(&handler, &network, &event, &output);
-                    dcc_handle(&dcc, &network, &event);
+            while ((editor.state != EDITOR_STATE_TERMINATE) &&
+                (editor_process_key(&editor) == 0)) {
+                if (editor.state == EDITOR_STATE_SEND) {
+                    char *msg = editor_last_entry(&editor);
 
-                    msg = eol + 2;
-                    remaining = network.buffer + network.len - msg;
-                }
+                    output_source(&output,
+                        kirc_label(&servers[active], count));
 
-                if (remaining > 0) {
-                    if ((remaining < sizeof(network.buffer)) &&
-                        (msg > network.buffer)) {
-                        memmove(network.buffer, msg, remaining);
+                    if (!kirc_server_command(servers, count, &active,
+                        &editor, msg, &output)) {
+                        network_command_handler(&servers[active].network,
+                            msg, &output);
                     }
-                    network.len = remaining;
-                } else {
-                    network.len = 0;
+                    server_events(&servers[active], &loop);
+                    output_flush(&output);
+                    editor_invalidate(&editor);
+                } else if (editor.state == EDITOR_STATE_PASTE) {
+                    size_t len;
+                    const char *paste = editor_paste(&editor, &len);
+
+                    output_source(&output,
+                        kirc_label(&servers[active], count));
+                    network_send_paste(&servers[active].network,
+                        paste, len, &output);
+                    server_events(&servers[active], &loop);
+                    output_flush(&output);
+                    editor_invalidate(&editor);
                 }
-
-                output_flush(&output);
-                editor_handle(&editor);
             }
-            
-        }
 
-        dcc_process(&dcc);
+            if (editor.state == EDITOR_STATE_TERMINATE)
+                break;
+
+            editor_handle(&editor);
+        }
     }
 
+    loop_remove(&loop, STDIN_FILENO, &editor);
     terminal_disable_raw(&terminal);
     dcc_free(&dcc);
-    network_free(&network);
+    kirc_servers_free(servers, count, &loop);
 
     return 0;
 }
@@ -416,30 +581,45 @@ static int kirc_run(struct kirc_context *ctx)
  * @argv: Argument vector
  *
  * Initializes configuration from environment and command-line arguments,
- * runs the IRC client, and cleans up on exit. Ensures secure cleanup of
- * sensitive data.
+ * one context per configured server, runs the IRC client, and cleans up
+ * on exit. Ensures secure cleanup of sensitive data.
  *
  * Return: EXIT_SUCCESS on normal termination, EXIT_FAILURE on error
  */
 int main(int argc, char *argv[])
 {
-    struct kirc_context ctx;
+    struct kirc_context *ctx = calloc(KIRC_SERVER_LIMIT, sizeof(*ctx));
 
-    if (config_init(&ctx) < 0) {
+    if (ctx == NULL) {
+        fprintf(stderr, "out of memory\n");
         return EXIT_FAILURE;
     }
 
-    if (config_parse_args(&ctx, argc, argv) < 0) {
-        config_free(&ctx);
+    if (config_init(&ctx[0]) < 0) {
+        free(ctx);
         return EXIT_FAILURE;
     }
 
-    if (kirc_run(&ctx) < 0) {
-        config_free(&ctx);
-        return EXIT_FAILURE;
+    int count = config_parse_args(ctx, KIRC_SERVER_LIMIT, argc, argv);
+    int status = EXIT_SUCCESS;
+    struct scrollback scrollback;
+
+    if (scrollback_init(&scrollback, KIRC_SCROLLBACK_MEMORY) < 0) {
+        fprintf(stderr, "scrollback_init failed\n");
+        status = EXIT_FAILURE;
+    } else {
+        if ((count < 0) || (kirc_run(ctx, count, &scrollback) < 0)) {
+            status = EXIT_FAILURE;
+        }
+
+        scrollback_free(&scrollback);
+    }
+
+    for (int i = 0; i < KIRC_SERVER_LIMIT; ++i) {
+        config_free(&ctx[i]);
     }
 
-    config_free(&ctx);
+    free(ctx);
 
-    return EXIT_SUCCESS;
+    return status;
 }
@@ -8,93 +8,949 @@
 #include "network.h"
 
 /**
- * network_send() - Send formatted message to IRC server
+ * network_enqueue() - Append bytes to the outbound queue
+ * @network: Network connection structure
+ * @buf: Bytes to append
+ * @len: Number of bytes
+ *
+ * Copies a complete message into the send ring, wrapping around the end
+ * if necessary. Messages are never split across a full queue: if the
+ * whole message does not fit, nothing is queued.
+ *
+ * Return: 0 on success, -1 if the queue lacks space
+ */
+static int network_enqueue(struct network *network,
+        const char *buf, size_t len)
+{
+    size_t size = sizeof(network->sendq);
+
+    if (len > size - network->sendq_len) {
+        return -1;
+    }
+
+    size_t tail = (network->sendq_head + network->sendq_len) % size;
+    size_t first = size - tail;
+
+    if (first > len) {
+        first = len;
+    }
+
+    memcpy(network->sendq + tail, buf, first);
+    memcpy(network->sendq, buf + first, len - first);
+    network->sendq_len += len;
+
+    return 0;
+}
+
+/**
+ * network_send() - Queue formatted message for the IRC server
  * @network: Network connection structure
  * @fmt: printf-style format string
  * @...: Variable arguments for format string
  *
- * Constructs and sends a formatted message to the IRC server through the
- * transport layer. Messages are limited to MESSAGE_MAX_LEN bytes.
+ * Formats a message (limited to MESSAGE_MAX_LEN bytes) and hands it to
+ * the send scheduler, which picks a priority lane from the command.
+ * Nothing is written here; network_schedule() releases messages to the
+ * outbound queue as the flood control bucket allows.
+ *
+ * Return: 0 on success, -1 if network is NULL, offline, or the message
+ * was dropped
+ */
+int network_send(struct network *network, const char *fmt, ...)
+{
+    if (network == NULL) {
+        return -1;
+    }
+
+    if (network->transport == NULL) {
+        return -1;
+    }
+
+    if (network->state != NETWORK_ONLINE) {
+        return -1;
+    }
+
+    char buf[MESSAGE_MAX_LEN];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    size_t len = strnlen(buf, sizeof(buf));
+
+    return scheduler_push(&network->scheduler, buf, len);
+}
+
+/**
+ * network_schedule() - Move messages from the scheduler to the wire
+ * @network: Network connection structure
+ *
+ * Copies every message the scheduler currently allows into the
+ * outbound queue, highest priority first, stopping early if the queue
+ * is out of space. Called once per main loop iteration before poll().
+ *
+ * Return: poll() timeout in milliseconds until the next message is
+ * due, or -1 if nothing is waiting on the bucket
+ */
+int network_schedule(struct network *network)
+{
+    const char *buf;
+    size_t len;
+
+    while (scheduler_peek(&network->scheduler, &buf, &len) == 0) {
+        if (network_enqueue(network, buf, len) < 0) {
+            break;
+        }
+
+        scheduler_pop(&network->scheduler);
+    }
+
+    return scheduler_timeout(&network->scheduler);
+}
+
+/**
+ * network_flush() - Write queued messages to the IRC server
+ * @network: Network connection structure
+ *
+ * Hands the whole pending queue to the transport in one writev() call,
+ * using two iovecs when the ring wraps. A partial write advances the
+ * queue head so the next flush resumes mid-message. EAGAIN leaves the
+ * queue untouched until the socket reports POLLOUT again.
+ *
+ * Return: Number of bytes still queued, or -1 on a transport error
+ */
+int network_flush(struct network *network)
+{
+    if (network->sendq_len == 0) {
+        return 0;
+    }
+
+    size_t size = sizeof(network->sendq);
+    size_t first = size - network->sendq_head;
+    struct iovec iov[2];
+    int iovcnt = 1;
+
+    if (first >= network->sendq_len) {
+        first = network->sendq_len;
+    } else {
+        iov[1].iov_base = network->sendq;
+        iov[1].iov_len = network->sendq_len - first;
+        iovcnt = 2;
+    }
+
+    iov[0].iov_base = network->sendq + network->sendq_head;
+    iov[0].iov_len = first;
+
+    ssize_t nsent = transport_sendv(network->transport, iov, iovcnt);
+
+    if (nsent < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+            (errno == EINTR)) {
+            return (int)network->sendq_len;
+        }
+        return -1;
+    }
+
+    network->sendq_head = (network->sendq_head + (size_t)nsent) % size;
+    network->sendq_len -= (size_t)nsent;
+
+    if (network->sendq_len == 0) {
+        network->sendq_head = 0;
+    }
+
+    return (int)network->sendq_len;
+}
+
+/**
+ * network_pending() - Check for unsent outbound data
+ * @network: Network connection structure
+ *
+ * Return: Number of bytes waiting in the send queue
+ */
+int network_pending(struct network *network)
+{
+    return (int)network->sendq_len;
+}
+
+/**
+ * network_reserve() - Make room at the end of the receive buffer
+ * @network: Network connection structure
+ *
+ * Lines are parsed in place and consumed by advancing head, so the
+ * buffer only has to be compacted when a partial line sits at the very
+ * end and less than one message of space is left. That copies at most
+ * one partial line per buffer-full of input. If a single line fills the
+ * whole buffer it is grown, up to KIRC_RECEIVE_BUFFER_MAX; past that the
+ * oversized line is discarded.
+ *
+ * Return: Number of free bytes after tail, or -1 on allocation failure
+ */
+static ssize_t network_reserve(struct network *network)
+{
+    if (network->head == network->tail) {
+        network->head = 0;
+        network->tail = 0;
+    }
+
+    size_t avail = network->size - 1 - network->tail;
+
+    if (avail >= MESSAGE_MAX_LEN) {
+        return avail;
+    }
+
+    network->end_count = 0;  /* offsets are rebuilt from head */
+    network->end_next = 0;
+
+    if (network->head > 0) {
+        size_t pending = network->tail - network->head;
+        memmove(network->buffer, network->buffer + network->head, pending);
+        network->head = 0;
+        network->tail = pending;
+    } else if (network->size < KIRC_RECEIVE_BUFFER_MAX) {
+        size_t size = network->size * 2;
+        char *buffer = realloc(network->buffer, size);
+
+        if (buffer == NULL) {
+            return -1;
+        }
+
+        network->buffer = buffer;
+        network->size = size;
+    } else {
+        network->tail = 0;  /* line exceeds every protocol limit */
+    }
+
+    return network->size - 1 - network->tail;
+}
+
+/**
+ * network_receive() - Receive data from IRC server
+ * @network: Network connection structure
+ *
+ * Reads as much available data as fits into the free space at the end
+ * of the receive buffer, typically many messages per call. Handles
+ * non-blocking I/O and partial reads. Complete lines are then taken
+ * out with network_next_message(). Returns immediately if no data is
+ * available.
+ *
+ * Return: Number of bytes received, 0 if would block, -1 on error or disconnect
+ */
+int network_receive(struct network *network)
+{
+    ssize_t avail = network_reserve(network);
+
+    if (avail < 0) {
+        return -1;
+    }
+
+    ssize_t nread = transport_receive(
+        network->transport,
+        network->buffer + network->tail,
+        (size_t)avail);
+
+    if (nread < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    if (nread == 0) {
+        return -1;
+    }
+
+    network->tail += (size_t)nread;
+    network->buffer[network->tail] = '\0';
+
+    return nread;
+}
+
+/**
+ * network_next_message() - Take the next complete line from the buffer
+ * @network: Network connection structure
+ *
+ * Terminates the next complete message in place and advances past it.
+ * Line boundaries are located in batches with find_message_ends(), so
+ * the received data is scanned once rather than once per message. The
+ * returned line stays valid until the next network_receive() call.
+ *
+ * Return: Pointer to the NUL-terminated line, or NULL if none is complete
+ */
+char *network_next_message(struct network *network)
+{
+    if (network->end_next == network->end_count) {
+        size_t base = network->head;
+        size_t count = find_message_ends(network->buffer + base,
+            network->tail - base, network->ends, KIRC_MESSAGE_BATCH);
+
+        for (size_t i = 0; i < count; ++i) {
+            network->ends[i] += base;
+        }
+
+        network->end_count = count;
+        network->end_next = 0;
+
+        if (count == 0) {
+            return NULL;
+        }
+    }
+
+    char *msg = network->buffer + network->head;
+    size_t eol = network->ends[network->end_next++];
+
+    network->buffer[eol] = '\0';
+    network->head = eol + 2;
+
+    return msg;
+}
+
+/**
+ * network_keepalive() - Probe the server with PING, or declare it dead
+ * @timer: The network's keepalive timer
+ * @data: Network connection structure
+ *
+ * Fires KIRC_PING_INTERVAL_MS after the last PONG. Sends a PING whose
+ * token is the send time and waits up to KIRC_PING_TIMEOUT_MS for the
+ * answer; if none comes, the link is marked dead. Either way the wake
+ * timer, if the owner set one, is started so that the PING goes out or
+ * the dead link is torn down without waiting for the socket.
+ */
+static void network_keepalive(struct timer *timer, void *data)
+{
+    struct network *network = data;
+
+    if (network->state != NETWORK_ONLINE) {
+        return;
+    }
+
+    if (network->wake != NULL) {
+        timer_start(network->wheel, network->wake, 0);
+    }
+
+    if (network->ping_pending) {
+        network->dead = 1;
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &network->ping_sent);
+    snprintf(network->ping_token, sizeof(network->ping_token),
+        "kirc%lld.%03ld", (long long)network->ping_sent.tv_sec,
+        network->ping_sent.tv_nsec / 1000000L);
+
+    network->ping_pending = 1;
+    network->pings++;
+    network_send(network, "PING :%s\r\n", network->ping_token);
+
+    timer_start(network->wheel, timer, KIRC_PING_TIMEOUT_MS);
+}
+
+/**
+ * network_online() - Mark the connection usable and start the keepalive
+ * @network: Network connection structure
+ */
+static void network_online(struct network *network)
+{
+    network->state = NETWORK_ONLINE;
+    network->ping_pending = 0;
+    network->dead = 0;
+
+    timer_start(network->wheel, &network->keepalive, KIRC_PING_INTERVAL_MS);
+}
+
+/**
+ * network_is_self() - Whether a nickname is our own
+ * @network: Network connection structure
+ * @nick: Nickname from an event
+ *
+ * Compares interned ids, so the check follows the server's CASEMAPPING
+ * and our renames without a string compare per message.
+ *
+ * Return: 1 if @nick is us, 0 otherwise
+ */
+int network_is_self(struct network *network, const struct event_view *nick)
+{
+    return (network->self != 0) &&
+        (intern_find(&network->names, nick->ptr, nick->len) == network->self);
+}
+
+/**
+ * network_pong() - Match a PONG against the outstanding keepalive PING
+ * @network: Network connection structure
+ * @token: Trailing parameter of the PONG
+ *
+ * On a match, records the round trip as the current lag and schedules
+ * the next PING KIRC_PING_INTERVAL_MS from now.
+ *
+ * Return: 0 if the PONG answered our PING, -1 otherwise
+ */
+int network_pong(struct network *network, const char *token)
+{
+    if (!network->ping_pending || (token == NULL) ||
+        (strcmp(token, network->ping_token) != 0)) {
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long lag = (now.tv_sec - network->ping_sent.tv_sec) * 1000 +
+        (now.tv_nsec - network->ping_sent.tv_nsec) / 1000000L;
+
+    if (lag < 0) {
+        lag = 0;
+    }
+
+    network->ctx->lag = lag;
+
+    if (lag > network->lag_max) {
+        network->lag_max = lag;
+    }
+
+    network->ping_pending = 0;
+    network->pongs++;
+
+    timer_start(network->wheel, &network->keepalive, KIRC_PING_INTERVAL_MS);
+
+    return 0;
+}
+
+/**
+ * network_start() - Begin connecting to the IRC server
+ * @network: Network connection structure
+ * @output: Output buffer for status messages
+ *
+ * Starts resolving the server and leaves the rest of the connection to
+ * network_reconnect_process(), which the main loop drives alongside
+ * every other server and which sends the credentials once connected.
+ * A connection that cannot even be started is retried like one that
+ * failed.
+ *
+ * Return: 0 if connecting or a retry is scheduled, -1 when giving up
+ */
+int network_start(struct network *network, struct output *output)
+{
+    output_append(output, "\r" CLEAR_LINE DIM "%s: connecting to %s:%s"
+        RESET "\r\n", (network->retries > 0) ? "reconnect" : "connect",
+        network->ctx->server, network->ctx->port);
+
+    if (transport_connect_start(network->transport) < 0) {
+        return network_disconnect(network, output);
+    }
+
+    network->state = NETWORK_CONNECTING;
+
+    return 0;
+}
+
+/**
+ * network_connect_report() - Display per-address connection timings
+ * @network: Network connection structure
+ * @output: Output buffer for display
+ *
+ * Lists every address the last connection attempt tried, in the order
+ * they were started, with how long each took and how it ended, followed
+ * by the outcome of the TLS handshake when TLS is enabled.
+ */
+void network_connect_report(struct network *network, struct output *output)
+{
+    struct transport *transport = network->transport;
+
+    if (transport->resolve_status != 0) {
+        output_append(output, "\r" CLEAR_LINE DIM "connect: %s: %s"
+            RESET "\r\n", network->ctx->server,
+            gai_strerror(transport->resolve_status));
+        return;
+    }
+
+    for (int i = 0; i < transport->attempt_count; ++i) {
+        struct transport_attempt *attempt = &transport->attempts[i];
+
+        if (attempt->error == 0) {
+            output_append(output, "\r" CLEAR_LINE DIM
+                "connect: %s connected in %ld ms" RESET "\r\n",
+                attempt->address, attempt->elapsed);
+        } else if (attempt->error == ECANCELED) {
+            output_append(output, "\r" CLEAR_LINE DIM
+                "connect: %s abandoned after %ld ms" RESET "\r\n",
+                attempt->address, attempt->elapsed);
+        } else {
+            output_append(output, "\r" CLEAR_LINE DIM
+                "connect: %s failed after %ld ms (%s)" RESET "\r\n",
+                attempt->address, attempt->elapsed,
+                strerror(attempt->error));
+        }
+    }
+
+    if (!transport->secure || (transport->attempt_count == 0)) {
+        return;
+    }
+
+    char summary[128];
+
+    if (transport->state == TRANSPORT_CONNECTED) {
+        tls_describe(&transport->tls, summary, sizeof(summary));
+        output_append(output, "\r" CLEAR_LINE DIM
+            "tls: %s in %ld ms" RESET "\r\n",
+            summary, transport->handshake_elapsed);
+    } else if (transport->tls.error[0] != '\0') {
+        output_append(output, "\r" CLEAR_LINE DIM
+            "tls: %s" RESET "\r\n", transport->tls.error);
+    }
+}
+
+/**
+ * network_reset() - Discard all per-connection state
+ * @network: Network connection structure
+ *
+ * Empties the receive buffer, the outbound queue and the scheduler
+ * lanes, refills the flood bucket, stops the keepalive, and forgets
+ * what the server advertised, who was in our channels, our user@host
+ * and the measured lag. Configuration, the channel list, the name
+ * table and ctx->target are kept for the next connection; names fold
+ * by the default case mapping until the server announces its own.
+ */
+static void network_reset(struct network *network)
+{
+    timer_stop(network->wheel, &network->keepalive);
+    network->ping_pending = 0;
+    network->dead = 0;
+    network->ctx->lag = -1;
+
+    network->head = network->tail = 0;
+    network->end_count = network->end_next = 0;
+    network->sendq_head = network->sendq_len = 0;
+
+    scheduler_reset(&network->scheduler);
+    channel_clear(&network->chanstate);
+    isupport_init(&network->isupport);
+    intern_casemap(&network->names, network->isupport.casemapping);
+    network->user_len = network->host_len = 0;
+    network->autojoined = 0;
+}
+
+/**
+ * network_disconnect() - Drop the connection and schedule a reconnect
+ * @network: Network connection structure
+ * @output: Output buffer for status messages
+ *
+ * Closes the transport and waits before the next attempt. The wait
+ * doubles with each consecutive failure, from KIRC_RECONNECT_BASE_MS up
+ * to KIRC_RECONNECT_MAX_MS. The actual delay is picked at random from
+ * the upper half of that range, so clients cut off by the same netsplit
+ * do not all return at once. The retry counter is reset once a
+ * connection completes registration.
+ *
+ * Return: 0 if a retry is scheduled, -1 after KIRC_RECONNECT_RETRIES
+ */
+int network_disconnect(struct network *network, struct output *output)
+{
+    transport_free(network->transport);
+    network_reset(network);
+
+    if (network->retries >= KIRC_RECONNECT_RETRIES) {
+        network->state = NETWORK_OFFLINE;
+        output_append(output, "\r" CLEAR_LINE DIM
+            "reconnect: giving up after %d attempts" RESET "\r\n",
+            network->retries);
+        return -1;
+    }
+
+    long delay = KIRC_RECONNECT_BASE_MS;
+
+    for (int i = 0; (i < network->retries) &&
+        (delay < KIRC_RECONNECT_MAX_MS); ++i) {
+        delay *= 2;
+    }
+
+    if (delay > KIRC_RECONNECT_MAX_MS) {
+        delay = KIRC_RECONNECT_MAX_MS;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &network->retry_at);
+
+    /* the clock's low bits are as good a jitter source as any here */
+    delay = delay / 2 + (long)(network->retry_at.tv_nsec / 1000) %
+        (delay / 2 + 1);
+
+    network->retry_at.tv_sec += delay / 1000;
+    network->retry_at.tv_nsec += (delay % 1000) * 1000000L;
+
+    if (network->retry_at.tv_nsec >= 1000000000L) {
+        network->retry_at.tv_sec++;
+        network->retry_at.tv_nsec -= 1000000000L;
+    }
+
+    network->retries++;
+    network->state = NETWORK_WAITING;
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "reconnect: attempt %d of %d in %ld ms" RESET "\r\n",
+        network->retries, KIRC_RECONNECT_RETRIES, delay);
+
+    return 0;
+}
+
+/**
+ * network_reconnect_events() - Describe what a reconnect waits on
+ * @network: Network connection structure
+ * @fds: Array to fill with pollfd entries
+ * @n: Capacity of @fds
+ *
+ * Return: Number of entries written to @fds
+ */
+int network_reconnect_events(struct network *network,
+        struct pollfd *fds, int n)
+{
+    if (network->state != NETWORK_CONNECTING) {
+        return 0;
+    }
+
+    return transport_connect_events(network->transport, fds, n);
+}
+
+/**
+ * network_reconnect_timeout() - Time until the reconnect needs attention
+ * @network: Network connection structure
+ *
+ * Return: Milliseconds to wait, or -1 if only fd events are pending
+ */
+int network_reconnect_timeout(struct network *network)
+{
+    if (network->state == NETWORK_CONNECTING) {
+        return transport_connect_timeout(network->transport);
+    }
+
+    if (network->state != NETWORK_WAITING) {
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long left = (network->retry_at.tv_sec - now.tv_sec) * 1000 +
+        (network->retry_at.tv_nsec - now.tv_nsec) / 1000000;
+
+    return (left > 0) ? (int)left : 0;
+}
+
+/**
+ * network_reconnect_process() - Advance the reconnect state machine
+ * @network: Network connection structure
+ * @fds: pollfd entries from network_reconnect_events(), after poll()
+ * @n: Number of entries in @fds
+ * @output: Output buffer for status messages
+ *
+ * Starts a new connection once the backoff delay has passed and drives
+ * it, or the first one begun by network_start(), to completion. When it
+ * succeeds, the credentials are sent; channels are joined in one batch
+ * when registration finishes. A failed attempt schedules the next one
+ * through network_disconnect().
+ *
+ * Return: 1 once back online, 0 while in progress, -1 when giving up
+ */
+int network_reconnect_process(struct network *network,
+        struct pollfd *fds, int n, struct output *output)
+{
+    if ((network->state == NETWORK_WAITING) &&
+        (network_reconnect_timeout(network) == 0)) {
+        return network_start(network, output);
+    }
+
+    if (network->state != NETWORK_CONNECTING) {
+        return 0;
+    }
+
+    int rc = transport_connect_process(network->transport, fds, n);
+
+    if (rc == 0) {
+        return 0;
+    }
+
+    network_connect_report(network, output);
+
+    if (rc < 0) {
+        return network_disconnect(network, output);
+    }
+
+    network_online(network);
+
+    if (network_send_credentials(network) < 0) {
+        return network_disconnect(network, output);
+    }
+
+    return 1;
+}
+
+/**
+ * network_remember() - Keep a line we sent in the scrollback and log
+ * @network: Network connection structure
+ * @name: Channel or nickname it was sent to
+ * @kind: Message or action
+ * @text: Line text
+ */
+static void network_remember(struct network *network, const char *name,
+        enum scrollback_kind kind, const char *text)
+{
+    const char *nickname = network->ctx->nickname;
+
+    time_t now = time(NULL);
+
+    scrollback_add(network->scrollback, network, name, now, kind,
+        nickname, (int)strlen(nickname), text, (int)strlen(text));
+    chatlog_append(&network->chatlog, now,
+        kind == SCROLLBACK_ACTION ? "ACTION" : "PRIVMSG",
+        name, (int)strlen(name), nickname, (int)strlen(nickname),
+        text, (int)strlen(text));
+}
+
+/**
+ * network_line_max() - Longest line we may send, including CRLF
+ * @network: Network connection structure
+ *
+ * Return: The server's LINELEN, capped by our MESSAGE_MAX_LEN buffer
+ */
+static size_t network_line_max(struct network *network)
+{
+    size_t linelen = (size_t)network->isupport.linelen;
+
+    return (linelen < MESSAGE_MAX_LEN - 1) ? linelen : MESSAGE_MAX_LEN - 1;
+}
+
+/**
+ * network_text_room() - Bytes left for the text of a message
+ * @network: Network connection structure
+ * @command: "PRIVMSG" or "NOTICE"
+ * @target: Channel or nickname
+ *
+ * The server relays the message to others with our ":nick!user@host "
+ * in front, and that copy must fit the line as well. Until the server
+ * has shown us our user and host, in a JOIN echo or RPL_HOSTHIDDEN,
+ * the longest usual ones are assumed.
+ *
+ * Return: Longest text for which "<command> <target> :<text>\r\n" still
+ * fits network_line_max() once relayed, 0 if none does
+ */
+static size_t network_text_room(struct network *network,
+        const char *command, const char *target)
+{
+    size_t max = network_line_max(network);
+    size_t user = (network->user_len > 0) ?
+        (size_t)network->user_len : KIRC_USERLEN_GUESS;
+    size_t host = (network->host_len > 0) ?
+        (size_t)network->host_len : KIRC_HOSTLEN_GUESS;
+    size_t prefix = 1 + strlen(network->ctx->nickname) + 1 + user + 1 +
+        host + 1;
+    size_t overhead = prefix + strlen(command) + 1 + strlen(target) + 2 + 2;
+
+    return (overhead < max) ? max - overhead : 0;
+}
+
+/**
+ * network_piece_room() - Bytes of text one message to a target can carry
+ * @network: Network connection structure
+ * @target: Channel or nickname
+ * @kind: Message or action
+ *
+ * Return: network_text_room() less the CTCP framing of an action
+ */
+static size_t network_piece_room(struct network *network,
+        const char *target, enum scrollback_kind kind)
+{
+    size_t room = network_text_room(network, "PRIVMSG", target);
+
+    /* "\001ACTION " and "\001" around the text */
+    if (kind == SCROLLBACK_ACTION) {
+        room = (room > 9) ? room - 9 : 0;
+    }
+
+    return room;
+}
+
+/**
+ * network_text_next() - Skip to the start of the next piece
+ * @text: Text after the current piece
+ * @len: Bytes left in @text, updated
+ *
+ * Return: @text past the spaces the piece was cut at
+ */
+static const char *network_text_next(const char *text, size_t *len)
+{
+    while ((*len > 0) && (*text == ' ')) {
+        text++;
+        (*len)--;
+    }
+
+    return text;
+}
+
+/**
+ * network_send_text() - Send text to a target, split to fit the line
+ * @network: Network connection structure
+ * @target: Channel or nickname
+ * @kind: Message or action
+ * @text: Text to send, need not be NUL-terminated
+ * @len: Length of @text
+ * @output: Output buffer for display feedback
+ *
+ * Text longer than network_text_room() goes out as several messages,
+ * cut between words or, failing that, between UTF-8 characters. Each
+ * piece is queued on the send scheduler, which releases them at the
+ * flood control rate. Pieces are shown like a private message if the
+ * target is not a channel by the server's CHANTYPES.
+ *
+ * Return: 0 on success, -1 if some of the text was not sent
+ */
+static int network_send_text(struct network *network, const char *target,
+        enum scrollback_kind kind, const char *text, size_t len,
+        struct output *output)
+{
+    size_t room = network_piece_room(network, target, kind);
+
+    if (room == 0) {
+        const char *err = "error: message too long";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+        return -1;
+    }
+
+    int channel = isupport_is_channel(&network->isupport, target,
+        (int)strlen(target));
+
+    while (len > 0) {
+        char piece[MESSAGE_MAX_LEN];
+        size_t n = find_text_split(text, len, room);
+        int sent;
+
+        memcpy(piece, text, n);
+        piece[n] = '\0';
+
+        if (kind == SCROLLBACK_ACTION) {
+            sent = network_send(network,
+                "PRIVMSG %s :\001ACTION %s\001\r\n", target, piece);
+        } else {
+            sent = network_send(network, "PRIVMSG %s :%s\r\n",
+                target, piece);
+        }
+
+        if (sent < 0) {
+            output_append(output, "\r" CLEAR_LINE DIM
+                "error: %zu bytes not sent" RESET "\r\n", len);
+            return -1;
+        }
+
+        network_remember(network, target, kind, piece);
+
+        if (kind == SCROLLBACK_ACTION) {
+            output_append(output, "\rto \u2022 " BOLD "%s" RESET ": %s"
+                CLEAR_LINE "\r\n", target, piece);
+        } else if (channel) {
+            output_append(output, "\rto " BOLD "%s" RESET ": %s"
+                CLEAR_LINE "\r\n", target, piece);
+        } else {
+            output_append(output, "\rto " BOLD_RED "%s" RESET ": %s"
+                CLEAR_LINE "\r\n", target, piece);
+        }
+
+        len -= n;
+        text = network_text_next(text + n, &len);
+    }
+
+    return 0;
+}
+
+/**
+ * network_line_len() - Length of the first line of pasted text
+ * @text: Pasted text, need not be NUL-terminated
+ * @len: Length of @text
+ *
+ * Return: Bytes before the first CR or LF, or @len if there is none
+ */
+static size_t network_line_len(const char *text, size_t len)
+{
+    size_t n = 0;
+
+    while ((n < len) && (text[n] != '\r') && (text[n] != '\n')) {
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * network_send_paste() - Send a confirmed multi-line paste
+ * @network: Network connection structure
+ * @text: Pasted text, lines ending in CR, LF or CRLF
+ * @len: Length of @text
+ * @output: Output buffer for display feedback
+ *
+ * Every non-empty line becomes a message to the current target, never
+ * a command, split like any other message. The paste is only queued
+ * if the scheduler's bulk lane has room for all of its messages, so it
+ * either goes out whole, at the flood control rate, or not at all.
  *
- * Return: 0 on success, -1 if network is NULL or send fails
+ * Return: 0 on success, -1 if nothing was queued or sending stopped
  */
-int network_send(struct network *network, const char *fmt, ...)
+int network_send_paste(struct network *network, const char *text,
+        size_t len, struct output *output)
 {
-    if (network == NULL) {
+    const char *target = network->ctx->target;
+
+    if (target[0] == '\0') {
+        const char *err = "error: no channel set";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
         return -1;
     }
 
-    if (network->transport == NULL) {
+    size_t room = network_piece_room(network, target, SCROLLBACK_MESSAGE);
+
+    if (room == 0) {
+        const char *err = "error: message too long";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
         return -1;
     }
 
-    char buf[MESSAGE_MAX_LEN];
-    va_list ap;
+    size_t pieces = 0;
 
-    va_start(ap, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, ap);
-    va_end(ap);
+    for (size_t i = 0; i < len; ) {
+        size_t n = network_line_len(text + i, len - i);
 
-    size_t len = strnlen(buf, sizeof(buf));
+        const char *line = text + i;
+        size_t left = n;
 
-    ssize_t nsent = transport_send(
-        network->transport, buf, len);
+        while (left > 0) {
+            size_t cut = find_text_split(line, left, room);
 
-    if (nsent < 0) {
-        return -1;
+            left -= cut;
+            line = network_text_next(line + cut, &left);
+            pieces++;
+        }
+
+        i += n + 1;
     }
 
-    return 0;
-}
+    size_t spare = KIRC_SCHEDULER_DEPTH -
+        scheduler_depth(&network->scheduler, SCHEDULER_BULK);
 
-/**
- * network_receive() - Receive data from IRC server
- * @network: Network connection structure
- *
- * Reads available data from the server into the network buffer. Handles
- * non-blocking I/O and partial reads. Updates the buffer length with
- * newly received data. Returns immediately if no data is available.
- *
- * Return: Number of bytes received, 0 if would block, -1 on error or disconnect
- */
-int network_receive(struct network *network)
-{
-    size_t buffer_n = sizeof(network->buffer) - 1;
-    ssize_t nread = transport_receive(
-        network->transport,
-        network->buffer + network->len,
-        buffer_n - network->len);
+    if (pieces > spare) {
+        output_append(output, "\r" CLEAR_LINE DIM
+            "error: paste needs %zu messages, send queue has room for %zu"
+            RESET "\r\n", pieces, spare);
+        return -1;
+    }
 
-    if (nread < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;
-        } else {
+    for (size_t i = 0; i < len; ) {
+        size_t n = network_line_len(text + i, len - i);
+
+        if ((n > 0) && (network_send_text(network, target,
+            SCROLLBACK_MESSAGE, text + i, n, output) < 0)) {
             return -1;
         }
-    }
 
-    if (nread == 0) {
-        return -1;
+        i += n + 1;
     }
 
-    network->len += (int)nread;
-    network->buffer[network->len] = '\0';
-
-    return nread;
-}
-
-/**
- * network_connect() - Establish connection to IRC server
- * @network: Network connection structure
- *
- * Initiates connection to the IRC server using the transport layer.
- * Connection details (server, port) are taken from the context.
- *
- * Return: 0 on success, -1 on connection failure
- */
-int network_connect(struct network *network)
-{
-    return transport_connect(network->transport);
+    return 0;
 }
 
 /**
@@ -104,8 +960,8 @@ int network_connect(struct network *network)
  * @output: Output buffer for display feedback
  *
  * Parses and sends a private message (PRIVMSG) to a specific user.
- * Expected format: "username message text". Validates message length
- * and displays sent message to user.
+ * Expected format: "username message text". Long messages are split
+ * by network_send_text(), which also displays what was sent.
  */
 static void network_send_private_msg(struct network *network,
         char *msg, struct output *output)
@@ -129,19 +985,8 @@ static void network_send_private_msg(struct network *network,
         return;
     }
 
-    size_t overhead = strlen(username) + 13;
-    size_t msg_len = strlen(message);
-    
-    if (overhead + msg_len >= MESSAGE_MAX_LEN) {
-        const char *err = "error: message too long";
-        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
-        return;
-    }
-
-    network_send(network, "PRIVMSG %s :%s\r\n",
-        username, message);
-    output_append(output, "\rto " BOLD_RED "%s" RESET ": %s" CLEAR_LINE "\r\n",
-        username, message);
+    network_send_text(network, username, SCROLLBACK_MESSAGE, message,
+        strlen(message), output);
 }
 
 /**
@@ -185,27 +1030,14 @@ static void network_send_topic(struct network *network,
  * @output: Output buffer for display feedback
  *
  * Sends a CTCP ACTION message (/me command) to the current target channel
- * or user. Validates message length and requires a target to be set.
+ * or user, split like any other message. Requires a target to be set.
  */
 static void network_send_ctcp_action(struct network *network,
         char *msg, struct output *output)
 {
     if (network->ctx->target[0] != '\0') {
-        /* Validate total message length: "PRIVMSG " + target + " :\001ACTION " + msg + "\001\r\n" */
-        size_t overhead = 10 + strlen(network->ctx->target) + 10 + 3; /* "PRIVMSG " + target + " :\001ACTION " + "\001\r\n" */
-        size_t msg_len = strlen(msg);
-        
-        if (overhead + msg_len >= MESSAGE_MAX_LEN) {
-            const char *err = "error: message too long";
-            output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
-            return;
-        }
-
-        network_send(network,
-            "PRIVMSG %s :\001ACTION %s\001\r\n",
-            network->ctx->target, msg);
-        output_append(output, "\rto \u2022 " BOLD "%s" RESET ": %s" CLEAR_LINE "\r\n",
-            network->ctx->target, msg);
+        network_send_text(network, network->ctx->target,
+            SCROLLBACK_ACTION, msg, strlen(msg), output);
     } else {
         const char *err = "error: no channel set";
         output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
@@ -249,37 +1081,263 @@ static void network_send_ctcp_command(struct network *network,
         target, command);
 }
 
+/**
+ * network_send_nick() - Ask the server for a new nickname
+ * @network: Network connection structure
+ * @msg: Requested nickname
+ * @output: Output buffer for error messages
+ *
+ * Refuses names longer than the server's NICKLEN, which the server
+ * would otherwise truncate or reject. The nickname itself only changes
+ * once the server echoes the NICK.
+ */
+static void network_send_nick(struct network *network,
+        char *msg, struct output *output)
+{
+    size_t len = strcspn(msg, " ");
+
+    if (len == 0) {
+        const char *err = "usage: /nick <nickname>";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+        return;
+    }
+
+    if (len > (size_t)network->isupport.nicklen) {
+        output_append(output, "\r" CLEAR_LINE DIM
+            "error: nickname longer than %d" RESET "\r\n",
+            network->isupport.nicklen);
+        return;
+    }
+
+    network_send(network, "NICK %.*s\r\n", (int)len, msg);
+}
+
 /**
  * network_send_channel_msg() - Send message to current target channel
  * @network: Network connection structure
  * @msg: Message text to send
  * @output: Output buffer for display feedback
  *
- * Sends a channel message to the currently set target. Validates message
- * length and requires a target to be set. Displays sent message locally.
+ * Sends a channel message to the currently set target, split to the
+ * server's LINELEN by network_send_text(). Requires a target to be set.
  */
 static void network_send_channel_msg(
         struct network *network, char *msg, struct output *output)
 {
-    if (network->ctx->target[0] != '\0') {
-        /* Validate total message length: "PRIVMSG " + target + " :" + msg + "\r\n" */
-        size_t overhead = 10 + strlen(network->ctx->target) + 3 + 2; /* "PRIVMSG " + target + " :" + "\r\n" */
-        size_t msg_len = strlen(msg);
-        
-        if (overhead + msg_len >= MESSAGE_MAX_LEN) {
-            const char *err = "error: message too long";
+    const char *target = network->ctx->target;
+
+    if (target[0] != '\0') {
+        network_send_text(network, target, SCROLLBACK_MESSAGE, msg,
+            strlen(msg), output);
+    } else {
+        const char *err = "error: no channel set";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+    }
+}
+
+/**
+ * network_send_queue_stats() - Display send scheduler statistics
+ * @network: Network connection structure
+ * @output: Output buffer for display
+ *
+ * Shows how many messages wait on each priority lane, how many bytes
+ * are queued for the socket, and the running delayed and dropped
+ * counters.
+ */
+static void network_send_queue_stats(struct network *network,
+        struct output *output)
+{
+    struct scheduler *scheduler = &network->scheduler;
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "queue: urgent %zu normal %zu bulk %zu, %d bytes pending, "
+        "%lu delayed, %lu dropped" RESET "\r\n",
+        scheduler_depth(scheduler, SCHEDULER_URGENT),
+        scheduler_depth(scheduler, SCHEDULER_NORMAL),
+        scheduler_depth(scheduler, SCHEDULER_BULK),
+        network_pending(network),
+        scheduler->delayed, scheduler->dropped);
+}
+
+/**
+ * network_send_lag_stats() - Display keepalive statistics
+ * @network: Network connection structure
+ * @output: Output buffer for display
+ *
+ * Shows the last and the worst PING round trip of this connection and
+ * how many keepalive PINGs were answered.
+ */
+static void network_send_lag_stats(struct network *network,
+        struct output *output)
+{
+    if (network->ctx->lag < 0) {
+        output_append(output, "\r" CLEAR_LINE DIM
+            "lag: not measured yet, %lu of %lu pings answered"
+            RESET "\r\n", network->pongs, network->pings);
+        return;
+    }
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "lag: %ld ms, max %ld ms, %lu of %lu pings answered" RESET "\r\n",
+        network->ctx->lag, network->lag_max,
+        network->pongs, network->pings);
+}
+
+/**
+ * network_send_history() - Replay the scrollback of the current target
+ * @network: Network connection structure
+ * @arg: Number of lines, or empty for KIRC_SCROLLBACK_REPLAY
+ * @output: Output buffer for display
+ */
+static void network_send_history(struct network *network,
+        const char *arg, struct output *output)
+{
+    long lines = KIRC_SCROLLBACK_REPLAY;
+
+    if (*arg != '\0') {
+        char *endptr;
+        lines = strtol(arg, &endptr, 10);
+
+        if ((endptr == arg) || (*endptr != '\0') || (lines < 1)) {
+            const char *err = "usage: /history [<lines>]";
             output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
             return;
         }
+    }
 
-        network_send(network, "PRIVMSG %s :%s\r\n",
-            network->ctx->target, msg);
-        output_append(output, "\rto " BOLD "%s" RESET ": %s" CLEAR_LINE "\r\n",
-            network->ctx->target, msg);
-    } else {
+    if (network->ctx->target[0] == '\0') {
         const char *err = "error: no channel set";
         output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+        return;
+    }
+
+    scrollback_replay(network->scrollback, network, network->ctx->target,
+        (size_t)lines, output);
+}
+
+struct network_user {
+    int rank;  /* of the highest prefix, KIRC_PREFIX_MAX if none */
+    char prefix[2];
+    const char *name;
+    const struct casemap *casemap;  /* of the server, for sorting */
+};
+
+/**
+ * network_user_compare() - Order members by rank, then by name
+ * @a: First struct network_user
+ * @b: Second struct network_user
+ *
+ * Return: Negative, zero or positive as for qsort()
+ */
+static int network_user_compare(const void *a, const void *b)
+{
+    const struct network_user *x = a;
+    const struct network_user *y = b;
+
+    if (x->rank != y->rank) {
+        return x->rank - y->rank;
+    }
+
+    return casemap_compare(x->casemap, x->name, y->name);
+}
+
+/**
+ * network_send_users() - List the members of the current channel
+ * @network: Network connection structure
+ * @output: Output buffer for display
+ *
+ * Lists the members known from NAMES, JOIN, PART, KICK, NICK, QUIT and
+ * MODE, highest prefix first, without asking the server.
+ */
+static void network_send_users(struct network *network,
+        struct output *output)
+{
+    struct channel_state *state = &network->chanstate;
+    const char *target = network->ctx->target;
+    struct channel *channel = channel_find(state, target,
+        (int)strlen(target));
+
+    if (channel == NULL) {
+        const char *err = "error: not in a channel";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+        return;
+    }
+
+    struct network_user *users = malloc((channel->count + 1) *
+        sizeof(*users));
+
+    if (users == NULL) {
+        return;
+    }
+
+    size_t count = 0;
+
+    for (uint32_t i = 0; i <= channel->mask; ++i) {
+        const struct channel_member *member = &channel->members[i];
+
+        if (member->nick == 0) {
+            continue;
+        }
+
+        int prefix = channel_member_prefix(state, member);
+        const char *symbols = state->isupport->prefix_symbols;
+
+        users[count].prefix[0] = (char)prefix;
+        users[count].prefix[1] = '\0';
+        users[count].rank = (prefix != 0) ?
+            (int)(strchr(symbols, prefix) - symbols) : KIRC_PREFIX_MAX;
+        users[count].name = channel_member_name(state, member);
+        users[count].casemap = &network->names.casemap;
+        count++;
+    }
+
+    qsort(users, count, sizeof(*users), network_user_compare);
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "users: %zu in %s, %zu KiB tracked" RESET "\r\n",
+        count, channel_name(state, channel),
+        (channel_memory(state) + intern_memory(&network->names)) / 1024);
+
+    char line[MESSAGE_MAX_LEN];
+    size_t len = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t need = strlen(users[i].name) + 2;
+
+        if ((len > 0) && (len + need >= sizeof(line))) {
+            output_append(output, "\r" CLEAR_LINE "%s\r\n", line);
+            len = 0;
+        }
+
+        len += (size_t)snprintf(line + len, sizeof(line) - len, "%s%s%s",
+            (len > 0) ? " " : "", users[i].prefix, users[i].name);
+    }
+
+    if (len > 0) {
+        output_append(output, "\r" CLEAR_LINE "%s\r\n", line);
+    }
+
+    free(users);
+}
+
+/**
+ * network_send_search() - Search the chat log of the current target
+ * @network: Network connection structure
+ * @arg: Text to look for
+ * @output: Output buffer for display
+ *
+ * Without a target set, every channel and query is searched.
+ */
+static void network_send_search(struct network *network,
+        const char *arg, struct output *output)
+{
+    if (*arg == '\0') {
+        const char *err = "usage: /search <text>";
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET "\r\n", err);
+        return;
     }
+
+    chatlog_search(&network->chatlog, network->ctx->target, arg, output);
 }
 
 /**
@@ -289,7 +1347,8 @@ static void network_send_channel_msg(
  * @output: Output buffer for display feedback
  *
  * Routes user input to appropriate handlers based on prefix:
- *   / - IRC commands (/set, /me, /ctcp, or raw IRC commands)
+ *   / - IRC commands (/set, /me, /ctcp, /nick, /queue, /lag, /history,
+ *       /search, /users, or raw IRC commands)
  *   @ - Private messages to users
  *   (default) - Channel messages to current target
  * Parses commands and delegates to specialized send functions.
@@ -301,10 +1360,14 @@ int network_command_handler(struct network *network, char *msg, struct output *o
     switch (msg[0]) {
     case '/':  /* system command message */
         switch (msg[1]) {
-        case 's':  /* set target (channel or nickname) */
+        case 's':  /* set target, or search the chat log */
             if (strncmp(msg + 1, "set ", 4) == 0) {
                 size_t siz = sizeof(network->ctx->target);
                 safecpy(network->ctx->target, msg + 5, siz);
+            } else if (strcmp(msg + 1, "search") == 0) {
+                network_send_search(network, "", output);
+            } else if (strncmp(msg + 1, "search ", 7) == 0) {
+                network_send_search(network, msg + 8, output);
             } else {
                 network_send(network, "%s\r\n", msg + 1);
             }
@@ -326,6 +1389,48 @@ int network_command_handler(struct network *network, char *msg, struct output *o
             }
             break;
 
+        case 'q':  /* show send queue statistics */
+            if (strcmp(msg + 1, "queue") == 0) {
+                network_send_queue_stats(network, output);
+            } else {
+                network_send(network, "%s\r\n", msg + 1);
+            }
+            break;
+
+        case 'l':  /* show keepalive lag */
+            if (strcmp(msg + 1, "lag") == 0) {
+                network_send_lag_stats(network, output);
+            } else {
+                network_send(network, "%s\r\n", msg + 1);
+            }
+            break;
+
+        case 'h':  /* replay scrollback of the target */
+            if (strcmp(msg + 1, "history") == 0) {
+                network_send_history(network, "", output);
+            } else if (strncmp(msg + 1, "history ", 8) == 0) {
+                network_send_history(network, msg + 9, output);
+            } else {
+                network_send(network, "%s\r\n", msg + 1);
+            }
+            break;
+
+        case 'u':  /* list members of the target */
+            if (strcmp(msg + 1, "users") == 0) {
+                network_send_users(network, output);
+            } else {
+                network_send(network, "%s\r\n", msg + 1);
+            }
+            break;
+
+        case 'n':  /* change nickname */
+            if (strncmp(msg + 1, "nick ", 5) == 0) {
+                network_send_nick(network, msg + 6, output);
+            } else {
+                network_send(network, "%s\r\n", msg + 1);
+            }
+            break;
+
         case 'c':  /* send CTCP command */
             if (strncmp(msg + 1, "ctcp ", 5) == 0) {
                 network_send_ctcp_command(network, msg + 6, output);
@@ -356,8 +1461,9 @@ int network_command_handler(struct network *network, char *msg, struct output *o
  * network_send_credentials() - Send authentication credentials to server
  * @network: Network connection structure
  *
- * Sends initial authentication sequence to IRC server including SASL
- * capability negotiation (if configured), NICK, USER commands, and
+ * Sends initial authentication sequence to IRC server including IRCv3
+ * message-tags and SASL capability negotiation (if configured), NICK,
+ * USER commands, and
  * optionally PASS (server password). Initiates SASL authentication
  * for EXTERNAL or PLAIN mechanisms.
  *
@@ -365,6 +1471,8 @@ int network_command_handler(struct network *network, char *msg, struct output *o
  */
 int network_send_credentials(struct network *network)
 {
+    network_send(network, "CAP REQ :message-tags server-time batch\r\n");
+
     if (network->ctx->mechanism != SASL_NONE) {
         network_send(network, "CAP REQ :sasl\r\n");
     }
@@ -408,28 +1516,177 @@ int network_send_credentials(struct network *network)
     return 0;
 }
 
+/**
+ * network_send_join() - Send one packed JOIN line
+ * @network: Network connection structure
+ * @channels: Comma-separated channel list
+ * @keys: Comma-separated key list, may be empty
+ */
+static void network_send_join(struct network *network,
+        const char *channels, const char *keys)
+{
+    if (keys[0] != '\0') {
+        network_send(network, "JOIN %s %s\r\n", channels, keys);
+    } else {
+        network_send(network, "JOIN %s\r\n", channels);
+    }
+}
+
+/**
+ * network_join_channels() - Join all configured channels
+ * @network: Network connection structure
+ *
+ * Packs ctx->channels into as few comma-separated JOIN lines as
+ * possible. Each line stays within the server's LINELEN, capped by
+ * MESSAGE_MAX_LEN, and its TARGMAX limit for JOIN. Keyed channels go
+ * first in every line, because JOIN matches keys to channels by
+ * position.
+ *
+ * Return: Number of JOIN lines queued
+ */
+int network_join_channels(struct network *network)
+{
+    struct kirc_context *ctx = network->ctx;
+    int targmax = network->isupport.targmax[ISUPPORT_TARGET_JOIN];
+    size_t line_max = network_line_max(network);
+    char channels[MESSAGE_MAX_LEN];
+    char keys[MESSAGE_MAX_LEN];
+    size_t channels_len = 0, keys_len = 0;
+    int count = 0, lines = 0;
+
+    /* first pass takes keyed channels, second pass the rest */
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; (i < KIRC_CHANNEL_LIMIT) &&
+            (ctx->channels[i][0] != '\0'); ++i) {
+            const char *channel = ctx->channels[i];
+            const char *key = ctx->keys[i];
+
+            if ((key[0] != '\0') != (pass == 0)) {
+                continue;
+            }
+
+            size_t channel_n = strlen(channel);
+            size_t key_n = strlen(key);
+
+            /* "JOIN " channels [" " keys] "\r\n" */
+            size_t need = 5 + channels_len + (count > 0) + channel_n + 2;
+
+            if ((keys_len > 0) || (key_n > 0)) {
+                need += 1 + keys_len + (keys_len > 0) + key_n;
+            }
+
+            if ((count > 0) && ((need > line_max) ||
+                ((targmax > 0) && (count == targmax)))) {
+                network_send_join(network, channels, keys);
+                lines++;
+                channels_len = keys_len = 0;
+                count = 0;
+            }
+
+            if (count > 0) {
+                channels[channels_len++] = ',';
+            }
+
+            memcpy(channels + channels_len, channel, channel_n + 1);
+            channels_len += channel_n;
+
+            if (key_n > 0) {
+                if (keys_len > 0) {
+                    keys[keys_len++] = ',';
+                }
+
+                memcpy(keys + keys_len, key, key_n + 1);
+                keys_len += key_n;
+            }
+
+            keys[keys_len] = '\0';
+            count++;
+        }
+    }
+
+    if (count > 0) {
+        network_send_join(network, channels, keys);
+        lines++;
+    }
+
+    return lines;
+}
+
 /**
  * network_init() - Initialize network connection structure
  * @network: Network structure to initialize
  * @transport: Transport layer instance
  * @ctx: IRC context structure
+ * @wheel: Timer wheel that drives the keepalive
+ * @scrollback: Store that received and sent lines are kept in
  *
  * Initializes the network management structure, associating it with a
- * transport layer and IRC context. Zeros the buffer and state.
+ * transport layer and IRC context. Allocates the receive buffer and the
+ * send scheduler and the channel state, opens the chat log if one is
+ * configured, and zeros the state.
  *
- * Return: 0 on success, -1 if any parameter is NULL
+ * Return: 0 on success, -1 if any parameter is NULL or allocation fails
  */
 int network_init(struct network *network, 
-        struct transport *transport, struct kirc_context *ctx)
+        struct transport *transport, struct kirc_context *ctx,
+        struct timer_wheel *wheel, struct scrollback *scrollback)
 {
-    if ((network == NULL) || (transport == NULL) || (ctx == NULL)) {
+    if ((network == NULL) || (transport == NULL) || (ctx == NULL) ||
+        (wheel == NULL) || (scrollback == NULL)) {
         return -1;
     }
 
     memset(network, 0, sizeof(*network));
 
+    network->buffer = malloc(KIRC_RECEIVE_BUFFER_SIZE);
+
+    if (network->buffer == NULL) {
+        return -1;
+    }
+
+    isupport_init(&network->isupport);
+
+    if (scheduler_init(&network->scheduler, ctx) < 0) {
+        free(network->buffer);
+        network->buffer = NULL;
+        return -1;
+    }
+
+    if (intern_init(&network->names) < 0) {
+        scheduler_free(&network->scheduler);
+        free(network->buffer);
+        network->buffer = NULL;
+        return -1;
+    }
+
+    if (channel_init(&network->chanstate, &network->names,
+        &network->isupport) < 0) {
+        intern_free(&network->names);
+        scheduler_free(&network->scheduler);
+        free(network->buffer);
+        network->buffer = NULL;
+        return -1;
+    }
+
+    if (chatlog_init(&network->chatlog, ctx) < 0) {
+        channel_free(&network->chanstate);
+        intern_free(&network->names);
+        scheduler_free(&network->scheduler);
+        free(network->buffer);
+        network->buffer = NULL;
+        return -1;
+    }
+
     network->ctx = ctx;
     network->transport = transport;
+    network->size = KIRC_RECEIVE_BUFFER_SIZE;
+    network->buffer[0] = '\0';
+    network->wheel = wheel;
+    network->scrollback = scrollback;
+    network->self = intern_add(&network->names, ctx->nickname,
+        (int)strlen(ctx->nickname));
+    timer_setup(&network->keepalive, network_keepalive, network);
+    ctx->lag = -1;
 
     return 0;
 }
@@ -439,12 +1696,25 @@ int network_init(struct network *network,
  * @network: Network structure to clean up
  *
  * Releases resources associated with the network connection by freeing
- * the transport layer.
+ * the receive buffer, the send scheduler, the channel state, the name
+ * table, the chat log and the transport layer, and disarms the keepalive.
  *
  * Return: 0 on success, -1 if transport cleanup fails
  */
 int network_free(struct network *network)
 {
+    if (network->wheel != NULL) {
+        timer_stop(network->wheel, &network->keepalive);
+    }
+
+    free(network->buffer);
+    network->buffer = NULL;
+
+    scheduler_free(&network->scheduler);
+    channel_free(&network->chanstate);
+    intern_free(&network->names);
+    chatlog_free(&network->chatlog);
+
     if (transport_free(network->transport) < 0) {
         return -1;
     }
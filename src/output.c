@@ -42,7 +42,8 @@ int output_init(struct output *output,
  * Appends formatted text to the output buffer. Automatically flushes if
  * buffer becomes nearly full (within 256 bytes of capacity). If text
  * doesn't fit, flushes buffer and retries. Handles truncation for
- * extremely long messages.
+ * extremely long messages. When the source server changed since the
+ * last line, a marker naming it is written first.
  *
  * Return: 0 on success, -1 on error
  */
@@ -59,6 +60,15 @@ int output_append(struct output *output,
         output_flush(output);
     }
     
+    if (output->source != output->shown) {
+        output->shown = output->source;
+
+        if (output->source != NULL) {
+            output_append(output, "\r" CLEAR_LINE DIM "[%s]" RESET "\r\n",
+                output->source);
+        }
+    }
+
     va_list ap;
     va_start(ap, fmt);
     
@@ -93,6 +103,24 @@ int output_append(struct output *output,
     return 0;
 }
 
+/**
+ * output_source() - Name the server subsequent output belongs to
+ * @output: Output buffer structure
+ * @source: Server name, or NULL when only one server is configured
+ *
+ * The name is not printed until a line is actually appended, so
+ * servicing a server that produces no output leaves no trace. The
+ * pointer must stay valid while it is set.
+ */
+void output_source(struct output *output, const char *source)
+{
+    if (output == NULL) {
+        return;
+    }
+
+    output->source = source;
+}
+
 /**
  * output_flush() - Write buffered output to stdout
  * @output: Output buffer structure
@@ -9,24 +9,55 @@
 
 /**
  * protocol_get_time() - Get formatted timestamp string
+ * @event: Event being displayed
  *
- * Returns the current local time as a formatted string using the format
- * defined by KIRC_TIMESTAMP_FORMAT. Uses a static buffer, so the returned
- * pointer is valid until the next call.
+ * Returns the event's local time, see event_time(), as a
+ * formatted string using the format defined by KIRC_TIMESTAMP_FORMAT.
+ * Uses a static buffer, so the returned pointer is valid until the next
+ * call.
  *
  * Return: Pointer to static timestamp string
  */
-static const char *protocol_get_time(void)
+static const char *protocol_get_time(struct event *event)
 {
     static char timestamp[KIRC_TIMESTAMP_SIZE];
-    time_t current;
-    time(&current);
+    time_t current = event_time(event);
+
     struct tm *info = localtime(&current);
     strftime(timestamp, KIRC_TIMESTAMP_SIZE,
         KIRC_TIMESTAMP_FORMAT, info);
     return timestamp;
 }
 
+/**
+ * protocol_remember() - Keep a message in the scrollback
+ * @network: Network the message arrived on
+ * @event: Message event
+ * @kind: Message, action or notice
+ *
+ * Channel messages go to the channel's buffer; messages addressed to
+ * us go to the sender's, like a query window would.
+ */
+static void protocol_remember(struct network *network, struct event *event,
+        enum scrollback_kind kind)
+{
+    char name[CHANNEL_MAX_LEN];
+    const struct event_view *buffer = &event->channel;
+
+    if (network_is_self(network, &event->channel)) {
+        buffer = &event->nickname;
+    }
+
+    if (buffer->len == 0) {
+        return;
+    }
+
+    event_view_copy(name, buffer, sizeof(name));
+    scrollback_add(network->scrollback, network, name,
+        event_time(event), kind, event->nickname.ptr,
+        event->nickname.len, event->message.ptr, event->message.len);
+}
+
 /**
  * protocol_noop() - No-operation event handler
  * @network: Network connection (unused)
@@ -55,7 +86,45 @@ void protocol_noop(struct network *network, struct event *event, struct output *
 void protocol_ping(struct network *network, struct event *event, struct output *output)
 {
     (void)output;
-    network_send(network, "PONG :%s\r\n", event->message);
+
+    const struct event_view *token = &event->message;
+
+    if (token->len == 0) {
+        token = &event->channel;
+    }
+
+    network_send(network, "PONG :%.*s\r\n", token->len, token->ptr);
+}
+
+/**
+ * protocol_pong() - Handle PONG replies from server
+ * @network: Network connection structure
+ * @event: Event containing the echoed token
+ * @output: Output buffer for display
+ *
+ * Answers to our keepalive PING update the lag silently; any other
+ * PONG, such as one for a PING typed by the user, is displayed.
+ */
+void protocol_pong(struct network *network, struct event *event, struct output *output)
+{
+    const struct event_view *token = &event->message;
+
+    if (token->len == 0) {
+        token = &event->channel;
+    }
+
+    char buf[sizeof(network->ping_token)];
+
+    if ((size_t)token->len < sizeof(buf)) {
+        memcpy(buf, token->ptr, (size_t)token->len);
+        buf[token->len] = '\0';
+
+        if (network_pong(network, buf) == 0) {
+            return;
+        }
+    }
+
+    protocol_raw(network, event, output);
 }
 
 /**
@@ -121,23 +190,108 @@ void protocol_authenticate(struct network *network, struct event *event, struct
 }
 
 /**
- * protocol_welcome() - Handle RPL_WELCOME (001) server message
+ * protocol_cap() - Handle CAP negotiation replies
  * @network: Network connection structure
- * @event: Welcome event (unused)
- * @output: Output buffer (unused)
+ * @event: CAP event
+ * @output: Output buffer for display
+ *
+ * Displays the reply and ends capability negotiation once the server
+ * has answered our requests. When SASL is configured, CAP END is sent
+ * by protocol_authenticate() instead, unless the server refused sasl.
+ */
+void protocol_cap(struct network *network, struct event *event, struct output *output)
+{
+    protocol_info(network, event, output);
+
+    if (event->param_count < 2) {
+        return;
+    }
+
+    const struct event_view *subcommand = &event->params[1];
+    int nak = event_view_equals(subcommand, "NAK");
+
+    if (!nak && !event_view_equals(subcommand, "ACK")) {
+        return;
+    }
+
+    if (network->ctx->mechanism == SASL_NONE) {
+        network_send(network, "CAP END\r\n");
+    } else if (nak && (event->message.len >= 4) &&
+        (memcmp(event->message.ptr, "sasl", 4) == 0)) {
+        network_send(network, "CAP END\r\n");
+    }
+}
+
+/**
+ * protocol_isupport() - Handle RPL_ISUPPORT (005) server message
+ * @network: Network connection structure
+ * @event: ISUPPORT event carrying NAME[=VALUE] tokens
+ * @output: Output buffer for display
+ *
+ * Records the advertised server limits on the connection, switches the
+ * name table to the advertised CASEMAPPING, then displays the message
+ * like any other informational reply.
+ */
+void protocol_isupport(struct network *network, struct event *event, struct output *output)
+{
+    isupport_parse(&network->isupport, event);
+    intern_casemap(&network->names, network->isupport.casemapping);
+    protocol_info(network, event, output);
+}
+
+/**
+ * protocol_welcome() - Handle the end of the registration burst
+ * @network: Network connection structure
+ * @event: RPL_ENDOFMOTD (376) or ERR_NOMOTD (422) event
+ * @output: Output buffer for display
  *
- * Processes the server welcome message by automatically joining all
- * configured channels from the context.
+ * Displays the message, then joins all configured channels the first
+ * time either reply arrives. Registration is complete at this point,
+ * so the reconnect backoff starts over. Joining here rather than on
+ * RPL_WELCOME means RPL_ISUPPORT has been seen, so the JOIN lines can
+ * be packed to the server's limits.
  */
 void protocol_welcome(struct network *network, struct event *event, struct output *output)
 {
-    (void)event;
-    (void)output;
+    if (event->type == EVENT_422_ERR_NOMOTD) {
+        protocol_error(network, event, output);
+    } else {
+        protocol_info(network, event, output);
+    }
+
+    if (network->autojoined) {
+        return;
+    }
+
+    network->autojoined = 1;
+    network->retries = 0;
+    network_join_channels(network);
+}
 
-    for (int i = 0; network->ctx->channels[i][0] != '\0'; ++i) {
-        network_send(network, "JOIN %s\r\n",
-            network->ctx->channels[i]);
+/**
+ * protocol_hosthidden() - Handle RPL_HOSTHIDDEN (396)
+ * @network: Network connection structure
+ * @event: Event whose second parameter is our new host, or user@host
+ * @output: Output buffer for display
+ *
+ * Remembers how long the host others now see is, so long messages are
+ * split to fit once the server puts our prefix in front of them.
+ */
+void protocol_hosthidden(struct network *network, struct event *event, struct output *output)
+{
+    if (event->param_count > 1) {
+        const struct event_view *host = &event->params[1];
+        const char *at = memchr(host->ptr, '@', (size_t)host->len);
+
+        if (at != NULL) {
+            network->user_len = (int)(at - host->ptr);
+            network->host_len = host->len - network->user_len - 1;
+        } else {
+            network->host_len = host->len;
+        }
     }
+
+    protocol_info(network, event, output);
 }
 
 /**
@@ -154,8 +308,8 @@ void protocol_raw(struct network *network, struct event *event, struct output *o
     (void)network;
 
     output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
-        " " REVERSE "%s" RESET "\r\n",
-        protocol_get_time(), event->raw);
+        " " REVERSE "%.*s" RESET "\r\n",
+        protocol_get_time(event), event->raw.len, event->raw.ptr);
 }
 
 /**
@@ -171,8 +325,8 @@ void protocol_info(struct network *network, struct event *event, struct output *
 {
     (void)network;
 
-    output_append(output, "\r" CLEAR_LINE DIM "%s %s" RESET "\r\n",
-        protocol_get_time(), event->message);
+    output_append(output, "\r" CLEAR_LINE DIM "%s %.*s" RESET "\r\n",
+        protocol_get_time(event), event->message.len, event->message.ptr);
 }
 
 /**
@@ -189,26 +343,29 @@ void protocol_error(struct network *network, struct event *event, struct output
     (void)network;
 
     output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
-        " " BOLD_RED "%s" RESET "\r\n",
-        protocol_get_time(), event->message);
+        " " BOLD_RED "%.*s" RESET "\r\n",
+        protocol_get_time(event), event->message.len, event->message.ptr);
 }
 
 /**
  * protocol_notice() - Display NOTICE message
- * @network: Network connection (unused)
+ * @network: Network connection structure
  * @event: Event containing notice details
  * @output: Output buffer for display
  *
  * Displays a NOTICE message with the sender's nickname in bold blue
- * and timestamp.
+ * and timestamp. Notices from users are kept in the scrollback.
  */
 void protocol_notice(struct network *network, struct event *event, struct output *output)
 {
-    (void)network;
+    if (event->nickname.len > 0) {
+        protocol_remember(network, event, SCROLLBACK_NOTICE);
+    }
 
     output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
-        " " BOLD_BLUE "%s" RESET " %s\r\n",
-        protocol_get_time(), event->nickname, event->message);
+        " " BOLD_BLUE "%.*s" RESET " %.*s\r\n",
+        protocol_get_time(event), event->nickname.len, event->nickname.ptr,
+        event->message.len, event->message.ptr);
 }
 
 /**
@@ -225,8 +382,9 @@ static void protocol_privmsg_direct(struct network *network, struct event *event
     (void)network;
 
     output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
-        " " BOLD_BLUE "%s" RESET " " BLUE "%s" RESET "\r\n",
-        protocol_get_time(), event->nickname, event->message);
+        " " BOLD_BLUE "%.*s" RESET " " BLUE "%.*s" RESET "\r\n",
+        protocol_get_time(event), event->nickname.len, event->nickname.ptr,
+        event->message.len, event->message.ptr);
 }
 
 /**
@@ -243,8 +401,10 @@ static void protocol_privmsg_indirect(struct network *network, struct event *eve
     (void)network;
 
     output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
-        " " BOLD "%s" RESET " [%s]: %s\r\n",
-        protocol_get_time(), event->nickname, event->channel, event->message);
+        " " BOLD "%.*s" RESET " [%.*s]: %.*s\r\n",
+        protocol_get_time(event), event->nickname.len, event->nickname.ptr,
+        event->channel.len, event->channel.ptr,
+        event->message.len, event->message.ptr);
 
 }
 
@@ -255,70 +415,159 @@ static void protocol_privmsg_indirect(struct network *network, struct event *eve
  * @output: Output buffer for display
  *
  * Determines whether a PRIVMSG is a direct message or channel message
- * by comparing the target with the user's nickname, then routes to the
- * appropriate display function.
+ * by looking the target up in the server's CHANTYPES, then routes to the
+ * appropriate display function. The message is kept in the scrollback.
  */
 void protocol_privmsg(struct network *network, struct event *event, struct output *output)
 {
-    char *channel = event->channel;
-    char *nickname = event->ctx->nickname;
+    protocol_remember(network, event, SCROLLBACK_MESSAGE);
 
-    if (strcmp(channel, nickname) == 0) {
+    if (!isupport_is_channel(&network->isupport, event->channel.ptr,
+        event->channel.len)) {
         protocol_privmsg_direct(network, event, output);
     } else {
         protocol_privmsg_indirect(network, event, output);
     }
 }
 
+/**
+ * protocol_channel_add() - Remember a channel we joined
+ * @network: Network connection structure
+ * @channel: Channel name
+ *
+ * Keeps ctx->channels in step with the channels we are actually in, so
+ * a reconnect rejoins them. Channels already listed keep their key.
+ */
+static void protocol_channel_add(struct network *network,
+        const struct event_view *channel)
+{
+    struct kirc_context *ctx = network->ctx;
+    int i;
+
+    for (i = 0; (i < KIRC_CHANNEL_LIMIT) &&
+        (ctx->channels[i][0] != '\0'); ++i) {
+        if (casemap_equals(&network->names.casemap, channel->ptr,
+            (size_t)channel->len, ctx->channels[i],
+            strlen(ctx->channels[i]))) {
+            return;
+        }
+    }
+
+    if (i < KIRC_CHANNEL_LIMIT) {
+        event_view_copy(ctx->channels[i], channel, CHANNEL_MAX_LEN);
+        ctx->keys[i][0] = '\0';
+    }
+}
+
+/**
+ * protocol_channel_remove() - Forget a channel we left
+ * @network: Network connection structure
+ * @channel: Channel name
+ *
+ * Removes the channel and its key, closing the gap so the list stays
+ * terminated by the first empty entry.
+ */
+static void protocol_channel_remove(struct network *network,
+        const struct event_view *channel)
+{
+    struct kirc_context *ctx = network->ctx;
+    int i, last;
+
+    for (last = 0; (last < KIRC_CHANNEL_LIMIT) &&
+        (ctx->channels[last][0] != '\0'); ++last) {
+        continue;
+    }
+
+    for (i = 0; i < last; ++i) {
+        if (casemap_equals(&network->names.casemap, channel->ptr,
+            (size_t)channel->len, ctx->channels[i],
+            strlen(ctx->channels[i]))) {
+            break;
+        }
+    }
+
+    if (i == last) {
+        return;
+    }
+
+    memmove(ctx->channels[i], ctx->channels[i + 1],
+        (size_t)(last - i - 1) * sizeof(ctx->channels[0]));
+    memmove(ctx->keys[i], ctx->keys[i + 1],
+        (size_t)(last - i - 1) * sizeof(ctx->keys[0]));
+    ctx->channels[last - 1][0] = '\0';
+    ctx->keys[last - 1][0] = '\0';
+}
+
 /**
  * protocol_nick() - Handle nickname change events
- * @network: Network connection (unused)
+ * @network: Network connection structure
  * @event: Event containing nickname change information
  * @output: Output buffer for display
  *
- * Handles NICK events by displaying the nickname change. If the change
- * is for the current user, updates the context with the new nickname.
- * Shows appropriate messages for self and other users.
+ * Handles NICK events by renaming the interned nick, which the channel
+ * state, DCC and our own id all refer to, and displaying the change. If
+ * the change is for the current user, updates the context with the new
+ * nickname. Shows appropriate messages for self and other users.
  */
 void protocol_nick(struct network *network, struct event *event, struct output *output)
 {
-    (void)network;
-
     struct kirc_context *ctx = event->ctx;
-    const char *timestamp = protocol_get_time();
-    
-    if (strcmp(event->nickname, ctx->nickname) == 0) {
-        size_t siz = sizeof(ctx->nickname) - 1;
-        strncpy(ctx->nickname, event->message, siz);
-        ctx->nickname[siz] = '\0';
+    struct intern *names = &network->names;
+    uint32_t id = intern_find(names, event->nickname.ptr,
+        event->nickname.len);
+    uint32_t other = intern_find(names, event->message.ptr,
+        event->message.len);
+    const char *timestamp = protocol_get_time(event);
+
+    if ((other != 0) && (other != id)) {
+        channel_quit(&network->chanstate, other);
+    }
+
+    intern_rename(names, id, event->message.ptr, event->message.len);
+
+    if ((id != 0) && (id == network->self)) {
+        size_t siz = sizeof(ctx->nickname);
+        event_view_copy(ctx->nickname, &event->message, siz);
         output_append(output, "\r" CLEAR_LINE
-            DIM "%s you are now known as %s" RESET "\r\n",
-            timestamp, event->message);
+            DIM "%s you are now known as %.*s" RESET "\r\n",
+            timestamp, event->message.len, event->message.ptr);
     } else {
         output_append(output, "\r" CLEAR_LINE
-            DIM "%s %s is now known as %s" RESET "\r\n",
-            timestamp, event->nickname, event->message);
+            DIM "%s %.*s is now known as %.*s" RESET "\r\n",
+            timestamp, event->nickname.len, event->nickname.ptr,
+            event->message.len, event->message.ptr);
     }
 
 }
 
 /**
  * protocol_join() - Handle JOIN channel event
- * @network: Network connection (unused)
+ * @network: Network connection structure
  * @event: Event containing JOIN details
  * @output: Output buffer for display
  *
- * Processes IRC JOIN events. If the joining user is the client itself,
- * displays a confirmation message. Otherwise, delegates to protocol_noop().
+ * Processes IRC JOIN events and adds the user to the channel state. If
+ * the joining user is the client itself, records the channel for
+ * rejoining after a reconnect, learns our user@host as the server
+ * relays it and displays a confirmation message.
+ * Otherwise, delegates to protocol_noop().
  */
 void protocol_join(struct network *network, struct event *event, struct output *output)
 {
-    (void)network;
+    int self = network_is_self(network, &event->nickname);
+
+    channel_join(&network->chanstate, event, self);
 
-    if (strcmp(event->nickname, event->ctx->nickname) == 0) {
+    if (self) {
+        if ((event->user.len > 0) && (event->host.len > 0)) {
+            network->user_len = event->user.len;
+            network->host_len = event->host.len;
+        }
+
+        protocol_channel_add(network, &event->channel);
         output_append(output, "\r" CLEAR_LINE
-            DIM "kirc: you've joined %s" RESET "\r\n",
-            event->channel);
+            DIM "kirc: you've joined %.*s" RESET "\r\n",
+            event->channel.len, event->channel.ptr);
     } else {
         protocol_noop(network, event, output);
     }
@@ -326,41 +575,120 @@ void protocol_join(struct network *network, struct event *event, struct output *
 
 /**
  * protocol_part() - Handle PART channel event
- * @network: Network connection (unused)
+ * @network: Network connection structure
  * @event: Event containing PART details
  * @output: Output buffer for display
  *
- * Processes IRC PART events. If the leaving user is the client itself,
- * displays a confirmation message. Otherwise, delegates to protocol_noop().
+ * Processes IRC PART events and removes the user from the channel
+ * state. If the leaving user is the client itself, drops the channel
+ * from the rejoin list and displays a confirmation message. Otherwise,
+ * delegates to protocol_noop().
  */
 void protocol_part(struct network *network, struct event *event, struct output *output)
 {
-    (void)network;
+    int self = network_is_self(network, &event->nickname);
+
+    channel_part(&network->chanstate, &event->channel, &event->nickname,
+        self);
 
-    if (strcmp(event->nickname, event->ctx->nickname) == 0) {
+    if (self) {
+        protocol_channel_remove(network, &event->channel);
         output_append(output, "\r" CLEAR_LINE
-            DIM "kirc: you left %s" RESET "\r\n",
-            event->channel);
+            DIM "kirc: you left %.*s" RESET "\r\n",
+            event->channel.len, event->channel.ptr);
     } else {
         protocol_noop(network, event, output);
     }
 }
 
+/**
+ * protocol_kick() - Handle KICK channel event
+ * @network: Network connection structure
+ * @event: Event containing KICK details
+ * @output: Output buffer for display
+ *
+ * Displays the kick like other informational messages and removes the
+ * kicked user from the channel state. If the client itself was kicked,
+ * the channel is dropped from the rejoin list.
+ */
+void protocol_kick(struct network *network, struct event *event, struct output *output)
+{
+    if (event->param_count > 1) {
+        int self = network_is_self(network, &event->params[1]);
+
+        channel_part(&network->chanstate, &event->channel,
+            &event->params[1], self);
+
+        if (self) {
+            protocol_channel_remove(network, &event->channel);
+        }
+    }
+
+    protocol_info(network, event, output);
+}
+
+/**
+ * protocol_quit() - Handle QUIT event
+ * @network: Network connection structure
+ * @event: Event containing the nick that quit
+ * @output: Output buffer (unused)
+ *
+ * Removes the user from every channel it was in. Nothing is displayed.
+ */
+void protocol_quit(struct network *network, struct event *event, struct output *output)
+{
+    channel_quit(&network->chanstate, intern_find(&network->names,
+        event->nickname.ptr, event->nickname.len));
+    protocol_noop(network, event, output);
+}
+
+/**
+ * protocol_mode() - Handle MODE event
+ * @network: Network connection structure
+ * @event: Event containing the mode change
+ * @output: Output buffer for display
+ *
+ * Applies membership prefix changes such as +o to the channel state,
+ * then displays the message like other informational replies.
+ */
+void protocol_mode(struct network *network, struct event *event, struct output *output)
+{
+    channel_mode(&network->chanstate, event);
+    protocol_info(network, event, output);
+}
+
+/**
+ * protocol_names() - Handle RPL_NAMREPLY (353) server message
+ * @network: Network connection structure
+ * @event: Event listing members of a channel
+ * @output: Output buffer for display
+ *
+ * Adds the listed members to the channel state, then displays the
+ * message like other informational replies.
+ */
+void protocol_names(struct network *network, struct event *event, struct output *output)
+{
+    channel_names(&network->chanstate, event);
+    protocol_info(network, event, output);
+}
+
 /**
  * protocol_ctcp_action() - Display CTCP ACTION message
- * @network: Network connection (unused)
+ * @network: Network connection structure
  * @event: Event containing ACTION details
  * @output: Output buffer for display
  *
  * Displays a CTCP ACTION message (/me command) with a bullet point
- * prefix, timestamp, nickname, and action text in dimmed format.
+ * prefix, timestamp, nickname, and action text in dimmed format, and
+ * keeps it in the scrollback.
  */
 void protocol_ctcp_action(struct network *network, struct event *event, struct output *output)
 {
-    (void)network;
+    protocol_remember(network, event, SCROLLBACK_ACTION);
 
-    output_append(output, "\r" CLEAR_LINE DIM "%s \u2022 %s %s" RESET "\r\n",
-        protocol_get_time(), event->nickname, event->message);
+    output_append(output, "\r" CLEAR_LINE DIM "%s \u2022 %.*s %.*s" RESET "\r\n",
+        protocol_get_time(event), event->nickname.len, event->nickname.ptr,
+        event->message.len, event->message.ptr);
 }
 
 /**
@@ -371,14 +699,14 @@ void protocol_ctcp_action(struct network *network, struct event *event, struct o
  *
  * Displays CTCP protocol messages (CLIENTINFO, DCC, PING, TIME, VERSION)
  * with sender's nickname in bold blue and appropriate label. Shows
- * parameters or message content if present.
+ * the CTCP arguments if present.
  */
 void protocol_ctcp_info(struct network *network, struct event *event, struct output *output)
 {
     (void)network;
 
     const char *label = "";
-    const char *timestamp = protocol_get_time();
+    const char *timestamp = protocol_get_time(event);
 
     switch(event->type) {
     case EVENT_CTCP_CLIENTINFO:
@@ -406,17 +734,14 @@ void protocol_ctcp_info(struct network *network, struct event *event, struct out
         break;
     }
 
-    if (event->params[0] != '\0') {
-        output_append(output, "\r" CLEAR_LINE DIM "%s " RESET
-            BOLD_BLUE "%s" RESET " %s: %s\r\n",
-            timestamp, event->nickname, label, event->params);
-    } else if (event->message[0] != '\0') {
+    if (event->message.len > 0) {
         output_append(output, "\r" CLEAR_LINE DIM "%s " RESET
-            BOLD_BLUE "%s" RESET " %s: %s\r\n",
-            timestamp, event->nickname, label, event->message);
+            BOLD_BLUE "%.*s" RESET " %s: %.*s\r\n",
+            timestamp, event->nickname.len, event->nickname.ptr,
+            label, event->message.len, event->message.ptr);
     } else {
         output_append(output, "\r" CLEAR_LINE DIM "%s " RESET
-            BOLD_BLUE "%s" RESET " %s\r\n",
-            timestamp, event->nickname, label);
+            BOLD_BLUE "%.*s" RESET " %s\r\n",
+            timestamp, event->nickname.len, event->nickname.ptr, label);
     }
 }
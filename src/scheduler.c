@@ -0,0 +1,356 @@
+/*
+ * scheduler.c
+ * Outbound send scheduler
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "scheduler.h"
+
+/**
+ * scheduler_refill() - Credit the token bucket for elapsed time
+ * @scheduler: Scheduler structure
+ *
+ * Adds one millisecond of allowance per millisecond elapsed since the
+ * last refill, capped at @burst messages worth. Only whole milliseconds
+ * are consumed from the clock so frequent calls do not lose time.
+ */
+static void scheduler_refill(struct scheduler *scheduler)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long elapsed = (now.tv_sec - scheduler->last.tv_sec) * 1000 +
+        (now.tv_nsec - scheduler->last.tv_nsec) / 1000000;
+
+    if (elapsed <= 0) {
+        return;
+    }
+
+    scheduler->last.tv_sec += elapsed / 1000;
+    scheduler->last.tv_nsec += (elapsed % 1000) * 1000000;
+
+    if (scheduler->last.tv_nsec >= 1000000000) {
+        scheduler->last.tv_sec++;
+        scheduler->last.tv_nsec -= 1000000000;
+    }
+
+    long limit = scheduler->burst * scheduler->interval;
+
+    if (elapsed >= limit - scheduler->credit) {
+        scheduler->credit = limit;
+    } else {
+        scheduler->credit += elapsed;
+    }
+}
+
+/**
+ * scheduler_front() - Find the highest priority non-empty lane
+ * @scheduler: Scheduler structure
+ *
+ * Return: Lane index, or SCHEDULER_LANES if every lane is empty
+ */
+static enum scheduler_lane scheduler_front(struct scheduler *scheduler)
+{
+    int lane;
+
+    for (lane = 0; lane < SCHEDULER_LANES; ++lane) {
+        if (scheduler->lanes[lane].count > 0) {
+            break;
+        }
+    }
+
+    return (enum scheduler_lane)lane;
+}
+
+/**
+ * scheduler_classify() - Pick the priority lane for a message
+ * @buf: Raw IRC line, as it will be sent
+ * @len: Length of @buf
+ *
+ * Replies the server is waiting on (PONG), keepalive PINGs, whose round
+ * trip would otherwise measure our own queue, and the registration and
+ * authentication handshake go to the urgent lane so they are never
+ * stuck behind a paste. PRIVMSG and NOTICE are bulk traffic; anything
+ * else (JOIN, MODE, WHOIS, ...) is normal.
+ *
+ * Return: Lane for the message
+ */
+enum scheduler_lane scheduler_classify(const char *buf, size_t len)
+{
+    static const char *urgent[] = {
+        "PONG", "PING", "AUTHENTICATE", "CAP", "NICK", "USER", "PASS",
+        "QUIT"
+    };
+    static const char *bulk[] = {
+        "PRIVMSG", "NOTICE"
+    };
+
+    char word[16];
+    size_t i = 0, n = 0;
+
+    if ((len > 0) && (buf[0] == '@')) {
+        while ((i < len) && (buf[i] != ' ')) {
+            i++;
+        }
+        i++;
+    }
+
+    while ((i < len) && (buf[i] != ' ') && (buf[i] != '\r') &&
+           (n < sizeof(word) - 1)) {
+        word[n++] = toupper((unsigned char)buf[i++]);
+    }
+
+    word[n] = '\0';
+
+    for (size_t j = 0; j < sizeof(urgent) / sizeof(urgent[0]); ++j) {
+        if (strcmp(word, urgent[j]) == 0) {
+            return SCHEDULER_URGENT;
+        }
+    }
+
+    for (size_t j = 0; j < sizeof(bulk) / sizeof(bulk[0]); ++j) {
+        if (strcmp(word, bulk[j]) == 0) {
+            return SCHEDULER_BULK;
+        }
+    }
+
+    return SCHEDULER_NORMAL;
+}
+
+/**
+ * scheduler_push() - Queue a message on its priority lane
+ * @scheduler: Scheduler structure
+ * @buf: Raw IRC line including CRLF
+ * @len: Length of @buf (at most MESSAGE_MAX_LEN)
+ *
+ * Non-urgent messages that cannot leave immediately, because the bucket
+ * is empty or older messages are still waiting, count as delayed. A
+ * full lane drops the message and counts it.
+ *
+ * Return: 0 on success, -1 if the message was dropped
+ */
+int scheduler_push(struct scheduler *scheduler,
+        const char *buf, size_t len)
+{
+    enum scheduler_lane lane = scheduler_classify(buf, len);
+    struct scheduler_queue *queue = &scheduler->lanes[lane];
+
+    if ((queue->count == KIRC_SCHEDULER_DEPTH) ||
+        (len > MESSAGE_MAX_LEN)) {
+        scheduler->dropped++;
+        return -1;
+    }
+
+    scheduler_refill(scheduler);
+
+    if ((lane != SCHEDULER_URGENT) &&
+        ((scheduler->credit < scheduler->interval) ||
+         (scheduler->lanes[SCHEDULER_NORMAL].count > 0) ||
+         (scheduler->lanes[SCHEDULER_BULK].count > 0))) {
+        scheduler->delayed++;
+    }
+
+    size_t slot = (queue->head + queue->count) % KIRC_SCHEDULER_DEPTH;
+    memcpy(queue->slots[slot].data, buf, len);
+    queue->slots[slot].len = len;
+    queue->count++;
+
+    return 0;
+}
+
+/**
+ * scheduler_peek() - Return the next message allowed on the wire
+ * @scheduler: Scheduler structure
+ * @buf: Set to the message bytes
+ * @len: Set to the message length
+ *
+ * Urgent messages are always eligible. Normal and bulk messages wait
+ * until the bucket holds a full interval of credit. The message stays
+ * queued until scheduler_pop() is called, so a caller that cannot
+ * accept it yet loses nothing.
+ *
+ * Return: 0 if a message is ready, -1 otherwise
+ */
+int scheduler_peek(struct scheduler *scheduler,
+        const char **buf, size_t *len)
+{
+    enum scheduler_lane lane = scheduler_front(scheduler);
+
+    if (lane == SCHEDULER_LANES) {
+        return -1;
+    }
+
+    scheduler_refill(scheduler);
+
+    if ((lane != SCHEDULER_URGENT) &&
+        (scheduler->credit < scheduler->interval)) {
+        return -1;
+    }
+
+    struct scheduler_queue *queue = &scheduler->lanes[lane];
+    *buf = queue->slots[queue->head].data;
+    *len = queue->slots[queue->head].len;
+
+    return 0;
+}
+
+/**
+ * scheduler_pop() - Remove the message returned by scheduler_peek()
+ * @scheduler: Scheduler structure
+ *
+ * Charges one interval against the bucket. Urgent messages are charged
+ * too, which may drive the credit negative, so traffic that jumped the
+ * queue still slows down whatever follows it.
+ */
+void scheduler_pop(struct scheduler *scheduler)
+{
+    enum scheduler_lane lane = scheduler_front(scheduler);
+
+    if (lane == SCHEDULER_LANES) {
+        return;
+    }
+
+    struct scheduler_queue *queue = &scheduler->lanes[lane];
+    queue->head = (queue->head + 1) % KIRC_SCHEDULER_DEPTH;
+    queue->count--;
+
+    long floor = -scheduler->burst * scheduler->interval;
+
+    scheduler->credit -= scheduler->interval;
+
+    if (scheduler->credit < floor) {
+        scheduler->credit = floor;
+    }
+}
+
+/**
+ * scheduler_timeout() - Time until the next queued message may be sent
+ * @scheduler: Scheduler structure
+ *
+ * Meant to be used as the poll() timeout of the main loop, after every
+ * eligible message has been handed on. A message that is eligible but
+ * still queued is waiting for socket space, not for the bucket, so
+ * POLLOUT rather than a timeout will wake the loop.
+ *
+ * Return: Milliseconds to wait, or -1 if nothing is waiting on the bucket
+ */
+int scheduler_timeout(struct scheduler *scheduler)
+{
+    enum scheduler_lane lane = scheduler_front(scheduler);
+
+    if ((lane == SCHEDULER_LANES) || (lane == SCHEDULER_URGENT)) {
+        return -1;
+    }
+
+    scheduler_refill(scheduler);
+
+    if (scheduler->credit >= scheduler->interval) {
+        return -1;
+    }
+
+    return (int)(scheduler->interval - scheduler->credit);
+}
+
+/**
+ * scheduler_depth() - Number of messages waiting on a lane
+ * @scheduler: Scheduler structure
+ * @lane: Lane to inspect, or SCHEDULER_LANES for the total
+ *
+ * Return: Queued message count
+ */
+size_t scheduler_depth(struct scheduler *scheduler,
+        enum scheduler_lane lane)
+{
+    if (lane != SCHEDULER_LANES) {
+        return scheduler->lanes[lane].count;
+    }
+
+    size_t total = 0;
+
+    for (int i = 0; i < SCHEDULER_LANES; ++i) {
+        total += scheduler->lanes[i].count;
+    }
+
+    return total;
+}
+
+/**
+ * scheduler_reset() - Discard queued messages and refill the bucket
+ * @scheduler: Scheduler structure
+ *
+ * Used when a new connection starts: the server keeps flood accounting
+ * per connection, so nothing carries over from the previous one. The
+ * delayed and dropped counters are kept.
+ */
+void scheduler_reset(struct scheduler *scheduler)
+{
+    for (int i = 0; i < SCHEDULER_LANES; ++i) {
+        scheduler->lanes[i].head = 0;
+        scheduler->lanes[i].count = 0;
+    }
+
+    scheduler->credit = scheduler->burst * scheduler->interval;
+    clock_gettime(CLOCK_MONOTONIC, &scheduler->last);
+}
+
+/**
+ * scheduler_init() - Initialize the send scheduler
+ * @scheduler: Scheduler structure to initialize
+ * @ctx: IRC context holding the flood control settings
+ *
+ * Allocates KIRC_SCHEDULER_DEPTH message slots per lane and starts with
+ * a full bucket, so the registration burst goes out at once.
+ *
+ * Return: 0 on success, -1 if a parameter is NULL or allocation fails
+ */
+int scheduler_init(struct scheduler *scheduler,
+        struct kirc_context *ctx)
+{
+    if ((scheduler == NULL) || (ctx == NULL)) {
+        return -1;
+    }
+
+    memset(scheduler, 0, sizeof(*scheduler));
+
+    scheduler->ctx = ctx;
+    scheduler->burst = ctx->flood_burst;
+    scheduler->interval = ctx->flood_interval;
+    scheduler->credit = scheduler->burst * scheduler->interval;
+    clock_gettime(CLOCK_MONOTONIC, &scheduler->last);
+
+    for (int i = 0; i < SCHEDULER_LANES; ++i) {
+        scheduler->lanes[i].slots = malloc(KIRC_SCHEDULER_DEPTH *
+            sizeof(struct scheduler_message));
+
+        if (scheduler->lanes[i].slots == NULL) {
+            scheduler_free(scheduler);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * scheduler_free() - Release scheduler resources
+ * @scheduler: Scheduler structure to clean up
+ *
+ * Frees the lane storage. Any queued messages are discarded.
+ *
+ * Return: 0 on success, -1 if scheduler is NULL
+ */
+int scheduler_free(struct scheduler *scheduler)
+{
+    if (scheduler == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < SCHEDULER_LANES; ++i) {
+        free(scheduler->lanes[i].slots);
+        scheduler->lanes[i].slots = NULL;
+        scheduler->lanes[i].count = 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,710 @@
+/*
+ * scrollback.c
+ * In-memory scrollback per channel and query
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "scrollback.h"
+
+/*
+ * Each buffer keeps its lines in a list of fixed-size chunks holding
+ * the line records and, packed behind them, the text. Lines are only
+ * ever appended at the newest chunk and dropped a whole chunk at a
+ * time from the oldest, so storing a line costs no allocation, and a
+ * chunk that falls off one end is reused at the other. Nicknames are
+ * stored once and referenced by id; each line holds a reference, so a
+ * nick goes when the last chunk mentioning it does, and the nick table
+ * stays within the memory limit along with the chunks. Buffers are
+ * kept in least recently used order; when the memory limit is reached,
+ * chunks are taken from the coldest buffer, and a buffer left empty is
+ * dropped altogether.
+ */
+
+/**
+ * scrollback_hash() - FNV-1a hash of a nickname
+ * @nick: Nickname bytes
+ * @len: Length of @nick
+ *
+ * Return: 32-bit hash
+ */
+static uint32_t scrollback_hash(const char *nick, int len)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < len; ++i) {
+        hash ^= (unsigned char)nick[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * scrollback_nick_rehash() - Resize the nickname hash table
+ * @scrollback: Scrollback store
+ * @size: Number of slots, a power of two
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int scrollback_nick_rehash(struct scrollback *scrollback,
+        uint32_t size)
+{
+    uint32_t *slots = calloc(size, sizeof(*slots));
+
+    if (slots == NULL) {
+        return -1;
+    }
+
+    for (uint32_t id = 1; id <= scrollback->nick_count; ++id) {
+        const struct scrollback_nick *entry = &scrollback->nicks[id - 1];
+
+        if (entry->name == NULL) {
+            continue;
+        }
+
+        uint32_t i = entry->hash & (size - 1);
+
+        while (slots[i] != 0) {
+            i = (i + 1) & (size - 1);
+        }
+
+        slots[i] = id;
+    }
+
+    scrollback->memory += (size - (scrollback->nick_mask + 1)) *
+        sizeof(*slots);
+    free(scrollback->nick_slots);
+    scrollback->nick_slots = slots;
+    scrollback->nick_mask = size - 1;
+
+    return 0;
+}
+
+/**
+ * scrollback_nick_slot() - Probe the nickname hash table
+ * @scrollback: Scrollback store
+ * @nick: Nickname bytes, not NUL-terminated
+ * @len: Length of @nick
+ * @hash: scrollback_hash() of @nick
+ *
+ * Return: Slot holding @nick, or the empty slot where it belongs
+ */
+static uint32_t scrollback_nick_slot(struct scrollback *scrollback,
+        const char *nick, int len, uint32_t hash)
+{
+    uint32_t mask = scrollback->nick_mask;
+    uint32_t i = hash & mask;
+
+    while (scrollback->nick_slots[i] != 0) {
+        const struct scrollback_nick *entry =
+            &scrollback->nicks[scrollback->nick_slots[i] - 1];
+
+        if ((entry->hash == hash) &&
+            (strncmp(entry->name, nick, (size_t)len) == 0) &&
+            (entry->name[len] == '\0')) {
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/**
+ * scrollback_nick() - Find or add a nickname and take a reference to it
+ * @scrollback: Scrollback store
+ * @nick: Nickname bytes, not NUL-terminated
+ * @len: Length of @nick
+ *
+ * Every stored line holds one reference to its nick.
+ *
+ * Return: Nick id, or 0 if @len is 0 or the table cannot grow
+ */
+static uint32_t scrollback_nick(struct scrollback *scrollback,
+        const char *nick, int len)
+{
+    if (len <= 0) {
+        return 0;
+    }
+
+    uint32_t hash = scrollback_hash(nick, len);
+    uint32_t i = scrollback_nick_slot(scrollback, nick, len, hash);
+
+    if (scrollback->nick_slots[i] != 0) {
+        uint32_t id = scrollback->nick_slots[i];
+
+        scrollback->nicks[id - 1].refs++;
+        return id;
+    }
+
+    /* keep the table at most half full */
+    if ((scrollback->nick_used + 1) * 2 > scrollback->nick_mask + 1) {
+        if (scrollback_nick_rehash(scrollback,
+            (scrollback->nick_mask + 1) * 2) < 0) {
+            return 0;
+        }
+
+        i = scrollback_nick_slot(scrollback, nick, len, hash);
+    }
+
+    if ((scrollback->nick_free == 0) &&
+        (scrollback->nick_count == scrollback->nick_size)) {
+        uint32_t size = scrollback->nick_size * 2;
+        struct scrollback_nick *nicks = realloc(scrollback->nicks,
+            size * sizeof(*nicks));
+
+        if (nicks == NULL) {
+            return 0;
+        }
+
+        scrollback->memory += (size - scrollback->nick_size) *
+            sizeof(*nicks);
+        scrollback->nicks = nicks;
+        scrollback->nick_size = size;
+    }
+
+    char *copy = malloc((size_t)len + 1);
+
+    if (copy == NULL) {
+        return 0;
+    }
+
+    memcpy(copy, nick, (size_t)len);
+    copy[len] = '\0';
+
+    uint32_t id = scrollback->nick_free;
+
+    if (id != 0) {
+        scrollback->nick_free = scrollback->nicks[id - 1].refs;
+    } else {
+        id = ++scrollback->nick_count;
+    }
+
+    struct scrollback_nick *entry = &scrollback->nicks[id - 1];
+
+    entry->name = copy;
+    entry->hash = hash;
+    entry->refs = 1;
+    scrollback->nick_slots[i] = id;
+    scrollback->nick_used++;
+    scrollback->memory += (size_t)len + 1;
+
+    return id;
+}
+
+/**
+ * scrollback_nick_release() - Drop a line's reference to its nickname
+ * @scrollback: Scrollback store
+ * @id: Nick id, or 0 for none
+ *
+ * The last reference frees the name and hands the id back. The hash
+ * table closes the gap by moving later entries of the probe sequence
+ * back, so lookups never need tombstones.
+ */
+static void scrollback_nick_release(struct scrollback *scrollback,
+        uint32_t id)
+{
+    if (id == 0) {
+        return;
+    }
+
+    struct scrollback_nick *entry = &scrollback->nicks[id - 1];
+
+    if (--entry->refs != 0) {
+        return;
+    }
+
+    uint32_t mask = scrollback->nick_mask;
+    uint32_t *slots = scrollback->nick_slots;
+    uint32_t i = entry->hash & mask;
+
+    while (slots[i] != id) {
+        i = (i + 1) & mask;
+    }
+
+    slots[i] = 0;
+
+    for (uint32_t j = (i + 1) & mask; slots[j] != 0; j = (j + 1) & mask) {
+        uint32_t home = scrollback->nicks[slots[j] - 1].hash & mask;
+
+        /* move back unless its home lies cyclically in (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            slots[i] = slots[j];
+            slots[j] = 0;
+            i = j;
+        }
+    }
+
+    scrollback->memory -= strlen(entry->name) + 1;
+    free(entry->name);
+    entry->name = NULL;
+    entry->refs = scrollback->nick_free;
+    scrollback->nick_free = id;
+    scrollback->nick_used--;
+}
+
+/**
+ * scrollback_forget() - Release the nicknames of a chunk's lines
+ * @scrollback: Scrollback store
+ * @chunk: Chunk whose lines are being dropped
+ */
+static void scrollback_forget(struct scrollback *scrollback,
+        struct scrollback_chunk *chunk)
+{
+    for (int i = 0; i < chunk->count; ++i) {
+        scrollback_nick_release(scrollback, chunk->lines[i].nick);
+    }
+}
+
+/**
+ * scrollback_touch() - Mark a buffer as the most recently used
+ * @scrollback: Scrollback store
+ * @buffer: Buffer in the store
+ */
+static void scrollback_touch(struct scrollback *scrollback,
+        struct scrollback_buffer *buffer)
+{
+    if (scrollback->first == buffer) {
+        return;
+    }
+
+    buffer->prev->next = buffer->next;
+
+    if (buffer->next != NULL) {
+        buffer->next->prev = buffer->prev;
+    } else {
+        scrollback->last = buffer->prev;
+    }
+
+    buffer->prev = NULL;
+    buffer->next = scrollback->first;
+    scrollback->first->prev = buffer;
+    scrollback->first = buffer;
+}
+
+/**
+ * scrollback_find() - Look up the buffer of a channel or query
+ * @scrollback: Scrollback store
+ * @owner: Server the buffer belongs to
+ * @name: Channel or nickname
+ * @create: Whether to create the buffer if it does not exist
+ *
+ * Return: Buffer, or NULL if not found or allocation fails
+ */
+static struct scrollback_buffer *scrollback_find(
+        struct scrollback *scrollback, const void *owner,
+        const char *name, int create)
+{
+    struct scrollback_buffer *buffer;
+
+    for (buffer = scrollback->first; buffer != NULL; buffer = buffer->next) {
+        if ((buffer->owner == owner) && casemap_equals(&scrollback->casemap,
+            buffer->name, strlen(buffer->name), name, strlen(name))) {
+            return buffer;
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    buffer = calloc(1, sizeof(*buffer));
+
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    buffer->owner = owner;
+    safecpy(buffer->name, name, sizeof(buffer->name));
+
+    buffer->next = scrollback->first;
+
+    if (scrollback->first != NULL) {
+        scrollback->first->prev = buffer;
+    } else {
+        scrollback->last = buffer;
+    }
+
+    scrollback->first = buffer;
+    scrollback->buffers++;
+    scrollback->memory += sizeof(*buffer);
+
+    return buffer;
+}
+
+/**
+ * scrollback_drop() - Remove a buffer and free its chunks
+ * @scrollback: Scrollback store
+ * @buffer: Buffer in the store
+ */
+static void scrollback_drop(struct scrollback *scrollback,
+        struct scrollback_buffer *buffer)
+{
+    while (buffer->head != NULL) {
+        struct scrollback_chunk *chunk = buffer->head;
+
+        buffer->head = chunk->next;
+        scrollback_forget(scrollback, chunk);
+        free(chunk);
+        scrollback->memory -= sizeof(*chunk);
+    }
+
+    if (buffer->prev != NULL) {
+        buffer->prev->next = buffer->next;
+    } else {
+        scrollback->first = buffer->next;
+    }
+
+    if (buffer->next != NULL) {
+        buffer->next->prev = buffer->prev;
+    } else {
+        scrollback->last = buffer->prev;
+    }
+
+    free(buffer);
+    scrollback->buffers--;
+    scrollback->memory -= sizeof(*buffer);
+}
+
+/**
+ * scrollback_shift() - Detach the oldest chunk of a buffer
+ * @scrollback: Scrollback store
+ * @buffer: Buffer with at least one chunk
+ *
+ * Return: The detached chunk, its lines counted as evicted and their
+ * nicknames released
+ */
+static struct scrollback_chunk *scrollback_shift(
+        struct scrollback *scrollback, struct scrollback_buffer *buffer)
+{
+    struct scrollback_chunk *chunk = buffer->head;
+
+    buffer->head = chunk->next;
+
+    if (buffer->head == NULL) {
+        buffer->tail = NULL;
+    }
+
+    buffer->count -= (size_t)chunk->count;
+    scrollback->evicted += (unsigned long)chunk->count;
+    scrollback_forget(scrollback, chunk);
+
+    return chunk;
+}
+
+/**
+ * scrollback_chunk() - Obtain an empty chunk for a buffer
+ * @scrollback: Scrollback store
+ * @buffer: Buffer that needs room for a new line
+ *
+ * A buffer at KIRC_SCROLLBACK_LINES recycles its own oldest chunk.
+ * Otherwise a new chunk is allocated while the store is within its
+ * memory limit; past that, the oldest chunk of the least recently used
+ * buffer is taken over instead.
+ *
+ * Return: Empty chunk, or NULL on allocation failure
+ */
+static struct scrollback_chunk *scrollback_chunk(
+        struct scrollback *scrollback, struct scrollback_buffer *buffer)
+{
+    struct scrollback_chunk *chunk = NULL;
+
+    if ((buffer->count >= KIRC_SCROLLBACK_LINES) && (buffer->head != NULL)) {
+        chunk = scrollback_shift(scrollback, buffer);
+    } else if (scrollback->memory + sizeof(*chunk) > scrollback->limit) {
+        struct scrollback_buffer *victim = scrollback->last;
+
+        while ((victim != NULL) && (victim->head == NULL)) {
+            victim = victim->prev;
+        }
+
+        if (victim != NULL) {
+            chunk = scrollback_shift(scrollback, victim);
+
+            if ((victim->head == NULL) && (victim != buffer)) {
+                scrollback_drop(scrollback, victim);
+            }
+        }
+    }
+
+    if (chunk == NULL) {
+        chunk = malloc(sizeof(*chunk));
+
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        scrollback->memory += sizeof(*chunk);
+    }
+
+    chunk->next = NULL;
+    chunk->count = 0;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+/**
+ * scrollback_trim() - Free chunks until the store is within its limit
+ * @scrollback: Scrollback store
+ * @keep: Buffer whose newest chunk must stay
+ *
+ * New nicknames and a growing nick table add to the memory held between
+ * chunk allocations. Whole chunks are given back, coldest buffer first,
+ * until the nick table and the chunks fit again.
+ */
+static void scrollback_trim(struct scrollback *scrollback,
+        struct scrollback_buffer *keep)
+{
+    while (scrollback->memory > scrollback->limit) {
+        struct scrollback_buffer *victim = scrollback->last;
+
+        while ((victim != NULL) && ((victim->head == NULL) ||
+            ((victim == keep) && (victim->head == victim->tail)))) {
+            victim = victim->prev;
+        }
+
+        if (victim == NULL) {
+            break;
+        }
+
+        free(scrollback_shift(scrollback, victim));
+        scrollback->memory -= sizeof(struct scrollback_chunk);
+
+        if ((victim->head == NULL) && (victim != keep)) {
+            scrollback_drop(scrollback, victim);
+        }
+    }
+}
+
+/**
+ * scrollback_add() - Record a line in a channel or query buffer
+ * @scrollback: Scrollback store
+ * @owner: Server the line was received on or sent to
+ * @name: Channel or nickname the line belongs to
+ * @time: When the line was sent
+ * @kind: Message, action or notice
+ * @nick: Sender, not NUL-terminated, may be empty
+ * @nick_len: Length of @nick
+ * @text: Line text, not NUL-terminated
+ * @text_len: Length of @text, cut to MESSAGE_MAX_LEN
+ *
+ * Return: 0 on success, -1 on error
+ */
+int scrollback_add(struct scrollback *scrollback, const void *owner,
+        const char *name, time_t time, enum scrollback_kind kind,
+        const char *nick, int nick_len, const char *text, int text_len)
+{
+    if ((scrollback == NULL) || (name == NULL) || (name[0] == '\0') ||
+        (text == NULL) || (text_len < 0)) {
+        return -1;
+    }
+
+    if (text_len > MESSAGE_MAX_LEN) {
+        text_len = MESSAGE_MAX_LEN;
+    }
+
+    struct scrollback_buffer *buffer = scrollback_find(scrollback,
+        owner, name, 1);
+
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    scrollback_touch(scrollback, buffer);
+
+    struct scrollback_chunk *chunk = buffer->tail;
+
+    if ((chunk == NULL) || (chunk->count == SCROLLBACK_CHUNK_LINES) ||
+        (chunk->used + (uint32_t)text_len > SCROLLBACK_CHUNK_TEXT)) {
+        chunk = scrollback_chunk(scrollback, buffer);
+
+        if (chunk == NULL) {
+            return -1;
+        }
+
+        if (buffer->tail != NULL) {
+            buffer->tail->next = chunk;
+        } else {
+            buffer->head = chunk;
+        }
+
+        buffer->tail = chunk;
+    }
+
+    struct scrollback_line *line = &chunk->lines[chunk->count++];
+
+    line->time = (uint32_t)time;
+    line->nick = scrollback_nick(scrollback, nick, nick_len);
+    line->offset = chunk->used;
+    line->len = (uint16_t)text_len;
+    line->kind = (uint8_t)kind;
+    line->unused = 0;
+
+    memcpy(chunk->text + chunk->used, text, (size_t)text_len);
+    chunk->used += (uint32_t)text_len;
+    buffer->count++;
+
+    scrollback_trim(scrollback, buffer);
+
+    return 0;
+}
+
+/**
+ * scrollback_replay_line() - Display one stored line
+ * @scrollback: Scrollback store
+ * @chunk: Chunk holding the line
+ * @line: Line record
+ * @output: Output buffer for display
+ */
+static void scrollback_replay_line(struct scrollback *scrollback,
+        const struct scrollback_chunk *chunk,
+        const struct scrollback_line *line, struct output *output)
+{
+    char timestamp[KIRC_TIMESTAMP_SIZE];
+    time_t when = (time_t)line->time;
+    const char *nick = "";
+    const char *text = chunk->text + line->offset;
+
+    strftime(timestamp, sizeof(timestamp), KIRC_TIMESTAMP_FORMAT,
+        localtime(&when));
+
+    if (line->nick != 0) {
+        nick = scrollback->nicks[line->nick - 1].name;
+    }
+
+    switch (line->kind) {
+    case SCROLLBACK_ACTION:
+        output_append(output, "\r" CLEAR_LINE DIM "%s \u2022 %s %.*s"
+            RESET "\r\n", timestamp, nick, line->len, text);
+        break;
+
+    case SCROLLBACK_NOTICE:
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
+            " " BOLD_BLUE "%s" RESET " %.*s\r\n",
+            timestamp, nick, line->len, text);
+        break;
+
+    default:
+        output_append(output, "\r" CLEAR_LINE DIM "%s" RESET
+            " " BOLD "%s" RESET " %.*s\r\n",
+            timestamp, nick, line->len, text);
+        break;
+    }
+}
+
+/**
+ * scrollback_replay() - Display the most recent lines of a buffer
+ * @scrollback: Scrollback store
+ * @owner: Server the buffer belongs to
+ * @name: Channel or nickname
+ * @lines: Maximum number of lines to show
+ * @output: Output buffer for display
+ *
+ * Whole chunks before the first wanted line are skipped without
+ * looking at their lines.
+ *
+ * Return: Number of lines shown, or -1 if there is no such buffer
+ */
+int scrollback_replay(struct scrollback *scrollback, const void *owner,
+        const char *name, size_t lines, struct output *output)
+{
+    struct scrollback_buffer *buffer = scrollback_find(scrollback,
+        owner, name, 0);
+
+    if ((buffer == NULL) || (buffer->count == 0)) {
+        output_append(output, "\r" CLEAR_LINE DIM
+            "history: nothing kept for %s" RESET "\r\n", name);
+        return -1;
+    }
+
+    scrollback_touch(scrollback, buffer);
+
+    if (lines > buffer->count) {
+        lines = buffer->count;
+    }
+
+    output_append(output, "\r" CLEAR_LINE DIM
+        "history: last %zu of %zu lines in %s" RESET "\r\n",
+        lines, buffer->count, buffer->name);
+
+    size_t skip = buffer->count - lines;
+    struct scrollback_chunk *chunk = buffer->head;
+
+    while ((chunk != NULL) && (skip >= (size_t)chunk->count)) {
+        skip -= (size_t)chunk->count;
+        chunk = chunk->next;
+    }
+
+    for (; chunk != NULL; chunk = chunk->next) {
+        for (int i = (int)skip; i < chunk->count; ++i) {
+            scrollback_replay_line(scrollback, chunk, &chunk->lines[i],
+                output);
+        }
+
+        skip = 0;
+    }
+
+    return (int)lines;
+}
+
+/**
+ * scrollback_init() - Initialize an empty scrollback store
+ * @scrollback: Scrollback store to initialize
+ * @limit: Memory limit in bytes
+ *
+ * Return: 0 on success, -1 if scrollback is NULL or allocation fails
+ */
+int scrollback_init(struct scrollback *scrollback, size_t limit)
+{
+    if (scrollback == NULL) {
+        return -1;
+    }
+
+    memset(scrollback, 0, sizeof(*scrollback));
+    casemap_init(&scrollback->casemap, CASEMAPPING_RFC1459);
+    scrollback->limit = limit;
+    scrollback->nick_size = 128;
+    scrollback->nick_mask = 255;
+
+    scrollback->nicks = malloc(scrollback->nick_size *
+        sizeof(*scrollback->nicks));
+    scrollback->nick_slots = calloc(scrollback->nick_mask + 1,
+        sizeof(*scrollback->nick_slots));
+
+    if ((scrollback->nicks == NULL) || (scrollback->nick_slots == NULL)) {
+        scrollback_free(scrollback);
+        return -1;
+    }
+
+    scrollback->memory = scrollback->nick_size * sizeof(*scrollback->nicks) +
+        (scrollback->nick_mask + 1) * sizeof(*scrollback->nick_slots);
+
+    return 0;
+}
+
+/**
+ * scrollback_free() - Release every buffer and the nick table
+ * @scrollback: Scrollback store to clean up
+ *
+ * Return: 0 on success, -1 if scrollback is NULL
+ */
+int scrollback_free(struct scrollback *scrollback)
+{
+    if (scrollback == NULL) {
+        return -1;
+    }
+
+    while (scrollback->first != NULL) {
+        scrollback_drop(scrollback, scrollback->first);
+    }
+
+    free(scrollback->nicks);
+    free(scrollback->nick_slots);
+    scrollback->nicks = NULL;
+    scrollback->nick_slots = NULL;
+
+    return 0;
+}
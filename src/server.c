@@ -0,0 +1,365 @@
+/*
+ * server.c
+ * Per-server connection state and servicing
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "server.h"
+
+/**
+ * server_service() - Handle socket readiness on a live connection
+ * @server: Server connection
+ * @handler: Event handler table
+ * @dcc: DCC transfer state
+ * @output: Output buffer for display
+ *
+ * Flushes queued messages when the socket is writable, then reads and
+ * dispatches every complete line that arrived, then writes out what the
+ * chat log buffered. Over TLS either direction may be blocked on the
+ * other, so both are retried when the event the library waits for
+ * fires, and data already decrypted by the library counts as readable
+ * even though poll() cannot see it. A read that finds no data, e.g.
+ * only a session ticket, is not a disconnect.
+ *
+ * Return: 1 if data was read, 0 if not, -1 if the connection was lost
+ */
+static int server_service(struct server *server, struct handler *handler,
+        struct dcc *dcc, struct output *output)
+{
+    struct network *network = &server->network;
+    struct transport *transport = &server->transport;
+    short ready = (server->nfds > 0) ? server->fds[0].revents : 0;
+
+    if (ready & (POLLERR | POLLNVAL)) {
+        return -1;
+    }
+
+    if (ready & transport_events(transport)) {
+        ready |= POLLIN | POLLOUT;
+    }
+
+    if ((ready & POLLOUT) && (network_pending(network) > 0)) {
+        if (network_flush(network) < 0) {
+            return -1;
+        }
+    }
+
+    if (!(ready & (POLLIN | POLLHUP)) &&
+        (transport_pending(transport) == 0)) {
+        return 0;
+    }
+
+    /* POLLHUP may still leave unread data, e.g. a final ERROR line */
+    int recv = network_receive(network);
+    char *msg;
+
+    while ((msg = network_next_message(network)) != NULL) {
+        struct event event;
+        event_init(&event, network->ctx);
+        event_parse(&event, msg);
+
+        handler_dispatch(handler, network, &event, output);
+        dcc_handle(dcc, network, &event);
+    }
+
+    chatlog_flush(&network->chatlog);
+
+    if (recv < 0) {
+        return -1;
+    }
+
+    return (recv > 0) ? 1 : 0;
+}
+
+/**
+ * server_mark() - Queue a server for servicing after this poll()
+ * @server: Server connection
+ *
+ * Does nothing if the server is already queued.
+ */
+void server_mark(struct server *server)
+{
+    if (server->ready) {
+        return;
+    }
+
+    server->ready = 1;
+    server->next = *server->work;
+    *server->work = server;
+}
+
+/**
+ * server_wake() - Queue a server whose timed work is due
+ * @timer: The server's wake timer
+ * @data: Server connection
+ */
+static void server_wake(struct timer *timer, void *data)
+{
+    (void)timer;
+    server_mark(data);
+}
+
+/**
+ * server_events() - Bring a server's loop registrations up to date
+ * @server: Server connection
+ * @loop: Event loop shared by all servers
+ *
+ * Called only when the server may have changed, i.e. after it was
+ * serviced or sent user input, so idle servers cost nothing per poll().
+ * A live connection keeps its socket registered for as long as it is
+ * up, and only its interest changes, gaining POLLOUT while bytes are
+ * queued. A reconnecting one registers its pending connect attempts and
+ * keeps those still in flight. A finished attempt's descriptor number is
+ * often reused by the next one, which the kernel has not seen yet, so
+ * once the transport has opened descriptors since the last update, the
+ * ones kept by number are registered afresh. The next timed work, be it
+ * the flood bucket, a connect deadline or the reconnect backoff, is
+ * armed on the wake timer; work that cannot wait queues the server.
+ *
+ * Return: Number of registered descriptors
+ */
+int server_events(struct server *server, struct loop *loop)
+{
+    struct network *network = &server->network;
+    struct pollfd want[KIRC_CONNECT_ATTEMPTS];
+    int timeout = -1;
+    int n = 0;
+
+    switch (network->state) {
+    case NETWORK_ONLINE:
+        timeout = network_schedule(network);
+
+        want[0].fd = server->transport.fd;
+        want[0].events = POLLIN | transport_events(&server->transport);
+        n = 1;
+
+        if (network_pending(network) > 0) {
+            want[0].events |= POLLOUT;
+        }
+
+        if ((transport_pending(&server->transport) > 0) || network->dead) {
+            server_mark(server);
+        }
+        break;
+
+    case NETWORK_WAITING:
+    case NETWORK_CONNECTING:
+        n = network_reconnect_events(network, want, KIRC_CONNECT_ATTEMPTS);
+        timeout = network_reconnect_timeout(network);
+        break;
+
+    default:
+        break;
+    }
+
+    if (timeout >= 0) {
+        timer_start(network->wheel, &server->wake, timeout);
+    } else {
+        timer_stop(network->wheel, &server->wake);
+    }
+
+    int fresh = (server->transport.opened != server->opened);
+
+    for (int i = 0; i < server->nfds; ++i) {
+        int keep = 0;
+
+        for (int j = 0; j < n; ++j) {
+            keep |= (want[j].fd == server->fds[i].fd);
+        }
+
+        if (!keep) {
+            loop_remove(loop, server->fds[i].fd, server);
+        }
+    }
+
+    for (int j = 0; j < n; ++j) {
+        int known = 0;
+
+        for (int i = 0; !fresh && (i < server->nfds); ++i) {
+            known |= (server->fds[i].fd == want[j].fd);
+        }
+
+        if (known) {
+            loop_modify(loop, want[j].fd, want[j].events, server);
+        } else {
+            loop_add(loop, want[j].fd, want[j].events, server, 0);
+        }
+    }
+
+    for (int j = 0; j < n; ++j) {
+        want[j].revents = 0;
+    }
+
+    memcpy(server->fds, want, (size_t)n * sizeof(want[0]));
+    server->nfds = n;
+    server->opened = server->transport.opened;
+
+    return n;
+}
+
+/**
+ * server_ready() - Record readiness reported by the event loop
+ * @server: Server connection
+ * @fd: Descriptor that became ready
+ * @revents: poll() event bits
+ *
+ * Also queues the server for servicing.
+ */
+void server_ready(struct server *server, int fd, short revents)
+{
+    server_mark(server);
+
+    for (int i = 0; i < server->nfds; ++i) {
+        if (server->fds[i].fd == fd) {
+            server->fds[i].revents = revents;
+            return;
+        }
+    }
+}
+
+/**
+ * server_process() - Service a server after poll()
+ * @server: Server connection
+ * @handler: Event handler table
+ * @dcc: DCC transfer state
+ * @output: Output buffer for display
+ *
+ * Reads and dispatches traffic on a live connection, or advances the
+ * reconnect state machine otherwise. A lost connection, or one whose
+ * keepalive PING went unanswered, is handed to network_disconnect(),
+ * which schedules the next attempt.
+ *
+ * Return: 1 if output may have changed, 0 if not, -1 once the server
+ * has given up reconnecting
+ */
+int server_process(struct server *server, struct handler *handler,
+        struct dcc *dcc, struct output *output)
+{
+    struct network *network = &server->network;
+    int rc;
+
+    switch (network->state) {
+    case NETWORK_ONLINE:
+        if (network->dead) {
+            output_append(output, "\r" CLEAR_LINE DIM
+                "ping: no reply from %s in %d s" RESET "\r\n",
+                server->ctx->server, KIRC_PING_TIMEOUT_MS / 1000);
+            rc = -1;
+        } else {
+            rc = server_service(server, handler, dcc, output);
+        }
+
+        if (rc >= 0) {
+            return rc;
+        }
+
+        return (network_disconnect(network, output) < 0) ? -1 : 1;
+
+    case NETWORK_WAITING:
+    case NETWORK_CONNECTING:
+        rc = network_reconnect_process(network, server->fds,
+            server->nfds, output);
+
+        return (rc < 0) ? -1 : 1;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * server_find() - Look up a server by name or position
+ * @servers: Array of servers
+ * @count: Number of entries in @servers
+ * @name: Server hostname as configured, or its 1-based position
+ *
+ * Return: Index into @servers, or -1 if nothing matches
+ */
+int server_find(struct server *servers, int count, const char *name)
+{
+    for (int i = 0; i < count; ++i) {
+        if (strcmp(servers[i].ctx->server, name) == 0) {
+            return i;
+        }
+    }
+
+    char *endptr;
+    long index = strtol(name, &endptr, 10);
+
+    if ((endptr == name) || (*endptr != '\0') ||
+        (index < 1) || (index > count)) {
+        return -1;
+    }
+
+    return (int)index - 1;
+}
+
+/**
+ * server_init() - Initialize a server connection
+ * @server: Server structure to initialize
+ * @ctx: Configuration of this server
+ * @wheel: Timer wheel shared by all servers
+ * @scrollback: Scrollback store shared by all servers
+ * @work: List the server joins whenever it needs servicing
+ *
+ * Sets up the transport and the network layer, each with its own
+ * receive buffer, send queue, scheduler and keepalive timer. The
+ * connection is not started.
+ *
+ * Return: 0 on success, -1 if any parameter is NULL or setup fails
+ */
+int server_init(struct server *server, struct kirc_context *ctx,
+        struct timer_wheel *wheel, struct scrollback *scrollback,
+        struct server **work)
+{
+    if ((server == NULL) || (ctx == NULL) || (work == NULL)) {
+        return -1;
+    }
+
+    memset(server, 0, sizeof(*server));
+
+    server->ctx = ctx;
+    server->work = work;
+    timer_setup(&server->wake, server_wake, server);
+
+    if (transport_init(&server->transport, ctx) < 0) {
+        return -1;
+    }
+
+    if (network_init(&server->network, &server->transport, ctx,
+        wheel, scrollback) < 0) {
+        transport_free(&server->transport);
+        return -1;
+    }
+
+    server->network.wake = &server->wake;
+
+    return 0;
+}
+
+/**
+ * server_free() - Free server connection resources
+ * @server: Server structure to clean up
+ * @loop: Event loop the server's descriptors are registered with
+ *
+ * Unregisters and closes the connection, stops the wake timer and
+ * releases the network and transport layers.
+ *
+ * Return: 0 on success, -1 if cleanup fails
+ */
+int server_free(struct server *server, struct loop *loop)
+{
+    if (server == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < server->nfds; ++i) {
+        loop_remove(loop, server->fds[i].fd, server);
+    }
+
+    server->nfds = 0;
+    timer_stop(server->network.wheel, &server->wake);
+
+    return network_free(&server->network);
+}
@@ -7,6 +7,39 @@
 
 #include "terminal.h"
 
+static volatile sig_atomic_t terminal_winch;  /* set by SIGWINCH */
+
+/**
+ * terminal_on_winch() - SIGWINCH handler
+ * @sig: Signal number (unused)
+ *
+ * Only notes that the window changed; terminal_resized() reports it.
+ */
+static void terminal_on_winch(int sig)
+{
+    (void)sig;
+    terminal_winch = 1;
+}
+
+/**
+ * terminal_resized() - Check whether the window changed size
+ *
+ * Lets callers keep the width from terminal_columns() until the
+ * terminal reports a new one, rather than asking on every redraw.
+ *
+ * Return: 1 if a SIGWINCH arrived since the last call, 0 otherwise
+ */
+int terminal_resized(void)
+{
+    if (!terminal_winch) {
+        return 0;
+    }
+
+    terminal_winch = 0;
+
+    return 1;
+}
+
 /**
  * terminal_get_cursor_column() - Query terminal cursor column position
  * @in_fd: File descriptor to read response from
@@ -111,7 +144,10 @@ int terminal_columns(int tty_fd)
  * Configures the terminal for raw (non-canonical) input mode, disabling
  * line buffering, echo, and signal generation. Saves the original terminal
  * settings for later restoration. Required for character-by-character input
- * processing.
+ * processing. Also turns on bracketed paste, so the editor can tell a
+ * paste from typing, and starts listening for SIGWINCH. The handler is
+ * installed without SA_RESTART, so a resize interrupts poll() and the
+ * prompt is redrawn at once.
  *
  * Return: 0 on success, -1 if stdin is not a TTY or configuration fails
  */
@@ -145,6 +181,16 @@ int terminal_enable_raw(struct terminal *terminal)
 
     terminal->raw_mode_enabled = 1;
 
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = terminal_on_winch;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+
+    printf(PASTE_ON);
+    fflush(stdout);
+
     return 0;
 }
 
@@ -153,8 +199,9 @@ int terminal_enable_raw(struct terminal *terminal)
  * @terminal: Terminal state structure
  *
  * Restores the terminal to its original configuration, re-enabling
- * line buffering, echo, and signal generation. Should be called before
- * program exit or when switching away from raw mode.
+ * line buffering, echo, and signal generation, and turns bracketed
+ * paste off again. Should be called before program exit or when
+ * switching away from raw mode.
  */
 void terminal_disable_raw(struct terminal *terminal)
 {
@@ -162,6 +209,9 @@ void terminal_disable_raw(struct terminal *terminal)
         return;
     }
 
+    printf(PASTE_OFF);
+    fflush(stdout);
+
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &terminal->original);
     terminal->raw_mode_enabled = 0;
 }
@@ -0,0 +1,342 @@
+/*
+ * timer.c
+ * Hierarchical timer wheel
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "timer.h"
+
+/*
+ * Time is counted in ticks of KIRC_TIMER_TICK_MS. Level 0 holds timers
+ * due within the next TIMER_SLOTS ticks, one slot per tick; each level
+ * above covers TIMER_SLOTS times the span of the one below. When level
+ * 0 wraps around, the next slot of level 1 is cascaded down, and so on
+ * upwards, so arming and stopping a timer are O(1) and a timer moves at
+ * most TIMER_LEVELS - 1 times before it fires.
+ */
+
+/**
+ * timer_now() - Milliseconds since the wheel was created
+ * @wheel: Timer wheel
+ *
+ * Return: Elapsed monotonic time in milliseconds
+ */
+static uint64_t timer_now(struct timer_wheel *wheel)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long long ms = (long long)(now.tv_sec - wheel->origin.tv_sec) * 1000 +
+        (now.tv_nsec - wheel->origin.tv_nsec) / 1000000L;
+
+    return (ms > 0) ? (uint64_t)ms : 0;
+}
+
+/**
+ * timer_link() - Put an armed timer into the slot for its expiry
+ * @wheel: Timer wheel
+ * @timer: Timer with expires set
+ */
+static void timer_link(struct timer_wheel *wheel, struct timer *timer)
+{
+    if (timer->expires < wheel->tick) {
+        timer->expires = wheel->tick;
+    }
+
+    uint64_t delta = timer->expires - wheel->tick;
+    uint64_t max = (uint64_t)1 << (TIMER_BITS * TIMER_LEVELS);
+
+    if (delta >= max) {
+        timer->expires = wheel->tick + max - 1;
+        delta = max - 1;
+    }
+
+    int level = 0;
+
+    while (delta >= ((uint64_t)1 << (TIMER_BITS * (level + 1)))) {
+        level++;
+    }
+
+    int index = (int)((timer->expires >> (TIMER_BITS * level)) &
+        (TIMER_SLOTS - 1));
+    struct timer **head = &wheel->slots[level][index];
+
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+
+    wheel->count++;
+}
+
+/**
+ * timer_unlink() - Take a timer out of whatever list holds it
+ * @wheel: Timer wheel
+ * @timer: Armed timer
+ */
+static void timer_unlink(struct timer_wheel *wheel, struct timer *timer)
+{
+    *timer->pprev = timer->next;
+
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+
+    wheel->count--;
+}
+
+/**
+ * timer_next() - Find the next tick that has work
+ * @wheel: Timer wheel
+ *
+ * That is either a level 0 slot with timers to fire, or the boundary at
+ * which a non-empty slot of a higher level is cascaded down.
+ *
+ * Return: Tick number, or UINT64_MAX if no timer is armed
+ */
+static uint64_t timer_next(struct timer_wheel *wheel)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (int level = 0; level < TIMER_LEVELS; ++level) {
+        int shift = TIMER_BITS * level;
+        uint64_t base = wheel->tick >> shift;
+
+        /* above level 0 the current slot was already cascaded, so
+         * anything in it belongs to the next time round */
+        int first = (level == 0) ? 0 : 1;
+        int last = (level == 0) ? TIMER_SLOTS - 1 : TIMER_SLOTS;
+
+        for (int j = first; j <= last; ++j) {
+            int index = (int)((base + (uint64_t)j) & (TIMER_SLOTS - 1));
+
+            if (wheel->slots[level][index] != NULL) {
+                uint64_t when = (base + (uint64_t)j) << shift;
+
+                if (when < next) {
+                    next = when;
+                }
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+/**
+ * timer_cascade() - Redistribute a higher-level slot
+ * @wheel: Timer wheel
+ * @level: Level of the slot, at least 1
+ * @index: Slot index
+ */
+static void timer_cascade(struct timer_wheel *wheel, int level, int index)
+{
+    struct timer *timer = wheel->slots[level][index];
+
+    wheel->slots[level][index] = NULL;
+
+    while (timer != NULL) {
+        struct timer *next = timer->next;
+
+        wheel->count--;
+        timer_link(wheel, timer);
+        timer = next;
+    }
+}
+
+/**
+ * timer_boundary() - Cascade the slots that begin at the current tick
+ * @wheel: Timer wheel
+ *
+ * Every TIMER_SLOTS ticks the next level 1 slot is handed down to level
+ * 0, every TIMER_SLOTS level 1 slots the next level 2 slot, and so on.
+ * Must run whenever the wheel arrives on such a boundary, whether there
+ * was work due there or the wheel only caught up with the clock.
+ */
+static void timer_boundary(struct timer_wheel *wheel)
+{
+    if ((wheel->tick & (TIMER_SLOTS - 1)) != 0) {
+        return;
+    }
+
+    for (int level = 1; level < TIMER_LEVELS; ++level) {
+        int slot = (int)((wheel->tick >> (TIMER_BITS * level)) &
+            (TIMER_SLOTS - 1));
+
+        timer_cascade(wheel, level, slot);
+
+        if (slot != 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * timer_setup() - Prepare a timer for use
+ * @timer: Timer to initialize
+ * @fn: Function called when the timer fires
+ * @data: Argument passed to @fn
+ */
+void timer_setup(struct timer *timer, timer_fn fn, void *data)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->data = data;
+}
+
+/**
+ * timer_start() - Arm or re-arm a timer
+ * @wheel: Timer wheel
+ * @timer: Timer set up with timer_setup()
+ * @ms: Delay in milliseconds
+ *
+ * A timer that is already armed is moved to the new expiry. It fires
+ * once, no earlier than @ms from now, the next time timer_advance()
+ * runs after that.
+ */
+void timer_start(struct timer_wheel *wheel, struct timer *timer, long ms)
+{
+    if (timer->pprev != NULL) {
+        timer_unlink(wheel, timer);
+    }
+
+    if (ms < 0) {
+        ms = 0;
+    }
+
+    uint64_t due = timer_now(wheel) + (uint64_t)ms;
+
+    timer->expires = (due + KIRC_TIMER_TICK_MS - 1) / KIRC_TIMER_TICK_MS;
+    timer_link(wheel, timer);
+}
+
+/**
+ * timer_stop() - Disarm a timer
+ * @wheel: Timer wheel
+ * @timer: Timer, armed or not
+ */
+void timer_stop(struct timer_wheel *wheel, struct timer *timer)
+{
+    if (timer->pprev != NULL) {
+        timer_unlink(wheel, timer);
+    }
+}
+
+/**
+ * timer_pending() - Check whether a timer is armed
+ * @timer: Timer
+ *
+ * Return: 1 if armed, 0 otherwise
+ */
+int timer_pending(const struct timer *timer)
+{
+    return timer->pprev != NULL;
+}
+
+/**
+ * timer_timeout() - Time until the wheel needs attention
+ * @wheel: Timer wheel
+ *
+ * Suitable as a poll() timeout. The wheel may ask to be woken for a
+ * cascade that fires nothing, at most once per level per timer.
+ *
+ * Return: Milliseconds to wait, or -1 if no timer is armed
+ */
+int timer_timeout(struct timer_wheel *wheel)
+{
+    if (wheel->count == 0) {
+        return -1;
+    }
+
+    uint64_t due = timer_next(wheel) * KIRC_TIMER_TICK_MS;
+    uint64_t now = timer_now(wheel);
+
+    if (due <= now) {
+        return 0;
+    }
+
+    if (due - now > INT_MAX) {
+        return INT_MAX;
+    }
+
+    return (int)(due - now);
+}
+
+/**
+ * timer_advance() - Run every timer that is due
+ * @wheel: Timer wheel
+ *
+ * Catches the wheel up with the clock, skipping straight over ticks
+ * with nothing to do. Callbacks may arm or stop any timer, including
+ * the one that fired.
+ *
+ * Return: Number of timers fired
+ */
+int timer_advance(struct timer_wheel *wheel)
+{
+    uint64_t target = timer_now(wheel) / KIRC_TIMER_TICK_MS;
+    int fired = 0;
+
+    while (wheel->tick <= target) {
+        uint64_t next = timer_next(wheel);
+
+        if (next > target) {
+            /* timer_next() takes a boundary stepped onto as cascaded */
+            wheel->tick = target + 1;
+            timer_boundary(wheel);
+            break;
+        }
+
+        wheel->tick = next;
+        timer_boundary(wheel);
+
+        int index = (int)(wheel->tick & (TIMER_SLOTS - 1));
+
+        /* detach the due list so timers re-armed for "now" wait a tick */
+        struct timer *list = wheel->slots[0][index];
+
+        wheel->slots[0][index] = NULL;
+        if (list != NULL) {
+            list->pprev = &list;
+        }
+
+        wheel->tick++;
+
+        while (list != NULL) {
+            struct timer *timer = list;
+
+            timer_unlink(wheel, timer);
+            timer->fn(timer, timer->data);
+            fired++;
+        }
+    }
+
+    return fired;
+}
+
+/**
+ * timer_init() - Initialize a timer wheel
+ * @wheel: Timer wheel to initialize
+ *
+ * Return: 0 on success, -1 if wheel is NULL
+ */
+int timer_init(struct timer_wheel *wheel)
+{
+    if (wheel == NULL) {
+        return -1;
+    }
+
+    memset(wheel, 0, sizeof(*wheel));
+    clock_gettime(CLOCK_MONOTONIC, &wheel->origin);
+
+    return 0;
+}
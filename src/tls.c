@@ -0,0 +1,490 @@
+/*
+ * tls.c
+ * TLS transport backend
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "tls.h"
+
+#if defined(KIRC_TLS_OPENSSL)
+
+/*
+ * OpenSSL (or LibreSSL) backend. Another library can be supported by
+ * providing the same functions under its own KIRC_TLS_* flag.
+ */
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+/**
+ * tls_set_error() - Record the most recent library error
+ * @tls: TLS structure
+ * @what: Operation that failed
+ */
+static void tls_set_error(struct tls *tls, const char *what)
+{
+    unsigned long code = ERR_get_error();
+
+    if (code != 0) {
+        char reason[200];
+        ERR_error_string_n(code, reason, sizeof(reason));
+        snprintf(tls->error, sizeof(tls->error), "%s: %s", what, reason);
+    } else {
+        snprintf(tls->error, sizeof(tls->error), "%s failed", what);
+    }
+
+    ERR_clear_error();
+}
+
+/**
+ * tls_retry() - Classify a failed non-blocking TLS call
+ * @tls: TLS structure
+ * @rc: Return value of the SSL_* call
+ * @what: Operation, for the error message
+ *
+ * WANT_READ and WANT_WRITE are not errors: they record in @tls->want
+ * which poll event must fire before the call is repeated. Either can
+ * be returned by any call, e.g. a read may need to write during a key
+ * update.
+ *
+ * Return: 0 if the call should be retried later, -1 on failure
+ */
+static int tls_retry(struct tls *tls, int rc, const char *what)
+{
+    SSL *ssl = tls->session;
+
+    switch (SSL_get_error(ssl, rc)) {
+    case SSL_ERROR_WANT_READ:
+        tls->want = POLLIN;
+        return 0;
+
+    case SSL_ERROR_WANT_WRITE:
+        tls->want = POLLOUT;
+        return 0;
+
+    case SSL_ERROR_ZERO_RETURN:
+        snprintf(tls->error, sizeof(tls->error), "connection closed");
+        return -1;
+
+    case SSL_ERROR_SSL:
+        if (SSL_get_verify_result(ssl) != X509_V_OK) {
+            snprintf(tls->error, sizeof(tls->error), "%s: %s", what,
+                X509_verify_cert_error_string(SSL_get_verify_result(ssl)));
+            ERR_clear_error();
+        } else {
+            tls_set_error(tls, what);
+        }
+        return -1;
+
+    default:
+        snprintf(tls->error, sizeof(tls->error), "%s: %s", what,
+            (errno != 0) ? strerror(errno) : "unexpected end of stream");
+        ERR_clear_error();
+        return -1;
+    }
+}
+
+/**
+ * tls_session_save() - Store a new session ticket on disk
+ * @ssl: Connection that received the ticket
+ * @session: Session to store
+ *
+ * Called by the library whenever the server issues a ticket, which for
+ * TLS 1.3 happens after the handshake. The file is created with mode
+ * 0600 because it holds resumption secrets.
+ *
+ * Return: 0, as no reference to @session is kept
+ */
+static int tls_session_save(SSL *ssl, SSL_SESSION *session)
+{
+    struct tls *tls = SSL_get_app_data(ssl);
+
+    if ((tls->session_path[0] == '\0') ||
+        !SSL_SESSION_is_resumable(session)) {
+        return 0;
+    }
+
+    int fd = open(tls->session_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+    if (fd < 0) {
+        return 0;
+    }
+
+    FILE *fp = fdopen(fd, "w");
+
+    if (fp == NULL) {
+        close(fd);
+        return 0;
+    }
+
+    PEM_write_SSL_SESSION(fp, session);
+    fclose(fp);
+
+    return 0;
+}
+
+/**
+ * tls_session_load() - Offer a cached session for resumption
+ * @tls: TLS structure
+ * @ssl: Connection about to handshake
+ *
+ * A missing, stale or unreadable cache file simply means a full
+ * handshake.
+ */
+static void tls_session_load(struct tls *tls, SSL *ssl)
+{
+    if (tls->session_path[0] == '\0') {
+        return;
+    }
+
+    FILE *fp = fopen(tls->session_path, "r");
+
+    if (fp == NULL) {
+        return;
+    }
+
+    SSL_SESSION *session = PEM_read_SSL_SESSION(fp, NULL, NULL, NULL);
+    fclose(fp);
+
+    if (session != NULL) {
+        SSL_set_session(ssl, session);
+        SSL_SESSION_free(session);
+    }
+
+    ERR_clear_error();
+}
+
+/**
+ * tls_start() - Prepare a TLS client session on a connected socket
+ * @tls: TLS structure
+ * @fd: Connected, non-blocking socket
+ *
+ * Sets up certificate verification against the system trust store and
+ * the configured server name (sent as SNI unless it is an address), the
+ * optional client certificate used by SASL EXTERNAL, and a cached
+ * session if one exists. The handshake itself is driven by
+ * tls_handshake().
+ *
+ * Return: 0 on success, -1 on failure (see @tls->error)
+ */
+int tls_start(struct tls *tls, int fd)
+{
+    tls_close(tls);
+
+    tls->error[0] = '\0';
+    tls->resumed = 0;
+
+    SSL_CTX *config = SSL_CTX_new(TLS_client_method());
+
+    if (config == NULL) {
+        tls_set_error(tls, "SSL_CTX_new");
+        return -1;
+    }
+
+    tls->config = config;
+
+    SSL_CTX_set_min_proto_version(config, TLS1_2_VERSION);
+    SSL_CTX_set_verify(config, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_mode(config, SSL_MODE_ENABLE_PARTIAL_WRITE |
+        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    SSL_CTX_set_session_cache_mode(config, SSL_SESS_CACHE_CLIENT |
+        SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(config, tls_session_save);
+
+    if (SSL_CTX_set_default_verify_paths(config) != 1) {
+        tls_set_error(tls, "trust store");
+        tls_close(tls);
+        return -1;
+    }
+
+    const char *cert = tls->ctx->tls_cert;
+
+    if ((cert[0] != '\0') &&
+        ((SSL_CTX_use_certificate_chain_file(config, cert) != 1) ||
+         (SSL_CTX_use_PrivateKey_file(config, cert,
+            SSL_FILETYPE_PEM) != 1))) {
+        tls_set_error(tls, "client certificate");
+        tls_close(tls);
+        return -1;
+    }
+
+    SSL *ssl = SSL_new(config);
+
+    if (ssl == NULL) {
+        tls_set_error(tls, "SSL_new");
+        tls_close(tls);
+        return -1;
+    }
+
+    tls->session = ssl;
+    SSL_set_app_data(ssl, tls);
+
+    const char *server = tls->ctx->server;
+    unsigned char addr[sizeof(struct in6_addr)];
+    int literal = (inet_pton(AF_INET, server, addr) == 1) ||
+        (inet_pton(AF_INET6, server, addr) == 1);
+
+    if (literal) {
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), server);
+    } else {
+        SSL_set_tlsext_host_name(ssl, server);
+        SSL_set1_host(ssl, server);
+    }
+
+    if (SSL_set_fd(ssl, fd) != 1) {
+        tls_set_error(tls, "SSL_set_fd");
+        tls_close(tls);
+        return -1;
+    }
+
+    tls_session_load(tls, ssl);
+    SSL_set_connect_state(ssl);
+    tls->want = POLLOUT;
+
+    return 0;
+}
+
+/**
+ * tls_handshake() - Advance the TLS handshake
+ * @tls: TLS structure set up by tls_start()
+ *
+ * Return: 1 when complete, 0 if waiting on @tls->want, -1 on failure
+ */
+int tls_handshake(struct tls *tls)
+{
+    ERR_clear_error();
+    errno = 0;
+
+    int rc = SSL_do_handshake(tls->session);
+
+    if (rc == 1) {
+        tls->want = 0;
+        tls->resumed = SSL_session_reused(tls->session);
+        return 1;
+    }
+
+    return tls_retry(tls, rc, "handshake");
+}
+
+/**
+ * tls_read() - Read decrypted data
+ * @tls: TLS structure
+ * @buffer: Buffer to store the data
+ * @len: Maximum number of bytes to read
+ *
+ * Behaves like read() on a non-blocking socket. A read finding only a
+ * record without application data, such as a TLS 1.3 session ticket
+ * sent after the handshake, would block rather than end the stream.
+ *
+ * Return: Number of bytes read, 0 when the peer closed the connection,
+ * or -1 with errno set to EAGAIN if it would block, or EIO on failure
+ */
+ssize_t tls_read(struct tls *tls, char *buffer, size_t len)
+{
+    ERR_clear_error();
+    errno = 0;
+
+    int rc = SSL_read(tls->session, buffer,
+        (len > INT_MAX) ? INT_MAX : (int)len);
+
+    if (rc > 0) {
+        tls->want = 0;
+        return rc;
+    }
+
+    if (tls_retry(tls, rc, "read") == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (SSL_get_shutdown(tls->session) & SSL_RECEIVED_SHUTDOWN) {
+        return 0;
+    }
+
+    errno = EIO;
+
+    return -1;
+}
+
+/**
+ * tls_write() - Encrypt and send data
+ * @tls: TLS structure
+ * @buffer: Data to send
+ * @len: Number of bytes to send
+ *
+ * Partial writes are enabled, so this behaves like write() on a
+ * non-blocking socket.
+ *
+ * Return: Number of bytes written, or -1 with errno set to EAGAIN if
+ * it would block, or EIO on failure
+ */
+ssize_t tls_write(struct tls *tls, const char *buffer, size_t len)
+{
+    ERR_clear_error();
+    errno = 0;
+
+    int rc = SSL_write(tls->session, buffer,
+        (len > INT_MAX) ? INT_MAX : (int)len);
+
+    if (rc > 0) {
+        tls->want = 0;
+        return rc;
+    }
+
+    errno = (tls_retry(tls, rc, "write") == 0) ? EAGAIN : EIO;
+
+    return -1;
+}
+
+/**
+ * tls_pending() - Decrypted bytes buffered inside the library
+ * @tls: TLS structure
+ *
+ * These bytes are already off the socket, so poll() will not report
+ * them. Callers must keep reading while this is non-zero.
+ *
+ * Return: Number of buffered bytes
+ */
+size_t tls_pending(struct tls *tls)
+{
+    if (tls->session == NULL) {
+        return 0;
+    }
+
+    return (size_t)SSL_pending(tls->session);
+}
+
+/**
+ * tls_describe() - Summarize the negotiated connection
+ * @tls: TLS structure after a completed handshake
+ * @buffer: Destination buffer
+ * @len: Size of @buffer
+ *
+ * Return: 0 on success, -1 if no session is active
+ */
+int tls_describe(struct tls *tls, char *buffer, size_t len)
+{
+    if (tls->session == NULL) {
+        return -1;
+    }
+
+    snprintf(buffer, len, "%s %s%s", SSL_get_version(tls->session),
+        SSL_get_cipher_name(tls->session),
+        tls->resumed ? ", session resumed" : "");
+
+    return 0;
+}
+
+/**
+ * tls_close() - Tear down the TLS session
+ * @tls: TLS structure
+ *
+ * Sends close_notify without waiting for the peer's reply and frees the
+ * library state. The socket itself is closed by the transport.
+ *
+ * Return: 0 on success, -1 if tls is NULL
+ */
+int tls_close(struct tls *tls)
+{
+    if (tls == NULL) {
+        return -1;
+    }
+
+    if (tls->session != NULL) {
+        SSL_shutdown(tls->session);
+        SSL_free(tls->session);
+        tls->session = NULL;
+    }
+
+    if (tls->config != NULL) {
+        SSL_CTX_free(tls->config);
+        tls->config = NULL;
+    }
+
+    ERR_clear_error();
+    tls->want = 0;
+
+    return 0;
+}
+
+#else  /* no TLS backend */
+
+int tls_start(struct tls *tls, int fd)
+{
+    (void)fd;
+    snprintf(tls->error, sizeof(tls->error),
+        "TLS support not compiled in");
+    return -1;
+}
+
+int tls_handshake(struct tls *tls)
+{
+    return -1;
+}
+
+ssize_t tls_read(struct tls *tls, char *buffer, size_t len)
+{
+    errno = EIO;
+    return -1;
+}
+
+ssize_t tls_write(struct tls *tls, const char *buffer, size_t len)
+{
+    errno = EIO;
+    return -1;
+}
+
+size_t tls_pending(struct tls *tls)
+{
+    return 0;
+}
+
+int tls_describe(struct tls *tls, char *buffer, size_t len)
+{
+    return -1;
+}
+
+int tls_close(struct tls *tls)
+{
+    return (tls == NULL) ? -1 : 0;
+}
+
+#endif
+
+/**
+ * tls_init() - Initialize TLS structure
+ * @tls: TLS structure to initialize
+ * @ctx: IRC context with server and certificate settings
+ *
+ * Zeroes the structure and derives the session cache file from the
+ * server and port: $XDG_CACHE_HOME/kirc-<server>-<port>.session, or
+ * ~/.cache/... when XDG_CACHE_HOME is unset. Without either variable
+ * sessions are not cached.
+ *
+ * Return: 0 on success, -1 if tls or ctx is NULL
+ */
+int tls_init(struct tls *tls, struct kirc_context *ctx)
+{
+    if ((tls == NULL) || (ctx == NULL)) {
+        return -1;
+    }
+
+    memset(tls, 0, sizeof(*tls));
+    tls->ctx = ctx;
+
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if ((cache != NULL) && (*cache != '\0')) {
+        snprintf(tls->session_path, sizeof(tls->session_path),
+            "%s/kirc-%s-%s.session", cache, ctx->server, ctx->port);
+    } else if ((home != NULL) && (*home != '\0')) {
+        snprintf(tls->session_path, sizeof(tls->session_path),
+            "%s/.cache/kirc-%s-%s.session", home, ctx->server, ctx->port);
+    }
+
+    return 0;
+}
@@ -7,34 +7,6 @@
 
 #include "transport.h"
 
-/**
- * poll_wait_write() - Wait for socket to be writable
- * @fd: File descriptor to poll
- * @timeout_ms: Timeout in milliseconds
- *
- * Polls a file descriptor for write readiness, handling EINTR by retrying.
- * Used during non-blocking connect() to wait for connection completion.
- *
- * Return: 0 if ready for write, -1 on timeout or error
- */
-static int poll_wait_write(int fd, int timeout_ms)
-{
-    struct pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLOUT;
-
-    for (;;) {
-        int rc = poll(&pfd, 1, timeout_ms);
-        if (rc > 0)
-            return 0;  /* ready */
-        if (rc == 0)
-            return -1;  /* timeout */
-        if (errno == EINTR)
-            continue;
-        return -1;  /* error */
-    }
-}
-
 /**
  * transport_send() - Send data over transport connection
  * @transport: Transport structure
@@ -55,6 +27,9 @@ ssize_t transport_send(struct transport *transport,
     if (transport->fd < 0)
         return -1;
 
+    if (transport->secure)
+        return tls_write(&transport->tls, buffer, len);
+
     ssize_t rc = write(transport->fd,
         buffer, len);
 
@@ -64,17 +39,63 @@ ssize_t transport_send(struct transport *transport,
     return rc;
 }
 
+/**
+ * transport_sendv() - Send scattered data over transport connection
+ * @transport: Transport structure
+ * @iov: Array of buffers to send in order
+ * @iovcnt: Number of entries in @iov
+ *
+ * Gathers several buffers into a single writev() call. Like
+ * transport_send(), the write may be partial; errno is preserved so
+ * callers can tell EAGAIN/EWOULDBLOCK from real errors. Over TLS the
+ * buffers are written one record call at a time, stopping at the first
+ * short write.
+ *
+ * Return: Number of bytes written, or -1 on error
+ */
+ssize_t transport_sendv(struct transport *transport,
+        const struct iovec *iov, int iovcnt)
+{
+    if (transport == NULL)
+        return -1;
+
+    if (transport->fd < 0)
+        return -1;
+
+    if (!transport->secure)
+        return writev(transport->fd, iov, iovcnt);
+
+    ssize_t total = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+        ssize_t rc = tls_write(&transport->tls,
+            iov[i].iov_base, iov[i].iov_len);
+
+        if (rc < 0)
+            return (total > 0) ? total : -1;
+
+        total += rc;
+
+        if ((size_t)rc < iov[i].iov_len)
+            break;
+    }
+
+    return total;
+}
+
 /**
  * transport_receive() - Receive data from transport connection
  * @transport: Transport structure
  * @buffer: Buffer to store received data
  * @len: Maximum number of bytes to receive
  *
- * Reads data from the transport file descriptor. Handles non-blocking
- * I/O by distinguishing between EAGAIN/EWOULDBLOCK (no data available)
- * and other errors. Returns -1 on connection close (nread == 0).
+ * Reads data from the transport file descriptor, or decrypted data over
+ * TLS. Both behave like read() on a non-blocking socket, so callers
+ * tell EAGAIN/EWOULDBLOCK (no data available) from the connection
+ * closing or failing.
  *
- * Return: Number of bytes read, 0 if would block, -1 on error or disconnect
+ * Return: Number of bytes read, 0 on disconnect, or -1 with errno set
+ * to EAGAIN if it would block, or to the error
  */
 ssize_t transport_receive(struct transport *transport,
         char *buffer, size_t len)
@@ -85,110 +106,593 @@ ssize_t transport_receive(struct transport *transport,
     if (transport->fd < 0)
         return -1;
 
-    ssize_t nread = read(transport->fd,
-        buffer, len);
+    if (transport->secure)
+        return tls_read(&transport->tls, buffer, len);
 
-    if (nread < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;
-        } else {
-            return -1;
-        } 
-    }
+    return read(transport->fd, buffer, len);
+}
 
-    if (nread == 0) {
-        return -1; 
-    }
+/**
+ * transport_pending() - Received bytes not visible to poll()
+ * @transport: Transport structure
+ *
+ * A TLS record may decrypt to more bytes than one transport_receive()
+ * call asks for; the rest waits inside the library, not on the socket.
+ *
+ * Return: Number of buffered bytes ready for transport_receive()
+ */
+size_t transport_pending(struct transport *transport)
+{
+    if (!transport->secure)
+        return 0;
+
+    return tls_pending(&transport->tls);
+}
+
+/**
+ * transport_events() - Extra poll events the transport is waiting for
+ * @transport: Transport structure
+ *
+ * A TLS read can block on the socket becoming writable (and a write on
+ * it becoming readable). The caller adds these events to its pollfd and
+ * retries both directions when either fires.
+ *
+ * Return: POLLIN and/or POLLOUT, or 0
+ */
+short transport_events(struct transport *transport)
+{
+    if (!transport->secure)
+        return 0;
 
-    return nread;
+    return transport->tls.want;
 }
 
+/**
+ * transport_elapsed() - Milliseconds since a monotonic timestamp
+ * @since: Earlier CLOCK_MONOTONIC reading
+ *
+ * Return: Elapsed time in milliseconds
+ */
+static long transport_elapsed(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - since->tv_sec) * 1000 +
+        (now.tv_nsec - since->tv_nsec) / 1000000;
+}
 
 /**
- * transport_connect() - Establish transport connection to server
- * @transport: Transport structure with server details
+ * transport_resolve() - Resolver thread entry point
+ * @arg: Transport structure
  *
- * Creates a socket and connects to the server specified in the transport
- * context (server name and port). Uses getaddrinfo() for address resolution,
- * supporting both IPv4 and IPv6. Configures socket for non-blocking I/O
- * and handles EINPROGRESS for asynchronous connection with timeout.
+ * Runs getaddrinfo() off the main thread and signals completion by
+ * writing one byte to the resolver pipe. The results are only read
+ * by the main thread after pthread_join().
  *
- * Return: 0 on successful connection, -1 on failure
+ * Return: NULL
  */
-int transport_connect(struct transport *transport)
+static void *transport_resolve(void *arg)
 {
-    struct addrinfo hints, *res = NULL, *p = NULL;
+    struct transport *transport = arg;
+    struct addrinfo hints;
+
     memset(&hints, 0, sizeof(hints));
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_family = AF_UNSPEC;
 
-    int status = getaddrinfo(transport->ctx->server,
-        transport->ctx->port, &hints, &res);
+    transport->resolve_status = getaddrinfo(transport->ctx->server,
+        transport->ctx->port, &hints, &transport->addrs);
 
-    if (status != 0) {
-        fprintf(stderr, "getaddrinfo: %s\n",
-            gai_strerror(status));
+    char done = 1;
+
+    while ((write(transport->resolver_pipe[1], &done, 1) < 0) &&
+           (errno == EINTR)) {
+        continue;
+    }
+
+    return NULL;
+}
+
+/**
+ * transport_resolved() - Collect resolver results and order them
+ * @transport: Transport structure in TRANSPORT_RESOLVING state
+ *
+ * Joins the resolver thread and interleaves the returned addresses by
+ * family, starting with the family getaddrinfo() preferred, as RFC 8305
+ * recommends. At most KIRC_CONNECT_ATTEMPTS addresses are kept.
+ *
+ * Return: 0 on success, -1 if resolution failed
+ */
+static int transport_resolved(struct transport *transport)
+{
+    pthread_join(transport->resolver, NULL);
+    close(transport->resolver_pipe[0]);
+    close(transport->resolver_pipe[1]);
+    transport->resolver_pipe[0] = transport->resolver_pipe[1] = -1;
+
+    if (transport->resolve_status != 0) {
+        transport->addrs = NULL;
         return -1;
     }
 
-    transport->fd = -1;
+    struct addrinfo *primary = transport->addrs;
+    struct addrinfo *secondary = transport->addrs;
+    int family = transport->addrs->ai_family;
 
-    for (p = res; p; p = p->ai_next) {
-        int fd = socket(p->ai_family, p->ai_socktype,
-            p->ai_protocol);
+    transport->order_count = 0;
 
-        if (fd < 0) {
-            continue;
+    while (transport->order_count < KIRC_CONNECT_ATTEMPTS) {
+        while ((primary != NULL) && (primary->ai_family != family)) {
+            primary = primary->ai_next;
+        }
+
+        while ((secondary != NULL) && (secondary->ai_family == family)) {
+            secondary = secondary->ai_next;
         }
 
-        int flags = fcntl(fd, F_GETFL, 0);
-        
-        if (flags < 0) {
-            close(fd);
+        if ((primary == NULL) && (secondary == NULL)) {
+            break;
+        }
+
+        if (primary != NULL) {
+            transport->order[transport->order_count++] = primary;
+            primary = primary->ai_next;
+        }
+
+        if ((secondary != NULL) &&
+            (transport->order_count < KIRC_CONNECT_ATTEMPTS)) {
+            transport->order[transport->order_count++] = secondary;
+            secondary = secondary->ai_next;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * transport_attempt_finish() - Close a connection attempt
+ * @transport: Transport structure
+ * @attempt: Attempt to finish
+ * @error: errno value describing the outcome, 0 if it won
+ *
+ * Records the attempt's duration. The winning socket is handed over to
+ * transport->fd instead of being closed.
+ */
+static void transport_attempt_finish(struct transport *transport,
+        struct transport_attempt *attempt, int error)
+{
+    attempt->elapsed = transport_elapsed(&attempt->started);
+    attempt->error = error;
+
+    if (error == 0) {
+        transport->fd = attempt->fd;
+    } else {
+        close(attempt->fd);
+    }
+
+    attempt->fd = -1;
+}
+
+/**
+ * transport_attempt_start() - Begin connecting to the next address
+ * @transport: Transport structure in TRANSPORT_CONNECTING state
+ *
+ * Opens a non-blocking socket and issues connect() for the next address
+ * in order, then arms the stagger timer for the one after it. Attempts
+ * that fail synchronously are recorded as finished immediately.
+ *
+ * Return: 1 if the connection completed at once, 0 otherwise
+ */
+static int transport_attempt_start(struct transport *transport)
+{
+    struct addrinfo *p = transport->order[transport->order_next++];
+    struct transport_attempt *attempt =
+        &transport->attempts[transport->attempt_count++];
+
+    clock_gettime(CLOCK_MONOTONIC, &attempt->started);
+    transport->next_start = attempt->started;
+    transport->next_start.tv_nsec += KIRC_CONNECT_DELAY_MS * 1000000L;
+
+    if (transport->next_start.tv_nsec >= 1000000000L) {
+        transport->next_start.tv_sec++;
+        transport->next_start.tv_nsec -= 1000000000L;
+    }
+
+    const void *addr;
+
+    if (p->ai_family == AF_INET6) {
+        addr = &((struct sockaddr_in6 *)p->ai_addr)->sin6_addr;
+    } else {
+        addr = &((struct sockaddr_in *)p->ai_addr)->sin_addr;
+    }
+
+    if (inet_ntop(p->ai_family, addr, attempt->address,
+        sizeof(attempt->address)) == NULL) {
+        safecpy(attempt->address, "?", sizeof(attempt->address));
+    }
+
+    attempt->fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+
+    if (attempt->fd < 0) {
+        attempt->elapsed = 0;
+        attempt->error = errno;
+        return 0;
+    }
+
+    transport->opened++;
+
+    int flags = fcntl(attempt->fd, F_GETFL, 0);
+
+    if ((flags < 0) ||
+        (fcntl(attempt->fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        transport_attempt_finish(transport, attempt, errno);
+        return 0;
+    }
+
+    if (connect(attempt->fd, p->ai_addr, p->ai_addrlen) == 0) {
+        transport_attempt_finish(transport, attempt, 0);
+        return 1;
+    }
+
+    if (errno != EINPROGRESS) {
+        transport_attempt_finish(transport, attempt, errno);
+    }
+
+    return 0;
+}
+
+/**
+ * transport_handshake() - Advance the TLS handshake on the connection
+ * @transport: Transport structure in TRANSPORT_HANDSHAKE state
+ *
+ * Fails the connection once the handshake has taken KIRC_TIMEOUT_MS.
+ *
+ * Return: 1 once connected, 0 while in progress, -1 on failure
+ */
+static int transport_handshake(struct transport *transport)
+{
+    int rc = tls_handshake(&transport->tls);
+
+    transport->handshake_elapsed =
+        transport_elapsed(&transport->handshake_started);
+
+    if ((rc == 0) && (transport->handshake_elapsed >= KIRC_TIMEOUT_MS)) {
+        snprintf(transport->tls.error, sizeof(transport->tls.error),
+            "handshake timed out");
+        rc = -1;
+    }
+
+    if (rc < 0) {
+        tls_close(&transport->tls);
+        close(transport->fd);
+        transport->fd = -1;
+        transport->state = TRANSPORT_FAILED;
+        return -1;
+    }
+
+    if (rc > 0) {
+        transport->state = TRANSPORT_CONNECTED;
+    }
+
+    return rc;
+}
+
+/**
+ * transport_connect_start() - Begin an asynchronous connection
+ * @transport: Transport structure with server details
+ *
+ * Starts resolving the server name on a separate thread. Progress is
+ * driven by transport_connect_events(), transport_connect_timeout()
+ * and transport_connect_process(), so the caller's event loop keeps
+ * running while the connection is established.
+ *
+ * Return: 0 on success, -1 if the resolver could not be started
+ */
+int transport_connect_start(struct transport *transport)
+{
+    transport_free(transport);
+
+    transport->attempt_count = 0;
+    transport->order_count = 0;
+    transport->order_next = 0;
+
+    if (pipe(transport->resolver_pipe) < 0) {
+        transport->state = TRANSPORT_FAILED;
+        return -1;
+    }
+
+    transport->opened++;
+
+    if (pthread_create(&transport->resolver, NULL,
+        transport_resolve, transport) != 0) {
+        close(transport->resolver_pipe[0]);
+        close(transport->resolver_pipe[1]);
+        transport->resolver_pipe[0] = transport->resolver_pipe[1] = -1;
+        transport->state = TRANSPORT_FAILED;
+        return -1;
+    }
+
+    transport->state = TRANSPORT_RESOLVING;
+
+    return 0;
+}
+
+/**
+ * transport_connect_events() - Describe what the connection waits on
+ * @transport: Transport structure
+ * @fds: Array to fill with pollfd entries
+ * @n: Capacity of @fds
+ *
+ * While resolving, this is the resolver pipe; while connecting, every
+ * attempt still in flight, polled for writability; during the TLS
+ * handshake, the winning socket with whatever the handshake awaits.
+ *
+ * Return: Number of entries written to @fds
+ */
+int transport_connect_events(struct transport *transport,
+        struct pollfd *fds, int n)
+{
+    int count = 0;
+
+    if ((transport->state == TRANSPORT_RESOLVING) && (n > 0)) {
+        fds[count].fd = transport->resolver_pipe[0];
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        count++;
+    }
+
+    if ((transport->state == TRANSPORT_HANDSHAKE) && (n > 0)) {
+        fds[count].fd = transport->fd;
+        fds[count].events = transport->tls.want;
+        fds[count].revents = 0;
+        count++;
+    }
+
+    if (transport->state == TRANSPORT_CONNECTING) {
+        for (int i = 0; (i < transport->attempt_count) && (count < n); ++i) {
+            if (transport->attempts[i].fd < 0) {
+                continue;
+            }
+
+            fds[count].fd = transport->attempts[i].fd;
+            fds[count].events = POLLOUT;
+            fds[count].revents = 0;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * transport_connect_timeout() - Time until the next connection deadline
+ * @transport: Transport structure
+ *
+ * The nearest of the stagger timer for the next address and the
+ * KIRC_TIMEOUT_MS deadline of each attempt in flight, or of the TLS
+ * handshake.
+ *
+ * Return: Milliseconds to wait, or -1 if only fd events are pending
+ */
+int transport_connect_timeout(struct transport *transport)
+{
+    if (transport->state == TRANSPORT_HANDSHAKE) {
+        long left = KIRC_TIMEOUT_MS -
+            transport_elapsed(&transport->handshake_started);
+        return (left > 0) ? (int)left : 0;
+    }
+
+    if (transport->state != TRANSPORT_CONNECTING) {
+        return -1;
+    }
+
+    long timeout = -1;
+
+    if (transport->order_next < transport->order_count) {
+        long wait = -transport_elapsed(&transport->next_start);
+        timeout = (wait > 0) ? wait : 0;
+    }
+
+    for (int i = 0; i < transport->attempt_count; ++i) {
+        struct transport_attempt *attempt = &transport->attempts[i];
+
+        if (attempt->fd < 0) {
             continue;
         }
 
-        if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
-            close(fd);
+        long left = KIRC_TIMEOUT_MS - transport_elapsed(&attempt->started);
+
+        if (left < 0) {
+            left = 0;
+        }
+
+        if ((timeout < 0) || (left < timeout)) {
+            timeout = left;
+        }
+    }
+
+    return (int)timeout;
+}
+
+/**
+ * transport_connect_process() - Advance an asynchronous connection
+ * @transport: Transport structure
+ * @fds: pollfd entries from transport_connect_events(), after poll()
+ * @n: Number of entries in @fds
+ *
+ * Collects the resolver result, finishes attempts whose sockets became
+ * writable or timed out, and starts the next address whenever the
+ * stagger delay has passed or nothing else is in flight. The first
+ * attempt to complete wins; the rest are abandoned. For TLS, the
+ * handshake on the winning socket is driven here as well.
+ *
+ * Return: 1 once connected, 0 while in progress, -1 on failure
+ */
+int transport_connect_process(struct transport *transport,
+        struct pollfd *fds, int n)
+{
+    if (transport->state == TRANSPORT_RESOLVING) {
+        if ((n < 1) || !(fds[0].revents & (POLLIN | POLLHUP))) {
+            return 0;
+        }
+
+        if (transport_resolved(transport) < 0) {
+            transport->state = TRANSPORT_FAILED;
+            return -1;
+        }
+
+        transport->state = TRANSPORT_CONNECTING;
+        n = 0;
+    }
+
+    if (transport->state == TRANSPORT_HANDSHAKE) {
+        return transport_handshake(transport);
+    }
+
+    if (transport->state != TRANSPORT_CONNECTING) {
+        return (transport->state == TRANSPORT_CONNECTED) ? 1 : -1;
+    }
+
+    int won = 0;
+
+    for (int i = 0; i < transport->attempt_count; ++i) {
+        struct transport_attempt *attempt = &transport->attempts[i];
+
+        if (attempt->fd < 0) {
             continue;
         }
 
-        int rc = connect(fd, p->ai_addr, p->ai_addrlen);
+        short revents = 0;
 
-        if (rc == 0) {
-            transport->fd = fd;
-            break;
+        for (int j = 0; j < n; ++j) {
+            if (fds[j].fd == attempt->fd) {
+                revents = fds[j].revents;
+            }
+        }
+
+        if (won) {
+            transport_attempt_finish(transport, attempt, ECANCELED);
+        } else if (revents != 0) {
+            int soerr = 0;
+            socklen_t slen = sizeof(soerr);
+
+            if (getsockopt(attempt->fd, SOL_SOCKET, SO_ERROR,
+                &soerr, &slen) < 0) {
+                soerr = errno;
+            }
+
+            transport_attempt_finish(transport, attempt, soerr);
+            won = (soerr == 0);
+
+            if (!won) {
+                /* a failure releases the next address at once */
+                clock_gettime(CLOCK_MONOTONIC, &transport->next_start);
+            }
+        } else if (transport_elapsed(&attempt->started) >= KIRC_TIMEOUT_MS) {
+            transport_attempt_finish(transport, attempt, ETIMEDOUT);
         }
+    }
 
-        if (errno == EINPROGRESS) {
-            int timeout_ms = KIRC_TIMEOUT_MS;
-            int rc = poll_wait_write(fd, timeout_ms);
+    while (!won && (transport->order_next < transport->order_count)) {
+        int active = 0;
 
-            if (rc == 0) {
+        for (int i = 0; i < transport->attempt_count; ++i) {
+            active += (transport->attempts[i].fd >= 0);
+        }
 
-                int soerr = 0;
-                socklen_t slen = sizeof(soerr);
+        if (active && (transport_elapsed(&transport->next_start) < 0)) {
+            break;
+        }
 
-                getsockopt(fd, SOL_SOCKET, SO_ERROR,
-                    &soerr, &slen);
+        won = transport_attempt_start(transport);
+    }
 
-                if (soerr == 0) {
-                    transport->fd = fd;
-                    break;
-                }
+    if (won) {
+        for (int i = 0; i < transport->attempt_count; ++i) {
+            if (transport->attempts[i].fd >= 0) {
+                transport_attempt_finish(transport,
+                    &transport->attempts[i], ECANCELED);
             }
         }
 
-        close(fd);
+        freeaddrinfo(transport->addrs);
+        transport->addrs = NULL;
+
+        if (!transport->secure) {
+            transport->state = TRANSPORT_CONNECTED;
+            return 1;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &transport->handshake_started);
+
+        if (tls_start(&transport->tls, transport->fd) < 0) {
+            transport->state = TRANSPORT_FAILED;
+            return -1;
+        }
+
+        transport->state = TRANSPORT_HANDSHAKE;
+        return transport_handshake(transport);
+    }
+
+    for (int i = 0; i < transport->attempt_count; ++i) {
+        if (transport->attempts[i].fd >= 0) {
+            return 0;
+        }
+    }
+
+    if (transport->order_next < transport->order_count) {
+        return 0;
     }
 
-    freeaddrinfo(res);
+    freeaddrinfo(transport->addrs);
+    transport->addrs = NULL;
+    transport->state = TRANSPORT_FAILED;
 
-    if (transport->fd < 0) {
+    return -1;
+}
+
+/**
+ * transport_connect() - Establish transport connection to server
+ * @transport: Transport structure with server details
+ *
+ * Blocking wrapper around the asynchronous connect: resolves the server
+ * on a helper thread, then races the returned IPv4 and IPv6 addresses,
+ * starting a new attempt every KIRC_CONNECT_DELAY_MS until one
+ * succeeds, followed by the TLS handshake when enabled. The winning
+ * socket is left in non-blocking mode. Per-address outcomes remain in
+ * transport->attempts for diagnostics.
+ *
+ * Return: 0 on successful connection, -1 on failure
+ */
+int transport_connect(struct transport *transport)
+{
+    if (transport_connect_start(transport) < 0) {
         return -1;
     }
 
-    return 0;
+    for (;;) {
+        struct pollfd fds[KIRC_CONNECT_ATTEMPTS];
+        int n = transport_connect_events(transport, fds,
+            KIRC_CONNECT_ATTEMPTS);
+        int timeout = transport_connect_timeout(transport);
+
+        if (poll(fds, n, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            transport_free(transport);
+            transport->state = TRANSPORT_FAILED;
+            return -1;
+        }
+
+        int rc = transport_connect_process(transport, fds, n);
+
+        if (rc != 0) {
+            return (rc > 0) ? 0 : -1;
+        }
+    }
 }
 
 /**
@@ -198,7 +702,7 @@ int transport_connect(struct transport *transport)
  *
  * Initializes the transport layer, zeroing the structure and setting
  * the file descriptor to -1 (not connected). Associates transport with
- * IRC context for server and port information.
+ * IRC context for server, port and TLS settings.
  *
  * Return: 0 on success, -1 if transport or ctx is NULL
  */
@@ -213,8 +717,11 @@ int transport_init(struct transport *transport,
 
     transport->ctx = ctx;
     transport->fd = -1;
+    transport->resolver_pipe[0] = -1;
+    transport->resolver_pipe[1] = -1;
+    transport->secure = ctx->tls;
 
-    return 0;
+    return tls_init(&transport->tls, ctx);
 }
 
 /**
@@ -222,7 +729,9 @@ int transport_init(struct transport *transport,
  * @transport: Transport structure to free
  *
  * Closes the transport socket if open and resets the file descriptor
- * to -1. Should be called during cleanup to release resources.
+ * to -1. A connection still in progress is abandoned: the resolver
+ * thread is joined and pending attempts are closed. Should be called
+ * during cleanup to release resources.
  *
  * Return: 0 on success, -1 if transport is NULL
  */
@@ -232,9 +741,30 @@ int transport_free(struct transport *transport)
         return -1;
     }
 
+    if (transport->state == TRANSPORT_RESOLVING) {
+        transport_resolved(transport);
+    }
+
+    for (int i = 0; i < transport->attempt_count; ++i) {
+        if (transport->attempts[i].fd >= 0) {
+            close(transport->attempts[i].fd);
+            transport->attempts[i].fd = -1;
+        }
+    }
+
+    if (transport->addrs != NULL) {
+        freeaddrinfo(transport->addrs);
+        transport->addrs = NULL;
+    }
+
+    tls_close(&transport->tls);
+
     if (transport->fd != -1) {
         close(transport->fd);
         transport->fd = -1;
     }
+
+    transport->state = TRANSPORT_IDLE;
+
     return 0;
 }
@@ -7,6 +7,155 @@
  
 #include "utf8.h"
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Display widths come from wcwidth(), so they agree with the C library
+ * the terminal is most likely configured alike with, but each code
+ * point below UTF8_CACHE_LIMIT is only asked about once: the first
+ * lookup in a block of 256 code points fills the whole block into a
+ * table of 2-bit widths. Printable ASCII never reaches the table, and
+ * runs of it are counted 16 bytes at a time.
+ *
+ * Widths are summed per grapheme cluster rather than per code point:
+ * combining marks and other zero-width code points, emoji modifiers and
+ * anything joined by a ZERO WIDTH JOINER belong to the character before
+ * them, and two regional indicators form one flag, two columns wide.
+ */
+
+static unsigned char utf8_widths[UTF8_CACHE_LIMIT / 4];
+static unsigned char utf8_cached[UTF8_CACHE_LIMIT / UTF8_CACHE_BLOCK];
+
+/**
+ * utf8_decode() - Decode the code point at the start of a string
+ * @s: UTF-8 string
+ * @len: Bytes available at @s, at least 1
+ * @cp: Set to the code point, or U+FFFD for an invalid sequence
+ *
+ * Return: Number of bytes used, 1 for an invalid or cut-off sequence
+ */
+static int utf8_decode(const char *s, int len, uint32_t *cp)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    int n;
+    uint32_t min;
+
+    if (u[0] < 0x80) {
+        *cp = u[0];
+        return 1;
+    } else if ((u[0] & 0xE0) == 0xC0) {
+        *cp = u[0] & 0x1F;
+        n = 2;
+        min = 0x80;
+    } else if ((u[0] & 0xF0) == 0xE0) {
+        *cp = u[0] & 0x0F;
+        n = 3;
+        min = 0x800;
+    } else if ((u[0] & 0xF8) == 0xF0) {
+        *cp = u[0] & 0x07;
+        n = 4;
+        min = 0x10000;
+    } else {
+        *cp = 0xFFFD;
+        return 1;
+    }
+
+    if (n > len) {
+        *cp = 0xFFFD;
+        return 1;
+    }
+
+    for (int i = 1; i < n; ++i) {
+        if ((u[i] & 0xC0) != 0x80) {
+            *cp = 0xFFFD;
+            return 1;
+        }
+
+        *cp = (*cp << 6) | (u[i] & 0x3F);
+    }
+
+    if ((*cp < min) || (*cp > 0x10FFFF) ||
+        ((*cp >= 0xD800) && (*cp <= 0xDFFF))) {
+        *cp = 0xFFFD;
+        return 1;
+    }
+
+    return n;
+}
+
+/**
+ * utf8_codepoint_width() - Columns a code point takes on its own
+ * @cp: Code point
+ *
+ * Return: 0, 1 or 2; non-printable code points count as 0
+ */
+static int utf8_codepoint_width(uint32_t cp)
+{
+    if ((cp >= 0x20) && (cp < 0x7F)) {
+        return 1;
+    }
+
+    if (cp >= UTF8_CACHE_LIMIT) {
+        int w = wcwidth((wchar_t)cp);
+
+        return (w < 0) ? 0 : w;
+    }
+
+    uint32_t block = cp / UTF8_CACHE_BLOCK;
+
+    if (!utf8_cached[block]) {
+        uint32_t first = block * UTF8_CACHE_BLOCK;
+
+        for (uint32_t c = first; c < first + UTF8_CACHE_BLOCK; ++c) {
+            int w = wcwidth((wchar_t)c);
+
+            if (w < 0) {
+                w = 0;
+            }
+
+            utf8_widths[c / 4] |= (unsigned char)((w & 3) << ((c % 4) * 2));
+        }
+
+        utf8_cached[block] = 1;
+    }
+
+    return (utf8_widths[cp / 4] >> ((cp % 4) * 2)) & 3;
+}
+
+/**
+ * utf8_is_regional() - Check for a regional indicator symbol
+ * @cp: Code point
+ *
+ * Return: 1 for U+1F1E6 to U+1F1FF, 0 otherwise
+ */
+static int utf8_is_regional(uint32_t cp)
+{
+    return (cp >= 0x1F1E6) && (cp <= 0x1F1FF);
+}
+
+/**
+ * utf8_is_extend() - Check whether a code point joins the one before
+ * @cp: Code point
+ *
+ * Return: 1 for zero-width code points other than controls, such as
+ * combining marks, variation selectors and ZWJ, and for emoji
+ * modifiers; 0 otherwise
+ */
+static int utf8_is_extend(uint32_t cp)
+{
+    if (cp < 0xA0) {
+        return 0;  /* ASCII and controls */
+    }
+
+    if ((cp >= 0x1F3FB) && (cp <= 0x1F3FF)) {
+        return 1;
+    }
+
+    return utf8_codepoint_width(cp) == 0;
+}
+
 /**
  * utf8_prev_char_len() - Get byte length of previous UTF-8 character
  * @s: UTF-8 string
@@ -39,9 +188,9 @@ int utf8_prev_char_len(const char *s, int pos)
  * @pos: Current byte position in string
  * @maxlen: Maximum valid position in string
  *
- * Determines the byte length of the UTF-8 character at the given position
- * using mbrtowc(). Handles invalid sequences by treating them as single
- * bytes. Safely handles null characters and position boundaries.
+ * Determines the byte length of the UTF-8 character at the given position.
+ * Handles invalid sequences by treating them as single bytes. Safely
+ * handles null characters and position boundaries.
  *
  * Return: Number of bytes in next character (1-4), or 0 if at end
  */
@@ -51,23 +200,234 @@ int utf8_next_char_len(const char *s, int pos, int maxlen)
         return 0;
     }
 
-    mbstate_t st;
-    memset(&st, 0, sizeof(st));
-    
-    wchar_t wc;
-    size_t ret = mbrtowc(&wc, s + pos, maxlen - pos, &st);
-    
-    if (ret == (size_t)-1 || ret == (size_t)-2) {
-        /* Invalid UTF-8 sequence, treat as single byte */
-        return 1;
+    uint32_t cp;
+
+    return utf8_decode(s + pos, maxlen - pos, &cp);
+}
+
+/**
+ * utf8_next_cluster_len() - Get byte length of the next grapheme cluster
+ * @s: UTF-8 string
+ * @pos: Current byte position in string, at a cluster boundary
+ * @maxlen: Maximum valid position in string
+ *
+ * A cluster is a character with the combining marks, variation
+ * selectors and emoji modifiers that follow it, extended past every
+ * ZERO WIDTH JOINER to the character after it, or a pair of regional
+ * indicators. The cursor moves and deletes by whole clusters.
+ *
+ * Return: Number of bytes in the cluster, or 0 if at end
+ */
+int utf8_next_cluster_len(const char *s, int pos, int maxlen)
+{
+    if (pos >= maxlen) {
+        return 0;
     }
-    
-    if (ret == 0) {
-        /* Null character */
-        return 1;
+
+    uint32_t cp;
+    int end = pos + utf8_decode(s + pos, maxlen - pos, &cp);
+    int regional = utf8_is_regional(cp);
+    int join = 0;
+
+    while (end < maxlen) {
+        uint32_t next;
+        int n = utf8_decode(s + end, maxlen - end, &next);
+
+        if (join && (next >= 0x80)) {
+            join = 0;
+        } else if (next == 0x200D) {
+            join = 1;
+        } else if (utf8_is_extend(next)) {
+            join = 0;
+        } else if (regional && utf8_is_regional(next)) {
+            regional = 0;
+        } else {
+            break;
+        }
+
+        end += n;
     }
-    
-    return (int)ret;
+
+    return end - pos;
+}
+
+/**
+ * utf8_prev_cluster_len() - Get byte length of the previous grapheme cluster
+ * @s: UTF-8 string
+ * @pos: Current byte position in string, at a cluster boundary
+ *
+ * Walks back over the same clusters utf8_next_cluster_len() walks
+ * forward over. Regional indicators pair up counting from the start of
+ * their run.
+ *
+ * Return: Number of bytes in the cluster, or 0 if at start
+ */
+int utf8_prev_cluster_len(const char *s, int pos)
+{
+    if (pos <= 0) {
+        return 0;
+    }
+
+    int start = pos - utf8_prev_char_len(s, pos);
+    uint32_t cp;
+
+    utf8_decode(s + start, pos - start, &cp);
+
+    while (start > 0) {
+        int prev = start - utf8_prev_char_len(s, start);
+        uint32_t pcp;
+
+        utf8_decode(s + prev, start - prev, &pcp);
+
+        if (utf8_is_extend(cp) || ((pcp == 0x200D) && (cp >= 0x80))) {
+            start = prev;
+            cp = pcp;
+            continue;
+        }
+
+        if (utf8_is_regional(cp) && utf8_is_regional(pcp)) {
+            int run = 0;
+
+            for (int i = start; i > 0; ) {
+                int j = i - utf8_prev_char_len(s, i);
+                uint32_t r;
+
+                utf8_decode(s + j, i - j, &r);
+
+                if (!utf8_is_regional(r)) {
+                    break;
+                }
+
+                run++;
+                i = j;
+            }
+
+            if (run % 2 == 1) {
+                start = prev;
+            }
+        }
+
+        break;
+    }
+
+    return pos - start;
+}
+
+/**
+ * utf8_ascii_run() - Count leading printable ASCII bytes
+ * @s: UTF-8 string
+ * @len: Number of bytes at @s
+ *
+ * Checks 16 bytes at a time with SSE2, or 8 with a portable SWAR test.
+ *
+ * Return: Length of the run of bytes 0x20 to 0x7E at the start of @s,
+ * rounded down to whole blocks; the caller decodes the rest
+ */
+static int utf8_ascii_run(const char *s, int len)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i low = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    /* bytes of 0x80 and up compare as negative, so fail the test */
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i ok = _mm_andnot_si128(_mm_cmpeq_epi8(v, del),
+            _mm_cmpgt_epi8(v, low));
+
+        if (_mm_movemask_epi8(ok) != 0xffff) {
+            break;
+        }
+
+        i += 16;
+    }
+#else
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    while (i + 8 <= len) {
+        uint64_t v;
+        memcpy(&v, s + i, sizeof(v));
+
+        uint64_t del = v ^ (ones * 0x7F);
+
+        /* a byte of 0x80 and up, below 0x20, or DEL */
+        if ((v | ((v - ones * 0x20) & ~v) | ((del - ones) & ~del)) & highs) {
+            break;
+        }
+
+        i += 8;
+    }
+#endif
+
+    return i;
+}
+
+/**
+ * utf8_width() - Calculate display width of a UTF-8 string
+ * @s: UTF-8 string
+ * @len: Number of bytes to measure
+ *
+ * Computes the number of terminal columns taken by a string, counting
+ * each grapheme cluster by its first character: wide characters such as
+ * CJK take two columns, zero-width and non-printable code points none.
+ * Invalid bytes count as one column each.
+ *
+ * Return: Display width in terminal columns
+ */
+int utf8_width(const char *s, int len)
+{
+    int width = 0;
+    int pos = 0;
+    int join = 0;
+    int regional = 0;
+
+    while (pos < len) {
+        if (!join) {
+            int run = utf8_ascii_run(s + pos, len - pos);
+
+            width += run;
+            pos += run;
+
+            if (pos == len) {
+                break;
+            }
+
+            if (run > 0) {
+                regional = 0;
+            }
+        }
+
+        uint32_t cp;
+        int n = utf8_decode(s + pos, len - pos, &cp);
+
+        pos += n;
+
+        if (join && (cp >= 0x80)) {
+            join = 0;
+            continue;
+        }
+
+        join = (cp == 0x200D);
+
+        if (utf8_is_extend(cp)) {
+            continue;
+        }
+
+        if (utf8_is_regional(cp)) {
+            /* the first of a pair takes both columns */
+            width += regional ? 0 : 2;
+            regional = !regional;
+            continue;
+        }
+
+        regional = 0;
+        width += utf8_codepoint_width(cp);
+    }
+
+    return width;
 }
 
 /**
@@ -0,0 +1,103 @@
+/*
+ * timer.c
+ * Regression checks for the timer wheel
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "timer.h"
+
+/*
+ * The wheel is driven the way the main loop drives it: sleep for
+ * timer_timeout(), then timer_advance(). Time is simulated by moving
+ * the wheel's origin back, so a timer minutes away is checked at once.
+ * A wakeup just before a higher-level boundary, e.g. for some other
+ * descriptor, used to leave the wheel on that boundary without
+ * cascading it, and the timers there fired a whole turn late.
+ */
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+
+    if (!ok) {
+        failures++;
+    }
+}
+
+static void fired(struct timer *timer, void *data)
+{
+    (void)timer;
+    *(int *)data = 1;
+}
+
+/* move the simulated clock forward by @ms */
+static void elapse(struct timer_wheel *wheel, long ms)
+{
+    wheel->origin.tv_sec -= ms / 1000;
+    wheel->origin.tv_nsec -= (ms % 1000) * 1000000L;
+
+    if (wheel->origin.tv_nsec < 0) {
+        wheel->origin.tv_sec--;
+        wheel->origin.tv_nsec += 1000000000L;
+    }
+}
+
+/**
+ * run() - Arm one timer and drive the wheel until it fires
+ * @delay: Delay of the timer in milliseconds
+ * @wakeup: Time of one extra wakeup, or -1 for none
+ *
+ * Return: Simulated time at which the timer fired
+ */
+static long run(long delay, long wakeup)
+{
+    struct timer_wheel wheel;
+    struct timer timer;
+    int done = 0;
+    long now = 0;
+
+    timer_init(&wheel);
+    timer_setup(&timer, fired, &done);
+    timer_start(&wheel, &timer, delay);
+
+    while (!done && (now < 100 * delay)) {
+        long wait = timer_timeout(&wheel);
+
+        if ((wakeup > now) && (wakeup < now + wait)) {
+            wait = wakeup - now;
+        }
+
+        elapse(&wheel, wait);
+        now += wait;
+        timer_advance(&wheel);
+    }
+
+    return now;
+}
+
+static void check_fires(long delay, long wakeup, const char *what)
+{
+    long at = run(delay, wakeup);
+
+    /* real time passes too, so allow a tick either way */
+    check((at >= delay - KIRC_TIMER_TICK_MS) &&
+        (at <= delay + 2 * KIRC_TIMER_TICK_MS), what);
+}
+
+int main(void)
+{
+    long level1 = (long)TIMER_SLOTS * KIRC_TIMER_TICK_MS;
+    long level2 = level1 * TIMER_SLOTS;
+
+    check_fires(1000, -1, "timer fires on time");
+    check_fires(1000, level1 - 5,
+        "wakeup before a level 1 boundary does not delay a timer");
+    check_fires(90000, -1, "level 2 timer fires on time");
+    check_fires(90000, 2 * level2 - 5,
+        "wakeup before a level 2 boundary does not delay a timer");
+
+    return (failures == 0) ? 0 : 1;
+}
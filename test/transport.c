@@ -0,0 +1,158 @@
+/*
+ * transport.c
+ * Regression checks for reading from a connection
+ * Author: Michael Czigler
+ * License: MIT
+ */
+
+#include "network.h"
+
+/*
+ * A read that finds no data must not look like the peer closing the
+ * connection. Over TLS 1.3 the first read after the handshake often
+ * finds only a session ticket, and treating that as end of stream made
+ * every TLS connection drop before registration.
+ */
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+
+    if (!ok) {
+        failures++;
+    }
+}
+
+static void check_plain(struct kirc_context *ctx)
+{
+    struct transport transport;
+    char buffer[64];
+    int sv[2];
+
+    transport_init(&transport, ctx);
+    transport.secure = 0;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        check(0, "socketpair");
+        return;
+    }
+
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    transport.fd = sv[0];
+
+    errno = 0;
+    ssize_t rc = transport_receive(&transport, buffer, sizeof(buffer));
+    check((rc < 0) && (errno == EAGAIN || errno == EWOULDBLOCK),
+        "plain read without data would block");
+
+    if (write(sv[1], "PING :x\r\n", 9) != 9) {
+        check(0, "write");
+    }
+
+    rc = transport_receive(&transport, buffer, sizeof(buffer));
+    check(rc == 9, "plain read returns the data");
+
+    close(sv[1]);
+    rc = transport_receive(&transport, buffer, sizeof(buffer));
+    check(rc == 0, "plain read after close is end of stream");
+
+    transport_free(&transport);
+}
+
+static void check_network(struct kirc_context *ctx)
+{
+    struct transport transport;
+    struct network network;
+    struct timer_wheel wheel;
+    struct scrollback scrollback;
+    int sv[2];
+
+    timer_init(&wheel);
+    scrollback_init(&scrollback, KIRC_SCROLLBACK_MEMORY);
+    transport_init(&transport, ctx);
+    transport.secure = 0;
+
+    if ((network_init(&network, &transport, ctx, &wheel,
+        &scrollback) < 0) || (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)) {
+        check(0, "network_init");
+        return;
+    }
+
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    transport.fd = sv[0];
+
+    check(network_receive(&network) == 0,
+        "network_receive without data is not a disconnect");
+
+    if (write(sv[1], "PING :x\r\n", 9) != 9) {
+        check(0, "write");
+    }
+
+    check(network_receive(&network) == 9, "network_receive reads data");
+
+    char *msg = network_next_message(&network);
+    check((msg != NULL) && (strcmp(msg, "PING :x") == 0),
+        "network_next_message returns the line");
+
+    close(sv[1]);
+    check(network_receive(&network) < 0, "network_receive sees the close");
+
+    network_free(&network);
+    scrollback_free(&scrollback);
+}
+
+#if defined(KIRC_TLS_OPENSSL)
+static void check_tls(struct kirc_context *ctx)
+{
+    struct transport transport;
+    char buffer[64];
+    int sv[2];
+
+    transport_init(&transport, ctx);
+    transport.secure = 1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        check(0, "socketpair");
+        return;
+    }
+
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    transport.fd = sv[0];
+
+    if (tls_start(&transport.tls, transport.fd) < 0) {
+        check(0, transport.tls.error);
+        return;
+    }
+
+    /* the peer stays silent, so the library sends its hello and waits */
+    errno = 0;
+    ssize_t rc = transport_receive(&transport, buffer, sizeof(buffer));
+    check((rc < 0) && (errno == EAGAIN) && (transport.tls.want == POLLIN),
+        "tls read without data would block");
+
+    close(sv[1]);
+    transport_free(&transport);
+}
+#endif
+
+int main(void)
+{
+    struct kirc_context ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+    safecpy(ctx.server, "127.0.0.1", sizeof(ctx.server));
+    safecpy(ctx.port, KIRC_DEFAULT_PORT, sizeof(ctx.port));
+    safecpy(ctx.nickname, "tester", sizeof(ctx.nickname));
+    ctx.flood_burst = KIRC_FLOOD_BURST;
+    ctx.flood_interval = KIRC_FLOOD_INTERVAL_MS;
+
+    check_plain(&ctx);
+    check_network(&ctx);
+#if defined(KIRC_TLS_OPENSSL)
+    check_tls(&ctx);
+#endif
+
+    return (failures == 0) ? 0 : 1;
+}